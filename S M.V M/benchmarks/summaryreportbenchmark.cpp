@@ -0,0 +1,160 @@
+#include "database/database.h"
+#include "reports/reports.h"
+#include <QCoreApplication>
+#include <QSqlDriver>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QElapsedTimer>
+#include <QDate>
+#include <QDebug>
+#include <sqlite3.h>
+
+// Seeds an in-memory database with 10 and then 200 classes and checks that
+// Reports::generateSummaryReport executes the same number of statements for
+// both, so the summary stays a fixed set of grouped queries. Counts come from
+// SQLite's statement trace on Qt's own connection.
+
+namespace {
+
+const int kSmallClassCount = 10;
+const int kLargeClassCount = 200;
+const int kStudentsPerClass = 30;
+const int kDays = 20;
+
+int countStatement(unsigned, void *counter, void *, void *)
+{
+    ++*static_cast<int *>(counter);
+    return 0;
+}
+
+sqlite3 *sqliteHandle(const QSqlDatabase &db)
+{
+    QVariant handle = db.driver()->handle();
+    if (handle.isValid() && qstrcmp(handle.typeName(), "sqlite3*") == 0) {
+        return *static_cast<sqlite3 *const *>(handle.constData());
+    }
+    return nullptr;
+}
+
+// Logs why seeding stopped and drops the half-written seed
+bool abortSeed(QSqlDatabase db, const char *what, const QSqlQuery &query)
+{
+    qDebug() << what << query.lastError().text();
+    db.rollback();
+    return false;
+}
+
+// Replaces every class, student and attendance row; not traced
+bool seed(QSqlDatabase db, int classCount, const QDate &fromDate)
+{
+    if (!db.transaction()) {
+        qDebug() << "Failed to start the benchmark seed:" << db.lastError().text();
+        return false;
+    }
+
+    QSqlQuery query(db);
+    if (!query.exec("DELETE FROM attendance") || !query.exec("DELETE FROM students")
+        || !query.exec("DELETE FROM classes")) {
+        return abortSeed(db, "Failed to clear benchmark data:", query);
+    }
+
+    QSqlQuery classQuery(db);
+    QSqlQuery studentQuery(db);
+    QSqlQuery attendanceQuery(db);
+    classQuery.prepare("INSERT INTO classes (id, name, grade, description) VALUES (?, ?, ?, ?)");
+    studentQuery.prepare("INSERT INTO students (id, roll_no, name, class_id) VALUES (?, ?, ?, ?)");
+    attendanceQuery.prepare("INSERT INTO attendance (student_id, class_id, date, status) VALUES (?, ?, ?, ?)");
+
+    int studentId = 0;
+    for (int classId = 1; classId <= classCount; ++classId) {
+        classQuery.addBindValue(classId);
+        classQuery.addBindValue(QString("Class %1").arg(classId));
+        classQuery.addBindValue(classId % 12 + 1);
+        classQuery.addBindValue(QString("Section %1").arg(classId));
+        if (!classQuery.exec()) {
+            return abortSeed(db, "Failed to seed classes:", classQuery);
+        }
+
+        for (int i = 0; i < kStudentsPerClass; ++i) {
+            ++studentId;
+            studentQuery.addBindValue(studentId);
+            studentQuery.addBindValue(QString("R%1").arg(studentId));
+            studentQuery.addBindValue(QString("Student %1").arg(studentId));
+            studentQuery.addBindValue(classId);
+            if (!studentQuery.exec()) {
+                return abortSeed(db, "Failed to seed students:", studentQuery);
+            }
+
+            for (int day = 0; day < kDays; ++day) {
+                attendanceQuery.addBindValue(studentId);
+                attendanceQuery.addBindValue(classId);
+                attendanceQuery.addBindValue(fromDate.addDays(day));
+                attendanceQuery.addBindValue((studentId + day) % 4);
+                if (!attendanceQuery.exec()) {
+                    return abortSeed(db, "Failed to seed attendance:", attendanceQuery);
+                }
+            }
+        }
+    }
+
+    if (!db.commit()) {
+        qDebug() << "Failed to commit the benchmark seed:" << db.lastError().text();
+        db.rollback();
+        return false;
+    }
+    return true;
+}
+
+// Statements executed by one summary report, or -1 when seeding failed
+int summaryStatements(Reports &reports, QSqlDatabase db, sqlite3 *handle, int classCount)
+{
+    QDate fromDate(2024, 1, 1);
+    QDate toDate = fromDate.addDays(kDays - 1);
+    if (!seed(db, classCount, fromDate)) {
+        return -1;
+    }
+
+    int statements = 0;
+    QElapsedTimer timer;
+    sqlite3_trace_v2(handle, SQLITE_TRACE_STMT, countStatement, &statements);
+    timer.start();
+    reports.generateSummaryReport(fromDate, toDate);
+    qint64 elapsed = timer.elapsed();
+    sqlite3_trace_v2(handle, 0, nullptr, nullptr);
+
+    qInfo().noquote() << QString("%1 classes: %2 statements, %3 ms").arg(classCount).arg(statements).arg(elapsed);
+    return statements;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    Database database;
+    database.setDatabasePath(":memory:");
+    if (!database.initialize()) {
+        return 1;
+    }
+
+    QSqlDatabase db = database.database();
+    sqlite3 *handle = sqliteHandle(db);
+    if (!handle) {
+        qDebug() << "Qt's SQLite driver does not expose a sqlite3 handle";
+        return 1;
+    }
+
+    Reports reports(&database);
+    int small = summaryStatements(reports, db, handle, kSmallClassCount);
+    int large = summaryStatements(reports, db, handle, kLargeClassCount);
+    if (small < 0 || large < 0) {
+        return 1;
+    }
+
+    if (small != large) {
+        qDebug() << "Summary report statements grow with the class count:" << small << "vs" << large;
+        return 1;
+    }
+    return 0;
+}
@@ -7,8 +7,20 @@
 #include <QJsonObject>
 #include <QFile>
 #include <QRegularExpression>
+#include <QHash>
+#include <QPair>
+#include <QVector>
+#include <QStringList>
+#include "attendance/leaveindex.h"
 
 class QNetworkAccessManager;
+class AttendanceRuleEngine;
+class AttendanceScheduler;
+class AttendanceJournal;
+class AttendanceExporter;
+class PeriodAttendance;
+class AttendanceAnomalyDetector;
+struct RuleOutcome;
 
 // Data structures for advanced attendance
 struct AttendanceEntry {
@@ -36,6 +48,27 @@ struct AttendanceStats {
     double attendancePercentage = 0.0;
 };
 
+// Per-student stats for one class in a flat array (index i = studentRolls[i])
+// plus class aggregates over the students who have any attendance in range
+struct ClassAttendanceStats {
+    QString grade;
+    QString section;
+    QStringList studentRolls;
+    QVector<AttendanceStats> students;
+    AttendanceStats classTotals;
+    int studentsWithData = 0;
+    double meanPercentage = 0.0;
+    double medianPercentage = 0.0;
+    double p10Percentage = 0.0;
+    double p25Percentage = 0.0;
+    double p75Percentage = 0.0;
+    double p90Percentage = 0.0;
+    double threshold = 75.0;
+    int belowThreshold = 0;
+
+    int indexOf(const QString &studentRoll) const { return studentRolls.indexOf(studentRoll); }
+};
+
 struct BiometricData {
     QString studentRoll;
     QString fingerprintHash;
@@ -98,8 +131,9 @@ public:
     
     // Statistics and analytics
     AttendanceStats getAttendanceStats(const QString &studentRoll, const QDate &fromDate, const QDate &toDate);
-    QMap<QString, AttendanceStats> getClassAttendanceStats(const QString &grade, const QString &section,
-                                                          const QDate &fromDate, const QDate &toDate);
+    ClassAttendanceStats getClassAttendanceStats(const QString &grade, const QString &section,
+                                                 const QDate &fromDate, const QDate &toDate,
+                                                 double threshold = 75.0);
     
     // Biometric and advanced features
     bool setBiometricData(const QString &studentRoll, const BiometricData &data);
@@ -109,6 +143,7 @@ public:
     // Rules and automation
     bool addAttendanceRule(const AttendanceRule &rule);
     QList<AttendanceRule> getAttendanceRules();
+    void reloadAttendanceRules();
     void processAutoAttendance();
     
     // Reporting and export
@@ -128,20 +163,52 @@ public:
     
     // Utility functions
     QList<QString> getDefaultStudents(const QDate &date);
+    int pendingAttendanceWrites() const;
     bool bulkMarkAttendance(const QList<AttendanceEntry> &entries);
+    // Per-period marks for the secondary section; its tables are created with ours
+    PeriodAttendance *periodAttendance() const { return m_periodAttendance; }
     
     // Database management
     bool createDatabaseTables();
 
+public slots:
+    // Stops a running exportAttendanceData; the partial file is removed and the export returns false
+    void cancelExport();
+
 signals:
     void attendanceMarked(const QString &studentRoll, const QString &status);
     void timeOutMarked(const QString &studentRoll, const QTime &timeOut);
     void reportGenerated(const QString &grade, const QString &section);
     void leaveRequestSubmitted(const QString &studentRoll);
     void leaveRequestApproved(int requestId);
+    void attendanceAlertRaised(const AttendanceAlert &alert);
+    void exportProgress(qint64 rowsWritten, int percent);
 
 private:
-    QTimer *m_autoMarkTimer;
+    void ensureRulesLoaded();
+    void startAutoMarkScheduler();
+    void loadScheduleSettings();
+    QList<QTime> autoMarkDeadlines() const;
+    void resolveStudentClass(AttendanceEntry &entry) const;
+    RuleOutcome prepareEntry(AttendanceEntry &entry);
+    bool writeAttendance(const QList<AttendanceEntry> &entries);
+    bool insertAttendance(const QList<AttendanceEntry> &entries);
+    bool ensureJournalOpen();
+    void applyRuleOutcome(const RuleOutcome &outcome);
+    void ensureLeavesLoaded();
+    bool applyApprovedLeave(AttendanceEntry &entry);
+    bool excuseLeaveDays(const QString &studentRoll, const QDate &fromDate, const QDate &toDate,
+                         int requestId, const QString &approvedBy);
+
+    AttendanceScheduler *m_autoMarkScheduler;
+    AttendanceRuleEngine *m_ruleEngine;
+    AttendanceJournal *m_journal;
+    AttendanceExporter *m_exporter;
+    PeriodAttendance *m_periodAttendance;
+    AttendanceAnomalyDetector *m_anomalyDetector;
+    bool m_rulesLoaded;
+    QHash<QString, QPair<QString, QString>> m_studentClasses;
+    LeaveIndex m_leaveIndex;
 };
 
 #endif // ADVANCEDATTENDANCE_H
@@ -0,0 +1,86 @@
+#ifndef ATTENDANCEANOMALYDETECTOR_H
+#define ATTENDANCEANOMALYDETECTOR_H
+
+#include <QObject>
+#include <QDate>
+#include <QHash>
+#include <QPair>
+#include <QTimer>
+#include "attendance/advancedattendance.h"
+
+// Streaming detector for unusual class absenteeism. Every attendance write
+// updates today's per-class counters in O(1); each class keeps an EWMA
+// baseline (mean and variance of the daily absence rate) per weekday that
+// is folded forward once per day, so the baseline never rescans history.
+// The day closes when the wall-clock date moves on, never because of the
+// date on a mark.
+class AttendanceAnomalyDetector : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AttendanceAnomalyDetector(QObject *parent = nullptr);
+    ~AttendanceAnomalyDetector();
+
+    // Tuning
+    void setSmoothing(double alpha) { m_alpha = alpha; }
+    void setMinimumSamples(int samples) { m_minimumSamples = samples; }
+    void setClassSizes(const QHash<QString, int> &sizes);
+
+    // Restores baselines, folds days missed while closed and rebuilds today's counters
+    bool load(const QDate &today = QDate::currentDate());
+
+    // Feed; entries for other days than the current one, future dates included, are ignored
+    void record(const AttendanceEntry &entry);
+
+    // Baseline inspection
+    double baselineRate(const QString &grade, const QString &section, int weekday) const;
+    double todayRate(const QString &grade, const QString &section) const;
+
+    bool createDatabaseTables();
+
+signals:
+    void anomalyDetected(const AttendanceAlert &alert);
+
+private slots:
+    void rollOver();
+
+private:
+    struct Baseline {
+        double mean = 0.0;
+        double variance = 0.0;
+        int samples = 0;
+    };
+
+    struct ClassDay {
+        QString grade;
+        QString section;
+        int marked = 0;
+        int away = 0;             // Absent or Excused
+        int raisedLevel = 0;      // Highest severity already alerted today
+    };
+
+    void startDay(const QDate &date);
+    void closeDay();
+    void armDayTimer();
+    void foldDay(const QString &grade, const QString &section, int weekday, double rate);
+    bool saveBaseline(const QString &grade, const QString &section, int weekday,
+                      const Baseline &baseline, const QDate &foldedDate);
+    void check(ClassDay &day);
+    int minimumMarked(const QString &key) const;
+    static bool isAway(const QString &status);
+    static QString classKey(const QString &grade, const QString &section);
+    static QString baselineKey(const QString &classKey, int weekday);
+
+    double m_alpha;
+    int m_minimumSamples;
+    QHash<QString, Baseline> m_baselines;     // "grade|section|weekday"
+    QHash<QString, int> m_classSizes;         // "grade|section"
+    QDate m_currentDate;
+    QDate m_lastFoldedDate;
+    QHash<QString, ClassDay> m_today;         // "grade|section"
+    QHash<QString, QPair<QString, QString>> m_studentToday;  // roll -> (class key, status)
+    QTimer *m_dayTimer;
+};
+
+#endif // ATTENDANCEANOMALYDETECTOR_H
@@ -0,0 +1,57 @@
+#ifndef ATTENDANCEEXPORTER_H
+#define ATTENDANCEEXPORTER_H
+
+#include <QObject>
+#include <QDate>
+#include <QAtomicInt>
+
+// Streams advanced_attendance rows to disk in constant memory. Rows are read
+// through a forward-only cursor one date window at a time and encoded through
+// a fixed-size BufferedWriter, so whole-school multi-year exports never hold
+// more than one row group in memory.
+//
+// Formats:
+//   Csv        RFC 4180 CSV with the historical column set
+//   JsonLines  one compact JSON object per line
+//   Columnar   "SMAC" binary: header, then row groups of up to 4096 rows in
+//              which dates are delta/varint encoded and every other column
+//              is dictionary encoded; a zero row count terminates the file
+class AttendanceExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Format {
+        Csv = 0,
+        JsonLines = 1,
+        Columnar = 2
+    };
+
+    explicit AttendanceExporter(QObject *parent = nullptr);
+
+    static bool formatFromString(const QString &name, Format *format);
+
+    bool exportRange(const QString &filePath, Format format,
+                     const QDate &fromDate, const QDate &toDate,
+                     const QString &grade = QString(), const QString &section = QString());
+
+    void setChunkDays(int days) { m_chunkDays = qMax(1, days); }
+    void setBufferSize(int bytes) { m_bufferSize = bytes; }
+    qint64 rowsWritten() const { return m_rowsWritten; }
+    qint64 bytesWritten() const { return m_bytesWritten; }
+
+public slots:
+    void cancel();
+
+signals:
+    void progress(qint64 rowsWritten, int percent);
+
+private:
+    int m_chunkDays;
+    int m_bufferSize;
+    qint64 m_rowsWritten;
+    qint64 m_bytesWritten;
+    QAtomicInt m_cancelled;
+};
+
+#endif // ATTENDANCEEXPORTER_H
@@ -0,0 +1,82 @@
+#ifndef ATTENDANCEHEATMAP_H
+#define ATTENDANCEHEATMAP_H
+
+#include <QObject>
+#include <QDate>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <QStringList>
+
+// Attendance counts of one class on one day
+struct AttendanceHeatmapTile {
+    int present = 0;
+    int late = 0;
+    int absent = 0;
+    int excused = 0;
+
+    int total() const { return present + late + absent + excused; }
+    // Same definition as AttendanceStats::attendancePercentage; -1 when nothing is marked
+    double rate() const { return total() > 0 ? double(present + late + excused) / total() : -1.0; }
+};
+
+// Class x day grid for one BS month
+struct AttendanceHeatmapMonth {
+    int monthIndex = -1;                 // NepaliCalendar::getNepaliMonthIndex
+    QDate startDate;                     // AD date of BS day 1
+    int dayCount = 0;
+    QStringList classes;                 // Class keys "grade|section", sorted
+    QHash<QString, QVector<AttendanceHeatmapTile>> tiles;   // Class key -> one tile per BS day
+};
+
+// Per-(class, day) attendance tiles cached per BS month. A month is built
+// from one range query the first time it is asked for and then kept up to
+// date by recordMark() on every attendance write, so the calendar and the
+// charts read a whole month from memory.
+class AttendanceHeatmap : public QObject
+{
+    Q_OBJECT
+
+public:
+    static AttendanceHeatmap &instance();
+
+    AttendanceHeatmapMonth month(int monthIndex);
+    AttendanceHeatmapTile tile(const QString &grade, const QString &section, const QDate &date);
+
+    // Write feed; ignored for months that are not cached
+    void recordMark(const QString &studentRoll, const QString &grade, const QString &section,
+                    const QDate &date, const QString &status);
+    void invalidate(const QDate &fromDate, const QDate &toDate);
+    void clear();
+
+    void setMaxCachedMonths(int months) { m_maxCachedMonths = qMax(1, months); }
+
+    static QString classKey(const QString &grade, const QString &section);
+    static QString className(const QString &classKey);
+
+signals:
+    void tilesChanged(int monthIndex);
+
+private:
+    explicit AttendanceHeatmap(QObject *parent = nullptr);
+
+    struct CachedMonth {
+        AttendanceHeatmapMonth grid;
+        // Per-student day codes so a re-mark moves the student between counts
+        QHash<QString, QString> studentClass;
+        QHash<QString, QByteArray> studentDays;
+    };
+
+    CachedMonth *ensureMonth(int monthIndex);
+    bool loadMonth(int monthIndex, CachedMonth &cached);
+    void touch(int monthIndex);
+    static void apply(AttendanceHeatmapMonth &grid, const QString &classKey, int day, quint8 code, int delta);
+    static quint8 statusCode(const QString &status);
+    static void sortClasses(QStringList &classes);
+
+    QHash<int, CachedMonth> m_months;
+    QList<int> m_recentMonths;            // Most recently used first
+    int m_maxCachedMonths;
+};
+
+#endif // ATTENDANCEHEATMAP_H
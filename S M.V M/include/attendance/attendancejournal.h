@@ -0,0 +1,132 @@
+#ifndef ATTENDANCEJOURNAL_H
+#define ATTENDANCEJOURNAL_H
+
+#include <QObject>
+#include <QFile>
+#include <QHash>
+#include <QThread>
+#include <QTimer>
+#include <QSqlError>
+#include "attendance/advancedattendance.h"
+
+class JournalApplier;
+
+// Append-only local journal in front of advanced_attendance. Marks are
+// framed, checksummed and synced to disk in the journal file (no database access),
+// then a JournalApplier on its own thread and connection drains them into
+// SQLite in batches. The applied sequence is committed in the same
+// transaction as the batch, so a crash at any point replays at most the
+// unapplied tail; a torn final record is truncated on startup. A damaged
+// record with synced records after it is skipped by its size prefix, or the
+// journal is not opened when that prefix is unreadable too. A record that
+// keeps failing for a reason other than a busy or full database is moved to
+// attendance_journal_dead_letters, so it cannot hold back the marks behind it.
+//
+// File layout: "SMAJ", quint32 generation, then records of
+// quint32 payload size, quint16 checksum, payload (QDataStream).
+class AttendanceJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum RecordType : quint8 {
+        BaseRecord = 0,      // Sequence base written after compaction
+        MarkRecord = 1,
+        TimeOutRecord = 2,
+        BatchRecord = 3      // Several marks under one sequence, applied in one transaction
+    };
+
+    struct Record {
+        RecordType type = MarkRecord;
+        quint64 sequence = 0;
+        AttendanceEntry entry;   // TimeOutRecord uses studentRoll, date, timeOut
+        QList<AttendanceEntry> entries;   // BatchRecord
+    };
+
+    explicit AttendanceJournal(QObject *parent = nullptr);
+    ~AttendanceJournal();
+
+    bool open(const QString &journalPath = QString());
+    bool isOpen() const { return m_file.isOpen(); }
+    void close();
+
+    // Appends return once the record is synced to the journal file
+    bool appendMark(const AttendanceEntry &entry);
+    // All of entries in one record: a crash or failure keeps every mark or none
+    bool appendMarks(const QList<AttendanceEntry> &entries);
+    bool appendTimeOut(const QString &studentRoll, const QDate &date, const QTime &timeOut);
+
+    // Marks written to the journal but not yet visible in SQLite
+    bool hasPending(const QString &studentRoll, const QDate &date) const;
+    int pendingCount() const { return m_pending.size(); }
+    quint64 lastSequence() const { return m_nextSequence - 1; }
+
+    // Stores one mark, bound in AttendanceEntry field order. An Absent never
+    // replaces a day excused by approved leave: a mark journaled before the
+    // approval may reach SQLite after it. Shared with the direct-write fallback.
+    static QString markStatement();
+
+    // Record framing shared with the applier
+    static QByteArray encodeRecord(const Record &record);
+    static int decodeRecord(const QByteArray &data, int offset, Record *record);
+    static const int HeaderSize = 8;
+
+signals:
+    void recordsApplied(quint64 appliedSequence);
+    void applyFailed(const QString &error);
+
+private slots:
+    void onRecordsApplied(quint64 appliedSequence);
+
+private:
+    bool append(Record &record);
+    bool recover();
+    bool writeFreshFile(quint32 generation, quint64 baseSequence);
+    static QString pendingKey(const QString &studentRoll, const QDate &date);
+
+    QFile m_file;
+    quint32 m_generation;
+    quint64 m_nextSequence;
+    QHash<QString, quint64> m_pending;
+    QThread m_applierThread;
+    JournalApplier *m_applier;
+};
+
+// Drains the journal into SQLite; lives on AttendanceJournal's worker thread
+class JournalApplier : public QObject
+{
+    Q_OBJECT
+
+public:
+    JournalApplier(const QString &journalPath, const QString &databasePath);
+    ~JournalApplier();
+
+public slots:
+    void scheduleDrain();
+
+signals:
+    void recordsApplied(quint64 appliedSequence);
+    void applyFailed(const QString &error);
+
+private slots:
+    void drain();
+
+private:
+    bool openConnection();
+    void closeConnection();
+    bool applyBatch(const QList<AttendanceJournal::Record> &batch, quint64 lastSequence, QSqlError *error);
+    bool applyEach(const QList<AttendanceJournal::Record> &batch, quint64 lastSequence, QSqlError *error);
+    bool deadLetter(const AttendanceJournal::Record &record, const QSqlError &failure, QSqlError *error);
+    void retryLater(const QString &error);
+
+    QString m_journalPath;
+    QString m_databasePath;
+    QString m_connectionName;
+    QTimer *m_drainTimer;
+    quint32 m_generation;
+    qint64 m_readOffset;
+    int m_retryDelay;
+    int m_failedAttempts;
+};
+
+#endif // ATTENDANCEJOURNAL_H
@@ -0,0 +1,54 @@
+#ifndef ATTENDANCEROLLUPS_H
+#define ATTENDANCEROLLUPS_H
+
+#include <QDate>
+#include <QString>
+#include <QList>
+#include <QSqlDatabase>
+
+// Attendance counts of one class over one AD or BS month
+struct AttendanceRollupRow {
+    QDate periodStart;                   // AD date the month starts on
+    int bsMonthIndex = -1;               // NepaliCalendar::getNepaliMonthIndex; BS rollups only
+    QString grade;
+    QString section;
+    int present = 0;
+    int late = 0;
+    int absent = 0;
+    int excused = 0;
+    int total = 0;
+};
+
+// Per-class monthly totals of advanced_attendance, in AD and BS months.
+// Closed months are appended once to attendance_monthly_rollup and
+// attendance_bs_monthly_rollup; triggers on advanced_attendance note the
+// date of every later write, and the months those dates fall in are
+// re-aggregated on the next refresh. The open month is always counted
+// live, so callers see the same totals as a GROUP BY over the raw rows
+// while reading one row per class per closed month.
+class AttendanceRollups
+{
+public:
+    // Rollup tables, the write triggers and the date index; advanced_attendance must exist
+    static bool createTables(QSqlDatabase db);
+
+    // Patches edited months and appends months closed since the last call
+    static bool refresh(QSqlDatabase db);
+
+    // One row per class and month from fromDate's month through toDate's month,
+    // ordered by month then class. Empty grade or section means all. Refreshes first.
+    static QList<AttendanceRollupRow> monthly(QSqlDatabase db, const QDate &fromDate, const QDate &toDate,
+                                              const QString &grade = QString(), const QString &section = QString());
+    static QList<AttendanceRollupRow> bsMonthly(QSqlDatabase db, const QDate &fromDate, const QDate &toDate,
+                                                const QString &grade = QString(), const QString &section = QString());
+
+private:
+    // Last AD month start and BS month index already rolled up; invalid / -1 before the first refresh
+    static bool watermarks(QSqlDatabase db, QDate *monthThrough, int *bsMonthThrough);
+    static bool rollMonth(QSqlDatabase db, const QDate &monthStart);
+    static bool rollBsMonth(QSqlDatabase db, int monthIndex);
+    static QList<AttendanceRollupRow> liveTotals(QSqlDatabase db, const QDate &fromDate, const QDate &toDate,
+                                                 const QString &grade, const QString &section);
+};
+
+#endif // ATTENDANCEROLLUPS_H
@@ -0,0 +1,146 @@
+#ifndef ATTENDANCERULEENGINE_H
+#define ATTENDANCERULEENGINE_H
+
+#include <QObject>
+#include <QHash>
+#include <QVector>
+#include <QStringList>
+#include <QTime>
+#include "attendance/advancedattendance.h"
+
+// Result of running the active rules against one attendance entry
+struct RuleOutcome {
+    QString status;              // Empty when no rule set a status
+    QStringList firedRules;
+    QList<AttendanceAlert> alerts;
+    bool notifyParent = false;
+};
+
+// Compiles AttendanceRule::conditions / actions once into bytecode and
+// evaluates them in-process for every incoming AttendanceEntry.
+//
+// Conditions are boolean expressions over these fields:
+//   time_in, time_out, now         times, compared against HH:MM literals
+//   status, method, grade, section strings, compared against quoted literals
+//   weekday                        1 = Monday ... 7 = Sunday
+//   unmarked                       1 when the student has no mark yet today
+//   late_count_month               Late marks this BS month, including this one
+//   absent_count_month             Absent marks this BS month, including this one
+// with == != < <= > >=, AND / OR / NOT and parentheses. An empty condition
+// always matches.
+//
+// Actions are separated by ';':
+//   status=Late          first rule (by priority) to set a status wins
+//   notify_parent        raise a parent notification alert
+//   alert=High           raise an alert with the given severity
+//   stop                 skip the remaining lower-priority rules
+class AttendanceRuleEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AttendanceRuleEngine(QObject *parent = nullptr);
+    ~AttendanceRuleEngine();
+
+    // Rule loading; rules that fail to compile are logged and skipped
+    void loadRules(const QList<AttendanceRule> &rules);
+    static bool validateRule(const AttendanceRule &rule, QString *error = nullptr);
+    int ruleCount() const { return m_rules.size(); }
+
+    // Evaluation
+    RuleOutcome evaluate(const AttendanceEntry &entry, const QTime &now = QTime::currentTime()) const;
+
+    // AutoMark rules without a 'now' cutoff wait for the end of the school day
+    void setSchoolDayEnd(const QTime &time) { m_schoolDayEnd = time; }
+    QTime schoolDayEnd() const { return m_schoolDayEnd; }
+
+    // Times at which AutoMark rules for this class can start firing (sorted)
+    QList<QTime> autoMarkTimes(const QString &grade, const QString &section) const;
+    QTime earliestAutoMarkTime() const;
+
+    // Monthly counters backing late_count_month / absent_count_month
+    bool loadMonthlyCounters(const QDate &date);
+    void recordStatus(const QString &studentRoll, const QDate &date, const QString &status);
+    int countersMonth() const { return m_countersMonth; }
+
+private:
+    enum class Op : quint8 {
+        PushNumber,
+        PushString,
+        LoadField,
+        Eq, Ne, Lt, Le, Gt, Ge,
+        And, Or, Not
+    };
+
+    enum Field {
+        TimeIn = 0,
+        TimeOut,
+        Now,
+        Status,
+        Method,
+        Grade,
+        Section,
+        Weekday,
+        Unmarked,
+        LateCountMonth,
+        AbsentCountMonth
+    };
+
+    struct Instruction {
+        Op op;
+        int operand;
+    };
+
+    struct Action {
+        enum Type { SetStatus, NotifyParent, RaiseAlert, Stop } type;
+        QString argument;
+    };
+
+    struct CompiledRule {
+        AttendanceRule rule;
+        QVector<Instruction> code;
+        QVector<double> numbers;
+        QStringList strings;
+        QVector<Action> actions;
+        QList<QTime> gates;              // Cutoffs from 'now' comparisons, empty when ungated
+    };
+
+    struct Value {
+        bool isString = false;
+        double number = 0.0;
+        QString text;
+    };
+
+    struct StudentMonth {
+        int monthIndex = -1;
+        int lateCount = 0;
+        int absentCount = 0;
+        QHash<QDate, QString> dayStatus;
+    };
+
+    // Compilation
+    static bool compileConditions(const QString &source, CompiledRule &compiled, QString *error);
+    static bool compileActions(const QString &source, CompiledRule &compiled, QString *error);
+    static bool compile(const AttendanceRule &rule, CompiledRule &compiled, QString *error);
+    static int fieldId(const QString &name);
+    static QList<QTime> timeGates(const CompiledRule &compiled);
+    bool isWaiting(const CompiledRule &compiled, const QTime &now) const;
+
+    // Evaluation helpers
+    bool matches(const CompiledRule &compiled, const AttendanceEntry &entry,
+                 const QString &status, const QTime &now) const;
+    Value fieldValue(int field, const AttendanceEntry &entry, const QString &status, const QTime &now) const;
+    const QVector<int> &rulesFor(const QString &grade, const QString &section) const;
+    int monthlyCount(const AttendanceEntry &entry, const QString &status, const QString &countedStatus) const;
+    static QString scopeKey(const QString &grade, const QString &section);
+    static AttendanceRule defaultAutoMarkRule();
+
+    QVector<CompiledRule> m_rules;
+    QHash<QString, QVector<int>> m_scopeIndex;
+    mutable QHash<QString, QVector<int>> m_resolvedIndex;
+    QHash<QString, StudentMonth> m_monthly;
+    int m_countersMonth;
+    QTime m_schoolDayEnd;
+};
+
+#endif // ATTENDANCERULEENGINE_H
@@ -0,0 +1,64 @@
+#ifndef ATTENDANCESCHEDULER_H
+#define ATTENDANCESCHEDULER_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QList>
+#include <QSet>
+#include <QTimer>
+
+// Wakes attendance automation only when something is due. The next deadline
+// is computed from the daily cutoffs and the end of the school day, skipping
+// weekly off days (Saturday, the BS weekend) and dates in the holidays table,
+// and a single-shot timer is armed for exactly that moment. Holidays are
+// re-read whenever the holidays table version is bumped, and once more for
+// the day itself when a deadline fires.
+class AttendanceScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AttendanceScheduler(QObject *parent = nullptr);
+    ~AttendanceScheduler();
+
+    // Schedule configuration; re-arms the timer when running
+    void setDeadlines(const QList<QTime> &times);
+    void setSchoolDayEnd(const QTime &time);
+    void setWeeklyOffDays(const QList<int> &daysOfWeek);
+    QTime schoolDayEnd() const { return m_schoolDayEnd; }
+
+    // Calendar
+    bool isSchoolDay(const QDate &date);
+    void reloadHolidays();
+
+    void start();
+    void stop();
+    bool isRunning() const { return m_running; }
+    QDateTime nextDeadline() const { return m_nextDeadline; }
+
+signals:
+    void deadlineReached(const QDateTime &deadline);
+
+private slots:
+    void onTimeout();
+    void onTableChanged(const QString &table);
+
+private:
+    void arm(const QDateTime &after);
+    QDateTime computeNextDeadline(const QDateTime &after);
+    QList<QTime> dailyTimes() const;
+    void ensureHolidays(const QDate &date);
+    bool isHolidayInTable(const QDate &date) const;
+
+    QTimer *m_timer;
+    QList<QTime> m_deadlines;
+    QTime m_schoolDayEnd;
+    QSet<int> m_offDays;
+    QSet<QDate> m_holidays;
+    QDate m_holidaysFrom;
+    QDate m_holidaysTo;
+    QDateTime m_nextDeadline;
+    bool m_running;
+};
+
+#endif // ATTENDANCESCHEDULER_H
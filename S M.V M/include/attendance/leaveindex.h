@@ -0,0 +1,52 @@
+#ifndef LEAVEINDEX_H
+#define LEAVEINDEX_H
+
+#include <QDate>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+// In-memory index of approved leave per student. Each student's leaves are
+// coalesced into disjoint ranges sorted by start date, so "is this student
+// on leave on this day" is a binary search: O(log n) in that student's
+// leave count, with no database access. A coalesced range keeps the ids of
+// every request in it, and each request's own dates are kept beside it, so
+// a lookup reports the request that covers the day and one request can be
+// dropped without losing the others.
+class LeaveIndex
+{
+public:
+    LeaveIndex();
+
+    bool load();
+    void clear();
+
+    void addLeave(const QString &studentRoll, const QDate &fromDate, const QDate &toDate, int requestId);
+    void removeLeave(int requestId);
+    bool isOnLeave(const QString &studentRoll, const QDate &date, int *requestId = nullptr) const;
+    QList<QPair<QDate, QDate>> leavesFor(const QString &studentRoll) const;
+
+    bool isLoaded() const { return m_loaded; }
+    int studentCount() const { return m_intervals.size(); }
+
+private:
+    struct Interval {
+        qint64 from;  // Julian days, inclusive
+        qint64 to;
+        QVector<int> requestIds;  // Every request coalesced into the range
+    };
+
+    struct Leave {
+        QString studentRoll;
+        qint64 from;
+        qint64 to;
+    };
+
+    QHash<QString, QVector<Interval>> m_intervals;
+    QHash<int, Leave> m_requests;
+    bool m_loaded;
+};
+
+#endif // LEAVEINDEX_H
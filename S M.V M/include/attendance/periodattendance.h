@@ -0,0 +1,106 @@
+#ifndef PERIODATTENDANCE_H
+#define PERIODATTENDANCE_H
+
+#include <QObject>
+#include <QDate>
+#include <QTime>
+#include <QHash>
+#include <QVector>
+#include <QStringList>
+
+// One period of a class timetable, as produced by the SmartMavi scheduler
+// (TimeSlot + subject/teacher assignment)
+struct PeriodSlot {
+    int dayOfWeek = 1;       // 1 = Monday ... 7 = Sunday
+    int periodNumber = 1;    // 1-based
+    QTime startTime;
+    int durationMinutes = 45;
+    QString subject;
+    QString teacher;
+    bool isBreak = false;
+};
+
+// Period statuses of one student for one day
+struct PeriodAttendanceDay {
+    QString studentRoll;
+    QDate date;
+    QStringList statuses;    // Index 0 = period 1; empty string = not marked
+};
+
+// Aggregated period attendance for one subject or teacher
+struct PeriodAttendanceSummary {
+    QString subject;
+    QString teacher;
+    int presentPeriods = 0;
+    int absentPeriods = 0;
+    int latePeriods = 0;
+    int excusedPeriods = 0;
+    int totalPeriods = 0;
+    double attendancePercentage = 0.0;
+};
+
+// Period-level attendance for the secondary section. Each student-day is a
+// single period_attendance row whose period_bits packs a 3-bit status code
+// per period, so a full day of periods costs one row instead of eight.
+// Every saved timetable is also kept as a numbered version of its class in
+// period_timetable_versions; a student-day row records the version it was
+// first marked under, so summaries keep past periods under the subjects and
+// teachers of their day.
+class PeriodAttendance : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int MaxPeriods = 16;
+
+    explicit PeriodAttendance(QObject *parent = nullptr);
+    ~PeriodAttendance();
+
+    // Timetable
+    bool setClassTimetable(const QString &grade, const QString &section, const QList<PeriodSlot> &timetable);
+    QList<PeriodSlot> getClassTimetable(const QString &grade, const QString &section);
+    int periodAt(const QString &grade, const QString &section, const QDate &date, const QTime &time);
+
+    // Marking
+    bool markPeriod(const QString &studentRoll, const QDate &date, int period, const QString &status,
+                    const QString &grade = QString(), const QString &section = QString());
+    bool markClassPeriod(const QString &grade, const QString &section, const QDate &date, int period,
+                         const QHash<QString, QString> &statusByRoll);
+
+    // Queries
+    QString getPeriodStatus(const QString &studentRoll, const QDate &date, int period);
+    PeriodAttendanceDay getPeriodAttendance(const QString &studentRoll, const QDate &date);
+    QList<PeriodAttendanceDay> getClassPeriodAttendance(const QString &grade, const QString &section, const QDate &date);
+
+    // Aggregation
+    QList<PeriodAttendanceSummary> getSubjectSummary(const QDate &fromDate, const QDate &toDate,
+                                                     const QString &grade = QString(), const QString &section = QString());
+    QList<PeriodAttendanceSummary> getTeacherSummary(const QDate &fromDate, const QDate &toDate,
+                                                     const QString &grade = QString(), const QString &section = QString());
+
+    // Status packing
+    static int statusCode(const QString &status);
+    static QString statusName(int code);
+    static int periodCode(qint64 bits, int period);
+    static QStringList unpackStatuses(qint64 bits, int periodCount);
+
+    // Database management
+    bool createDatabaseTables();
+
+signals:
+    void periodMarked(const QString &studentRoll, const QDate &date, int period, const QString &status);
+    void timetableChanged(const QString &grade, const QString &section);
+
+private:
+    QList<PeriodAttendanceSummary> summarize(const QString &groupBy, const QDate &fromDate, const QDate &toDate,
+                                             const QString &grade, const QString &section);
+    bool lookupClass(const QString &studentRoll, QString *grade, QString *section);
+    int timetableVersion(const QString &grade, const QString &section);
+    static int bitShift(int period) { return (period - 1) * 3; }
+
+    // Timetable cache keyed by "grade|section"
+    QHash<QString, QList<PeriodSlot>> m_timetables;
+    QHash<QString, int> m_timetableVersions;
+};
+
+#endif // PERIODATTENDANCE_H
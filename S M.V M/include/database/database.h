@@ -28,9 +28,12 @@ public:
     explicit Database(QObject *parent = nullptr);
     ~Database();
 
+    // Before initialize(); ":memory:" gives a private in-memory database
+    void setDatabasePath(const QString &path) { m_databasePath = path; }
     bool initialize();
     bool createTables();
     bool isConnected() const;
+    QSqlDatabase database() const { return m_database; }
     
     // Teacher operations
     bool addTeacher(const Teacher &teacher);
@@ -0,0 +1,33 @@
+#ifndef DATAVERSIONS_H
+#define DATAVERSIONS_H
+
+#include <QObject>
+#include <QHash>
+#include <QStringList>
+
+// Per-table change counters. Every write path bumps the tables it touched
+// once the change is visible in SQLite, so caches built from those tables
+// can tell whether they are still current without querying anything.
+// Versions live for the process only; they start at 0 on every launch.
+class DataVersions : public QObject
+{
+    Q_OBJECT
+
+public:
+    static DataVersions &instance();
+
+    quint64 version(const QString &table) const { return m_versions.value(table, 0); }
+    QHash<QString, quint64> versions(const QStringList &tables) const;
+
+    void bump(const QString &table);
+
+signals:
+    void tableChanged(const QString &table, quint64 version);
+
+private:
+    explicit DataVersions(QObject *parent = nullptr);
+
+    QHash<QString, quint64> m_versions;
+};
+
+#endif // DATAVERSIONS_H
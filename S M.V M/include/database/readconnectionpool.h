@@ -0,0 +1,37 @@
+#ifndef READCONNECTIONPOOL_H
+#define READCONNECTIONPOOL_H
+
+#include <QString>
+#include <QSqlDatabase>
+#include <QThreadPool>
+#include <QThreadStorage>
+
+// Worker threads that each keep one read-only SQLite connection open for
+// as long as the pool lives. A QSqlDatabase may only be used on the thread
+// that opened it, so connections are per thread rather than handed out:
+// jobs started on threadPool() call connection() to get their thread's.
+class ReadConnectionPool
+{
+public:
+    explicit ReadConnectionPool(const QString &databasePath, int maxThreads = 0);
+    ~ReadConnectionPool();
+
+    QThreadPool *threadPool() { return &m_threads; }
+    int maxThreads() const { return m_threads.maxThreadCount(); }
+
+    // Opens the calling thread's connection on first use; invalid on failure
+    QSqlDatabase connection();
+
+private:
+    struct Connection {
+        QString name;
+        ~Connection();
+    };
+
+    QString m_databasePath;
+    // Declared before m_threads so it outlives the threads' cleanup
+    QThreadStorage<Connection *> m_connections;
+    QThreadPool m_threads;
+};
+
+#endif // READCONNECTIONPOOL_H
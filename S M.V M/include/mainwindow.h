@@ -96,6 +96,7 @@ private slots:
     
     // Calendar slots
     void onDateSelected(const QDate &date);
+    void updateAttendanceHeatmap();
     void addHoliday();
     void addEvent();
     
@@ -184,6 +185,7 @@ private:
     QWidget *m_calendarWidget;
     QCalendarWidget *m_calendar;
     QTableWidget *m_eventsTable;
+    QTableWidget *m_attendanceHeatmapTable;
     QPushButton *m_addHolidayBtn;
     QPushButton *m_addEventBtn;
     QLabel *m_nepaliDateLabel;
@@ -209,6 +211,7 @@ private:
     AdminPanel *m_adminPanel;
     void *m_reports;  // Temporarily void* until Reports class is implemented
     NepaliCalendar *m_nepaliCalendar;
+    int m_heatmapMonthIndex;
     
     bool m_isAdmin;
     QString m_currentUser;
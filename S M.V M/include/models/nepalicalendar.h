@@ -49,6 +49,11 @@ public:
     static QDate getNepaliNewYear(int adYear);
     static QDate getNepaliNewYearDate(int bsYear);
     
+    // BS month index (bsYear * 12 + month - 1), usable as a cache or counter key
+    static int getNepaliMonthIndex(const QDate &adDate);
+    static QDate getNepaliMonthStart(int monthIndex);
+    static QDate getNepaliMonthEnd(int monthIndex);
+    
     // Validation
     static bool isValidNepaliDate(int year, int month, int day);
     static bool isValidNepaliYear(int year);
@@ -6,6 +6,11 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QJsonDocument>
+#include <QSqlDatabase>
+
+class ReportCache;
+class ReportExecutor;
+class ReportTemplateEngine;
 
 // Data structures for advanced reporting
 struct ReportData {
@@ -14,6 +19,7 @@ struct ReportData {
     QString dateRange;
     QString parameters;
     QJsonDocument jsonData;
+    QString error;                       // Why jsonData is empty, such as a busy database
 };
 
 struct ReportTemplate {
@@ -63,11 +69,26 @@ public:
                                      const QString &section = QString());
     ReportData generateFinancialReport(const QDate &fromDate, const QDate &toDate);
     ReportData generateCustomReport(const QString &reportName, const QMap<QString, QVariant> &parameters);
-
-    // Export functions
+    
+    // Attendance, academic or financial report built with one query set on db, bypassing the
+    // cache and the partition workers; for background jobs that hold their own connection
+    static ReportData buildReport(QSqlDatabase db, const QString &reportType,
+                                  const QMap<QString, QVariant> &parameters);
+    // Whether buildReport supports reportType; scheduling accepts only these
+    static bool canBuildReport(const QString &reportType);
+
+    // Export functions; they touch no member state, so background jobs may call them
     bool exportReportToPDF(const ReportData &report, const QString &filePath);
     bool exportReportToExcel(const ReportData &report, const QString &filePath);
     bool exportReportToCSV(const ReportData &report, const QString &filePath);
+    // Report cards for a grade: exam_name, grade, optional section, attendance
+    // from_date/to_date, format (PDF or HTML) and merged (default true). outputPath
+    // is the merged file, or the directory that receives one file per student.
+    bool exportReportCards(const QMap<QString, QVariant> &parameters, const QString &outputPath);
+
+    // Report archive: generated reports kept in report_history as ReportCodec payloads
+    qint64 archiveReport(const ReportData &report, const QString &reportName, const QString &filePath = QString());
+    bool loadArchivedReport(qint64 historyId, ReportData *report);
 
     // Template management
     QList<ReportTemplate> getReportTemplates();
@@ -82,16 +103,36 @@ public:
 
     // Database management
     bool createDatabaseTables();
+    
+    // Attendance, academic and financial reports are served from here while their tables are unchanged
+    ReportCache *reportCache() const { return m_reportCache; }
+
+public slots:
+    // Stops a whole-school report between partitions; it then comes back without data
+    void cancelReportGeneration();
 
 signals:
     void reportGenerated(const QString &reportType);
     void reportExported(const QString &filePath);
+    void reportProgress(int completedPartitions, int totalPartitions);
+    void scheduleChanged();
 
 private:
+    ReportData buildAttendanceReport(const QDate &fromDate, const QDate &toDate,
+                                     const QString &grade, const QString &section);
+    ReportData buildAcademicReport(const QString &examName, const QString &grade, const QString &section);
+    ReportData buildFinancialReport(const QDate &fromDate, const QDate &toDate);
+    
     ReportData generateStudentPerformanceSummary(const QMap<QString, QVariant> &parameters);
     ReportData generateTeacherWorkloadAnalysis(const QMap<QString, QVariant> &parameters);
     ReportData generateClassComparisonReport(const QMap<QString, QVariant> &parameters);
     ReportData generateTrendAnalysisReport(const QMap<QString, QVariant> &parameters);
+    ReportData generateMeritList(const QMap<QString, QVariant> &parameters);
+    ReportData generatePeriodComparison(const QMap<QString, QVariant> &parameters);
+    
+    ReportCache *m_reportCache;
+    ReportExecutor *m_executor;
+    ReportTemplateEngine *m_templateEngine;
 };
 
 #endif // ADVANCEDREPORTS_H
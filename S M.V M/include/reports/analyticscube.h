@@ -0,0 +1,105 @@
+#ifndef ANALYTICSCUBE_H
+#define ANALYTICSCUBE_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QHash>
+#include <QMap>
+#include <QVector>
+#include <QSqlDatabase>
+#include "attendance/attendancerollups.h"
+
+// Additive measures of one cube cell or of any set of cells summed together
+struct CubeMeasures {
+    qint64 present = 0;
+    qint64 late = 0;
+    qint64 absent = 0;
+    qint64 excused = 0;
+    double marksObtained = 0.0;
+    double totalMarks = 0.0;
+    qint64 resultCount = 0;              // exam_results rows
+
+    qint64 attendanceTotal() const { return present + late + absent + excused; }
+    // Same definition as AttendanceHeatmapTile::rate, in percent; -1 when nothing is marked
+    double attendanceRate() const
+    {
+        return attendanceTotal() > 0 ? 100.0 * (present + late + excused) / attendanceTotal() : -1.0;
+    }
+    // Marks over total marks, in percent; -1 without results
+    double averagePercentage() const { return totalMarks > 0 ? 100.0 * marksObtained / totalMarks : -1.0; }
+
+    void add(const CubeMeasures &other);
+};
+
+// In-memory cube over grade, section, BS month, subject and teacher.
+// Attendance cells come from the BS monthly rollups (subject and teacher
+// empty); exam cells are grouped from exam_results per class, BS month and
+// subject, with the teacher of that subject in that grade. A query scans
+// the few thousand cells in memory:
+//  - slice and dice: Query::members keeps only the listed members of a dimension
+//  - rollup: dimensions left out of Query::groupBy are summed over
+// The cube checks DataVersions before every query. When advanced_attendance
+// changes, only the BS months of the dates written since the last query are
+// re-read from the rollups; triggers note those dates in
+// analytics_cube_attendance_dirty. New exam results are appended by id, and
+// only student, teacher or class edits rebuild the exam cells. Main thread
+// only, as the rollup refresh writes.
+class AnalyticsCube
+{
+public:
+    enum Dimension { Grade, Section, BsMonth, Subject, Teacher };
+
+    struct Query {
+        QList<Dimension> groupBy;
+        QMap<Dimension, QStringList> members;   // BsMonth members are month indexes
+        int fromMonth = -1;                     // NepaliCalendar::getNepaliMonthIndex; -1 leaves it open
+        int toMonth = -1;
+    };
+
+    struct Row {
+        QStringList keys;                // One per groupBy dimension; BsMonth as its month index
+        CubeMeasures measures;
+    };
+
+    static AnalyticsCube &instance();
+
+    // Rows ordered by their keys, numbers numerically
+    QList<Row> query(const Query &query);
+    CubeMeasures total(const Query &query);
+    // Full rebuild of both slabs on the next query
+    void invalidate();
+
+    static QString monthLabel(int monthIndex);
+
+private:
+    AnalyticsCube();
+
+    struct Slab {
+        QHash<quint64, CubeMeasures> cells;
+        QHash<QString, quint64> versions;
+        bool loaded = false;
+    };
+
+    void ensureCurrent();
+    bool loadAttendance();
+    bool reloadAttendanceMonths();
+    void addAttendanceRows(const QList<AttendanceRollupRow> &rows);
+    static bool ensureChangeLog(QSqlDatabase db);
+    bool loadExamResults(bool append);
+    QHash<QString, QString> subjectTeachers() const;
+
+    int memberId(Dimension dimension, const QString &member);
+    QString memberName(Dimension dimension, int id) const;
+    static quint64 cellKey(int grade, int section, int month, int subject, int teacher);
+    static int field(quint64 key, Dimension dimension);
+
+    Slab m_attendance;
+    Slab m_exams;
+    qint64 m_examWatermark;              // Highest exam_results id in m_exams
+    // Per-dimension dictionaries; id 0 is the empty member. BsMonth is stored as the index itself.
+    QVector<QStringList> m_members;
+    QVector<QHash<QString, int>> m_memberIds;
+};
+
+#endif // ANALYTICSCUBE_H
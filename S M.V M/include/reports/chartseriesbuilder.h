@@ -0,0 +1,61 @@
+#ifndef CHARTSERIESBUILDER_H
+#define CHARTSERIESBUILDER_H
+
+#include <QList>
+#include <QMap>
+#include <QPointF>
+#include <QDate>
+#include <QString>
+#include <QSqlDatabase>
+#include "attendance/attendanceheatmap.h"
+
+class QChart;
+class QLineSeries;
+
+// Builds QtCharts series from aggregated attendance, thinned to the width
+// of the plot. Long ranges are reduced with LTTB (largest triangle three
+// buckets), which keeps the visual shape of a rate, or min-max, which
+// keeps every spike of a count. Either way a series carries at most about
+// one point per horizontal pixel, however many days it spans.
+class ChartSeriesBuilder
+{
+public:
+    enum Decimation { Lttb, MinMax };
+
+    // Per-day totals of advanced_attendance; x is msecs since epoch.
+    // Only days with marked attendance have points.
+    struct DailyAttendance {
+        QList<QPointF> present;
+        QList<QPointF> absent;
+        QList<QPointF> late;
+        QList<QPointF> excused;
+        QList<QPointF> rate;             // Attended over marked, in percent, as AttendanceHeatmapTile::rate
+    };
+
+    // One grouped query; empty grade means the whole school
+    static DailyAttendance dailyAttendance(QSqlDatabase db, const QDate &startDate, const QDate &endDate,
+                                           const QString &grade = QString());
+    // Same series for one classes.id, from the basic attendance table
+    static DailyAttendance dailyAttendance(QSqlDatabase db, const QDate &startDate, const QDate &endDate,
+                                           int classId);
+    // Per-day counts of one class from the basic attendance table, keyed by
+    // date; Leave is counted as excused. Only days with marks are present.
+    static QMap<QDate, AttendanceHeatmapTile> classDailyCounts(QSqlDatabase db, int classId,
+                                                                const QDate &startDate, const QDate &endDate);
+
+    // points must be ordered by x; inputs already within budget come back unchanged
+    static QList<QPointF> lttb(const QList<QPointF> &points, int threshold);
+    static QList<QPointF> minMax(const QList<QPointF> &points, int buckets);
+    static QList<QPointF> decimate(const QList<QPointF> &points, int pixelWidth, Decimation method);
+
+    static QLineSeries *lineSeries(const QString &name, const QList<QPointF> &points, int pixelWidth,
+                                   Decimation method = Lttb);
+    // Swaps in new points in one go, so the chart redraws once
+    static void replacePoints(QLineSeries *series, const QList<QPointF> &points, int pixelWidth,
+                              Decimation method = Lttb);
+
+    // Date x axis over the series' span and a value y axis, attached to every series of chart
+    static void attachTimeAxes(QChart *chart, const QString &yTitle, double yMin, double yMax);
+};
+
+#endif // CHARTSERIESBUILDER_H
@@ -0,0 +1,96 @@
+#ifndef MARKSTATISTICS_H
+#define MARKSTATISTICS_H
+
+#include <QString>
+#include <QList>
+#include <QVector>
+#include <QDate>
+#include <QSqlDatabase>
+#include <vector>
+
+// Descriptive statistics of one set of marks
+struct MarkSummary {
+    int count = 0;
+    double mean = 0.0;
+    double variance = 0.0;               // Sample variance, over n - 1
+    double standardDeviation = 0.0;
+    double skewness = 0.0;               // Adjusted Fisher-Pearson, as Excel SKEW; 0 below three marks
+    double minimum = 0.0;
+    double q1 = 0.0;                     // Quartiles interpolate between ranks, as Excel QUARTILE.INC
+    double median = 0.0;
+    double q3 = 0.0;
+    double maximum = 0.0;
+};
+
+// Exam result percentages of one section in one subject, contiguous in
+// memory; an empty subject holds every result of the section
+struct MarkSample {
+    QString section;
+    QString subject;
+    QVector<float> percentages;
+};
+
+// Approximate percentiles of an unbounded stream in a few kilobytes, after
+// Dunning's merging t-digest. Values are buffered, then sorted into
+// weighted centroids that stay small near the tails, so extreme
+// percentiles are the most accurate. Digests of sections merge into one
+// for the school.
+class TDigest
+{
+public:
+    // Higher compression keeps more centroids: about compression / 2 after a merge
+    explicit TDigest(double compression = 100.0);
+
+    void add(double value, double weight = 1.0);
+    void add(const float *values, int count);
+    void merge(const TDigest &other);
+
+    bool isEmpty() const { return totalWeight() == 0.0; }
+    double totalWeight() const { return m_mergedWeight + m_bufferedWeight; }
+    int centroidCount() const;
+
+    // q in [0, 1]; 0 for an empty digest
+    double quantile(double q) const;
+    // Share of the weight at or below value
+    double cdf(double value) const;
+
+private:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    void flush() const;
+
+    double m_compression;
+    // Buffered values are merged lazily, so the readers are const
+    mutable std::vector<Centroid> m_centroids;
+    mutable std::vector<Centroid> m_buffer;
+    mutable double m_mergedWeight;
+    mutable double m_bufferedWeight;
+    double m_minimum;
+    double m_maximum;
+};
+
+// Kernels over float arrays of marks. Sums and moments are accumulated in
+// double, four floats per SSE2 step where available, with a scalar loop
+// for the rest and for other targets.
+class MarkStatistics
+{
+public:
+    // One grouped, ordered read of a grade's results; each section's whole
+    // sample comes first, followed by its subjects
+    static QList<MarkSample> load(QSqlDatabase db, const QString &grade, const QDate &fromDate, const QDate &toDate);
+    // Every result percentage of the school in the range, streamed into digest
+    static bool loadDigest(QSqlDatabase db, const QDate &fromDate, const QDate &toDate, TDigest *digest);
+
+    static double sum(const float *values, int count);
+    static MarkSummary summarize(const float *values, int count);
+    static MarkSummary summarize(const QVector<float> &values) { return summarize(values.constData(), values.size()); }
+    // bins equal-width bins over [low, high]; values outside land in the end bins
+    static QVector<int> histogram(const float *values, int count, int bins, float low = 0.0f, float high = 100.0f);
+    // Linear interpolation between closest ranks; partially reorders values
+    static double quantile(float *values, int count, double q);
+};
+
+#endif // MARKSTATISTICS_H
@@ -0,0 +1,79 @@
+#ifndef PDFREPORTRENDERER_H
+#define PDFREPORTRENDERER_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QVector>
+#include <QPair>
+
+class QPainter;
+class QPicture;
+
+// Lays a report out on A4 pages and writes it with QPdfWriter. Blocks are
+// added in reading order; write() paginates them in one cheap pass (tables
+// split across pages and repeat their header row), then records every page
+// into its own QPicture on the thread pool and replays the pictures into
+// the PDF in page order. Coordinates are in points.
+class PdfReportRenderer
+{
+public:
+    PdfReportRenderer(const QString &title, const QString &subtitle = QString());
+    ~PdfReportRenderer();
+
+    void addHeading(const QString &text);
+    void addField(const QString &label, const QString &value);
+    void addParagraph(const QString &text);
+    // Weights are relative column widths; missing ones count as 1
+    void addTable(const QStringList &columns, const QList<QStringList> &rows,
+                  const QList<double> &weights = QList<double>());
+    // maximum fixes the value axis; 0 scales to the largest bar
+    void addBarChart(const QString &title, const QList<QPair<QString, double>> &bars, double maximum = 0.0);
+    // Following blocks start on a fresh page
+    void addPageBreak();
+
+    bool write(const QString &filePath) const;
+
+    int pageCount() const;
+
+private:
+    struct Block {
+        enum Kind { Heading, Field, Paragraph, Table, BarChart, PageBreak };
+        Kind kind;
+        QString text;
+        QString value;
+        QStringList columns;
+        QList<double> weights;
+        QList<QStringList> rows;
+        QList<QPair<QString, double>> bars;
+        double maximum = 0.0;
+    };
+
+    // A block, or a run of a table's rows, at a vertical position on a page
+    struct Placement {
+        int block = 0;
+        int firstRow = 0;
+        int rowCount = 0;
+        double y = 0.0;
+        double height = 0.0;
+    };
+
+    typedef QVector<Placement> PageLayout;
+
+    QVector<PageLayout> layout() const;
+    double blockHeight(const Block &block) const;
+    double titleHeight() const;
+
+    QPicture renderPage(int index, const PageLayout &page, int pageCount) const;
+    void drawFrame(QPainter &painter, int index, int pageCount) const;
+    void drawTitle(QPainter &painter) const;
+    void drawTable(QPainter &painter, const Block &block, const Placement &placement) const;
+    void drawBarChart(QPainter &painter, const Block &block, const Placement &placement) const;
+
+    QString m_title;
+    QString m_subtitle;
+    QString m_generatedOn;
+    QList<Block> m_blocks;
+};
+
+#endif // PDFREPORTRENDERER_H
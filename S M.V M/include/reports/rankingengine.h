@@ -0,0 +1,67 @@
+#ifndef RANKINGENGINE_H
+#define RANKINGENGINE_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QHash>
+#include <vector>
+
+class QSqlQuery;
+
+struct RankedEntry {
+    QString id;
+    QString name;
+    QString group;                       // Ranks restart per group, e.g. per grade
+    double score = 0.0;
+    double secondary = 0.0;              // Second key for TieBreak BySecondary
+    int rank = 0;
+    double percentile = 0.0;             // Share of the group ranked below, 0-100
+};
+
+// Streams scores and keeps only the best (or worst) k per group in a
+// bounded heap, so a school-wide leaderboard costs O(n log k) time and
+// O(k) memory per group. Ranks are exact against everything added:
+// whatever ranks ahead of a kept entry is itself kept.
+class RankingEngine
+{
+public:
+    enum Order { Highest, Lowest };
+    // Competition 1, 2, 2, 4; Dense 1, 2, 2, 3; Ordinal 1, 2, 3, 4
+    enum Method { Competition, Dense, Ordinal };
+    // ByName: equal scores tie and are listed by name.
+    // BySecondary: equal scores are separated by the secondary value (same
+    // direction as the order) and tie only when that is equal too.
+    enum TieBreak { ByName, BySecondary };
+
+    // k <= 0 keeps everything
+    explicit RankingEngine(int k, Order order = Highest, Method method = Competition, TieBreak tieBreak = ByName);
+
+    void add(const RankedEntry &entry);
+    // Rows of id, name, group, score and optionally secondary, in that column order
+    bool addRows(QSqlQuery &query);
+
+    QStringList groups() const;
+    // Entries added to a group, kept or not
+    int count(const QString &group = QString()) const;
+    // Kept entries of a group, best first, with rank and percentile
+    QList<RankedEntry> results(const QString &group = QString()) const;
+
+private:
+    struct Group {
+        std::vector<RankedEntry> heap;   // Worst kept entry at the front
+        int seen = 0;
+    };
+
+    bool better(const RankedEntry &a, const RankedEntry &b) const;
+    bool tied(const RankedEntry &a, const RankedEntry &b) const;
+
+    int m_k;
+    Order m_order;
+    Method m_method;
+    TieBreak m_tieBreak;
+    QHash<QString, Group> m_groups;
+    QStringList m_groupOrder;            // First-seen order
+};
+
+#endif // RANKINGENGINE_H
@@ -0,0 +1,90 @@
+#ifndef REPORTCACHE_H
+#define REPORTCACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QMap>
+#include <QList>
+#include <QVariant>
+#include <QStringList>
+#include <QSqlDatabase>
+#include <functional>
+#include "reports/advancedreports.h"
+
+class QTimer;
+class ReadConnectionPool;
+
+// Caches generated ReportData by report type and normalized parameters.
+// Each entry remembers the DataVersions of the tables it was built from:
+// while those are unchanged the cached report is returned as is. When a
+// table changes, dependent entries are marked stale and rebuilt one at a
+// time on a worker thread with its own read connection; the new report is
+// swapped in when it completes, so the next request usually finds a fresh
+// report. A request that arrives before the rebuild computes it on the spot.
+class ReportCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef std::function<ReportData()> Producer;
+    // Same report from a worker thread's connection; touches no GUI-thread state
+    typedef std::function<ReportData(QSqlDatabase db)> Refresher;
+
+    explicit ReportCache(QObject *parent = nullptr);
+    ~ReportCache();
+
+    ReportData fetch(const QString &reportType, const QMap<QString, QVariant> &parameters,
+                     const QStringList &tables, const Producer &producer, const Refresher &refresher);
+
+    static QString cacheKey(const QString &reportType, const QMap<QString, QVariant> &parameters);
+
+    // Limits; entries larger than maxBytes are never cached
+    void setMaxEntries(int entries);
+    void setMaxBytes(qint64 bytes);
+    int entryCount() const { return m_entries.size(); }
+    qint64 bytesUsed() const { return m_bytesUsed; }
+
+    int hits() const { return m_hits; }
+    int misses() const { return m_misses; }
+
+    void clear();
+
+signals:
+    void reportRefreshed(const QString &key);
+
+private slots:
+    void onTableChanged(const QString &table);
+    void refreshNext();
+
+private:
+    struct Entry {
+        ReportData report;
+        QStringList tables;
+        QHash<QString, quint64> versions;
+        Refresher refresher;
+        qint64 bytes = 0;
+    };
+
+    bool isCurrent(const Entry &entry) const;
+    void store(const QString &key, const QStringList &tables, const QHash<QString, quint64> &versions,
+               const Refresher &refresher, const ReportData &report);
+    void finishRefresh(const QString &key, const QHash<QString, quint64> &versions, const ReportData &report);
+    void touch(const QString &key);
+    void remove(const QString &key);
+    void evict();
+    static qint64 estimateBytes(const ReportData &report);
+
+    QHash<QString, Entry> m_entries;
+    QList<QString> m_recentKeys;          // Most recently used first
+    QList<QString> m_staleKeys;           // Waiting for a background rebuild
+    QTimer *m_refreshTimer;
+    ReadConnectionPool *m_pool;           // Created with the first rebuild
+    bool m_refreshing;                    // A rebuild is running on m_pool
+    int m_maxEntries;
+    qint64 m_maxBytes;
+    qint64 m_bytesUsed;
+    int m_hits;
+    int m_misses;
+};
+
+#endif // REPORTCACHE_H
@@ -0,0 +1,83 @@
+#ifndef REPORTCARDGENERATOR_H
+#define REPORTCARDGENERATOR_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QDate>
+#include <QSqlDatabase>
+
+struct ReportCardSubject {
+    QString subject;
+    double marksObtained = 0.0;
+    double totalMarks = 0.0;
+    double percentage = 0.0;
+    QString letterGrade;
+    double gradePoint = 0.0;
+    QString remarks;
+};
+
+// Everything printed on one student's card
+struct ReportCard {
+    QString rollNumber;
+    QString name;
+    QString grade;
+    QString section;
+    QString parentName;
+
+    QList<ReportCardSubject> subjects;
+    double marksObtained = 0.0;
+    double totalMarks = 0.0;
+    double percentage = 0.0;
+    double gpa = 0.0;
+    QString letterGrade;
+    int gradeRank = 0;                   // 0 when the student has no results
+    int sectionRank = 0;
+    int gradeSize = 0;                   // Ranked students in the grade
+    int sectionSize = 0;
+
+    int presentDays = 0;
+    int absentDays = 0;
+    int lateDays = 0;
+    int excusedDays = 0;
+    int totalDays = 0;
+    double attendancePercentage = 0.0;
+};
+
+// Term-end report cards for a whole grade. load() reads the grade's
+// students, exam results and attendance in three queries, then computes
+// GPAs and grade and section ranks in memory. Cards are rendered in
+// parallel, either one file per student or one merged document.
+class ReportCardGenerator
+{
+public:
+    enum Format { Pdf, Html };
+
+    // Attendance is counted from fromDate through toDate
+    ReportCardGenerator(const QString &examName, const QDate &fromDate, const QDate &toDate);
+
+    // Empty section means every section of the grade
+    bool load(QSqlDatabase db, const QString &grade, const QString &section = QString());
+
+    const QList<ReportCard> &cards() const { return m_cards; }
+
+    // One file per student in directory; returns the files written
+    QStringList writeEach(const QString &directory, Format format) const;
+    // All cards in one file, each starting on a new page
+    bool writeMerged(const QString &filePath, Format format) const;
+
+    // NEB letter grading on the percentage of full marks
+    static QString letterGrade(double percentage);
+    static double gradePoint(double percentage);
+
+private:
+    void rank();
+    QString fileNameFor(const ReportCard &card, Format format) const;
+
+    QString m_examName;
+    QDate m_fromDate;
+    QDate m_toDate;
+    QList<ReportCard> m_cards;           // By section, then name
+};
+
+#endif // REPORTCARDGENERATOR_H
@@ -0,0 +1,33 @@
+#ifndef REPORTCODEC_H
+#define REPORTCODEC_H
+
+#include <QByteArray>
+#include "reports/advancedreports.h"
+
+// Binary form of generated reports for the report archive. A payload is a
+// 6-byte header ("SMRD", format version, flags) followed by a CBOR map with
+// integer keys; payloads above a small threshold are qCompress'ed. Decoding
+// walks the CBOR tree straight into a QJsonDocument, so no text is parsed.
+// The metadata keys come before the data key, so the header is read
+// without decoding the report body.
+class ReportCodec
+{
+public:
+    enum Compression { NoCompression, Compress };
+
+    static QByteArray encode(const ReportData &report, Compression compression = Compress);
+    static bool decode(const QByteArray &payload, ReportData *report);
+    // Everything but jsonData
+    static bool decodeHeader(const QByteArray &payload, ReportData *report);
+
+    static QByteArray encode(const ReportAnalytics &analytics, Compression compression = Compress);
+    static bool decode(const QByteArray &payload, ReportAnalytics *analytics);
+
+    static bool isPayload(const QByteArray &bytes);
+
+private:
+    static QByteArray wrap(const QByteArray &cbor, Compression compression);
+    static bool unwrap(const QByteArray &payload, QByteArray *cbor);
+};
+
+#endif // REPORTCODEC_H
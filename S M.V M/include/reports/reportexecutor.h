@@ -0,0 +1,64 @@
+#ifndef REPORTEXECUTOR_H
+#define REPORTEXECUTOR_H
+
+#include <QObject>
+#include <QList>
+#include <QVector>
+#include <QJsonArray>
+#include <QSqlDatabase>
+#include <QAtomicInt>
+#include <functional>
+
+class ReadConnectionPool;
+
+// One grade/section slice of a whole-school report
+struct ReportPartition {
+    QString grade;
+    QString section;
+};
+
+// Runs a report once per partition on a pool of worker threads, each with
+// its own read connection, and hands the rows back in partition order so
+// the merged report is the same as the sequential one. run() keeps the
+// event loop turning while it waits, so progress() reaches the UI and
+// cancel() can be called from it.
+class ReportExecutor : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Runs on a worker thread; fills rows, or error and returns false on a query error
+    typedef std::function<bool(QSqlDatabase db, const ReportPartition &partition, QJsonArray *rows,
+                               QString *error)> PartitionTask;
+
+    explicit ReportExecutor(QObject *parent = nullptr);
+    ~ReportExecutor();
+
+    // Distinct grade/section pairs of enhanced_students, sorted like ORDER BY grade, section.
+    // Empty when some students lack a grade or section, so callers keep to one query.
+    static QList<ReportPartition> partitions(const QString &grade = QString(), const QString &section = QString());
+
+    // False when cancelled or when any partition failed
+    bool run(const QList<ReportPartition> &partitions, const PartitionTask &task, QVector<QJsonArray> *results);
+    // Why the last run() returned false
+    QString lastError() const { return m_lastError; }
+    bool isRunning() const { return m_running; }
+    int maxThreads() const;
+
+public slots:
+    void cancel();
+
+signals:
+    void progress(int completed, int total);
+
+private:
+    bool runSequentially(const QList<ReportPartition> &partitions, const PartitionTask &task,
+                         QVector<QJsonArray> *results);
+
+    ReadConnectionPool *m_pool;
+    QAtomicInt m_cancelled;
+    bool m_running;
+    QString m_lastError;
+};
+
+#endif // REPORTEXECUTOR_H
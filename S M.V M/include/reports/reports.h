@@ -6,6 +6,7 @@
 #include <QDate>
 #include <QList>
 #include <QPair>
+#include <QHash>
 #include <QTextDocument>
 #include <QChart>
 #include <QChartView>
@@ -16,6 +17,7 @@
 #include <QPieSeries>
 
 class Database;
+class ReportWriter;
 class Teacher;
 class Student;
 class Class;
@@ -37,7 +39,8 @@ public:
     enum ExportFormat {
         CSV = 0,
         Excel = 1,
-        HTML = 2
+        HTML = 2,
+        PlainText = 3
     };
     
     explicit Reports(Database *database, QObject *parent = nullptr);
@@ -49,6 +52,19 @@ public:
     QString generateClassReport(int classId, const QDate &startDate, const QDate &endDate);
     QString generateSummaryReport(const QDate &startDate, const QDate &endDate);
     
+    // Streaming report generation; rows go to the writer as they are read
+    bool writeReport(ReportType type, ReportWriter &writer, int classId,
+                     const QDate &startDate, const QDate &endDate);
+    bool writeTeacherReport(ReportWriter &writer, const QDate &startDate, const QDate &endDate);
+    bool writeStudentReport(ReportWriter &writer, int classId, const QDate &startDate, const QDate &endDate);
+    bool writeAttendanceReport(ReportWriter &writer, int classId, const QDate &date);
+    bool writeClassReport(ReportWriter &writer, int classId, const QDate &startDate, const QDate &endDate);
+    bool writeSummaryReport(ReportWriter &writer, const QDate &startDate, const QDate &endDate);
+    
+    // Streams a report straight into a file in the Documents folder
+    bool exportReport(ReportType type, ExportFormat format, const QString &filename, int classId,
+                      const QDate &startDate, const QDate &endDate);
+    
     // Export functions
     bool exportToCSV(const QString &content, const QString &filename);
     bool exportToExcel(const QString &content, const QString &filename);
@@ -72,30 +88,47 @@ public:
     int calculateTotalStudents(int classId);
     int calculateTotalTeachers();
     int calculateTotalClasses();
-    QList<QPair<QString, double>> getTopPerformingStudents(int classId, const QDate &startDate, const QDate &endDate);
-    QList<QPair<QString, double>> getTopPerformingClasses(const QDate &startDate, const QDate &endDate);
+    // Best attendance first, at most limit entries (0 for all), via RankingEngine
+    QList<QPair<QString, double>> getTopPerformingStudents(int classId, const QDate &startDate, const QDate &endDate,
+                                                           int limit = 10);
+    QList<QPair<QString, double>> getTopPerformingClasses(const QDate &startDate, const QDate &endDate, int limit = 10);
 
 private:
+    // Per-class counts gathered by grouped queries
+    struct ClassSummary {
+        int studentCount = 0;
+        int present = 0;
+        int absent = 0;
+        int leave = 0;
+        int late = 0;
+
+        int marked() const { return present + absent + leave + late; }
+        double attendancePercentage() const { return marked() > 0 ? (double)(present + late) / marked() * 100 : 0.0; }
+    };
+
     Database *m_database;
     
+    QHash<int, ClassSummary> loadClassSummaries(const QDate &startDate, const QDate &endDate, int classId = -1);
+    QList<QPair<QString, double>> rankClasses(const QList<Class> &classes, const QHash<int, ClassSummary> &summaries);
+    
     // Helper methods
-    QString formatTeacherData(const QList<Teacher> &teachers);
-    QString formatStudentData(const QList<Student> &students);
-    QString formatAttendanceData(const QList<Attendance> &attendance);
-    QString formatClassData(const QList<Class> &classes);
+    QString renderReport(ReportType type, int classId, const QDate &startDate, const QDate &endDate);
+    int writeStudentTable(ReportWriter &writer, int classId);
     
     QString createHTMLTemplate(const QString &content);
     QString createCSVContent(const QString &content);
-    QString createExcelContent(const QString &content);
     
     QBarSeries* createAttendanceBarSeries(int classId, const QDate &startDate, const QDate &endDate);
     QPieSeries* createAttendancePieSeries(int classId, const QDate &date);
-    QBarSeries* createStudentPerformanceBarSeries(int classId, const QDate &startDate, const QDate &endDate);
-    QBarSeries* createTeacherWorkloadBarSeries(const QDate &startDate, const QDate &endDate);
-    QBarSeries* createClassComparisonBarSeries(const QDate &date);
+    // Bar labels go to categories, one per bar
+    QBarSeries* createStudentPerformanceBarSeries(int classId, const QDate &startDate, const QDate &endDate,
+                                                  QStringList *categories);
+    QBarSeries* createTeacherWorkloadBarSeries(const QDate &startDate, const QDate &endDate, QStringList *categories);
+    QBarSeries* createClassComparisonBarSeries(const QDate &date, QStringList *categories);
     
     void setupChart(QChart *chart, const QString &title);
-    void setupBarChart(QChart *chart, QBarSeries *series, const QString &title);
+    void setupBarChart(QChart *chart, QBarSeries *series, const QString &title,
+                       const QStringList &categories = QStringList());
     void setupPieChart(QChart *chart, QPieSeries *series, const QString &title);
 };
 
@@ -0,0 +1,75 @@
+#ifndef REPORTTEMPLATEENGINE_H
+#define REPORTTEMPLATEENGINE_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QMap>
+#include <QVariant>
+#include <QSqlQuery>
+#include <QSqlDatabase>
+#include <QDeadlineTimer>
+#include <functional>
+#include "reports/advancedreports.h"
+
+class ReadConnectionPool;
+
+// Rows of one template run
+struct TemplateResult {
+    QStringList columns;
+    QList<QVariantList> rows;
+    bool truncated = false;              // Row limit reached
+    qint64 elapsedMs = 0;
+};
+
+// Runs ReportTemplate.sqlQuery safely. Templates must be a single SELECT
+// (or WITH ... SELECT) with :named parameters that the template declares;
+// writes, PRAGMA, ATTACH and transaction statements are rejected when the
+// template is saved. Statements run on a worker thread with its own
+// read-only connection and stay prepared between runs. Each run stops
+// after the row limit, and after the time limit: with SQLite's progress
+// handler when built against SQLite3, otherwise between rows. The caller
+// never waits past the time limit; without SQLite3 a run still inside a
+// single step is abandoned to finish on the worker, and RECURSIVE, which
+// can make one step endless, is rejected.
+class ReportTemplateEngine
+{
+public:
+    explicit ReportTemplateEngine(const QString &databasePath);
+    ~ReportTemplateEngine();
+
+    // Empty when sql is acceptable, otherwise why it is not
+    static QString validate(const QString &sql, const QStringList &declaredParameters);
+    // validate() plus a trial prepare, for save time
+    bool check(const ReportTemplate &temp, QString *error);
+
+    bool execute(const ReportTemplate &temp, const QMap<QString, QVariant> &parameters,
+                 TemplateResult *result, QString *error);
+
+    void invalidate(const QString &templateName);
+    void clear();
+
+    void setRowLimit(int rows) { m_rowLimit = qMax(1, rows); }
+    void setTimeLimit(int milliseconds) { m_timeLimitMs = qMax(1, milliseconds); }
+
+private:
+    struct CachedStatement {
+        QString sql;
+        QStringList parameters;          // Placeholder names without the ':'
+        QSqlQuery query;
+    };
+
+    // Worker thread only
+    CachedStatement *statement(const ReportTemplate &temp, QString *error);
+    bool runStatement(const ReportTemplate &temp, const QMap<QString, QVariant> &parameters, int rowLimit,
+                      const QDeadlineTimer &deadline, TemplateResult *result, QString *error);
+    bool runOnWorker(const std::function<void()> &task, const QDeadlineTimer &deadline);
+    static QStringList placeholders(const QString &sql);
+
+    ReadConnectionPool *m_worker;                   // One thread, which owns m_statements
+    QHash<QString, CachedStatement> m_statements;   // By template name
+    int m_rowLimit;
+    int m_timeLimitMs;
+};
+
+#endif // REPORTTEMPLATEENGINE_H
@@ -0,0 +1,138 @@
+#ifndef REPORTWRITER_H
+#define REPORTWRITER_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QDate>
+#include "utils/bufferedwriter.h"
+#include "utils/xlsxwriter.h"
+
+class QIODevice;
+
+// Receives a report as it is generated. Generators push sections, tables
+// and rows; the writer formats them and streams the bytes through a fixed
+// buffer to any QIODevice (file, QBuffer, socket), so memory stays flat
+// however many rows the report has.
+class ReportWriter
+{
+public:
+    enum Format {
+        Text = 0,
+        Csv,
+        Html,
+        Xlsx
+    };
+
+    explicit ReportWriter(QIODevice *device);
+    virtual ~ReportWriter();
+
+    // Caller owns the result
+    static ReportWriter *create(Format format, QIODevice *device);
+
+    virtual bool beginReport(const QString &title, const QDate &startDate, const QDate &endDate) = 0;
+    virtual bool beginSection(const QString &title) = 0;
+    // Widths are text-column hints; other formats ignore them
+    virtual bool beginTable(const QStringList &columns, const QList<int> &widths = QList<int>()) = 0;
+    virtual bool addRow(const QStringList &cells) = 0;
+    virtual bool endTable() { return !m_out.hasError(); }
+    virtual bool addField(const QString &label, const QString &value) = 0;
+    virtual bool addText(const QString &text) = 0;
+    virtual bool endReport() = 0;
+
+    qint64 bytesWritten() const { return m_out.bytesWritten(); }
+    virtual bool hasError() const { return m_out.hasError(); }
+
+protected:
+    BufferedWriter m_out;
+};
+
+// Plain text with banner, "=== SECTION ===" headings and padded columns
+class TextReportWriter : public ReportWriter
+{
+public:
+    using ReportWriter::ReportWriter;
+
+    bool beginReport(const QString &title, const QDate &startDate, const QDate &endDate) override;
+    bool beginSection(const QString &title) override;
+    bool beginTable(const QStringList &columns, const QList<int> &widths = QList<int>()) override;
+    bool addRow(const QStringList &cells) override;
+    bool addField(const QString &label, const QString &value) override;
+    bool addText(const QString &text) override;
+    bool endReport() override;
+
+private:
+    QString formatRow(const QStringList &cells) const;
+
+    QList<int> m_widths;
+};
+
+// RFC 4180 records; sections and fields become one- and two-cell records
+class CsvReportWriter : public ReportWriter
+{
+public:
+    using ReportWriter::ReportWriter;
+
+    bool beginReport(const QString &title, const QDate &startDate, const QDate &endDate) override;
+    bool beginSection(const QString &title) override;
+    bool beginTable(const QStringList &columns, const QList<int> &widths = QList<int>()) override;
+    bool addRow(const QStringList &cells) override;
+    bool addField(const QString &label, const QString &value) override;
+    bool addText(const QString &text) override;
+    bool endReport() override;
+
+private:
+    bool writeRecord(const QStringList &cells);
+};
+
+// Standalone HTML page with one <table> per table
+class HtmlReportWriter : public ReportWriter
+{
+public:
+    using ReportWriter::ReportWriter;
+
+    bool beginReport(const QString &title, const QDate &startDate, const QDate &endDate) override;
+    bool beginSection(const QString &title) override;
+    bool beginTable(const QStringList &columns, const QList<int> &widths = QList<int>()) override;
+    bool addRow(const QStringList &cells) override;
+    bool endTable() override;
+    bool addField(const QString &label, const QString &value) override;
+    bool addText(const QString &text) override;
+    bool endReport() override;
+
+private:
+    bool m_inTable = false;
+};
+
+// XLSX workbook: the banner and each section's fields go on one sheet,
+// every table gets a sheet of its own with a frozen header row. Numeric
+// cells are written as numbers and "12.50%" as a percentage. Bypasses the
+// text buffer; the device must be seekable.
+class XlsxReportWriter : public ReportWriter
+{
+public:
+    explicit XlsxReportWriter(QIODevice *device);
+
+    bool beginReport(const QString &title, const QDate &startDate, const QDate &endDate) override;
+    bool beginSection(const QString &title) override;
+    bool beginTable(const QStringList &columns, const QList<int> &widths = QList<int>()) override;
+    bool addRow(const QStringList &cells) override;
+    bool endTable() override;
+    bool addField(const QString &label, const QString &value) override;
+    bool addText(const QString &text) override;
+    bool endReport() override;
+
+    bool hasError() const override { return m_xlsx.hasError(); }
+
+private:
+    bool ensureSheet();
+    static XlsxCell toCell(const QString &text);
+
+    XlsxWriter m_xlsx;
+    QString m_sheetName;
+    QString m_section;
+    bool m_sheetOpen = false;
+    bool m_inTable = false;
+};
+
+#endif // REPORTWRITER_H
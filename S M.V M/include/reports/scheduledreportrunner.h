@@ -0,0 +1,91 @@
+#ifndef SCHEDULEDREPORTRUNNER_H
+#define SCHEDULEDREPORTRUNNER_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QHash>
+#include <QSet>
+#include <queue>
+#include <vector>
+#include "reports/advancedreports.h"
+
+class QTimer;
+class ReadConnectionPool;
+
+// Executes the rows of scheduled_reports. Active schedules sit in a
+// min-heap keyed on next_run and one timer sleeps until the earliest is
+// due. Due reports are built and exported on a small pool of low-priority
+// threads with their own read-only connections, so the UI thread only
+// does the bookkeeping: a report_history row with size, duration and the
+// archived report, one scheduled_messages email per recipient, and the
+// advanced next_run.
+class ScheduledReportRunner : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ScheduledReportRunner(AdvancedReports *reports, QObject *parent = nullptr);
+    ~ScheduledReportRunner();
+
+    // Where exported files go; defaults to Documents/Scheduled Reports
+    void setOutputDirectory(const QString &path) { m_outputDirectory = path; }
+    QString outputDirectory() const { return m_outputDirectory; }
+
+    bool isActive() const { return m_active; }
+    int runningReports() const { return m_running.size(); }
+
+    // First Daily, Weekly or Monthly run after `after`; invalid for any other schedule type
+    static QDateTime followingRun(const ScheduledReport &report, const QDateTime &after);
+
+public slots:
+    void start();
+    void stop();
+    // Re-reads scheduled_reports; connected to AdvancedReports::scheduleChanged
+    void reload();
+
+signals:
+    void reportStarted(int scheduleId, const QString &reportName);
+    void reportFinished(int scheduleId, const QString &filePath, bool success);
+
+private slots:
+    void runDueReports();
+
+private:
+    struct QueuedRun {
+        QDateTime due;
+        int scheduleId;
+    };
+
+    struct RunsLater {
+        bool operator()(const QueuedRun &a, const QueuedRun &b) const { return a.due > b.due; }
+    };
+
+    struct RunResult {
+        QString filePath;
+        qint64 fileSize = 0;
+        qint64 durationMs = 0;
+        bool success = false;
+        QString error;                   // Why the report had no data
+        QByteArray archive;              // ReportCodec payload, encoded on the worker
+    };
+
+    void arm();
+    void dispatch(const ScheduledReport &report);
+    void finishRun(const ScheduledReport &report, const RunResult &result);
+    void queueEmails(const ScheduledReport &report, const RunResult &result);
+    static RunResult execute(ReadConnectionPool *pool, AdvancedReports *reports,
+                             const ScheduledReport &report, const QDateTime &runTime,
+                             const QString &directory);
+
+    AdvancedReports *m_reports;
+    ReadConnectionPool *m_pool;
+    QTimer *m_timer;
+    QHash<int, ScheduledReport> m_schedules;
+    // Entries are never removed in place; stale ones are skipped when popped
+    std::priority_queue<QueuedRun, std::vector<QueuedRun>, RunsLater> m_queue;
+    QSet<int> m_running;
+    QString m_outputDirectory;
+    bool m_active;
+};
+
+#endif // SCHEDULEDREPORTRUNNER_H
@@ -0,0 +1,35 @@
+#ifndef BUFFEREDWRITER_H
+#define BUFFEREDWRITER_H
+
+#include <QByteArray>
+#include <QString>
+
+class QIODevice;
+
+// Fixed-size write buffer in front of a QIODevice. Exporters push many small
+// fields; this turns them into a few large device writes and keeps memory
+// bounded by the buffer capacity regardless of output size.
+class BufferedWriter
+{
+public:
+    explicit BufferedWriter(QIODevice *device, int capacity = 64 * 1024);
+    ~BufferedWriter();
+
+    bool write(const char *data, qint64 size);
+    bool write(const QByteArray &data) { return write(data.constData(), data.size()); }
+    bool write(const QString &text) { return write(text.toUtf8()); }
+    bool write(char c) { return write(&c, 1); }
+    bool flush();
+
+    qint64 bytesWritten() const { return m_bytesWritten + m_buffer.size(); }
+    bool hasError() const { return m_error; }
+
+private:
+    QIODevice *m_device;
+    QByteArray m_buffer;
+    int m_capacity;
+    qint64 m_bytesWritten;
+    bool m_error;
+};
+
+#endif // BUFFEREDWRITER_H
@@ -0,0 +1,74 @@
+#ifndef XLSXWRITER_H
+#define XLSXWRITER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QList>
+#include "utils/zipwriter.h"
+
+class QIODevice;
+
+// One spreadsheet cell: a value, or a formula when formula is set
+struct XlsxCell {
+    QVariant value;
+    QString formula;             // Without the leading '='
+    int style = -1;              // XlsxWriter::Style; -1 picks one from the value
+
+    XlsxCell() {}
+    XlsxCell(const QVariant &cellValue, int cellStyle = -1) : value(cellValue), style(cellStyle) {}
+    static XlsxCell fromFormula(const QString &expression, int cellStyle = -1)
+    {
+        XlsxCell cell;
+        cell.formula = expression;
+        cell.style = cellStyle;
+        return cell;
+    }
+};
+
+// Streaming XLSX writer. Rows are serialized straight into the sheet's
+// ZIP entry as they arrive, with strings stored inline rather than in a
+// shared-string table, so memory does not grow with the sheet. Sheets are
+// written one after another; close() adds the workbook parts.
+class XlsxWriter
+{
+public:
+    enum Style {
+        General = 0,
+        Header,                  // Bold with a grey fill
+        Integer,                 // 0
+        Decimal,                 // 0.00
+        Percent,                 // 0.00% of a 0..1 value
+        Date                     // yyyy-mm-dd
+    };
+
+    explicit XlsxWriter(QIODevice *device);
+    ~XlsxWriter();
+
+    // frozenRows rows stay visible while scrolling; widths are in characters
+    bool beginSheet(const QString &name, int frozenRows = 1, const QList<double> &columnWidths = QList<double>());
+    bool addRow(const QList<XlsxCell> &cells);
+    bool addRow(const QVariantList &values, int style = -1);
+    bool endSheet();
+
+    bool close();
+
+    int rowCount() const { return m_rowCount; }
+    bool hasError() const { return m_zip.hasError(); }
+
+    static QString columnName(int column);
+    static QString cellReference(int column, int row) { return columnName(column) + QString::number(row); }
+
+private:
+    bool writeSheetData(const QString &xml);
+    static QString escape(const QString &text);
+    static int defaultStyle(const QVariant &value);
+
+    ZipWriter m_zip;
+    QStringList m_sheetNames;
+    QString m_rowXml;
+    bool m_inSheet;
+    int m_rowCount;
+};
+
+#endif // XLSXWRITER_H
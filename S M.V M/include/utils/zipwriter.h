@@ -0,0 +1,60 @@
+#ifndef ZIPWRITER_H
+#define ZIPWRITER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QList>
+
+class QIODevice;
+
+// Minimal streaming ZIP writer for OOXML containers. Entries are written
+// one at a time and may be any size: input is deflated in fixed chunks
+// (stored uncompressed when built without zlib) and the CRC and sizes are
+// patched into the local header afterwards, so the device must be
+// seekable. No ZIP64: entries and the archive stay under 4 GB.
+class ZipWriter
+{
+public:
+    explicit ZipWriter(QIODevice *device, int compressionLevel = 5);
+    ~ZipWriter();
+
+    bool beginEntry(const QString &name);
+    bool write(const char *data, qint64 size);
+    bool write(const QByteArray &data) { return write(data.constData(), data.size()); }
+    bool endEntry();
+
+    bool addEntry(const QString &name, const QByteArray &data);
+
+    // Writes the central directory; the archive is incomplete without it
+    bool finish();
+
+    bool hasError() const { return m_error; }
+
+private:
+    struct EntryRecord {
+        QByteArray name;
+        quint32 crc = 0;
+        quint32 compressedSize = 0;
+        quint32 size = 0;
+        quint32 offset = 0;
+        quint16 method = 0;
+    };
+
+    struct Deflater;
+
+    bool writeDevice(const QByteArray &data);
+    bool compressInput(bool finish);
+    bool fail(const QString &reason);
+
+    QIODevice *m_device;
+    Deflater *m_deflater;
+    QList<EntryRecord> m_entries;
+    EntryRecord m_current;
+    QByteArray m_input;
+    bool m_inEntry;
+    bool m_error;
+    quint16 m_dosTime;
+    quint16 m_dosDate;
+};
+
+#endif // ZIPWRITER_H
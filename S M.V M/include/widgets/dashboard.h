@@ -191,6 +191,7 @@ private:
     void updateAttendanceChart();
     void updatePerformanceChart();
     void updateTrendChart();
+    void applyTrendPoints();
     
     void showNotification(const QString &message, NotificationWidget::Type type = NotificationWidget::Info);
     void animateStatCards();
@@ -226,6 +227,10 @@ private:
     QChart *m_trendChart;
     QChart *m_overviewChart;
     
+    // Trend data at full daily resolution; the series holds a decimated copy
+    QLineSeries *m_trendSeries;
+    QList<QPointF> m_trendPoints;
+    
     // Notification system
     QWidget *m_notificationArea;
     QList<NotificationWidget*> m_notifications;
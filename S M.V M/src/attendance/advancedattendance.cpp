@@ -1,20 +1,45 @@
 #include "attendance/advancedattendance.h"
+#include "attendance/attendanceruleengine.h"
+#include "attendance/attendanceexporter.h"
+#include "attendance/attendancescheduler.h"
+#include "attendance/attendancejournal.h"
+#include "attendance/attendanceanomalydetector.h"
+#include "attendance/attendanceheatmap.h"
+#include "attendance/attendancerollups.h"
+#include "attendance/periodattendance.h"
 #include "database/database.h"
+#include "database/dataversions.h"
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QDebug>
 #include <QDateTime>
 #include <QTimer>
+#include <QSettings>
 #include <QTextStream>
+#include <QSet>
+#include <algorithm>
 
 AdvancedAttendance::AdvancedAttendance(QObject *parent)
     : QObject(parent)
-    , m_autoMarkTimer(new QTimer(this))
+    , m_autoMarkScheduler(new AttendanceScheduler(this))
+    , m_ruleEngine(new AttendanceRuleEngine(this))
+    , m_journal(new AttendanceJournal(this))
+    , m_exporter(new AttendanceExporter(this))
+    , m_periodAttendance(new PeriodAttendance(this))
+    , m_anomalyDetector(new AttendanceAnomalyDetector(this))
+    , m_rulesLoaded(false)
 {
-    connect(m_autoMarkTimer, &QTimer::timeout, this, &AdvancedAttendance::processAutoAttendance);
-    
-    // Check for auto attendance every minute
-    m_autoMarkTimer->start(60000);
+    connect(m_autoMarkScheduler, &AttendanceScheduler::deadlineReached,
+            this, &AdvancedAttendance::processAutoAttendance);
+    connect(m_anomalyDetector, &AttendanceAnomalyDetector::anomalyDetected,
+            this, &AdvancedAttendance::attendanceAlertRaised);
+    connect(m_exporter, &AttendanceExporter::progress, this, &AdvancedAttendance::exportProgress);
+    connect(m_journal, &AttendanceJournal::recordsApplied, this, []() {
+        DataVersions::instance().bump("advanced_attendance");
+    });
+    
+    // Deadlines come from the rules, so arm once the event loop (and database) is up
+    QTimer::singleShot(0, this, &AdvancedAttendance::startAutoMarkScheduler);
 }
 
 AdvancedAttendance::~AdvancedAttendance()
@@ -23,34 +48,121 @@ AdvancedAttendance::~AdvancedAttendance()
 
 bool AdvancedAttendance::markAttendance(const AttendanceEntry &entry)
 {
-    QSqlQuery query(Database::instance().database());
+    ensureRulesLoaded();
     
-    query.prepare("INSERT OR REPLACE INTO advanced_attendance "
-                 "(student_roll, date, time_in, time_out, status, method, "
-                 "location, notes, marked_by) "
-                 "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)");
-    
-    query.addBindValue(entry.studentRoll);
-    query.addBindValue(entry.date);
-    query.addBindValue(entry.timeIn);
-    query.addBindValue(entry.timeOut);
-    query.addBindValue(entry.status);
-    query.addBindValue(entry.method);
-    query.addBindValue(entry.location);
-    query.addBindValue(entry.notes);
-    query.addBindValue(entry.markedBy);
+    AttendanceEntry effective = entry;
+    RuleOutcome outcome = prepareEntry(effective);
     
-    if (!query.exec()) {
-        qDebug() << "Failed to mark attendance:" << query.lastError().text();
+    if (!writeAttendance({effective})) {
         return false;
     }
     
-    emit attendanceMarked(entry.studentRoll, entry.status);
+    applyRuleOutcome(outcome);
+    emit attendanceMarked(effective.studentRoll, effective.status);
     return true;
 }
 
+RuleOutcome AdvancedAttendance::prepareEntry(AttendanceEntry &entry)
+{
+    resolveStudentClass(entry);
+    
+    // Apply attendance rules before the entry is stored
+    RuleOutcome outcome = m_ruleEngine->evaluate(entry);
+    if (!outcome.status.isEmpty()) {
+        entry.status = outcome.status;
+    }
+    
+    // Approved leave turns an absence into Excused; rule alerts no longer apply
+    if (applyApprovedLeave(entry)) {
+        outcome.alerts.clear();
+    }
+    return outcome;
+}
+
+bool AdvancedAttendance::writeAttendance(const QList<AttendanceEntry> &entries)
+{
+    // Journal first: a locked or closed database never delays or loses a mark.
+    // Direct writes remain as the fallback when the journal is unavailable.
+    // Either way the entries are stored together or not at all.
+    bool journaled = ensureJournalOpen() && m_journal->appendMarks(entries);
+    if (!journaled && !insertAttendance(entries)) {
+        return false;
+    }
+    
+    for (const AttendanceEntry &entry : entries) {
+        m_ruleEngine->recordStatus(entry.studentRoll, entry.date, entry.status);
+        m_anomalyDetector->record(entry);
+        AttendanceHeatmap::instance().recordMark(entry.studentRoll, entry.grade, entry.section,
+                                                 entry.date, entry.status);
+    }
+    return true;
+}
+
+bool AdvancedAttendance::ensureJournalOpen()
+{
+    return m_journal->isOpen() || m_journal->open();
+}
+
+int AdvancedAttendance::pendingAttendanceWrites() const
+{
+    return m_journal->pendingCount();
+}
+
+bool AdvancedAttendance::insertAttendance(const QList<AttendanceEntry> &entries)
+{
+    QSqlDatabase db = Database::instance().database();
+    QSqlQuery query(db);
+    
+    if (!db.transaction()) {
+        qDebug() << "Failed to start attendance transaction:" << db.lastError().text();
+        return false;
+    }
+    
+    query.prepare(AttendanceJournal::markStatement());
+    
+    for (const AttendanceEntry &entry : entries) {
+        query.addBindValue(entry.studentRoll);
+        query.addBindValue(entry.date);
+        query.addBindValue(entry.timeIn);
+        query.addBindValue(entry.timeOut);
+        query.addBindValue(entry.status);
+        query.addBindValue(entry.method);
+        query.addBindValue(entry.location);
+        query.addBindValue(entry.notes);
+        query.addBindValue(entry.markedBy);
+        
+        if (!query.exec()) {
+            qDebug() << "Failed to mark attendance:" << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+    }
+    
+    if (!db.commit()) {
+        qDebug() << "Failed to commit attendance:" << db.lastError().text();
+        db.rollback();
+        return false;
+    }
+    
+    DataVersions::instance().bump("advanced_attendance");
+    return true;
+}
+
+void AdvancedAttendance::applyRuleOutcome(const RuleOutcome &outcome)
+{
+    for (const AttendanceAlert &alert : outcome.alerts) {
+        emit attendanceAlertRaised(alert);
+    }
+}
+
 bool AdvancedAttendance::markTimeOut(const QString &studentRoll, const QTime &timeOut)
 {
+    // Journaled behind the student's mark so the two apply in order
+    if (ensureJournalOpen() && m_journal->appendTimeOut(studentRoll, QDate::currentDate(), timeOut)) {
+        emit timeOutMarked(studentRoll, timeOut);
+        return true;
+    }
+    
     QSqlQuery query(Database::instance().database());
     
     query.prepare("UPDATE advanced_attendance SET time_out = ? "
@@ -65,6 +177,7 @@ bool AdvancedAttendance::markTimeOut(const QString &studentRoll, const QTime &ti
         return false;
     }
     
+    DataVersions::instance().bump("advanced_attendance");
     emit timeOutMarked(studentRoll, timeOut);
     return true;
 }
@@ -158,57 +271,102 @@ AttendanceStats AdvancedAttendance::getAttendanceStats(const QString &studentRol
     return stats;
 }
 
-QMap<QString, AttendanceStats> AdvancedAttendance::getClassAttendanceStats(const QString &grade, 
-                                                                          const QString &section, 
-                                                                          const QDate &fromDate, 
-                                                                          const QDate &toDate)
+ClassAttendanceStats AdvancedAttendance::getClassAttendanceStats(const QString &grade, 
+                                                                const QString &section, 
+                                                                const QDate &fromDate, 
+                                                                const QDate &toDate,
+                                                                double threshold)
 {
-    QMap<QString, AttendanceStats> classStats;
-    QSqlQuery query(Database::instance().database());
+    ClassAttendanceStats classStats;
+    classStats.grade = grade;
+    classStats.section = section;
+    classStats.threshold = threshold;
     
-    query.prepare("SELECT es.roll_number, aa.status, COUNT(*) as count "
+    QSqlQuery query(Database::instance().database());
+    query.setForwardOnly(true);
+    
+    // One row per student with every status counted in place
+    query.prepare("SELECT es.roll_number, "
+                 "SUM(CASE WHEN aa.status = 'Present' THEN 1 ELSE 0 END) AS present, "
+                 "SUM(CASE WHEN aa.status = 'Absent' THEN 1 ELSE 0 END) AS absent, "
+                 "SUM(CASE WHEN aa.status = 'Late' THEN 1 ELSE 0 END) AS late, "
+                 "SUM(CASE WHEN aa.status = 'Excused' THEN 1 ELSE 0 END) AS excused "
                  "FROM enhanced_students es "
                  "LEFT JOIN advanced_attendance aa ON es.roll_number = aa.student_roll "
                  "AND aa.date BETWEEN ? AND ? "
                  "WHERE es.grade = ? AND es.section = ? "
-                 "GROUP BY es.roll_number, aa.status");
+                 "GROUP BY es.roll_number "
+                 "ORDER BY es.roll_number");
     
     query.addBindValue(fromDate);
     query.addBindValue(toDate);
     query.addBindValue(grade);
     query.addBindValue(section);
     
-    if (query.exec()) {
-        while (query.next()) {
-            QString rollNumber = query.value("roll_number").toString();
-            QString status = query.value("status").toString();
-            int count = query.value("count").toInt();
-            
-            if (!classStats.contains(rollNumber)) {
-                classStats[rollNumber] = AttendanceStats();
-            }
-            
-            AttendanceStats &stats = classStats[rollNumber];
-            
-            if (status == "Present") {
-                stats.presentDays = count;
-            } else if (status == "Absent") {
-                stats.absentDays = count;
-            } else if (status == "Late") {
-                stats.lateDays = count;
-            } else if (status == "Excused") {
-                stats.excusedDays = count;
-            }
-        }
+    if (!query.exec()) {
+        qDebug() << "Failed to load class attendance stats:" << query.lastError().text();
+        return classStats;
     }
     
-    // Calculate totals and percentages
-    for (auto &stats : classStats) {
+    QVector<double> percentages;
+    double percentageSum = 0.0;
+    
+    // Single pass: per-student stats, class totals, mean and threshold count
+    while (query.next()) {
+        AttendanceStats stats;
+        stats.presentDays = query.value("present").toInt();
+        stats.absentDays = query.value("absent").toInt();
+        stats.lateDays = query.value("late").toInt();
+        stats.excusedDays = query.value("excused").toInt();
         stats.totalDays = stats.presentDays + stats.absentDays + stats.lateDays + stats.excusedDays;
         stats.attendancePercentage = stats.totalDays > 0 ? 
             (double)(stats.presentDays + stats.lateDays + stats.excusedDays) / stats.totalDays * 100 : 0.0;
+        
+        classStats.studentRolls.append(query.value("roll_number").toString());
+        classStats.students.append(stats);
+        
+        classStats.classTotals.presentDays += stats.presentDays;
+        classStats.classTotals.absentDays += stats.absentDays;
+        classStats.classTotals.lateDays += stats.lateDays;
+        classStats.classTotals.excusedDays += stats.excusedDays;
+        
+        // Students with no attendance in range say nothing about the distribution
+        if (stats.totalDays > 0) {
+            percentages.append(stats.attendancePercentage);
+            percentageSum += stats.attendancePercentage;
+            if (stats.attendancePercentage < threshold) {
+                classStats.belowThreshold++;
+            }
+        }
+    }
+    
+    AttendanceStats &totals = classStats.classTotals;
+    totals.totalDays = totals.presentDays + totals.absentDays + totals.lateDays + totals.excusedDays;
+    totals.attendancePercentage = totals.totalDays > 0 ?
+        (double)(totals.presentDays + totals.lateDays + totals.excusedDays) / totals.totalDays * 100 : 0.0;
+    
+    classStats.studentsWithData = percentages.size();
+    if (percentages.isEmpty()) {
+        return classStats;
     }
     
+    classStats.meanPercentage = percentageSum / percentages.size();
+    
+    // Linear-interpolated percentiles over the sorted percentages
+    std::sort(percentages.begin(), percentages.end());
+    auto percentile = [&percentages](double p) {
+        double position = p * (percentages.size() - 1);
+        int lower = static_cast<int>(position);
+        int upper = qMin(lower + 1, static_cast<int>(percentages.size()) - 1);
+        return percentages.at(lower) + (percentages.at(upper) - percentages.at(lower)) * (position - lower);
+    };
+    
+    classStats.p10Percentage = percentile(0.10);
+    classStats.p25Percentage = percentile(0.25);
+    classStats.medianPercentage = percentile(0.50);
+    classStats.p75Percentage = percentile(0.75);
+    classStats.p90Percentage = percentile(0.90);
+    
     return classStats;
 }
 
@@ -292,6 +450,13 @@ bool AdvancedAttendance::verifyBiometric(const QString &biometricHash, const QSt
 
 bool AdvancedAttendance::addAttendanceRule(const AttendanceRule &rule)
 {
+    // Reject rules the engine cannot compile instead of storing dead rules
+    QString error;
+    if (!AttendanceRuleEngine::validateRule(rule, &error)) {
+        qDebug() << "Invalid attendance rule" << rule.ruleName << ":" << error;
+        return false;
+    }
+    
     QSqlQuery query(Database::instance().database());
     
     query.prepare("INSERT INTO attendance_rules (rule_name, rule_type, conditions, "
@@ -312,6 +477,7 @@ bool AdvancedAttendance::addAttendanceRule(const AttendanceRule &rule)
         return false;
     }
     
+    reloadAttendanceRules();
     return true;
 }
 
@@ -339,39 +505,203 @@ QList<AttendanceRule> AdvancedAttendance::getAttendanceRules()
     return rules;
 }
 
+void AdvancedAttendance::reloadAttendanceRules()
+{
+    loadScheduleSettings();
+    m_ruleEngine->setSchoolDayEnd(m_autoMarkScheduler->schoolDayEnd());
+    m_ruleEngine->loadRules(getAttendanceRules());
+    
+    // Grade/section lookup so class-scoped rules apply to roll-only entries
+    m_studentClasses.clear();
+    QSqlQuery query(Database::instance().database());
+    query.setForwardOnly(true);
+    
+    if (query.exec("SELECT roll_number, grade, section FROM enhanced_students")) {
+        while (query.next()) {
+            m_studentClasses.insert(query.value("roll_number").toString(),
+                                    qMakePair(query.value("grade").toString(),
+                                              query.value("section").toString()));
+        }
+    }
+    
+    QHash<QString, int> classSizes;
+    for (const QPair<QString, QString> &studentClass : m_studentClasses) {
+        classSizes[studentClass.first + QLatin1Char('|') + studentClass.second]++;
+    }
+    m_anomalyDetector->setClassSizes(classSizes);
+    
+    m_rulesLoaded = true;
+    
+    m_autoMarkScheduler->setDeadlines(autoMarkDeadlines());
+}
+
+void AdvancedAttendance::startAutoMarkScheduler()
+{
+    ensureRulesLoaded();
+    m_autoMarkScheduler->start();
+}
+
+void AdvancedAttendance::loadScheduleSettings()
+{
+    // Kept with the main window's preferences; defaults are the 16:00 close and a Saturday weekend
+    QSettings settings;
+    QTime dayEnd = QTime::fromString(settings.value("schoolDayEnd", "16:00").toString(), "H:mm");
+    if (dayEnd.isValid()) {
+        m_autoMarkScheduler->setSchoolDayEnd(dayEnd);
+    } else {
+        qDebug() << "Ignoring invalid schoolDayEnd setting:" << settings.value("schoolDayEnd").toString();
+    }
+    
+    QList<int> offDays;
+    const QVariantList days = settings.value("weeklyOffDays", QVariantList{ int(Qt::Saturday) }).toList();
+    for (const QVariant &day : days) {
+        int dayOfWeek = day.toInt();
+        if (dayOfWeek >= Qt::Monday && dayOfWeek <= Qt::Sunday) {
+            offDays.append(dayOfWeek);
+        }
+    }
+    m_autoMarkScheduler->setWeeklyOffDays(offDays);
+}
+
+QList<QTime> AdvancedAttendance::autoMarkDeadlines() const
+{
+    // Union of the AutoMark cutoffs of every class on the roster
+    QSet<QPair<QString, QString>> classes;
+    for (const QPair<QString, QString> &studentClass : m_studentClasses) {
+        classes.insert(studentClass);
+    }
+    
+    QList<QTime> deadlines;
+    for (const QPair<QString, QString> &studentClass : classes) {
+        for (const QTime &time : m_ruleEngine->autoMarkTimes(studentClass.first, studentClass.second)) {
+            if (!deadlines.contains(time)) {
+                deadlines.append(time);
+            }
+        }
+    }
+    
+    return deadlines;
+}
+
+void AdvancedAttendance::ensureRulesLoaded()
+{
+    if (m_rulesLoaded) {
+        return;
+    }
+    
+    reloadAttendanceRules();
+    m_ruleEngine->loadMonthlyCounters(QDate::currentDate());
+    m_anomalyDetector->load(QDate::currentDate());
+}
+
+void AdvancedAttendance::ensureLeavesLoaded()
+{
+    if (!m_leaveIndex.isLoaded()) {
+        m_leaveIndex.load();
+    }
+}
+
+bool AdvancedAttendance::applyApprovedLeave(AttendanceEntry &entry)
+{
+    // A student who turns up while on leave keeps their Present/Late mark
+    if (entry.status == "Present" || entry.status == "Late" || entry.status == "Excused") {
+        return false;
+    }
+    
+    ensureLeavesLoaded();
+    
+    int requestId = 0;
+    if (!m_leaveIndex.isOnLeave(entry.studentRoll, entry.date, &requestId)) {
+        return false;
+    }
+    
+    entry.status = "Excused";
+    entry.method = "Leave Request";
+    entry.notes = QString("Approved leave request #%1").arg(requestId);
+    return true;
+}
+
+void AdvancedAttendance::resolveStudentClass(AttendanceEntry &entry) const
+{
+    if (!entry.grade.isEmpty() && !entry.section.isEmpty()) {
+        return;
+    }
+    
+    auto it = m_studentClasses.constFind(entry.studentRoll);
+    if (it != m_studentClasses.constEnd()) {
+        if (entry.grade.isEmpty()) entry.grade = it->first;
+        if (entry.section.isEmpty()) entry.section = it->second;
+    }
+}
+
 void AdvancedAttendance::processAutoAttendance()
 {
-    // Auto-mark students as late if they haven't arrived by a certain time
-    QTime cutoffTime = QTime(9, 0); // 9:00 AM cutoff
+    ensureRulesLoaded();
+    
     QTime currentTime = QTime::currentTime();
     QDate currentDate = QDate::currentDate();
     
-    if (currentTime >= cutoffTime) {
-        QSqlQuery query(Database::instance().database());
+    // No AutoMark rule can fire before its earliest cutoff, so skip the query
+    QTime earliestCutoff = m_ruleEngine->earliestAutoMarkTime();
+    if (!earliestCutoff.isValid() || currentTime < earliestCutoff) {
+        return;
+    }
+    
+    QSqlQuery query(Database::instance().database());
+    
+    // Find students who haven't been marked today
+    query.prepare("SELECT es.roll_number, es.name, es.grade, es.section FROM enhanced_students es "
+                 "LEFT JOIN advanced_attendance aa ON es.roll_number = aa.student_roll "
+                 "AND aa.date = ? "
+                 "WHERE aa.student_roll IS NULL");
+    
+    query.addBindValue(currentDate);
+    
+    if (!query.exec()) {
+        qDebug() << "Failed to load unmarked students:" << query.lastError().text();
+        return;
+    }
+    
+    QList<AttendanceEntry> unmarked;
+    while (query.next()) {
+        AttendanceEntry entry;
+        entry.studentRoll = query.value("roll_number").toString();
+        
+        // Marked already, but still on its way from the journal to SQLite
+        if (m_journal->hasPending(entry.studentRoll, currentDate)) {
+            continue;
+        }
+        
+        entry.studentName = query.value("name").toString();
+        entry.grade = query.value("grade").toString();
+        entry.section = query.value("section").toString();
+        entry.date = currentDate;
+        entry.status.clear(); // Unmarked; AutoMark rules decide the status
+        entry.method = "Auto-System";
+        unmarked.append(entry);
+    }
+    
+    for (AttendanceEntry &entry : unmarked) {
+        RuleOutcome outcome = m_ruleEngine->evaluate(entry, currentTime);
+        if (outcome.status.isEmpty()) {
+            continue;
+        }
         
-        // Find students who haven't been marked present today
-        query.prepare("SELECT es.roll_number FROM enhanced_students es "
-                     "LEFT JOIN advanced_attendance aa ON es.roll_number = aa.student_roll "
-                     "AND aa.date = ? "
-                     "WHERE aa.student_roll IS NULL");
+        entry.status = outcome.status;
+        entry.location = "Auto-Generated";
+        entry.markedBy = "System";
         
-        query.addBindValue(currentDate);
+        if (applyApprovedLeave(entry)) {
+            outcome.alerts.clear();
+        } else {
+            entry.notes = QString("Auto-marked %1 - no check-in recorded (%2)")
+                         .arg(outcome.status.toLower())
+                         .arg(outcome.firedRules.join(", "));
+        }
         
-        if (query.exec()) {
-            while (query.next()) {
-                QString studentRoll = query.value("roll_number").toString();
-                
-                AttendanceEntry entry;
-                entry.studentRoll = studentRoll;
-                entry.date = currentDate;
-                entry.status = "Absent";
-                entry.method = "Auto-System";
-                entry.location = "Auto-Generated";
-                entry.markedBy = "System";
-                entry.notes = "Auto-marked absent - no check-in recorded";
-                
-                markAttendance(entry);
-            }
+        if (writeAttendance({entry})) {
+            applyRuleOutcome(outcome);
+            emit attendanceMarked(entry.studentRoll, entry.status);
         }
     }
 }
@@ -548,7 +878,7 @@ bool AdvancedAttendance::approveLeaveRequest(int requestId, const QString &appro
         return false;
     }
     
-    // Get request details for marking excused attendance
+    // Get request details for re-classifying the covered days
     query.prepare("SELECT student_roll, from_date, to_date FROM leave_requests WHERE id = ?");
     query.addBindValue(requestId);
     
@@ -557,18 +887,12 @@ bool AdvancedAttendance::approveLeaveRequest(int requestId, const QString &appro
         QDate fromDate = query.value("from_date").toDate();
         QDate toDate = query.value("to_date").toDate();
         
-        // Mark all days in range as excused
-        for (QDate date = fromDate; date <= toDate; date = date.addDays(1)) {
-            AttendanceEntry entry;
-            entry.studentRoll = studentRoll;
-            entry.date = date;
-            entry.status = "Excused";
-            entry.method = "Leave Request";
-            entry.location = "N/A";
-            entry.markedBy = approvedBy;
-            entry.notes = "Approved leave request";
-            
-            markAttendance(entry);
+        // Future days are excused as they are marked, via the leave index
+        ensureLeavesLoaded();
+        m_leaveIndex.addLeave(studentRoll, fromDate, toDate, requestId);
+        
+        if (!excuseLeaveDays(studentRoll, fromDate, toDate, requestId, approvedBy)) {
+            return false;
         }
     }
     
@@ -576,72 +900,134 @@ bool AdvancedAttendance::approveLeaveRequest(int requestId, const QString &appro
     return true;
 }
 
-bool AdvancedAttendance::exportAttendanceData(const QString &filePath, const QString &format,
-                                             const QDate &fromDate, const QDate &toDate,
-                                             const QString &grade, const QString &section)
+bool AdvancedAttendance::excuseLeaveDays(const QString &studentRoll, const QDate &fromDate, const QDate &toDate,
+                                         int requestId, const QString &approvedBy)
 {
-    Q_UNUSED(format) // Currently only supporting CSV
+    QDate lastDay = qMin(toDate, QDate::currentDate());
+    if (!fromDate.isValid() || fromDate > lastDay) {
+        return true;
+    }
     
-    QSqlQuery query(Database::instance().database());
+    ensureRulesLoaded();
     
-    QString queryStr = "SELECT aa.*, es.name, es.grade, es.section "
-                      "FROM advanced_attendance aa "
-                      "JOIN enhanced_students es ON aa.student_roll = es.roll_number "
-                      "WHERE aa.date BETWEEN ? AND ?";
+    QSqlDatabase db = Database::instance().database();
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
     
-    QStringList params;
-    params << fromDate.toString(Qt::ISODate) << toDate.toString(Qt::ISODate);
+    // Existing marks in the range: absences get excused, other marks are kept
+    query.prepare("SELECT date, status FROM advanced_attendance "
+                 "WHERE student_roll = ? AND date BETWEEN ? AND ?");
+    query.addBindValue(studentRoll);
+    query.addBindValue(fromDate);
+    query.addBindValue(lastDay);
     
-    if (!grade.isEmpty()) {
-        queryStr += " AND es.grade = ?";
-        params << grade;
+    if (!query.exec()) {
+        qDebug() << "Failed to load attendance for leave:" << query.lastError().text();
+        return false;
     }
     
-    if (!section.isEmpty()) {
-        queryStr += " AND es.section = ?";
-        params << section;
+    QSet<QDate> markedDays;
+    QList<QDate> excusedDays;
+    while (query.next()) {
+        QDate date = query.value("date").toDate();
+        markedDays.insert(date);
+        if (query.value("status").toString() == "Absent") {
+            excusedDays.append(date);
+        }
     }
     
-    queryStr += " ORDER BY aa.date, es.grade, es.section, es.name";
+    // Unmarked days are only filled in where the school was open, by the scheduler's calendar
+    QVariantList missingDays;
+    for (QDate date = fromDate; date <= lastDay; date = date.addDays(1)) {
+        if (!markedDays.contains(date) && m_autoMarkScheduler->isSchoolDay(date)) {
+            missingDays.append(date);
+            excusedDays.append(date);
+        }
+    }
     
-    query.prepare(queryStr);
-    for (const QString &param : params) {
-        query.addBindValue(param);
+    if (excusedDays.isEmpty()) {
+        return true;
     }
     
-    if (!query.exec()) {
-        qDebug() << "Failed to export attendance data:" << query.lastError().text();
+    QString notes = QString("Approved leave request #%1").arg(requestId);
+    
+    if (!db.transaction()) {
+        qDebug() << "Failed to start leave transaction:" << db.lastError().text();
         return false;
     }
     
-    // Write to CSV file (simplified implementation)
-    QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    query.prepare("UPDATE advanced_attendance SET status = 'Excused', method = 'Leave Request', "
+                 "notes = ?, marked_by = ? "
+                 "WHERE student_roll = ? AND date BETWEEN ? AND ? AND status = 'Absent'");
+    query.addBindValue(notes);
+    query.addBindValue(approvedBy);
+    query.addBindValue(studentRoll);
+    query.addBindValue(fromDate);
+    query.addBindValue(lastDay);
+    
+    bool ok = query.exec();
+    
+    if (ok && !missingDays.isEmpty()) {
+        QVariantList rolls, notesList, markedBy;
+        for (int i = 0; i < missingDays.size(); ++i) {
+            rolls.append(studentRoll);
+            notesList.append(notes);
+            markedBy.append(approvedBy);
+        }
+        
+        query.prepare("INSERT OR IGNORE INTO advanced_attendance "
+                     "(student_roll, date, status, method, location, notes, marked_by) "
+                     "VALUES (?, ?, 'Excused', 'Leave Request', 'N/A', ?, ?)");
+        query.addBindValue(rolls);
+        query.addBindValue(missingDays);
+        query.addBindValue(notesList);
+        query.addBindValue(markedBy);
+        ok = query.execBatch();
+    }
+    
+    if (!ok) {
+        qDebug() << "Failed to excuse leave days:" << query.lastError().text();
+        db.rollback();
         return false;
     }
     
-    QTextStream out(&file);
-    out << "Date,Roll Number,Student Name,Grade,Section,Time In,Time Out,Status,Method,Location,Marked By,Notes\n";
+    if (!db.commit()) {
+        qDebug() << "Failed to commit excused leave days:" << db.lastError().text();
+        db.rollback();
+        return false;
+    }
+    DataVersions::instance().bump("advanced_attendance");
+    
+    QPair<QString, QString> studentClass = m_studentClasses.value(studentRoll);
+    for (const QDate &date : excusedDays) {
+        m_ruleEngine->recordStatus(studentRoll, date, "Excused");
+        AttendanceHeatmap::instance().recordMark(studentRoll, studentClass.first, studentClass.second,
+                                                 date, "Excused");
+        emit attendanceMarked(studentRoll, "Excused");
+    }
     
-    while (query.next()) {
-        out << query.value("date").toString() << ","
-            << query.value("student_roll").toString() << ","
-            << query.value("name").toString() << ","
-            << query.value("grade").toString() << ","
-            << query.value("section").toString() << ","
-            << query.value("time_in").toString() << ","
-            << query.value("time_out").toString() << ","
-            << query.value("status").toString() << ","
-            << query.value("method").toString() << ","
-            << query.value("location").toString() << ","
-            << query.value("marked_by").toString() << ","
-            << query.value("notes").toString() << "\n";
-    }
-    
-    file.close();
     return true;
 }
 
+bool AdvancedAttendance::exportAttendanceData(const QString &filePath, const QString &format,
+                                             const QDate &fromDate, const QDate &toDate,
+                                             const QString &grade, const QString &section)
+{
+    AttendanceExporter::Format exportFormat;
+    if (!AttendanceExporter::formatFromString(format, &exportFormat)) {
+        qDebug() << "Unsupported attendance export format:" << format;
+        return false;
+    }
+    
+    // Streams in date windows through a fixed buffer; memory stays constant
+    return m_exporter->exportRange(filePath, exportFormat, fromDate, toDate, grade, section);
+}
+
+void AdvancedAttendance::cancelExport()
+{
+    m_exporter->cancel();
+}
+
 QList<QString> AdvancedAttendance::getDefaultStudents(const QDate &date)
 {
     QStringList absentStudents;
@@ -774,26 +1160,33 @@ bool AdvancedAttendance::createDatabaseTables()
         return false;
     }
     
-    return true;
+    return m_anomalyDetector->createDatabaseTables()
+        && m_periodAttendance->createDatabaseTables()
+        && AttendanceRollups::createTables(Database::instance().database());
 }
 
 bool AdvancedAttendance::bulkMarkAttendance(const QList<AttendanceEntry> &entries)
 {
-    Database::instance().database().transaction();
-    
-    bool allSuccessful = true;
+    ensureRulesLoaded();
+    
+    // Rules and leave are settled for every entry first, then all of them
+    // are written as one journal record (or one transaction)
+    QList<AttendanceEntry> effective;
+    QList<RuleOutcome> outcomes;
+    effective.reserve(entries.size());
+    outcomes.reserve(entries.size());
     for (const AttendanceEntry &entry : entries) {
-        if (!markAttendance(entry)) {
-            allSuccessful = false;
-            break;
-        }
+        effective.append(entry);
+        outcomes.append(prepareEntry(effective.last()));
     }
     
-    if (allSuccessful) {
-        Database::instance().database().commit();
-    } else {
-        Database::instance().database().rollback();
+    if (!writeAttendance(effective)) {
+        return false;
     }
     
-    return allSuccessful;
+    for (int i = 0; i < effective.size(); ++i) {
+        applyRuleOutcome(outcomes.at(i));
+        emit attendanceMarked(effective.at(i).studentRoll, effective.at(i).status);
+    }
+    return true;
 }
@@ -0,0 +1,391 @@
+#include "attendance/attendanceanomalydetector.h"
+#include "database/database.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QLocale>
+#include <QDebug>
+#include <cmath>
+
+namespace {
+
+// Days folded into a fresh baseline on first run, and the most a restart catches up
+const int kSeedDays = 28;
+
+// Floor on the standard deviation so a class that is never absent does not
+// alert on a single absence
+const double kMinimumDeviation = 0.05;
+
+struct Level {
+    double z;
+    const char *severity;
+};
+
+const Level kLevels[] = {
+    { 2.5, "Medium" },
+    { 3.5, "High" },
+    { 5.0, "Critical" }
+};
+
+} // namespace
+
+AttendanceAnomalyDetector::AttendanceAnomalyDetector(QObject *parent)
+    : QObject(parent)
+    , m_alpha(0.2)
+    , m_minimumSamples(4)
+    , m_dayTimer(new QTimer(this))
+{
+    m_dayTimer->setSingleShot(true);
+    connect(m_dayTimer, &QTimer::timeout, this, &AttendanceAnomalyDetector::rollOver);
+}
+
+AttendanceAnomalyDetector::~AttendanceAnomalyDetector()
+{
+}
+
+void AttendanceAnomalyDetector::setClassSizes(const QHash<QString, int> &sizes)
+{
+    m_classSizes = sizes;
+}
+
+QString AttendanceAnomalyDetector::classKey(const QString &grade, const QString &section)
+{
+    return grade + QLatin1Char('|') + section;
+}
+
+QString AttendanceAnomalyDetector::baselineKey(const QString &classKey, int weekday)
+{
+    return classKey + QLatin1Char('|') + QString::number(weekday);
+}
+
+bool AttendanceAnomalyDetector::isAway(const QString &status)
+{
+    return status == "Absent" || status == "Excused";
+}
+
+int AttendanceAnomalyDetector::minimumMarked(const QString &key) const
+{
+    // Judge a class only once at least half of it has been marked
+    int size = m_classSizes.value(key);
+    return qMax(5, size / 2);
+}
+
+bool AttendanceAnomalyDetector::load(const QDate &today)
+{
+    QSqlQuery query(Database::instance().database());
+    query.setForwardOnly(true);
+    
+    m_baselines.clear();
+    m_lastFoldedDate = QDate();
+    
+    if (!query.exec("SELECT grade, section, weekday, mean, variance, samples, last_date "
+                    "FROM attendance_baselines")) {
+        qDebug() << "Failed to load attendance baselines:" << query.lastError().text();
+        return false;
+    }
+    
+    while (query.next()) {
+        Baseline baseline;
+        baseline.mean = query.value("mean").toDouble();
+        baseline.variance = query.value("variance").toDouble();
+        baseline.samples = query.value("samples").toInt();
+        
+        QString key = classKey(query.value("grade").toString(), query.value("section").toString());
+        m_baselines.insert(baselineKey(key, query.value("weekday").toInt()), baseline);
+        
+        QDate lastDate = query.value("last_date").toDate();
+        if (lastDate.isValid() && (!m_lastFoldedDate.isValid() || lastDate > m_lastFoldedDate)) {
+            m_lastFoldedDate = lastDate;
+        }
+    }
+    
+    // Fold only the days that closed while the application was not running
+    QDate foldFrom = today.addDays(-kSeedDays);
+    if (m_lastFoldedDate.isValid() && m_lastFoldedDate >= foldFrom) {
+        foldFrom = m_lastFoldedDate.addDays(1);
+    }
+    
+    if (foldFrom < today) {
+        query.prepare("SELECT aa.date, es.grade, es.section, COUNT(*) AS marked, "
+                     "SUM(CASE WHEN aa.status IN ('Absent', 'Excused') THEN 1 ELSE 0 END) AS away "
+                     "FROM advanced_attendance aa "
+                     "JOIN enhanced_students es ON aa.student_roll = es.roll_number "
+                     "WHERE aa.date >= ? AND aa.date < ? "
+                     "GROUP BY aa.date, es.grade, es.section "
+                     "ORDER BY aa.date");
+        query.addBindValue(foldFrom);
+        query.addBindValue(today);
+        
+        if (query.exec()) {
+            QHash<QString, QPair<QString, QString>> touched;
+            while (query.next()) {
+                QString grade = query.value("grade").toString();
+                QString section = query.value("section").toString();
+                int marked = query.value("marked").toInt();
+                
+                if (marked >= minimumMarked(classKey(grade, section))) {
+                    int weekday = query.value("date").toDate().dayOfWeek();
+                    foldDay(grade, section, weekday, double(query.value("away").toInt()) / marked);
+                    touched.insert(baselineKey(classKey(grade, section), weekday), qMakePair(grade, section));
+                }
+            }
+            
+            m_lastFoldedDate = today.addDays(-1);
+            for (auto it = touched.constBegin(); it != touched.constEnd(); ++it) {
+                int weekday = it.key().section(QLatin1Char('|'), -1).toInt();
+                saveBaseline(it->first, it->second, weekday, m_baselines.value(it.key()), m_lastFoldedDate);
+            }
+        } else {
+            qDebug() << "Failed to fold missed attendance days:" << query.lastError().text();
+        }
+    }
+    
+    startDay(today);
+    
+    // Rebuild today's counters from today's rows only
+    query.prepare("SELECT aa.student_roll, es.grade, es.section, aa.status "
+                 "FROM advanced_attendance aa "
+                 "JOIN enhanced_students es ON aa.student_roll = es.roll_number "
+                 "WHERE aa.date = ?");
+    query.addBindValue(today);
+    
+    if (!query.exec()) {
+        qDebug() << "Failed to load today's attendance for anomaly detection:" << query.lastError().text();
+        return false;
+    }
+    
+    while (query.next()) {
+        QString grade = query.value("grade").toString();
+        QString section = query.value("section").toString();
+        QString key = classKey(grade, section);
+        QString status = query.value("status").toString();
+        
+        ClassDay &day = m_today[key];
+        day.grade = grade;
+        day.section = section;
+        day.marked++;
+        if (isAway(status)) {
+            day.away++;
+        }
+        m_studentToday.insert(query.value("student_roll").toString(), qMakePair(key, status));
+    }
+    
+    return true;
+}
+
+void AttendanceAnomalyDetector::startDay(const QDate &date)
+{
+    m_currentDate = date;
+    m_today.clear();
+    m_studentToday.clear();
+    armDayTimer();
+}
+
+void AttendanceAnomalyDetector::armDayTimer()
+{
+    // Just past the next midnight; record() also checks, in case the machine slept through it
+    QDateTime midnight(QDate::currentDate().addDays(1), QTime(0, 0, 1));
+    m_dayTimer->start(static_cast<int>(qMax<qint64>(0, QDateTime::currentDateTime().msecsTo(midnight))));
+}
+
+void AttendanceAnomalyDetector::rollOver()
+{
+    QDate today = QDate::currentDate();
+    if (!m_currentDate.isValid()) {
+        return;
+    }
+    
+    // Woken early, or the clock went back
+    if (today <= m_currentDate) {
+        armDayTimer();
+        return;
+    }
+    
+    closeDay();
+    startDay(today);
+}
+
+void AttendanceAnomalyDetector::closeDay()
+{
+    if (!m_currentDate.isValid() || (m_lastFoldedDate.isValid() && m_lastFoldedDate >= m_currentDate)) {
+        return;
+    }
+    
+    const int weekday = m_currentDate.dayOfWeek();
+    for (auto it = m_today.constBegin(); it != m_today.constEnd(); ++it) {
+        const ClassDay &day = it.value();
+        if (day.marked < minimumMarked(it.key())) {
+            continue;
+        }
+        
+        foldDay(day.grade, day.section, weekday, double(day.away) / day.marked);
+        saveBaseline(day.grade, day.section, weekday, m_baselines.value(baselineKey(it.key(), weekday)),
+                     m_currentDate);
+    }
+    
+    m_lastFoldedDate = m_currentDate;
+}
+
+void AttendanceAnomalyDetector::foldDay(const QString &grade, const QString &section, int weekday, double rate)
+{
+    Baseline &baseline = m_baselines[baselineKey(classKey(grade, section), weekday)];
+    
+    if (baseline.samples == 0) {
+        baseline.mean = rate;
+        baseline.variance = 0.0;
+    } else {
+        // Incremental EWMA mean and variance
+        double diff = rate - baseline.mean;
+        double increment = m_alpha * diff;
+        baseline.mean += increment;
+        baseline.variance = (1.0 - m_alpha) * (baseline.variance + diff * increment);
+    }
+    
+    baseline.samples++;
+}
+
+bool AttendanceAnomalyDetector::saveBaseline(const QString &grade, const QString &section, int weekday,
+                                             const Baseline &baseline, const QDate &foldedDate)
+{
+    QSqlQuery query(Database::instance().database());
+    
+    query.prepare("INSERT OR REPLACE INTO attendance_baselines "
+                 "(grade, section, weekday, mean, variance, samples, last_date) "
+                 "VALUES (?, ?, ?, ?, ?, ?, ?)");
+    query.addBindValue(grade);
+    query.addBindValue(section);
+    query.addBindValue(weekday);
+    query.addBindValue(baseline.mean);
+    query.addBindValue(baseline.variance);
+    query.addBindValue(baseline.samples);
+    query.addBindValue(foldedDate);
+    
+    if (!query.exec()) {
+        qDebug() << "Failed to save attendance baseline:" << query.lastError().text();
+        return false;
+    }
+    
+    return true;
+}
+
+void AttendanceAnomalyDetector::record(const AttendanceEntry &entry)
+{
+    if (!m_currentDate.isValid() || entry.grade.isEmpty()) {
+        return;
+    }
+    
+    if (QDate::currentDate() > m_currentDate) {
+        rollOver();
+    }
+    
+    if (entry.date != m_currentDate) {
+        return;
+    }
+    
+    QString key = classKey(entry.grade, entry.section);
+    
+    // A re-mark replaces the student's earlier status for today
+    auto previous = m_studentToday.constFind(entry.studentRoll);
+    if (previous != m_studentToday.constEnd()) {
+        ClassDay &oldDay = m_today[previous->first];
+        oldDay.marked--;
+        if (isAway(previous->second)) {
+            oldDay.away--;
+        }
+    }
+    
+    ClassDay &day = m_today[key];
+    day.grade = entry.grade;
+    day.section = entry.section;
+    day.marked++;
+    if (isAway(entry.status)) {
+        day.away++;
+    }
+    m_studentToday.insert(entry.studentRoll, qMakePair(key, entry.status));
+    
+    check(day);
+}
+
+void AttendanceAnomalyDetector::check(ClassDay &day)
+{
+    QString key = classKey(day.grade, day.section);
+    if (day.marked < minimumMarked(key)) {
+        return;
+    }
+    
+    const int weekday = m_currentDate.dayOfWeek();
+    auto it = m_baselines.constFind(baselineKey(key, weekday));
+    if (it == m_baselines.constEnd() || it->samples < m_minimumSamples) {
+        return;
+    }
+    
+    // Only unusually high absence is actionable
+    double rate = double(day.away) / day.marked;
+    double deviation = qMax(std::sqrt(it->variance), kMinimumDeviation);
+    double z = (rate - it->mean) / deviation;
+    
+    int level = 0;
+    for (const Level &candidate : kLevels) {
+        if (z >= candidate.z) {
+            level++;
+        }
+    }
+    
+    if (level <= day.raisedLevel) {
+        return;
+    }
+    day.raisedLevel = level;
+    
+    AttendanceAlert alert;
+    alert.grade = day.grade;
+    alert.section = day.section;
+    alert.alertType = "Attendance Anomaly";
+    alert.message = QString("Grade %1-%2 has %3% absent today against a usual %4% on %5 (%6 of %7 marked)")
+                   .arg(day.grade)
+                   .arg(day.section)
+                   .arg(rate * 100, 0, 'f', 1)
+                   .arg(it->mean * 100, 0, 'f', 1)
+                   .arg(QLocale().dayName(weekday))
+                   .arg(day.away)
+                   .arg(day.marked);
+    alert.severity = kLevels[level - 1].severity;
+    alert.alertDate = QDateTime::currentDateTime();
+    
+    emit anomalyDetected(alert);
+}
+
+double AttendanceAnomalyDetector::baselineRate(const QString &grade, const QString &section, int weekday) const
+{
+    return m_baselines.value(baselineKey(classKey(grade, section), weekday)).mean;
+}
+
+double AttendanceAnomalyDetector::todayRate(const QString &grade, const QString &section) const
+{
+    ClassDay day = m_today.value(classKey(grade, section));
+    return day.marked > 0 ? double(day.away) / day.marked : 0.0;
+}
+
+bool AttendanceAnomalyDetector::createDatabaseTables()
+{
+    QSqlQuery query(Database::instance().database());
+    
+    // EWMA absence-rate baseline per class and weekday
+    QString createBaselinesTable = R"(
+        CREATE TABLE IF NOT EXISTS attendance_baselines (
+            grade TEXT NOT NULL,
+            section TEXT NOT NULL,
+            weekday INTEGER NOT NULL,
+            mean REAL NOT NULL DEFAULT 0,
+            variance REAL NOT NULL DEFAULT 0,
+            samples INTEGER NOT NULL DEFAULT 0,
+            last_date DATE,
+            PRIMARY KEY (grade, section, weekday)
+        )
+    )";
+    
+    if (!query.exec(createBaselinesTable)) {
+        qDebug() << "Failed to create attendance_baselines table:" << query.lastError().text();
+        return false;
+    }
+    
+    return true;
+}
@@ -0,0 +1,344 @@
+#include "attendance/attendanceexporter.h"
+#include "database/database.h"
+#include "utils/bufferedwriter.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QFile>
+#include <QHash>
+#include <QVector>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QDebug>
+#include <memory>
+
+namespace {
+
+// Column order of the export query; every encoder reads values by index
+const char *const kColumns[] = {
+    "date", "roll_number", "name", "grade", "section", "time_in", "time_out",
+    "status", "method", "location", "marked_by", "notes"
+};
+const int kColumnCount = sizeof(kColumns) / sizeof(kColumns[0]);
+const int kRowGroupSize = 4096;
+
+class RowEncoder
+{
+public:
+    explicit RowEncoder(BufferedWriter &writer) : m_writer(writer) {}
+    virtual ~RowEncoder() {}
+
+    virtual bool begin() = 0;
+    virtual bool writeRow(const QSqlQuery &query) = 0;
+    virtual bool end() { return true; }
+
+protected:
+    BufferedWriter &m_writer;
+};
+
+class CsvEncoder : public RowEncoder
+{
+public:
+    using RowEncoder::RowEncoder;
+
+    bool begin() override
+    {
+        return m_writer.write(QByteArray("Date,Roll Number,Student Name,Grade,Section,Time In,Time Out,"
+                                         "Status,Method,Location,Marked By,Notes\r\n"));
+    }
+
+    bool writeRow(const QSqlQuery &query) override
+    {
+        m_line.resize(0);
+        for (int i = 0; i < kColumnCount; ++i) {
+            if (i > 0) m_line.append(',');
+            appendField(query.value(i).toString());
+        }
+        m_line.append("\r\n");
+        return m_writer.write(m_line);
+    }
+
+private:
+    void appendField(const QString &field)
+    {
+        if (field.contains(',') || field.contains('"') || field.contains('\n') || field.contains('\r')) {
+            QString escaped = field;
+            escaped.replace("\"", "\"\"");
+            m_line.append('"').append(escaped.toUtf8()).append('"');
+        } else {
+            m_line.append(field.toUtf8());
+        }
+    }
+
+    QByteArray m_line;
+};
+
+class JsonLinesEncoder : public RowEncoder
+{
+public:
+    using RowEncoder::RowEncoder;
+
+    bool begin() override { return true; }
+
+    bool writeRow(const QSqlQuery &query) override
+    {
+        QJsonObject row;
+        for (int i = 0; i < kColumnCount; ++i) {
+            row.insert(QLatin1String(kColumns[i]), query.value(i).toString());
+        }
+        return m_writer.write(QJsonDocument(row).toJson(QJsonDocument::Compact)) && m_writer.write('\n');
+    }
+};
+
+class ColumnarEncoder : public RowEncoder
+{
+public:
+    enum ColumnType : quint8 { DateColumn = 1, DictionaryColumn = 2 };
+
+    explicit ColumnarEncoder(BufferedWriter &writer)
+        : RowEncoder(writer)
+        , m_strings(kColumnCount - 1)
+    {
+        m_days.reserve(kRowGroupSize);
+    }
+
+    bool begin() override
+    {
+        QByteArray header("SMAC", 4);
+        appendVarint(header, 1); // Format version
+        appendVarint(header, kColumnCount);
+        for (int i = 0; i < kColumnCount; ++i) {
+            header.append(static_cast<char>(i == 0 ? DateColumn : DictionaryColumn));
+            appendString(header, QString::fromLatin1(kColumns[i]));
+        }
+        return m_writer.write(header);
+    }
+
+    bool writeRow(const QSqlQuery &query) override
+    {
+        QDate date = query.value(0).toDate();
+        m_days.append(date.isValid() ? date.toJulianDay() : 0);
+        for (int i = 1; i < kColumnCount; ++i) {
+            m_strings[i - 1].append(query.value(i).toString());
+        }
+
+        return m_days.size() < kRowGroupSize || flushGroup();
+    }
+
+    bool end() override
+    {
+        if (!flushGroup()) {
+            return false;
+        }
+        QByteArray terminator;
+        appendVarint(terminator, 0);
+        return m_writer.write(terminator);
+    }
+
+private:
+    static void appendVarint(QByteArray &out, quint64 value)
+    {
+        while (value >= 0x80) {
+            out.append(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.append(static_cast<char>(value));
+    }
+
+    static void appendString(QByteArray &out, const QString &text)
+    {
+        QByteArray utf8 = text.toUtf8();
+        appendVarint(out, utf8.size());
+        out.append(utf8);
+    }
+
+    static quint64 zigzag(qint64 value)
+    {
+        return (static_cast<quint64>(value) << 1) ^ static_cast<quint64>(value >> 63);
+    }
+
+    bool flushGroup()
+    {
+        if (m_days.isEmpty()) {
+            return true;
+        }
+
+        QByteArray group;
+        appendVarint(group, m_days.size());
+
+        qint64 previous = 0;
+        for (qint64 day : m_days) {
+            appendVarint(group, zigzag(day - previous));
+            previous = day;
+        }
+
+        for (QStringList &column : m_strings) {
+            QHash<QString, quint32> dictionary;
+            QStringList entries;
+            QVector<quint32> indices;
+            indices.reserve(column.size());
+
+            for (const QString &value : column) {
+                auto it = dictionary.constFind(value);
+                if (it == dictionary.constEnd()) {
+                    it = dictionary.insert(value, static_cast<quint32>(entries.size()));
+                    entries.append(value);
+                }
+                indices.append(it.value());
+            }
+
+            appendVarint(group, entries.size());
+            for (const QString &entry : entries) {
+                appendString(group, entry);
+            }
+            for (quint32 index : indices) {
+                appendVarint(group, index);
+            }
+
+            column.clear();
+        }
+
+        m_days.clear();
+        return m_writer.write(group);
+    }
+
+    QVector<qint64> m_days;
+    QVector<QStringList> m_strings;
+};
+
+} // namespace
+
+AttendanceExporter::AttendanceExporter(QObject *parent)
+    : QObject(parent)
+    , m_chunkDays(31)
+    , m_bufferSize(256 * 1024)
+    , m_rowsWritten(0)
+    , m_bytesWritten(0)
+    , m_cancelled(0)
+{
+}
+
+bool AttendanceExporter::formatFromString(const QString &name, Format *format)
+{
+    QString key = name.trimmed().toLower();
+
+    if (key.isEmpty() || key == "csv") {
+        *format = Csv;
+    } else if (key == "jsonl" || key == "json lines" || key == "ndjson" || key == "json") {
+        *format = JsonLines;
+    } else if (key == "columnar" || key == "binary" || key == "smac") {
+        *format = Columnar;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+void AttendanceExporter::cancel()
+{
+    m_cancelled.storeRelaxed(1);
+}
+
+bool AttendanceExporter::exportRange(const QString &filePath, Format format,
+                                     const QDate &fromDate, const QDate &toDate,
+                                     const QString &grade, const QString &section)
+{
+    m_rowsWritten = 0;
+    m_bytesWritten = 0;
+    m_cancelled.storeRelaxed(0);
+
+    if (!fromDate.isValid() || !toDate.isValid() || fromDate > toDate) {
+        qDebug() << "Invalid attendance export range:" << fromDate << toDate;
+        return false;
+    }
+
+    QString queryStr = "SELECT aa.date, aa.student_roll, es.name, es.grade, es.section, "
+                      "aa.time_in, aa.time_out, aa.status, aa.method, aa.location, "
+                      "aa.marked_by, aa.notes "
+                      "FROM advanced_attendance aa "
+                      "JOIN enhanced_students es ON aa.student_roll = es.roll_number "
+                      "WHERE aa.date BETWEEN ? AND ?";
+
+    if (!grade.isEmpty()) {
+        queryStr += " AND es.grade = ?";
+    }
+
+    if (!section.isEmpty()) {
+        queryStr += " AND es.section = ?";
+    }
+
+    queryStr += " ORDER BY aa.date, es.grade, es.section, es.name";
+
+    // Prepared once, re-bound for every date window
+    QSqlQuery query(Database::instance().database());
+    query.setForwardOnly(true);
+    if (!query.prepare(queryStr)) {
+        qDebug() << "Failed to prepare attendance export:" << query.lastError().text();
+        return false;
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "Failed to open export file:" << filePath << file.errorString();
+        return false;
+    }
+
+    bool ok = true;
+    {
+        BufferedWriter writer(&file, m_bufferSize);
+        std::unique_ptr<RowEncoder> encoder;
+        switch (format) {
+        case JsonLines: encoder.reset(new JsonLinesEncoder(writer)); break;
+        case Columnar: encoder.reset(new ColumnarEncoder(writer)); break;
+        default: encoder.reset(new CsvEncoder(writer)); break;
+        }
+
+        ok = encoder->begin();
+        const qint64 totalDays = fromDate.daysTo(toDate) + 1;
+
+        for (QDate chunkStart = fromDate; ok && chunkStart <= toDate; chunkStart = chunkStart.addDays(m_chunkDays)) {
+            if (m_cancelled.loadRelaxed()) {
+                qDebug() << "Attendance export cancelled after" << m_rowsWritten << "rows";
+                ok = false;
+                break;
+            }
+
+            QDate chunkEnd = qMin(chunkStart.addDays(m_chunkDays - 1), toDate);
+
+            int bindIndex = 0;
+            query.bindValue(bindIndex++, chunkStart.toString(Qt::ISODate));
+            query.bindValue(bindIndex++, chunkEnd.toString(Qt::ISODate));
+            if (!grade.isEmpty()) query.bindValue(bindIndex++, grade);
+            if (!section.isEmpty()) query.bindValue(bindIndex++, section);
+
+            if (!query.exec()) {
+                qDebug() << "Failed to export attendance data:" << query.lastError().text();
+                ok = false;
+                break;
+            }
+
+            while (query.next()) {
+                if (!encoder->writeRow(query)) {
+                    ok = false;
+                    break;
+                }
+                m_rowsWritten++;
+            }
+            query.finish();
+
+            int percent = static_cast<int>((fromDate.daysTo(chunkEnd) + 1) * 100 / totalDays);
+            emit progress(m_rowsWritten, percent);
+        }
+
+        ok = ok && encoder->end() && writer.flush();
+        m_bytesWritten = writer.bytesWritten();
+    }
+
+    file.close();
+
+    if (!ok) {
+        file.remove();
+    }
+
+    return ok;
+}
@@ -0,0 +1,251 @@
+#include "attendance/attendanceheatmap.h"
+#include "database/database.h"
+#include "models/nepalicalendar.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+enum DayCode : quint8 {
+    Unmarked = 0,
+    PresentCode,
+    LateCode,
+    AbsentCode,
+    ExcusedCode
+};
+
+} // namespace
+
+AttendanceHeatmap &AttendanceHeatmap::instance()
+{
+    static AttendanceHeatmap heatmap;
+    return heatmap;
+}
+
+AttendanceHeatmap::AttendanceHeatmap(QObject *parent)
+    : QObject(parent)
+    , m_maxCachedMonths(6)
+{
+}
+
+QString AttendanceHeatmap::classKey(const QString &grade, const QString &section)
+{
+    return grade + QLatin1Char('|') + section;
+}
+
+QString AttendanceHeatmap::className(const QString &classKey)
+{
+    QString grade = classKey.section(QLatin1Char('|'), 0, 0);
+    QString section = classKey.section(QLatin1Char('|'), 1);
+    return section.isEmpty() ? grade : grade + "-" + section;
+}
+
+quint8 AttendanceHeatmap::statusCode(const QString &status)
+{
+    if (status == "Present") return PresentCode;
+    if (status == "Late") return LateCode;
+    if (status == "Absent") return AbsentCode;
+    if (status == "Excused") return ExcusedCode;
+    return Unmarked;
+}
+
+void AttendanceHeatmap::sortClasses(QStringList &classes)
+{
+    // Numeric grade order (9 before 10), then section
+    std::sort(classes.begin(), classes.end(), [](const QString &a, const QString &b) {
+        QString gradeA = a.section(QLatin1Char('|'), 0, 0);
+        QString gradeB = b.section(QLatin1Char('|'), 0, 0);
+        bool okA = false, okB = false;
+        int numberA = gradeA.toInt(&okA);
+        int numberB = gradeB.toInt(&okB);
+        if (okA && okB && numberA != numberB) {
+            return numberA < numberB;
+        }
+        return a < b;
+    });
+}
+
+void AttendanceHeatmap::apply(AttendanceHeatmapMonth &grid, const QString &classKey, int day, quint8 code, int delta)
+{
+    auto it = grid.tiles.find(classKey);
+    if (it == grid.tiles.end()) {
+        it = grid.tiles.insert(classKey, QVector<AttendanceHeatmapTile>(grid.dayCount));
+        grid.classes.append(classKey);
+        sortClasses(grid.classes);
+    }
+    
+    AttendanceHeatmapTile &tile = (*it)[day];
+    switch (code) {
+    case PresentCode: tile.present += delta; break;
+    case LateCode: tile.late += delta; break;
+    case AbsentCode: tile.absent += delta; break;
+    case ExcusedCode: tile.excused += delta; break;
+    default: break;
+    }
+}
+
+AttendanceHeatmapMonth AttendanceHeatmap::month(int monthIndex)
+{
+    CachedMonth *cached = ensureMonth(monthIndex);
+    return cached ? cached->grid : AttendanceHeatmapMonth();
+}
+
+AttendanceHeatmapTile AttendanceHeatmap::tile(const QString &grade, const QString &section, const QDate &date)
+{
+    CachedMonth *cached = ensureMonth(NepaliCalendar::getNepaliMonthIndex(date));
+    if (!cached) {
+        return AttendanceHeatmapTile();
+    }
+    
+    int day = cached->grid.startDate.daysTo(date);
+    QVector<AttendanceHeatmapTile> tiles = cached->grid.tiles.value(classKey(grade, section));
+    return day >= 0 && day < tiles.size() ? tiles.at(day) : AttendanceHeatmapTile();
+}
+
+AttendanceHeatmap::CachedMonth *AttendanceHeatmap::ensureMonth(int monthIndex)
+{
+    if (monthIndex < 0) {
+        return nullptr;
+    }
+    
+    auto it = m_months.find(monthIndex);
+    if (it == m_months.end()) {
+        CachedMonth cached;
+        if (!loadMonth(monthIndex, cached)) {
+            return nullptr;
+        }
+        m_months.insert(monthIndex, cached);
+    }
+    
+    // Eviction may rehash, so look the month up again afterwards
+    touch(monthIndex);
+    return &m_months[monthIndex];
+}
+
+void AttendanceHeatmap::touch(int monthIndex)
+{
+    m_recentMonths.removeOne(monthIndex);
+    m_recentMonths.prepend(monthIndex);
+    
+    while (m_recentMonths.size() > m_maxCachedMonths) {
+        m_months.remove(m_recentMonths.takeLast());
+    }
+}
+
+bool AttendanceHeatmap::loadMonth(int monthIndex, CachedMonth &cached)
+{
+    QDate startDate = NepaliCalendar::getNepaliMonthStart(monthIndex);
+    QDate endDate = NepaliCalendar::getNepaliMonthEnd(monthIndex);
+    if (!startDate.isValid() || !endDate.isValid()) {
+        return false;
+    }
+    
+    AttendanceHeatmapMonth &grid = cached.grid;
+    grid.monthIndex = monthIndex;
+    grid.startDate = startDate;
+    grid.dayCount = startDate.daysTo(endDate) + 1;
+    
+    // The whole month for every class in one query
+    QSqlQuery query(Database::instance().database());
+    query.setForwardOnly(true);
+    query.prepare("SELECT aa.student_roll, aa.date, aa.status, es.grade, es.section "
+                 "FROM advanced_attendance aa "
+                 "JOIN enhanced_students es ON aa.student_roll = es.roll_number "
+                 "WHERE aa.date BETWEEN ? AND ?");
+    query.addBindValue(startDate);
+    query.addBindValue(endDate);
+    
+    if (!query.exec()) {
+        qDebug() << "Failed to load attendance heatmap:" << query.lastError().text();
+        return false;
+    }
+    
+    while (query.next()) {
+        int day = startDate.daysTo(query.value("date").toDate());
+        quint8 code = statusCode(query.value("status").toString());
+        if (day < 0 || day >= grid.dayCount || code == Unmarked) {
+            continue;
+        }
+        
+        QString roll = query.value("student_roll").toString();
+        QString key = classKey(query.value("grade").toString(), query.value("section").toString());
+        
+        QByteArray &days = cached.studentDays[roll];
+        if (days.isEmpty()) {
+            days = QByteArray(grid.dayCount, char(Unmarked));
+        }
+        days[day] = char(code);
+        cached.studentClass.insert(roll, key);
+        
+        apply(grid, key, day, code, 1);
+    }
+    
+    return true;
+}
+
+void AttendanceHeatmap::recordMark(const QString &studentRoll, const QString &grade, const QString &section,
+                                   const QDate &date, const QString &status)
+{
+    int monthIndex = NepaliCalendar::getNepaliMonthIndex(date);
+    auto it = m_months.find(monthIndex);
+    if (it == m_months.end() || grade.isEmpty()) {
+        return;
+    }
+    
+    CachedMonth &cached = it.value();
+    int day = cached.grid.startDate.daysTo(date);
+    if (day < 0 || day >= cached.grid.dayCount) {
+        return;
+    }
+    
+    QString key = classKey(grade, section);
+    QByteArray &days = cached.studentDays[studentRoll];
+    if (days.isEmpty()) {
+        days = QByteArray(cached.grid.dayCount, char(Unmarked));
+    }
+    
+    // Move the student from their previous count for the day, if any
+    quint8 previous = quint8(days.at(day));
+    if (previous != Unmarked) {
+        apply(cached.grid, cached.studentClass.value(studentRoll, key), day, previous, -1);
+    }
+    
+    quint8 code = statusCode(status);
+    days[day] = char(code);
+    cached.studentClass.insert(studentRoll, key);
+    if (code != Unmarked) {
+        apply(cached.grid, key, day, code, 1);
+    }
+    
+    emit tilesChanged(monthIndex);
+}
+
+void AttendanceHeatmap::invalidate(const QDate &fromDate, const QDate &toDate)
+{
+    int first = NepaliCalendar::getNepaliMonthIndex(fromDate);
+    int last = NepaliCalendar::getNepaliMonthIndex(toDate);
+    if (first < 0 || last < 0) {
+        clear();
+        return;
+    }
+    
+    for (int monthIndex = first; monthIndex <= last; ++monthIndex) {
+        if (m_months.remove(monthIndex)) {
+            m_recentMonths.removeOne(monthIndex);
+            emit tilesChanged(monthIndex);
+        }
+    }
+}
+
+void AttendanceHeatmap::clear()
+{
+    QList<int> cachedMonths = m_months.keys();
+    m_months.clear();
+    m_recentMonths.clear();
+    
+    for (int monthIndex : cachedMonths) {
+        emit tilesChanged(monthIndex);
+    }
+}
@@ -0,0 +1,830 @@
+#include "attendance/attendancejournal.h"
+#include "database/database.h"
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QDir>
+#include <QDebug>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char kMagic[] = "SMAJ";
+const int kFrameHeaderSize = 6;                       // quint32 size + quint16 checksum
+// Bounds a batch of marks too; must stay below kMaxReadBytes so the applier can read any record whole
+const quint32 kMaxPayloadSize = 1024 * 1024;
+const qint64 kCompactBytes = 1024 * 1024;             // Rewrite the file once fully applied past this
+const qint64 kMaxReadBytes = 4 * 1024 * 1024;
+const int kBatchSize = 500;
+const int kCoalesceMsecs = 20;
+const int kInitialRetryMsecs = 250;
+const int kMaxRetryMsecs = 8000;
+// Failed attempts at one batch before its records are applied one by one and failures dead-lettered
+const int kMaxApplyAttempts = 5;
+
+QByteArray fileHeader(quint32 generation)
+{
+    QByteArray header(kMagic, 4);
+    QDataStream out(&header, QIODevice::WriteOnly | QIODevice::Append);
+    out << generation;
+    return header;
+}
+
+// flush() only reaches the OS cache; a mark is durable once this returns true
+bool syncToDisk(QFileDevice &file)
+{
+    if (!file.flush()) {
+        return false;
+    }
+#ifdef Q_OS_WIN
+    return FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(file.handle()))) != 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+// Makes a rename inside the directory durable; Windows has no equivalent and needs none
+void syncDirectory(const QString &directoryPath)
+{
+#ifndef Q_OS_WIN
+    int fd = ::open(QFile::encodeName(directoryPath).constData(), O_RDONLY);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+#else
+    Q_UNUSED(directoryPath);
+#endif
+}
+
+void writeEntry(QDataStream &out, const AttendanceEntry &entry)
+{
+    out << entry.studentRoll << entry.date << entry.timeIn << entry.timeOut
+        << entry.status << entry.method << entry.location << entry.notes << entry.markedBy;
+}
+
+void readEntry(QDataStream &in, AttendanceEntry *entry)
+{
+    in >> entry->studentRoll >> entry->date >> entry->timeIn >> entry->timeOut
+       >> entry->status >> entry->method >> entry->location >> entry->notes >> entry->markedBy;
+}
+
+// Busy, locked, I/O, full and unopenable databases fail every record alike; retrying is the only answer
+bool isTransient(const QSqlError &error)
+{
+    static const QStringList codes = { "5", "6", "10", "13", "14" };
+    return error.type() == QSqlError::ConnectionError || codes.contains(error.nativeErrorCode());
+}
+
+// Length of the frame at offset by its size prefix alone, or 0 when the prefix
+// itself is unusable; lets a reader step over a frame whose payload is damaged
+int framedSize(const QByteArray &data, int offset)
+{
+    if (data.size() - offset < kFrameHeaderSize) {
+        return 0;
+    }
+    
+    quint32 size = 0;
+    QDataStream in(data.mid(offset, 4));
+    in >> size;
+    
+    if (size == 0 || size > kMaxPayloadSize || data.size() - offset - kFrameHeaderSize < static_cast<qint64>(size)) {
+        return 0;
+    }
+    return kFrameHeaderSize + static_cast<int>(size);
+}
+
+// Some filesystems extend the file with zeros for a write that never landed
+bool isZeroFilled(const QByteArray &data, int offset)
+{
+    for (int i = offset; i < data.size(); ++i) {
+        if (data.at(i) != '\0') {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool readHeader(const QByteArray &header, quint32 *generation)
+{
+    if (header.size() < AttendanceJournal::HeaderSize || !header.startsWith(kMagic)) {
+        return false;
+    }
+    QDataStream in(header.mid(4, 4));
+    in >> *generation;
+    return true;
+}
+
+} // namespace
+
+AttendanceJournal::AttendanceJournal(QObject *parent)
+    : QObject(parent)
+    , m_generation(1)
+    , m_nextSequence(1)
+    , m_applier(nullptr)
+{
+}
+
+AttendanceJournal::~AttendanceJournal()
+{
+    close();
+}
+
+bool AttendanceJournal::open(const QString &journalPath)
+{
+    if (m_file.isOpen()) {
+        return true;
+    }
+    
+    QString path = journalPath;
+    if (path.isEmpty()) {
+        QString dataPath = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+        QDir().mkpath(dataPath);
+        path = dataPath + "/attendance.journal";
+    }
+    
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        qDebug() << "Failed to open attendance journal:" << path << m_file.errorString();
+        return false;
+    }
+    
+    if (!recover()) {
+        m_file.close();
+        return false;
+    }
+    
+    m_applier = new JournalApplier(path, Database::instance().database().databaseName());
+    m_applier->moveToThread(&m_applierThread);
+    connect(&m_applierThread, &QThread::finished, m_applier, &QObject::deleteLater);
+    connect(m_applier, &JournalApplier::recordsApplied, this, &AttendanceJournal::onRecordsApplied);
+    connect(m_applier, &JournalApplier::applyFailed, this, &AttendanceJournal::applyFailed);
+    m_applierThread.start(QThread::LowPriority);
+    
+    // Replays whatever a previous run left unapplied
+    QMetaObject::invokeMethod(m_applier, "scheduleDrain", Qt::QueuedConnection);
+    return true;
+}
+
+void AttendanceJournal::close()
+{
+    if (m_applierThread.isRunning()) {
+        m_applierThread.quit();
+        m_applierThread.wait();
+    }
+    m_applier = nullptr;
+    
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+}
+
+bool AttendanceJournal::recover()
+{
+    m_file.seek(0);
+    QByteArray data = m_file.readAll();
+    
+    // Sequences continue past whatever the database already applied, so a
+    // lost or replaced journal file can never reuse an applied number
+    quint64 appliedSequence = 0;
+    QSqlQuery query(Database::instance().database());
+    if (query.exec("SELECT applied_sequence FROM attendance_journal_state WHERE id = 1") && query.next()) {
+        appliedSequence = query.value(0).toULongLong();
+    }
+    
+    quint32 generation = 0;
+    if (!readHeader(data, &generation)) {
+        if (!data.isEmpty()) {
+            QString aside = m_file.fileName() + ".corrupt-" + QDateTime::currentDateTime().toString("yyyyMMddHHmmss");
+            QFile::copy(m_file.fileName(), aside);
+            qDebug() << "Unreadable attendance journal moved aside to" << aside;
+        }
+        m_nextSequence = appliedSequence + 1;
+        return writeFreshFile(1, appliedSequence);
+    }
+    
+    m_generation = generation;
+    m_pending.clear();
+    
+    quint64 lastSequence = 0;
+    int offset = HeaderSize;
+    QList<int> skipped;
+    while (offset < data.size()) {
+        Record record;
+        int used = decodeRecord(data, offset, &record);
+        if (used <= 0) {
+            // A crash mid-append leaves a short final record, or a damaged one that ends the file
+            int frame = used < 0 ? framedSize(data, offset) : 0;
+            if (used == 0 || isZeroFilled(data, offset) || offset + frame == data.size()) {
+                break;
+            }
+            
+            // Synced records follow: drop only this one, or keep the file untouched if it cannot be stepped over
+            if (frame == 0) {
+                qDebug() << "Attendance journal" << m_file.fileName() << "is damaged at offset" << offset
+                         << "with" << data.size() - offset << "bytes after it; not opening it";
+                return false;
+            }
+            skipped.append(offset);
+            offset += frame;
+            continue;
+        }
+        
+        lastSequence = record.sequence;
+        if (record.sequence > appliedSequence) {
+            if (record.type == MarkRecord) {
+                m_pending.insert(pendingKey(record.entry.studentRoll, record.entry.date), record.sequence);
+            }
+            for (const AttendanceEntry &entry : record.entries) {
+                m_pending.insert(pendingKey(entry.studentRoll, entry.date), record.sequence);
+            }
+        }
+        offset += used;
+    }
+    
+    if (!skipped.isEmpty()) {
+        QString aside = m_file.fileName() + ".corrupt-" + QDateTime::currentDateTime().toString("yyyyMMddHHmmss");
+        QFile::copy(m_file.fileName(), aside);
+        qDebug() << "Skipped" << skipped.size() << "damaged attendance journal records at offsets" << skipped
+                 << "; the journal was copied to" << aside;
+    }
+    
+    if (offset < data.size()) {
+        qDebug() << "Truncating torn attendance journal tail of" << data.size() - offset << "bytes";
+        if (!m_file.resize(offset)) {
+            qDebug() << "Failed to truncate attendance journal:" << m_file.errorString();
+            return false;
+        }
+    }
+    
+    m_nextSequence = qMax(lastSequence, appliedSequence) + 1;
+    return m_file.seek(m_file.size());
+}
+
+bool AttendanceJournal::writeFreshFile(quint32 generation, quint64 baseSequence)
+{
+    Record base;
+    base.type = BaseRecord;
+    base.sequence = baseSequence;
+    
+    QByteArray data = fileHeader(generation);
+    data.append(encodeRecord(base));
+    
+    // Written and synced beside the journal, then renamed over it, so a crash
+    // leaves either the old generation or the new one
+    QString path = m_file.fileName();
+    QSaveFile fresh(path);
+    if (!fresh.open(QIODevice::WriteOnly) || fresh.write(data) != data.size() || !syncToDisk(fresh)) {
+        qDebug() << "Failed to rewrite attendance journal:" << fresh.errorString();
+        fresh.cancelWriting();
+        return false;
+    }
+    
+    // Windows cannot rename over a file that is still open
+    m_file.close();
+    bool committed = fresh.commit();
+    if (!committed) {
+        qDebug() << "Failed to replace attendance journal:" << fresh.errorString();
+    }
+    if (!m_file.open(QIODevice::ReadWrite) || !m_file.seek(m_file.size())) {
+        qDebug() << "Failed to reopen attendance journal:" << m_file.errorString();
+        return false;
+    }
+    if (!committed) {
+        return false;
+    }
+    syncDirectory(QFileInfo(path).absolutePath());
+    
+    m_generation = generation;
+    return true;
+}
+
+QString AttendanceJournal::markStatement()
+{
+    return R"(
+        INSERT INTO advanced_attendance
+            (student_roll, date, time_in, time_out, status, method, location, notes, marked_by)
+        VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)
+        ON CONFLICT(student_roll, date) DO UPDATE SET
+            time_in = excluded.time_in, time_out = excluded.time_out, status = excluded.status,
+            method = excluded.method, location = excluded.location, notes = excluded.notes,
+            marked_by = excluded.marked_by
+        WHERE NOT (excluded.status = 'Absent' AND advanced_attendance.status = 'Excused'
+                   AND advanced_attendance.method = 'Leave Request')
+    )";
+}
+
+bool AttendanceJournal::appendMark(const AttendanceEntry &entry)
+{
+    Record record;
+    record.type = MarkRecord;
+    record.entry = entry;
+    return append(record);
+}
+
+bool AttendanceJournal::appendMarks(const QList<AttendanceEntry> &entries)
+{
+    if (entries.size() == 1) {
+        return appendMark(entries.first());
+    }
+    if (entries.isEmpty()) {
+        return true;
+    }
+    
+    Record record;
+    record.type = BatchRecord;
+    record.entries = entries;
+    return append(record);
+}
+
+bool AttendanceJournal::appendTimeOut(const QString &studentRoll, const QDate &date, const QTime &timeOut)
+{
+    Record record;
+    record.type = TimeOutRecord;
+    record.entry.studentRoll = studentRoll;
+    record.entry.date = date;
+    record.entry.timeOut = timeOut;
+    return append(record);
+}
+
+bool AttendanceJournal::append(Record &record)
+{
+    if (!m_file.isOpen()) {
+        return false;
+    }
+    
+    record.sequence = m_nextSequence;
+    QByteArray frame = encodeRecord(record);
+    if (frame.size() - kFrameHeaderSize > static_cast<int>(kMaxPayloadSize)) {
+        qDebug() << "Attendance journal record too large:" << frame.size() << "bytes";
+        return false;
+    }
+    qint64 sizeBefore = m_file.size();
+    
+    if (m_file.write(frame) != frame.size() || !syncToDisk(m_file)) {
+        qDebug() << "Failed to append to attendance journal:" << m_file.errorString();
+        // Never leave a partial frame in front of later records
+        m_file.resize(sizeBefore);
+        m_file.seek(sizeBefore);
+        return false;
+    }
+    
+    m_nextSequence++;
+    if (record.type == MarkRecord) {
+        m_pending.insert(pendingKey(record.entry.studentRoll, record.entry.date), record.sequence);
+    }
+    for (const AttendanceEntry &entry : record.entries) {
+        m_pending.insert(pendingKey(entry.studentRoll, entry.date), record.sequence);
+    }
+    
+    QMetaObject::invokeMethod(m_applier, "scheduleDrain", Qt::QueuedConnection);
+    return true;
+}
+
+bool AttendanceJournal::hasPending(const QString &studentRoll, const QDate &date) const
+{
+    return m_pending.contains(pendingKey(studentRoll, date));
+}
+
+void AttendanceJournal::onRecordsApplied(quint64 appliedSequence)
+{
+    for (auto it = m_pending.begin(); it != m_pending.end();) {
+        if (it.value() <= appliedSequence) {
+            it = m_pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    
+    emit recordsApplied(appliedSequence);
+    
+    // Everything is in SQLite: start a new generation so the file stays small
+    if (appliedSequence >= lastSequence() && m_file.size() > kCompactBytes) {
+        writeFreshFile(m_generation + 1, appliedSequence);
+    }
+}
+
+QString AttendanceJournal::pendingKey(const QString &studentRoll, const QDate &date)
+{
+    return studentRoll + QLatin1Char('|') + date.toString(Qt::ISODate);
+}
+
+QByteArray AttendanceJournal::encodeRecord(const Record &record)
+{
+    QByteArray payload;
+    {
+        QDataStream out(&payload, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_6_0);
+        out << static_cast<quint8>(record.type) << record.sequence;
+        
+        if (record.type == BatchRecord) {
+            out << static_cast<quint32>(record.entries.size());
+            for (const AttendanceEntry &entry : record.entries) {
+                writeEntry(out, entry);
+            }
+        } else if (record.type != BaseRecord) {
+            writeEntry(out, record.entry);
+        }
+    }
+    
+    QByteArray frame;
+    {
+        QDataStream out(&frame, QIODevice::WriteOnly);
+        out << static_cast<quint32>(payload.size()) << qChecksum(payload);
+    }
+    frame.append(payload);
+    return frame;
+}
+
+int AttendanceJournal::decodeRecord(const QByteArray &data, int offset, Record *record)
+{
+    if (data.size() - offset < kFrameHeaderSize) {
+        return 0;
+    }
+    
+    quint32 size = 0;
+    quint16 checksum = 0;
+    {
+        QDataStream in(data.mid(offset, kFrameHeaderSize));
+        in >> size >> checksum;
+    }
+    
+    if (size == 0 || size > kMaxPayloadSize) {
+        return -1;
+    }
+    
+    if (data.size() - offset - kFrameHeaderSize < static_cast<qint64>(size)) {
+        return 0;
+    }
+    
+    QByteArray payload = data.mid(offset + kFrameHeaderSize, size);
+    if (qChecksum(payload) != checksum) {
+        return -1;
+    }
+    
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_6_0);
+    
+    quint8 type = 0;
+    in >> type >> record->sequence;
+    record->type = static_cast<RecordType>(type);
+    
+    record->entries.clear();
+    if (record->type == BatchRecord) {
+        quint32 count = 0;
+        in >> count;
+        for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+            AttendanceEntry entry;
+            readEntry(in, &entry);
+            record->entries.append(entry);
+        }
+    } else if (record->type != BaseRecord) {
+        readEntry(in, &record->entry);
+    }
+    
+    if (in.status() != QDataStream::Ok || type > BatchRecord) {
+        return -1;
+    }
+    
+    return kFrameHeaderSize + static_cast<int>(size);
+}
+
+JournalApplier::JournalApplier(const QString &journalPath, const QString &databasePath)
+    : QObject(nullptr)
+    , m_journalPath(journalPath)
+    , m_databasePath(databasePath)
+    , m_connectionName(QString("attendance_journal_%1").arg(reinterpret_cast<quintptr>(this)))
+    , m_drainTimer(new QTimer(this))
+    , m_generation(0)
+    , m_readOffset(AttendanceJournal::HeaderSize)
+    , m_retryDelay(kInitialRetryMsecs)
+    , m_failedAttempts(0)
+{
+    m_drainTimer->setSingleShot(true);
+    connect(m_drainTimer, &QTimer::timeout, this, &JournalApplier::drain);
+}
+
+JournalApplier::~JournalApplier()
+{
+    closeConnection();
+}
+
+void JournalApplier::scheduleDrain()
+{
+    // Coalesces bursts of marks into one batch; a pending retry keeps its backoff
+    if (!m_drainTimer->isActive()) {
+        m_drainTimer->start(kCoalesceMsecs);
+    }
+}
+
+void JournalApplier::drain()
+{
+    QFile file(m_journalPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    
+    QByteArray header = file.read(AttendanceJournal::HeaderSize);
+    quint32 generation = 0;
+    if (!readHeader(header, &generation)) {
+        return; // Being rewritten; the next append reschedules
+    }
+    
+    if (generation != m_generation || file.size() < m_readOffset) {
+        m_generation = generation;
+        m_readOffset = AttendanceJournal::HeaderSize;
+    }
+    
+    file.seek(m_readOffset);
+    QByteArray data = file.read(kMaxReadBytes);
+    
+    // The file may have been compacted between the two reads
+    file.seek(0);
+    if (file.read(AttendanceJournal::HeaderSize) != header) {
+        scheduleDrain();
+        return;
+    }
+    file.close();
+    
+    QList<AttendanceJournal::Record> batch;
+    quint64 lastSequence = 0;
+    int offset = 0;
+    bool corrupt = false;
+    
+    while (offset < data.size() && batch.size() < kBatchSize) {
+        AttendanceJournal::Record record;
+        int used = AttendanceJournal::decodeRecord(data, offset, &record);
+        if (used < 0 && framedSize(data, offset) > 0) {
+            qDebug() << "Skipping damaged attendance journal record at offset" << m_readOffset + offset;
+            offset += framedSize(data, offset);
+            continue;
+        }
+        if (used <= 0) {
+            corrupt = used < 0;
+            break;
+        }
+        
+        if (record.type != AttendanceJournal::BaseRecord) {
+            batch.append(record);
+        }
+        lastSequence = record.sequence;
+        offset += used;
+    }
+    
+    if (corrupt && offset == 0) {
+        qDebug() << "Attendance journal has an unreadable record at offset" << m_readOffset;
+    }
+    
+    if (offset == 0) {
+        return;
+    }
+    
+    if (!openConnection()) {
+        return;
+    }
+    
+    quint64 appliedSequence = 0;
+    {
+        QSqlQuery query(QSqlDatabase::database(m_connectionName));
+        if (query.exec("SELECT applied_sequence FROM attendance_journal_state WHERE id = 1") && query.next()) {
+            appliedSequence = query.value(0).toULongLong();
+        }
+    }
+    
+    // Records committed before a crash are replayed only up to the checkpoint
+    QList<AttendanceJournal::Record> unapplied;
+    for (const AttendanceJournal::Record &record : batch) {
+        if (record.sequence > appliedSequence) {
+            unapplied.append(record);
+        }
+    }
+    
+    QSqlError error;
+    bool applied = applyBatch(unapplied, qMax(lastSequence, appliedSequence), &error);
+    if (!applied && !isTransient(error) && ++m_failedAttempts >= kMaxApplyAttempts) {
+        applied = applyEach(unapplied, qMax(lastSequence, appliedSequence), &error);
+    }
+    closeConnection();
+    
+    if (!applied) {
+        retryLater(error.text());
+        return;
+    }
+    
+    m_readOffset += offset;
+    m_retryDelay = kInitialRetryMsecs;
+    m_failedAttempts = 0;
+    emit recordsApplied(qMax(lastSequence, appliedSequence));
+    
+    if (batch.size() >= kBatchSize || data.size() >= kMaxReadBytes) {
+        m_drainTimer->start(0);
+    }
+}
+
+bool JournalApplier::openConnection()
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    db.setDatabaseName(m_databasePath);
+    db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=1000");
+    
+    if (!db.open()) {
+        QString error = db.lastError().text();
+        db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(m_connectionName);
+        
+        qDebug() << "Attendance journal applier cannot open database:" << error;
+        retryLater(error);
+        return false;
+    }
+    
+    QSqlQuery query(db);
+    query.exec(R"(
+        CREATE TABLE IF NOT EXISTS attendance_journal_state (
+            id INTEGER PRIMARY KEY CHECK (id = 1),
+            applied_sequence INTEGER NOT NULL DEFAULT 0,
+            applied_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
+        )
+    )");
+    query.exec(R"(
+        CREATE TABLE IF NOT EXISTS attendance_journal_dead_letters (
+            sequence INTEGER PRIMARY KEY,
+            record BLOB NOT NULL,
+            error TEXT,
+            failed_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
+        )
+    )");
+    
+    return true;
+}
+
+void JournalApplier::retryLater(const QString &error)
+{
+    emit applyFailed(error);
+    m_drainTimer->start(m_retryDelay);
+    m_retryDelay = qMin(m_retryDelay * 2, kMaxRetryMsecs);
+}
+
+void JournalApplier::closeConnection()
+{
+    if (!QSqlDatabase::contains(m_connectionName)) {
+        return;
+    }
+    
+    {
+        QSqlDatabase db = QSqlDatabase::database(m_connectionName, false);
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(m_connectionName);
+}
+
+bool JournalApplier::applyBatch(const QList<AttendanceJournal::Record> &batch, quint64 lastSequence,
+                                QSqlError *error)
+{
+    QSqlDatabase db = QSqlDatabase::database(m_connectionName);
+    *error = QSqlError();
+    
+    if (db.transaction()) {
+        QSqlQuery mark(db);
+        mark.prepare(AttendanceJournal::markStatement());
+        
+        QSqlQuery timeOut(db);
+        timeOut.prepare("UPDATE advanced_attendance SET time_out = ? "
+                       "WHERE student_roll = ? AND date = ? AND time_out IS NULL");
+        
+        auto applyMark = [&mark, &error](const AttendanceEntry &entry) {
+            mark.addBindValue(entry.studentRoll);
+            mark.addBindValue(entry.date);
+            mark.addBindValue(entry.timeIn);
+            mark.addBindValue(entry.timeOut);
+            mark.addBindValue(entry.status);
+            mark.addBindValue(entry.method);
+            mark.addBindValue(entry.location);
+            mark.addBindValue(entry.notes);
+            mark.addBindValue(entry.markedBy);
+            if (!mark.exec()) {
+                *error = mark.lastError();
+                return false;
+            }
+            return true;
+        };
+        
+        bool ok = true;
+        for (const AttendanceJournal::Record &record : batch) {
+            const AttendanceEntry &entry = record.entry;
+            
+            if (record.type == AttendanceJournal::TimeOutRecord) {
+                timeOut.addBindValue(entry.timeOut);
+                timeOut.addBindValue(entry.studentRoll);
+                timeOut.addBindValue(entry.date);
+                ok = timeOut.exec();
+                if (!ok) *error = timeOut.lastError();
+            } else if (record.type == AttendanceJournal::BatchRecord) {
+                for (const AttendanceEntry &batchEntry : record.entries) {
+                    ok = applyMark(batchEntry);
+                    if (!ok) {
+                        break;
+                    }
+                }
+            } else {
+                ok = applyMark(entry);
+            }
+            
+            if (!ok) {
+                break;
+            }
+        }
+        
+        if (ok) {
+            // Checkpoint commits atomically with the batch it covers
+            QSqlQuery state(db);
+            state.prepare("INSERT OR REPLACE INTO attendance_journal_state (id, applied_sequence, applied_at) "
+                         "VALUES (1, ?, CURRENT_TIMESTAMP)");
+            state.addBindValue(lastSequence);
+            ok = state.exec();
+            if (!ok) *error = state.lastError();
+        }
+        
+        if (ok && db.commit()) {
+            return true;
+        }
+        
+        if (!error->isValid()) {
+            *error = db.lastError();
+        }
+        db.rollback();
+    } else {
+        *error = db.lastError();
+    }
+    
+    qDebug() << "Failed to apply attendance journal batch:" << error->text();
+    return false;
+}
+
+bool JournalApplier::applyEach(const QList<AttendanceJournal::Record> &batch, quint64 lastSequence,
+                               QSqlError *error)
+{
+    // Each record commits with its own checkpoint, so the ones before a poison record are kept
+    *error = QSqlError();
+    for (const AttendanceJournal::Record &record : batch) {
+        QSqlError failure;
+        if (applyBatch({ record }, record.sequence, &failure)) {
+            continue;
+        }
+        if (isTransient(failure) || !deadLetter(record, failure, error)) {
+            if (!error->isValid()) {
+                *error = failure;
+            }
+            return false;
+        }
+    }
+    
+    // Base records past the last mark still move the checkpoint
+    return applyBatch({}, lastSequence, error);
+}
+
+bool JournalApplier::deadLetter(const AttendanceJournal::Record &record, const QSqlError &failure, QSqlError *error)
+{
+    QSqlDatabase db = QSqlDatabase::database(m_connectionName);
+    if (!db.transaction()) {
+        *error = db.lastError();
+        return false;
+    }
+    
+    // Kept whole, so it can be decoded and replayed by hand once the cause is fixed
+    QSqlQuery query(db);
+    query.prepare("INSERT OR REPLACE INTO attendance_journal_dead_letters (sequence, record, error) VALUES (?, ?, ?)");
+    query.addBindValue(record.sequence);
+    query.addBindValue(AttendanceJournal::encodeRecord(record));
+    query.addBindValue(failure.text());
+    bool ok = query.exec();
+    
+    if (ok) {
+        query.prepare("INSERT OR REPLACE INTO attendance_journal_state (id, applied_sequence, applied_at) "
+                     "VALUES (1, ?, CURRENT_TIMESTAMP)");
+        query.addBindValue(record.sequence);
+        ok = query.exec();
+    }
+    
+    if (ok && db.commit()) {
+        qDebug() << "Moved attendance journal record" << record.sequence
+                 << "to attendance_journal_dead_letters after" << kMaxApplyAttempts << "attempts:" << failure.text();
+        emit applyFailed(QString("Attendance record %1 could not be saved and was set aside: %2")
+                         .arg(record.sequence).arg(failure.text()));
+        return true;
+    }
+    
+    *error = query.lastError().isValid() ? query.lastError() : db.lastError();
+    db.rollback();
+    return false;
+}
@@ -0,0 +1,451 @@
+#include "attendance/attendancerollups.h"
+#include "models/nepalicalendar.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariantList>
+#include <QSet>
+#include <QDebug>
+
+namespace {
+
+// Counts per class over a date range; the caller appends filters and binds from/to first
+const char *const kTotalsColumns =
+    "COALESCE(es.grade, '') as grade, COALESCE(es.section, '') as section, "
+    "COUNT(CASE WHEN aa.status = 'Present' THEN 1 END) as present_count, "
+    "COUNT(CASE WHEN aa.status = 'Late' THEN 1 END) as late_count, "
+    "COUNT(CASE WHEN aa.status = 'Absent' THEN 1 END) as absent_count, "
+    "COUNT(CASE WHEN aa.status = 'Excused' THEN 1 END) as excused_count, "
+    "COUNT(*) as total_count ";
+const char *const kTotalsFrom =
+    "FROM advanced_attendance aa "
+    "LEFT JOIN enhanced_students es ON es.roll_number = aa.student_roll "
+    "WHERE aa.date BETWEEN ? AND ? ";
+const char *const kTotalsGroup = "GROUP BY COALESCE(es.grade, ''), COALESCE(es.section, '')";
+
+QDate monthStart(const QDate &date)
+{
+    return QDate(date.year(), date.month(), 1);
+}
+
+QString classFilter(const QString &grade, const QString &section, const QString &prefix)
+{
+    QString filter;
+    if (!grade.isEmpty()) {
+        filter += " AND " + prefix + "grade = ?";
+    }
+    if (!section.isEmpty()) {
+        filter += " AND " + prefix + "section = ?";
+    }
+    return filter;
+}
+
+void bindClass(QSqlQuery &query, const QString &grade, const QString &section)
+{
+    if (!grade.isEmpty()) query.addBindValue(grade);
+    if (!section.isEmpty()) query.addBindValue(section);
+}
+
+AttendanceRollupRow readCounts(const QSqlQuery &query)
+{
+    AttendanceRollupRow row;
+    row.grade = query.value("grade").toString();
+    row.section = query.value("section").toString();
+    row.present = query.value("present_count").toInt();
+    row.late = query.value("late_count").toInt();
+    row.absent = query.value("absent_count").toInt();
+    row.excused = query.value("excused_count").toInt();
+    row.total = query.value("total_count").toInt();
+    return row;
+}
+
+bool setWatermark(QSqlDatabase db, const QString &kind, const QVariant &value)
+{
+    QSqlQuery query(db);
+    query.prepare("INSERT OR REPLACE INTO attendance_rollup_state (kind, closed_through) VALUES (?, ?)");
+    query.addBindValue(kind);
+    query.addBindValue(value.toString());
+    if (!query.exec()) {
+        qDebug() << "Failed to advance attendance rollup:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool AttendanceRollups::createTables(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+
+    const QStringList statements = {
+        R"(
+        CREATE TABLE IF NOT EXISTS attendance_monthly_rollup (
+            grade TEXT NOT NULL,
+            section TEXT NOT NULL,
+            month DATE NOT NULL,
+            present_count INTEGER NOT NULL DEFAULT 0,
+            late_count INTEGER NOT NULL DEFAULT 0,
+            absent_count INTEGER NOT NULL DEFAULT 0,
+            excused_count INTEGER NOT NULL DEFAULT 0,
+            total_count INTEGER NOT NULL DEFAULT 0,
+            PRIMARY KEY (grade, section, month)
+        ) WITHOUT ROWID
+        )",
+        R"(
+        CREATE TABLE IF NOT EXISTS attendance_bs_monthly_rollup (
+            grade TEXT NOT NULL,
+            section TEXT NOT NULL,
+            bs_month_index INTEGER NOT NULL,
+            present_count INTEGER NOT NULL DEFAULT 0,
+            late_count INTEGER NOT NULL DEFAULT 0,
+            absent_count INTEGER NOT NULL DEFAULT 0,
+            excused_count INTEGER NOT NULL DEFAULT 0,
+            total_count INTEGER NOT NULL DEFAULT 0,
+            PRIMARY KEY (grade, section, bs_month_index)
+        ) WITHOUT ROWID
+        )",
+        R"(
+        CREATE TABLE IF NOT EXISTS attendance_rollup_state (
+            kind TEXT PRIMARY KEY,
+            closed_through TEXT NOT NULL
+        )
+        )",
+        // Dates written since the last refresh
+        R"(
+        CREATE TABLE IF NOT EXISTS attendance_rollup_dirty (
+            date DATE PRIMARY KEY
+        ) WITHOUT ROWID
+        )",
+        "CREATE INDEX IF NOT EXISTS idx_attendance_rollup_month ON attendance_monthly_rollup (month)",
+        "CREATE INDEX IF NOT EXISTS idx_attendance_rollup_bs_month ON attendance_bs_monthly_rollup (bs_month_index)",
+        // Month rollups and the live open month read raw rows by date range
+        "CREATE INDEX IF NOT EXISTS idx_advanced_attendance_date ON advanced_attendance (date)",
+        R"(
+        CREATE TRIGGER IF NOT EXISTS trg_attendance_rollup_insert
+        AFTER INSERT ON advanced_attendance
+        BEGIN
+            INSERT OR IGNORE INTO attendance_rollup_dirty (date) VALUES (NEW.date);
+        END
+        )",
+        R"(
+        CREATE TRIGGER IF NOT EXISTS trg_attendance_rollup_update
+        AFTER UPDATE OF student_roll, date, status ON advanced_attendance
+        BEGIN
+            INSERT OR IGNORE INTO attendance_rollup_dirty (date) VALUES (OLD.date);
+            INSERT OR IGNORE INTO attendance_rollup_dirty (date) VALUES (NEW.date);
+        END
+        )",
+        R"(
+        CREATE TRIGGER IF NOT EXISTS trg_attendance_rollup_delete
+        AFTER DELETE ON advanced_attendance
+        BEGIN
+            INSERT OR IGNORE INTO attendance_rollup_dirty (date) VALUES (OLD.date);
+        END
+        )"
+    };
+
+    for (const QString &statement : statements) {
+        if (!query.exec(statement)) {
+            qDebug() << "Failed to create attendance rollups:" << query.lastError().text();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool AttendanceRollups::watermarks(QSqlDatabase db, QDate *monthThrough, int *bsMonthThrough)
+{
+    *monthThrough = QDate();
+    *bsMonthThrough = -1;
+
+    QSqlQuery query(db);
+    if (!query.exec("SELECT kind, closed_through FROM attendance_rollup_state")) {
+        qDebug() << "Failed to read attendance rollup state:" << query.lastError().text();
+        return false;
+    }
+
+    while (query.next()) {
+        QString kind = query.value(0).toString();
+        if (kind == "month") {
+            *monthThrough = QDate::fromString(query.value(1).toString(), Qt::ISODate);
+        } else if (kind == "bs_month") {
+            *bsMonthThrough = query.value(1).toInt();
+        }
+    }
+    return true;
+}
+
+bool AttendanceRollups::rollMonth(QSqlDatabase db, const QDate &start)
+{
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM attendance_monthly_rollup WHERE month = ?");
+    query.addBindValue(start);
+    if (!query.exec()) {
+        qDebug() << "Failed to clear monthly rollup:" << query.lastError().text();
+        return false;
+    }
+
+    query.prepare(QString("INSERT INTO attendance_monthly_rollup (month, grade, section, present_count, "
+                          "late_count, absent_count, excused_count, total_count) SELECT ?, ")
+                  + kTotalsColumns + kTotalsFrom + kTotalsGroup);
+    query.addBindValue(start);
+    query.addBindValue(start);
+    query.addBindValue(start.addMonths(1).addDays(-1));
+    if (!query.exec()) {
+        qDebug() << "Failed to roll up attendance month:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool AttendanceRollups::rollBsMonth(QSqlDatabase db, int monthIndex)
+{
+    QDate start = NepaliCalendar::getNepaliMonthStart(monthIndex);
+    QDate end = NepaliCalendar::getNepaliMonthEnd(monthIndex);
+    if (!start.isValid() || !end.isValid()) {
+        return true;
+    }
+
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM attendance_bs_monthly_rollup WHERE bs_month_index = ?");
+    query.addBindValue(monthIndex);
+    if (!query.exec()) {
+        qDebug() << "Failed to clear BS monthly rollup:" << query.lastError().text();
+        return false;
+    }
+
+    query.prepare(QString("INSERT INTO attendance_bs_monthly_rollup (bs_month_index, grade, section, present_count, "
+                          "late_count, absent_count, excused_count, total_count) SELECT ?, ")
+                  + kTotalsColumns + kTotalsFrom + kTotalsGroup);
+    query.addBindValue(monthIndex);
+    query.addBindValue(start);
+    query.addBindValue(end);
+    if (!query.exec()) {
+        qDebug() << "Failed to roll up BS attendance month:" << query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool AttendanceRollups::refresh(QSqlDatabase db)
+{
+    QDate today = QDate::currentDate();
+    QDate lastClosedMonth = monthStart(today).addMonths(-1);
+    int lastClosedBsMonth = NepaliCalendar::getNepaliMonthIndex(today) - 1;
+
+    QDate monthThrough;
+    int bsMonthThrough = -1;
+    if (!watermarks(db, &monthThrough, &bsMonthThrough)) {
+        return false;
+    }
+
+    QSqlQuery query(db);
+    QVariantList dirtyDates;
+    if (!query.exec("SELECT date FROM attendance_rollup_dirty")) {
+        qDebug() << "Failed to read attendance edits:" << query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        dirtyDates.append(query.value(0));
+    }
+
+    bool appendMonths = !monthThrough.isValid() || monthThrough < lastClosedMonth;
+    bool appendBsMonths = lastClosedBsMonth >= 0 && bsMonthThrough < lastClosedBsMonth;
+    if (dirtyDates.isEmpty() && !appendMonths && !appendBsMonths) {
+        return true;
+    }
+
+    // Closed months touched by a late edit; edits to the open month need nothing
+    QSet<QDate> editedMonths;
+    QSet<int> editedBsMonths;
+    for (const QVariant &value : dirtyDates) {
+        QDate date = value.toDate();
+        if (monthThrough.isValid() && monthStart(date) <= monthThrough) {
+            editedMonths.insert(monthStart(date));
+        }
+        int bsMonth = NepaliCalendar::getNepaliMonthIndex(date);
+        if (bsMonth >= 0 && bsMonth <= bsMonthThrough) {
+            editedBsMonths.insert(bsMonth);
+        }
+    }
+
+    // First build starts at the oldest mark
+    QDate firstDate;
+    if ((appendMonths && !monthThrough.isValid()) || (appendBsMonths && bsMonthThrough < 0)) {
+        if (query.exec("SELECT MIN(date) FROM advanced_attendance") && query.next()) {
+            firstDate = query.value(0).toDate();
+        }
+    }
+
+    db.transaction();
+    bool ok = true;
+
+    for (const QDate &month : editedMonths) {
+        ok = ok && rollMonth(db, month);
+    }
+    for (int bsMonth : editedBsMonths) {
+        ok = ok && rollBsMonth(db, bsMonth);
+    }
+
+    if (ok && appendMonths) {
+        QDate month = monthThrough.isValid() ? monthThrough.addMonths(1)
+                                             : (firstDate.isValid() ? monthStart(firstDate) : lastClosedMonth.addMonths(1));
+        for (; ok && month <= lastClosedMonth; month = month.addMonths(1)) {
+            ok = rollMonth(db, month);
+        }
+        ok = ok && setWatermark(db, "month", lastClosedMonth.toString(Qt::ISODate));
+    }
+
+    if (ok && appendBsMonths) {
+        int bsMonth = bsMonthThrough >= 0 ? bsMonthThrough + 1
+                                          : (firstDate.isValid() ? NepaliCalendar::getNepaliMonthIndex(firstDate)
+                                                                 : lastClosedBsMonth + 1);
+        for (; ok && bsMonth >= 0 && bsMonth <= lastClosedBsMonth; ++bsMonth) {
+            ok = rollBsMonth(db, bsMonth);
+        }
+        ok = ok && setWatermark(db, "bs_month", lastClosedBsMonth);
+    }
+
+    // Only the dates read above, so an edit landing meanwhile is kept for next time
+    if (ok && !dirtyDates.isEmpty()) {
+        query.prepare("DELETE FROM attendance_rollup_dirty WHERE date = ?");
+        query.addBindValue(dirtyDates);
+        ok = query.execBatch();
+        if (!ok) {
+            qDebug() << "Failed to clear attendance edits:" << query.lastError().text();
+        }
+    }
+
+    if (!ok) {
+        db.rollback();
+        return false;
+    }
+    return db.commit();
+}
+
+QList<AttendanceRollupRow> AttendanceRollups::liveTotals(QSqlDatabase db, const QDate &fromDate, const QDate &toDate,
+                                                         const QString &grade, const QString &section)
+{
+    QList<AttendanceRollupRow> rows;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT ") + kTotalsColumns + kTotalsFrom + classFilter(grade, section, "es.")
+                  + " " + kTotalsGroup + " ORDER BY 1, 2");
+    query.addBindValue(fromDate);
+    query.addBindValue(toDate);
+    bindClass(query, grade, section);
+
+    if (!query.exec()) {
+        qDebug() << "Failed to count attendance:" << query.lastError().text();
+        return rows;
+    }
+    while (query.next()) {
+        rows.append(readCounts(query));
+    }
+    return rows;
+}
+
+QList<AttendanceRollupRow> AttendanceRollups::monthly(QSqlDatabase db, const QDate &fromDate, const QDate &toDate,
+                                                      const QString &grade, const QString &section)
+{
+    QList<AttendanceRollupRow> rows;
+    if (!fromDate.isValid() || !toDate.isValid() || toDate < fromDate) {
+        return rows;
+    }
+
+    // A failed refresh leaves the watermark behind; those months are then counted live
+    refresh(db);
+    QDate monthThrough;
+    int bsMonthThrough = -1;
+    watermarks(db, &monthThrough, &bsMonthThrough);
+
+    QDate firstMonth = monthStart(fromDate);
+    QDate lastMonth = monthStart(toDate);
+
+    if (monthThrough.isValid() && firstMonth <= monthThrough) {
+        QSqlQuery query(db);
+        query.setForwardOnly(true);
+        query.prepare("SELECT month, grade, section, present_count, late_count, absent_count, excused_count, total_count "
+                      "FROM attendance_monthly_rollup WHERE month BETWEEN ? AND ?"
+                      + classFilter(grade, section, QString()) + " ORDER BY month, grade, section");
+        query.addBindValue(firstMonth);
+        query.addBindValue(qMin(lastMonth, monthThrough));
+        bindClass(query, grade, section);
+
+        if (query.exec()) {
+            while (query.next()) {
+                AttendanceRollupRow row = readCounts(query);
+                row.periodStart = query.value("month").toDate();
+                rows.append(row);
+            }
+        } else {
+            qDebug() << "Failed to read monthly rollup:" << query.lastError().text();
+        }
+    }
+
+    QDate month = monthThrough.isValid() && monthThrough >= firstMonth ? monthThrough.addMonths(1) : firstMonth;
+    for (; month <= lastMonth; month = month.addMonths(1)) {
+        const QList<AttendanceRollupRow> live = liveTotals(db, month, month.addMonths(1).addDays(-1), grade, section);
+        for (AttendanceRollupRow row : live) {
+            row.periodStart = month;
+            rows.append(row);
+        }
+    }
+
+    return rows;
+}
+
+QList<AttendanceRollupRow> AttendanceRollups::bsMonthly(QSqlDatabase db, const QDate &fromDate, const QDate &toDate,
+                                                        const QString &grade, const QString &section)
+{
+    QList<AttendanceRollupRow> rows;
+    int firstMonth = NepaliCalendar::getNepaliMonthIndex(fromDate);
+    int lastMonth = NepaliCalendar::getNepaliMonthIndex(toDate);
+    if (firstMonth < 0 || lastMonth < firstMonth) {
+        return rows;
+    }
+
+    refresh(db);
+    QDate monthThrough;
+    int bsMonthThrough = -1;
+    watermarks(db, &monthThrough, &bsMonthThrough);
+
+    if (bsMonthThrough >= firstMonth) {
+        QSqlQuery query(db);
+        query.setForwardOnly(true);
+        query.prepare("SELECT bs_month_index, grade, section, present_count, late_count, absent_count, excused_count, total_count "
+                      "FROM attendance_bs_monthly_rollup WHERE bs_month_index BETWEEN ? AND ?"
+                      + classFilter(grade, section, QString()) + " ORDER BY bs_month_index, grade, section");
+        query.addBindValue(firstMonth);
+        query.addBindValue(qMin(lastMonth, bsMonthThrough));
+        bindClass(query, grade, section);
+
+        if (query.exec()) {
+            while (query.next()) {
+                AttendanceRollupRow row = readCounts(query);
+                row.bsMonthIndex = query.value("bs_month_index").toInt();
+                row.periodStart = NepaliCalendar::getNepaliMonthStart(row.bsMonthIndex);
+                rows.append(row);
+            }
+        } else {
+            qDebug() << "Failed to read BS monthly rollup:" << query.lastError().text();
+        }
+    }
+
+    for (int month = qMax(firstMonth, bsMonthThrough + 1); month <= lastMonth; ++month) {
+        QDate start = NepaliCalendar::getNepaliMonthStart(month);
+        QDate end = NepaliCalendar::getNepaliMonthEnd(month);
+        if (!start.isValid() || !end.isValid()) {
+            continue;
+        }
+        const QList<AttendanceRollupRow> live = liveTotals(db, start, end, grade, section);
+        for (AttendanceRollupRow row : live) {
+            row.bsMonthIndex = month;
+            row.periodStart = start;
+            rows.append(row);
+        }
+    }
+
+    return rows;
+}
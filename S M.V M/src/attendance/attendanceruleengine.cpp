@@ -0,0 +1,727 @@
+#include "attendance/attendanceruleengine.h"
+#include "database/database.h"
+#include "models/nepalicalendar.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+#include <QVarLengthArray>
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+struct Token {
+    enum Type { Number, String, Identifier, Operator, LeftParen, RightParen } type;
+    QString text;
+    double number = 0.0;
+};
+
+const double kMissing = std::numeric_limits<double>::quiet_NaN();
+
+double minutesOf(const QTime &time)
+{
+    return time.isValid() ? time.msecsSinceStartOfDay() / 60000.0 : kMissing;
+}
+
+bool tokenize(const QString &source, QList<Token> &tokens, QString *error)
+{
+    const int length = source.size();
+    int i = 0;
+
+    while (i < length) {
+        const QChar c = source.at(i);
+
+        if (c.isSpace()) {
+            ++i;
+            continue;
+        }
+
+        Token token;
+
+        if (c == '(' || c == ')') {
+            token.type = c == '(' ? Token::LeftParen : Token::RightParen;
+            token.text = c;
+            ++i;
+        } else if (c.isDigit()) {
+            int start = i;
+            while (i < length && (source.at(i).isDigit() || source.at(i) == '.' || source.at(i) == ':')) {
+                ++i;
+            }
+            QString text = source.mid(start, i - start);
+            token.type = Token::Number;
+            token.text = text;
+
+            if (text.contains(':')) {
+                // Time literals are stored as minutes since midnight
+                QTime time = QTime::fromString(text, text.count(':') == 2 ? "H:mm:ss" : "H:mm");
+                if (!time.isValid()) {
+                    if (error) *error = QString("Invalid time literal '%1'").arg(text);
+                    return false;
+                }
+                token.number = minutesOf(time);
+            } else {
+                bool ok = false;
+                token.number = text.toDouble(&ok);
+                if (!ok) {
+                    if (error) *error = QString("Invalid number '%1'").arg(text);
+                    return false;
+                }
+            }
+        } else if (c == '\'' || c == '"') {
+            int end = source.indexOf(c, i + 1);
+            if (end < 0) {
+                if (error) *error = "Unterminated string literal";
+                return false;
+            }
+            token.type = Token::String;
+            token.text = source.mid(i + 1, end - i - 1);
+            i = end + 1;
+        } else if (c.isLetter() || c == '_') {
+            int start = i;
+            while (i < length && (source.at(i).isLetterOrNumber() || source.at(i) == '_')) {
+                ++i;
+            }
+            QString word = source.mid(start, i - start);
+            QString upper = word.toUpper();
+            if (upper == "AND" || upper == "OR" || upper == "NOT") {
+                token.type = Token::Operator;
+                token.text = upper;
+            } else {
+                token.type = Token::Identifier;
+                token.text = word.toLower();
+            }
+        } else {
+            static const QStringList operators = { "==", "!=", "<=", ">=", "&&", "||", "<", ">", "=", "!" };
+            QString matched;
+            for (const QString &op : operators) {
+                if (source.mid(i, op.size()) == op) {
+                    matched = op;
+                    break;
+                }
+            }
+            if (matched.isEmpty()) {
+                if (error) *error = QString("Unexpected character '%1'").arg(c);
+                return false;
+            }
+            i += matched.size();
+
+            token.type = Token::Operator;
+            if (matched == "=") token.text = "==";
+            else if (matched == "&&") token.text = "AND";
+            else if (matched == "||") token.text = "OR";
+            else if (matched == "!") token.text = "NOT";
+            else token.text = matched;
+        }
+
+        tokens.append(token);
+    }
+
+    return true;
+}
+
+int precedence(const QString &op)
+{
+    if (op == "OR") return 1;
+    if (op == "AND") return 2;
+    if (op == "NOT") return 3;
+    return 4;
+}
+
+AttendanceAlert makeAlert(const AttendanceEntry &entry, const AttendanceRule &rule,
+                          const QString &alertType, const QString &severity)
+{
+    AttendanceAlert alert;
+    alert.studentRoll = entry.studentRoll;
+    alert.studentName = entry.studentName;
+    alert.grade = entry.grade;
+    alert.section = entry.section;
+    alert.alertType = alertType;
+    alert.message = QString("%1: student %2 (Roll: %3) marked %4 on %5")
+                   .arg(rule.ruleName)
+                   .arg(entry.studentName.isEmpty() ? entry.studentRoll : entry.studentName)
+                   .arg(entry.studentRoll)
+                   .arg(entry.status)
+                   .arg(entry.date.toString("dd/MM/yyyy"));
+    alert.severity = severity;
+    alert.alertDate = QDateTime::currentDateTime();
+    return alert;
+}
+
+} // namespace
+
+AttendanceRuleEngine::AttendanceRuleEngine(QObject *parent)
+    : QObject(parent)
+    , m_countersMonth(-1)
+    , m_schoolDayEnd(16, 0)
+{
+}
+
+AttendanceRuleEngine::~AttendanceRuleEngine()
+{
+}
+
+void AttendanceRuleEngine::loadRules(const QList<AttendanceRule> &rules)
+{
+    m_rules.clear();
+    m_scopeIndex.clear();
+    m_resolvedIndex.clear();
+
+    QList<AttendanceRule> ordered = rules;
+    std::stable_sort(ordered.begin(), ordered.end(), [](const AttendanceRule &a, const AttendanceRule &b) {
+        return a.priority < b.priority;
+    });
+
+    bool hasAutoMarkRule = false;
+    for (const AttendanceRule &rule : ordered) {
+        if (!rule.active) continue;
+
+        CompiledRule compiled;
+        QString error;
+        if (!compile(rule, compiled, &error)) {
+            qDebug() << "Skipping attendance rule" << rule.ruleName << ":" << error;
+            continue;
+        }
+
+        if (rule.ruleType.compare("AutoMark", Qt::CaseInsensitive) == 0) {
+            hasAutoMarkRule = true;
+        }
+        m_rules.append(compiled);
+    }
+
+    // Keep the historical 9:00 cutoff until the school configures its own
+    if (!hasAutoMarkRule) {
+        CompiledRule compiled;
+        if (compile(defaultAutoMarkRule(), compiled, nullptr)) {
+            m_rules.append(compiled);
+        }
+    }
+
+    for (int i = 0; i < m_rules.size(); ++i) {
+        const AttendanceRule &rule = m_rules.at(i).rule;
+        m_scopeIndex[scopeKey(rule.grade, rule.section)].append(i);
+    }
+}
+
+bool AttendanceRuleEngine::validateRule(const AttendanceRule &rule, QString *error)
+{
+    CompiledRule compiled;
+    return compile(rule, compiled, error);
+}
+
+RuleOutcome AttendanceRuleEngine::evaluate(const AttendanceEntry &entry, const QTime &now) const
+{
+    RuleOutcome outcome;
+    QString status = entry.status;
+
+    for (int index : rulesFor(entry.grade, entry.section)) {
+        const CompiledRule &compiled = m_rules.at(index);
+        if (isWaiting(compiled, now) || !matches(compiled, entry, status, now)) {
+            continue;
+        }
+
+        outcome.firedRules.append(compiled.rule.ruleName);
+
+        AttendanceEntry current = entry;
+        current.status = status;
+        bool stop = false;
+
+        for (const Action &action : compiled.actions) {
+            switch (action.type) {
+            case Action::SetStatus:
+                if (outcome.status.isEmpty()) {
+                    outcome.status = action.argument;
+                    status = action.argument;
+                    current.status = status;
+                }
+                break;
+            case Action::NotifyParent:
+                outcome.notifyParent = true;
+                outcome.alerts.append(makeAlert(current, compiled.rule, "Parent Notification", "Medium"));
+                break;
+            case Action::RaiseAlert:
+                outcome.alerts.append(makeAlert(current, compiled.rule, compiled.rule.ruleType, action.argument));
+                break;
+            case Action::Stop:
+                stop = true;
+                break;
+            }
+        }
+
+        if (stop) break;
+    }
+
+    return outcome;
+}
+
+QList<QTime> AttendanceRuleEngine::autoMarkTimes(const QString &grade, const QString &section) const
+{
+    QList<QTime> times;
+
+    for (int index : rulesFor(grade, section)) {
+        const CompiledRule &compiled = m_rules.at(index);
+        if (compiled.rule.ruleType.compare("AutoMark", Qt::CaseInsensitive) != 0) {
+            continue;
+        }
+
+        // A rule without a time gate fires once the school day is over
+        if (!compiled.gates.isEmpty()) {
+            times.append(compiled.gates);
+        } else if (m_schoolDayEnd.isValid()) {
+            times.append(m_schoolDayEnd);
+        }
+    }
+
+    std::sort(times.begin(), times.end());
+    times.erase(std::unique(times.begin(), times.end()), times.end());
+    return times;
+}
+
+QList<QTime> AttendanceRuleEngine::timeGates(const CompiledRule &compiled)
+{
+    QList<QTime> gates;
+    const QVector<Instruction> &code = compiled.code;
+
+    for (int i = 0; i + 2 < code.size(); ++i) {
+        const Instruction &a = code.at(i);
+        const Instruction &b = code.at(i + 1);
+        const Instruction &c = code.at(i + 2);
+
+        double minutes = -1;
+        if (a.op == Op::LoadField && a.operand == Now && b.op == Op::PushNumber &&
+            (c.op == Op::Ge || c.op == Op::Gt)) {
+            minutes = compiled.numbers.at(b.operand);
+        } else if (a.op == Op::PushNumber && b.op == Op::LoadField && b.operand == Now &&
+                   (c.op == Op::Le || c.op == Op::Lt)) {
+            minutes = compiled.numbers.at(a.operand);
+        }
+
+        if (minutes >= 0) {
+            gates.append(QTime::fromMSecsSinceStartOfDay(static_cast<int>(minutes * 60000)));
+        }
+    }
+
+    return gates;
+}
+
+bool AttendanceRuleEngine::isWaiting(const CompiledRule &compiled, const QTime &now) const
+{
+    return compiled.gates.isEmpty() && m_schoolDayEnd.isValid() && now < m_schoolDayEnd
+        && compiled.rule.ruleType.compare("AutoMark", Qt::CaseInsensitive) == 0;
+}
+
+QTime AttendanceRuleEngine::earliestAutoMarkTime() const
+{
+    QTime earliest;
+
+    for (auto it = m_scopeIndex.constBegin(); it != m_scopeIndex.constEnd(); ++it) {
+        const AttendanceRule &rule = m_rules.at(it.value().first()).rule;
+        QList<QTime> times = autoMarkTimes(rule.grade, rule.section);
+        if (!times.isEmpty() && (!earliest.isValid() || times.first() < earliest)) {
+            earliest = times.first();
+        }
+    }
+
+    return earliest;
+}
+
+bool AttendanceRuleEngine::loadMonthlyCounters(const QDate &date)
+{
+    int monthIndex = NepaliCalendar::getNepaliMonthIndex(date);
+    if (monthIndex < 0) {
+        return false;
+    }
+
+    QSqlQuery query(Database::instance().database());
+    query.setForwardOnly(true);
+    query.prepare("SELECT student_roll, date, status FROM advanced_attendance "
+                 "WHERE date BETWEEN ? AND ? AND status IN ('Late', 'Absent')");
+    query.addBindValue(NepaliCalendar::getNepaliMonthStart(monthIndex));
+    query.addBindValue(NepaliCalendar::getNepaliMonthEnd(monthIndex));
+
+    if (!query.exec()) {
+        qDebug() << "Failed to load attendance counters:" << query.lastError().text();
+        return false;
+    }
+
+    m_monthly.clear();
+    m_countersMonth = monthIndex;
+
+    while (query.next()) {
+        recordStatus(query.value("student_roll").toString(),
+                     query.value("date").toDate(),
+                     query.value("status").toString());
+    }
+
+    return true;
+}
+
+void AttendanceRuleEngine::recordStatus(const QString &studentRoll, const QDate &date, const QString &status)
+{
+    int monthIndex = NepaliCalendar::getNepaliMonthIndex(date);
+    if (monthIndex < 0) {
+        return;
+    }
+
+    StudentMonth &month = m_monthly[studentRoll];
+    if (monthIndex < month.monthIndex) {
+        return; // Back-filled marks from an earlier month do not affect "this month"
+    }
+    if (monthIndex > month.monthIndex) {
+        month = StudentMonth();
+        month.monthIndex = monthIndex;
+    }
+
+    QString previous = month.dayStatus.value(date);
+    if (previous == "Late") month.lateCount--;
+    else if (previous == "Absent") month.absentCount--;
+
+    if (status == "Late") month.lateCount++;
+    else if (status == "Absent") month.absentCount++;
+
+    if (status == "Late" || status == "Absent") {
+        month.dayStatus.insert(date, status);
+    } else {
+        month.dayStatus.remove(date);
+    }
+
+    if (monthIndex > m_countersMonth) {
+        m_countersMonth = monthIndex;
+    }
+}
+
+bool AttendanceRuleEngine::compile(const AttendanceRule &rule, CompiledRule &compiled, QString *error)
+{
+    compiled = CompiledRule();
+    compiled.rule = rule;
+
+    if (!compileConditions(rule.conditions, compiled, error)) {
+        return false;
+    }
+    compiled.gates = timeGates(compiled);
+
+    return compileActions(rule.actions, compiled, error);
+}
+
+bool AttendanceRuleEngine::compileConditions(const QString &source, CompiledRule &compiled, QString *error)
+{
+    QList<Token> tokens;
+    if (!tokenize(source, tokens, error)) {
+        return false;
+    }
+
+    // Shunting-yard into postfix bytecode
+    QStringList operators;
+    auto emitOperator = [&compiled](const QString &op) {
+        static const QHash<QString, Op> ops = {
+            { "==", Op::Eq }, { "!=", Op::Ne }, { "<", Op::Lt }, { "<=", Op::Le },
+            { ">", Op::Gt }, { ">=", Op::Ge }, { "AND", Op::And }, { "OR", Op::Or },
+            { "NOT", Op::Not }
+        };
+        compiled.code.append(Instruction{ ops.value(op), 0 });
+    };
+
+    for (const Token &token : tokens) {
+        switch (token.type) {
+        case Token::Number:
+            compiled.code.append(Instruction{ Op::PushNumber, static_cast<int>(compiled.numbers.size()) });
+            compiled.numbers.append(token.number);
+            break;
+        case Token::String:
+            compiled.code.append(Instruction{ Op::PushString, static_cast<int>(compiled.strings.size()) });
+            compiled.strings.append(token.text);
+            break;
+        case Token::Identifier: {
+            int field = fieldId(token.text);
+            if (field < 0) {
+                if (error) *error = QString("Unknown field '%1'").arg(token.text);
+                return false;
+            }
+            compiled.code.append(Instruction{ Op::LoadField, field });
+            break;
+        }
+        case Token::LeftParen:
+            operators.append("(");
+            break;
+        case Token::RightParen:
+            while (!operators.isEmpty() && operators.last() != "(") {
+                emitOperator(operators.takeLast());
+            }
+            if (operators.isEmpty()) {
+                if (error) *error = "Unbalanced ')'";
+                return false;
+            }
+            operators.removeLast();
+            break;
+        case Token::Operator:
+            if (token.text != "NOT") {
+                while (!operators.isEmpty() && operators.last() != "(" &&
+                       precedence(operators.last()) >= precedence(token.text)) {
+                    emitOperator(operators.takeLast());
+                }
+            }
+            operators.append(token.text);
+            break;
+        }
+    }
+
+    while (!operators.isEmpty()) {
+        if (operators.last() == "(") {
+            if (error) *error = "Unbalanced '('";
+            return false;
+        }
+        emitOperator(operators.takeLast());
+    }
+
+    // Verify the program leaves exactly one value on the stack
+    int depth = 0;
+    for (const Instruction &instruction : compiled.code) {
+        switch (instruction.op) {
+        case Op::PushNumber:
+        case Op::PushString:
+        case Op::LoadField:
+            depth++;
+            break;
+        case Op::Not:
+            if (depth < 1) depth = -1;
+            break;
+        default:
+            depth = depth < 2 ? -1 : depth - 1;
+            break;
+        }
+        if (depth < 0) {
+            if (error) *error = "Operator is missing an operand";
+            return false;
+        }
+    }
+
+    if (!compiled.code.isEmpty() && depth != 1) {
+        if (error) *error = "Condition does not reduce to a single value";
+        return false;
+    }
+
+    return true;
+}
+
+bool AttendanceRuleEngine::compileActions(const QString &source, CompiledRule &compiled, QString *error)
+{
+    static const QStringList statuses = { "Present", "Absent", "Late", "Excused" };
+
+    const QStringList parts = source.split(';', Qt::SkipEmptyParts);
+    for (const QString &part : parts) {
+        QString text = part.trimmed();
+        if (text.isEmpty()) continue;
+
+        int separator = text.indexOf(QRegularExpression("[=:]"));
+        QString name = (separator < 0 ? text : text.left(separator)).trimmed().toLower();
+        QString argument = separator < 0 ? QString() : text.mid(separator + 1).trimmed();
+
+        Action action;
+        if (name == "status" || name == "set_status") {
+            action.type = Action::SetStatus;
+            for (const QString &status : statuses) {
+                if (status.compare(argument, Qt::CaseInsensitive) == 0) {
+                    action.argument = status;
+                }
+            }
+            if (action.argument.isEmpty()) {
+                if (error) *error = QString("Unknown status '%1'").arg(argument);
+                return false;
+            }
+        } else if (name == "notify_parent") {
+            action.type = Action::NotifyParent;
+        } else if (name == "alert") {
+            action.type = Action::RaiseAlert;
+            action.argument = argument.isEmpty() ? QString("Medium") : argument;
+        } else if (name == "stop") {
+            action.type = Action::Stop;
+        } else {
+            if (error) *error = QString("Unknown action '%1'").arg(name);
+            return false;
+        }
+
+        compiled.actions.append(action);
+    }
+
+    if (compiled.actions.isEmpty()) {
+        if (error) *error = "Rule has no actions";
+        return false;
+    }
+
+    return true;
+}
+
+int AttendanceRuleEngine::fieldId(const QString &name)
+{
+    static const QHash<QString, int> fields = {
+        { "time_in", TimeIn },
+        { "time_out", TimeOut },
+        { "now", Now },
+        { "status", Status },
+        { "method", Method },
+        { "grade", Grade },
+        { "section", Section },
+        { "weekday", Weekday },
+        { "unmarked", Unmarked },
+        { "late_count_month", LateCountMonth },
+        { "absent_count_month", AbsentCountMonth }
+    };
+    return fields.value(name, -1);
+}
+
+bool AttendanceRuleEngine::matches(const CompiledRule &compiled, const AttendanceEntry &entry,
+                                   const QString &status, const QTime &now) const
+{
+    if (compiled.code.isEmpty()) {
+        return true;
+    }
+
+    QVarLengthArray<Value, 16> stack;
+
+    for (const Instruction &instruction : compiled.code) {
+        switch (instruction.op) {
+        case Op::PushNumber: {
+            Value value;
+            value.number = compiled.numbers.at(instruction.operand);
+            stack.append(value);
+            break;
+        }
+        case Op::PushString: {
+            Value value;
+            value.isString = true;
+            value.text = compiled.strings.at(instruction.operand);
+            stack.append(value);
+            break;
+        }
+        case Op::LoadField:
+            stack.append(fieldValue(instruction.operand, entry, status, now));
+            break;
+        case Op::Not: {
+            Value &top = stack.last();
+            top.number = top.number != 0.0 ? 0.0 : 1.0;
+            top.isString = false;
+            break;
+        }
+        default: {
+            Value rhs = stack.last();
+            stack.removeLast();
+            Value &lhs = stack.last();
+
+            bool result = false;
+            if (instruction.op == Op::And) {
+                result = lhs.number != 0.0 && rhs.number != 0.0;
+            } else if (instruction.op == Op::Or) {
+                result = lhs.number != 0.0 || rhs.number != 0.0;
+            } else if (lhs.isString != rhs.isString) {
+                result = instruction.op == Op::Ne;
+            } else {
+                // NaN (missing time) compares false, except for !=
+                int cmp = 0;
+                bool ordered = true;
+                if (lhs.isString) {
+                    cmp = lhs.text.compare(rhs.text, Qt::CaseInsensitive);
+                } else if (lhs.number != lhs.number || rhs.number != rhs.number) {
+                    ordered = false;
+                } else {
+                    cmp = lhs.number < rhs.number ? -1 : (lhs.number > rhs.number ? 1 : 0);
+                }
+
+                switch (instruction.op) {
+                case Op::Eq: result = ordered && cmp == 0; break;
+                case Op::Ne: result = !ordered || cmp != 0; break;
+                case Op::Lt: result = ordered && cmp < 0; break;
+                case Op::Le: result = ordered && cmp <= 0; break;
+                case Op::Gt: result = ordered && cmp > 0; break;
+                case Op::Ge: result = ordered && cmp >= 0; break;
+                default: break;
+                }
+            }
+
+            lhs.isString = false;
+            lhs.text.clear();
+            lhs.number = result ? 1.0 : 0.0;
+            break;
+        }
+        }
+    }
+
+    return !stack.isEmpty() && stack.last().number != 0.0;
+}
+
+AttendanceRuleEngine::Value AttendanceRuleEngine::fieldValue(int field, const AttendanceEntry &entry,
+                                                             const QString &status, const QTime &now) const
+{
+    Value value;
+
+    switch (field) {
+    case TimeIn: value.number = minutesOf(entry.timeIn); break;
+    case TimeOut: value.number = minutesOf(entry.timeOut); break;
+    case Now: value.number = minutesOf(now); break;
+    case Weekday: value.number = entry.date.dayOfWeek(); break;
+    case Unmarked: value.number = entry.status.isEmpty() ? 1.0 : 0.0; break;
+    case LateCountMonth: value.number = monthlyCount(entry, status, "Late"); break;
+    case AbsentCountMonth: value.number = monthlyCount(entry, status, "Absent"); break;
+    case Status: value.isString = true; value.text = status; break;
+    case Method: value.isString = true; value.text = entry.method; break;
+    case Grade: value.isString = true; value.text = entry.grade; break;
+    case Section: value.isString = true; value.text = entry.section; break;
+    default: break;
+    }
+
+    return value;
+}
+
+int AttendanceRuleEngine::monthlyCount(const AttendanceEntry &entry, const QString &status,
+                                       const QString &countedStatus) const
+{
+    int count = 0;
+    QString previous;
+
+    auto it = m_monthly.constFind(entry.studentRoll);
+    if (it != m_monthly.constEnd() && it->monthIndex == NepaliCalendar::getNepaliMonthIndex(entry.date)) {
+        count = countedStatus == "Late" ? it->lateCount : it->absentCount;
+        previous = it->dayStatus.value(entry.date);
+    }
+
+    // Replace whatever is stored for this day with the status being evaluated
+    if (previous == countedStatus) count--;
+    if (status == countedStatus) count++;
+
+    return count;
+}
+
+const QVector<int> &AttendanceRuleEngine::rulesFor(const QString &grade, const QString &section) const
+{
+    const QString key = scopeKey(grade, section);
+    auto cached = m_resolvedIndex.constFind(key);
+    if (cached != m_resolvedIndex.constEnd()) {
+        return cached.value();
+    }
+
+    // Merge class-specific, grade-wide, section-wide and school-wide rules
+    QVector<int> merged;
+    QStringList scopes = { key, scopeKey(grade, QString()), scopeKey(QString(), section), scopeKey(QString(), QString()) };
+    scopes.removeDuplicates();
+    for (const QString &scope : scopes) {
+        merged += m_scopeIndex.value(scope);
+    }
+
+    // m_rules is already in priority order, so index order is priority order
+    std::sort(merged.begin(), merged.end());
+    return m_resolvedIndex.insert(key, merged).value();
+}
+
+QString AttendanceRuleEngine::scopeKey(const QString &grade, const QString &section)
+{
+    return grade + '|' + section;
+}
+
+AttendanceRule AttendanceRuleEngine::defaultAutoMarkRule()
+{
+    AttendanceRule rule;
+    rule.ruleName = "Default Absent Cutoff";
+    rule.ruleType = "AutoMark";
+    rule.conditions = "unmarked == 1 AND now >= 09:00";
+    rule.actions = "status=Absent";
+    rule.priority = 9999;
+    return rule;
+}
@@ -0,0 +1,237 @@
+#include "attendance/attendancescheduler.h"
+#include "database/database.h"
+#include "database/dataversions.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+// Look-ahead for the next school day and for the holiday cache
+const int kSearchDays = 366;
+
+// Long waits are split so wall-clock changes are picked up within this bound
+const qint64 kMaxWaitMsecs = 6LL * 60 * 60 * 1000;
+
+} // namespace
+
+AttendanceScheduler::AttendanceScheduler(QObject *parent)
+    : QObject(parent)
+    , m_timer(new QTimer(this))
+    , m_schoolDayEnd(16, 0)
+    , m_running(false)
+{
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout, this, &AttendanceScheduler::onTimeout);
+    connect(&DataVersions::instance(), &DataVersions::tableChanged, this, &AttendanceScheduler::onTableChanged);
+    
+    m_offDays.insert(Qt::Saturday);
+}
+
+AttendanceScheduler::~AttendanceScheduler()
+{
+}
+
+void AttendanceScheduler::setDeadlines(const QList<QTime> &times)
+{
+    m_deadlines.clear();
+    for (const QTime &time : times) {
+        if (time.isValid() && !m_deadlines.contains(time)) {
+            m_deadlines.append(time);
+        }
+    }
+    std::sort(m_deadlines.begin(), m_deadlines.end());
+    
+    if (m_running) {
+        arm(QDateTime::currentDateTime());
+    }
+}
+
+void AttendanceScheduler::setSchoolDayEnd(const QTime &time)
+{
+    m_schoolDayEnd = time;
+    
+    if (m_running) {
+        arm(QDateTime::currentDateTime());
+    }
+}
+
+void AttendanceScheduler::setWeeklyOffDays(const QList<int> &daysOfWeek)
+{
+    m_offDays = QSet<int>(daysOfWeek.begin(), daysOfWeek.end());
+    
+    if (m_running) {
+        arm(QDateTime::currentDateTime());
+    }
+}
+
+bool AttendanceScheduler::isSchoolDay(const QDate &date)
+{
+    if (!date.isValid() || m_offDays.contains(date.dayOfWeek())) {
+        return false;
+    }
+    
+    ensureHolidays(date);
+    return !m_holidays.contains(date);
+}
+
+void AttendanceScheduler::reloadHolidays()
+{
+    m_holidaysFrom = QDate();
+    m_holidaysTo = QDate();
+    m_holidays.clear();
+    
+    if (m_running) {
+        arm(QDateTime::currentDateTime());
+    }
+}
+
+void AttendanceScheduler::ensureHolidays(const QDate &date)
+{
+    if (m_holidaysFrom.isValid() && date >= m_holidaysFrom && date <= m_holidaysTo) {
+        return;
+    }
+    
+    // One range query covers every lookup until the window is left
+    m_holidaysFrom = date;
+    m_holidaysTo = date.addDays(kSearchDays);
+    m_holidays.clear();
+    
+    QSqlQuery query(Database::instance().database());
+    query.setForwardOnly(true);
+    query.prepare("SELECT date FROM holidays WHERE date BETWEEN ? AND ?");
+    query.addBindValue(m_holidaysFrom);
+    query.addBindValue(m_holidaysTo);
+    
+    if (!query.exec()) {
+        qDebug() << "Failed to load holidays for attendance schedule:" << query.lastError().text();
+        return;
+    }
+    
+    while (query.next()) {
+        m_holidays.insert(query.value("date").toDate());
+    }
+}
+
+void AttendanceScheduler::start()
+{
+    m_running = true;
+    
+    QDateTime now = QDateTime::currentDateTime();
+    QList<QTime> times = dailyTimes();
+    
+    // Catch up when started during a school day after a cutoff has already passed
+    if (!times.isEmpty() && isSchoolDay(now.date())
+        && now.time() >= times.first() && now.time() < m_schoolDayEnd) {
+        QTimer::singleShot(0, this, [this, now]() {
+            if (m_running) {
+                emit deadlineReached(now);
+            }
+        });
+    }
+    
+    arm(now);
+}
+
+void AttendanceScheduler::stop()
+{
+    m_running = false;
+    m_timer->stop();
+    m_nextDeadline = QDateTime();
+}
+
+void AttendanceScheduler::onTimeout()
+{
+    QDateTime now = QDateTime::currentDateTime();
+    
+    // Woken early by the wait cap (or a clock change): just re-arm
+    if (!m_nextDeadline.isValid() || now < m_nextDeadline) {
+        arm(now);
+        return;
+    }
+    
+    QDateTime deadline = m_nextDeadline;
+    
+    // Checked against the table itself, in case the file was restored or edited behind our back
+    if (!isHolidayInTable(deadline.date())) {
+        emit deadlineReached(deadline);
+    }
+    
+    arm(now);
+}
+
+void AttendanceScheduler::onTableChanged(const QString &table)
+{
+    if (table == "holidays") {
+        reloadHolidays();
+    }
+}
+
+bool AttendanceScheduler::isHolidayInTable(const QDate &date) const
+{
+    QSqlQuery query(Database::instance().database());
+    query.prepare("SELECT 1 FROM holidays WHERE date = ?");
+    query.addBindValue(date);
+    
+    if (!query.exec()) {
+        qDebug() << "Failed to check holiday for attendance schedule:" << query.lastError().text();
+        return m_holidays.contains(date);
+    }
+    return query.next();
+}
+
+void AttendanceScheduler::arm(const QDateTime &after)
+{
+    m_timer->stop();
+    
+    if (!m_running) {
+        return;
+    }
+    
+    m_nextDeadline = computeNextDeadline(after);
+    
+    qint64 wait = kMaxWaitMsecs;
+    if (m_nextDeadline.isValid()) {
+        wait = qBound<qint64>(0, QDateTime::currentDateTime().msecsTo(m_nextDeadline), kMaxWaitMsecs);
+    }
+    
+    m_timer->start(static_cast<int>(wait));
+}
+
+QDateTime AttendanceScheduler::computeNextDeadline(const QDateTime &after)
+{
+    QList<QTime> times = dailyTimes();
+    if (times.isEmpty()) {
+        return QDateTime();
+    }
+    
+    QDate day = after.date();
+    for (int i = 0; i <= kSearchDays; ++i, day = day.addDays(1)) {
+        if (!isSchoolDay(day)) {
+            continue;
+        }
+        
+        for (const QTime &time : times) {
+            QDateTime candidate(day, time);
+            if (candidate > after) {
+                return candidate;
+            }
+        }
+    }
+    
+    return QDateTime();
+}
+
+QList<QTime> AttendanceScheduler::dailyTimes() const
+{
+    QList<QTime> times = m_deadlines;
+    
+    if (m_schoolDayEnd.isValid() && !times.contains(m_schoolDayEnd)) {
+        times.append(m_schoolDayEnd);
+        std::sort(times.begin(), times.end());
+    }
+    
+    return times;
+}
@@ -0,0 +1,152 @@
+#include "attendance/leaveindex.h"
+#include "database/database.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+#include <algorithm>
+
+LeaveIndex::LeaveIndex()
+    : m_loaded(false)
+{
+}
+
+bool LeaveIndex::load()
+{
+    QSqlQuery query(Database::instance().database());
+    query.setForwardOnly(true);
+    
+    if (!query.exec("SELECT id, student_roll, from_date, to_date FROM leave_requests "
+                    "WHERE status = 'Approved'")) {
+        qDebug() << "Failed to load approved leaves:" << query.lastError().text();
+        return false;
+    }
+    
+    clear();
+    while (query.next()) {
+        addLeave(query.value("student_roll").toString(),
+                 query.value("from_date").toDate(),
+                 query.value("to_date").toDate(),
+                 query.value("id").toInt());
+    }
+    
+    m_loaded = true;
+    return true;
+}
+
+void LeaveIndex::clear()
+{
+    m_intervals.clear();
+    m_requests.clear();
+    m_loaded = false;
+}
+
+void LeaveIndex::addLeave(const QString &studentRoll, const QDate &fromDate, const QDate &toDate, int requestId)
+{
+    if (!fromDate.isValid() || !toDate.isValid() || fromDate > toDate) {
+        return;
+    }
+    
+    // Re-approving a request replaces its old dates
+    if (m_requests.contains(requestId)) {
+        removeLeave(requestId);
+    }
+    m_requests.insert(requestId, { studentRoll, fromDate.toJulianDay(), toDate.toJulianDay() });
+    
+    QVector<Interval> &intervals = m_intervals[studentRoll];
+    Interval added = { fromDate.toJulianDay(), toDate.toJulianDay(), { requestId } };
+    
+    // First interval that could touch the new one (ends on or after the day before it starts)
+    auto first = std::lower_bound(intervals.begin(), intervals.end(), added.from - 1,
+                                  [](const Interval &interval, qint64 day) { return interval.to < day; });
+    
+    // Coalesce every overlapping or adjacent interval into the new one
+    auto last = first;
+    while (last != intervals.end() && last->from <= added.to + 1) {
+        added.from = qMin(added.from, last->from);
+        added.to = qMax(added.to, last->to);
+        added.requestIds += last->requestIds;
+        ++last;
+    }
+    
+    int position = first - intervals.begin();
+    intervals.erase(first, last);
+    intervals.insert(position, added);
+}
+
+void LeaveIndex::removeLeave(int requestId)
+{
+    auto request = m_requests.find(requestId);
+    if (request == m_requests.end()) {
+        return;
+    }
+    
+    const Leave removed = request.value();
+    m_requests.erase(request);
+    
+    QVector<Interval> &intervals = m_intervals[removed.studentRoll];
+    auto it = std::upper_bound(intervals.begin(), intervals.end(), removed.from,
+                               [](qint64 value, const Interval &interval) { return value < interval.from; });
+    if (it == intervals.begin()) {
+        return;
+    }
+    --it;
+    
+    // Drop the merged range and coalesce the other requests in it afresh
+    const QVector<int> others = it->requestIds;
+    intervals.erase(it);
+    for (int otherId : others) {
+        if (otherId == requestId) {
+            continue;
+        }
+        const Leave other = m_requests.take(otherId);
+        addLeave(other.studentRoll, QDate::fromJulianDay(other.from), QDate::fromJulianDay(other.to), otherId);
+    }
+    
+    if (m_intervals.value(removed.studentRoll).isEmpty()) {
+        m_intervals.remove(removed.studentRoll);
+    }
+}
+
+bool LeaveIndex::isOnLeave(const QString &studentRoll, const QDate &date, int *requestId) const
+{
+    auto it = m_intervals.constFind(studentRoll);
+    if (it == m_intervals.constEnd() || !date.isValid()) {
+        return false;
+    }
+    
+    const QVector<Interval> &intervals = it.value();
+    const qint64 day = date.toJulianDay();
+    
+    // Last interval starting on or before the day
+    auto next = std::upper_bound(intervals.constBegin(), intervals.constEnd(), day,
+                                 [](qint64 value, const Interval &interval) { return value < interval.from; });
+    if (next == intervals.constBegin()) {
+        return false;
+    }
+    
+    const Interval &candidate = *(next - 1);
+    if (candidate.to < day) {
+        return false;
+    }
+    
+    // The range may span several requests; report the one whose own dates cover the day
+    if (requestId) {
+        for (int id : candidate.requestIds) {
+            const Leave leave = m_requests.value(id);
+            if (leave.from <= day && day <= leave.to) {
+                *requestId = id;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+QList<QPair<QDate, QDate>> LeaveIndex::leavesFor(const QString &studentRoll) const
+{
+    QList<QPair<QDate, QDate>> leaves;
+    for (const Interval &interval : m_intervals.value(studentRoll)) {
+        leaves.append(qMakePair(QDate::fromJulianDay(interval.from), QDate::fromJulianDay(interval.to)));
+    }
+    return leaves;
+}
@@ -0,0 +1,582 @@
+#include "attendance/periodattendance.h"
+#include "database/database.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QMap>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+// 3-bit status codes packed into period_attendance.period_bits
+enum PeriodStatusCode {
+    Unmarked = 0,
+    PresentCode = 1,
+    AbsentCode = 2,
+    LateCode = 3,
+    ExcusedCode = 4
+};
+
+QString classKey(const QString &grade, const QString &section)
+{
+    return grade + QLatin1Char('|') + section;
+}
+
+} // namespace
+
+PeriodAttendance::PeriodAttendance(QObject *parent)
+    : QObject(parent)
+{
+}
+
+PeriodAttendance::~PeriodAttendance()
+{
+}
+
+int PeriodAttendance::statusCode(const QString &status)
+{
+    if (status == "Present") return PresentCode;
+    if (status == "Absent") return AbsentCode;
+    if (status == "Late") return LateCode;
+    if (status == "Excused") return ExcusedCode;
+    return Unmarked;
+}
+
+QString PeriodAttendance::statusName(int code)
+{
+    switch (code) {
+    case PresentCode: return "Present";
+    case AbsentCode: return "Absent";
+    case LateCode: return "Late";
+    case ExcusedCode: return "Excused";
+    default: return QString();
+    }
+}
+
+int PeriodAttendance::periodCode(qint64 bits, int period)
+{
+    if (period < 1 || period > MaxPeriods) {
+        return Unmarked;
+    }
+    return static_cast<int>((bits >> bitShift(period)) & 7);
+}
+
+QStringList PeriodAttendance::unpackStatuses(qint64 bits, int periodCount)
+{
+    QStringList statuses;
+    for (int period = 1; period <= periodCount; ++period) {
+        statuses.append(statusName(periodCode(bits, period)));
+    }
+    return statuses;
+}
+
+bool PeriodAttendance::setClassTimetable(const QString &grade, const QString &section, const QList<PeriodSlot> &timetable)
+{
+    QSqlDatabase db = Database::instance().database();
+    QSqlQuery query(db);
+    
+    db.transaction();
+    
+    // Versions only grow, so rows marked under an earlier one keep its subjects and teachers
+    query.prepare("SELECT COALESCE(MAX(version), 0) + 1 FROM period_timetable_versions WHERE grade = ? AND section = ?");
+    query.addBindValue(grade);
+    query.addBindValue(section);
+    
+    if (!query.exec() || !query.next()) {
+        qDebug() << "Failed to number period timetable version:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    const int version = query.value(0).toInt();
+    
+    query.prepare("DELETE FROM period_timetable WHERE grade = ? AND section = ?");
+    query.addBindValue(grade);
+    query.addBindValue(section);
+    
+    if (!query.exec()) {
+        qDebug() << "Failed to clear period timetable:" << query.lastError().text();
+        db.rollback();
+        return false;
+    }
+    
+    query.prepare("INSERT INTO period_timetable (grade, section, day_of_week, period_number, "
+                 "start_time, duration_minutes, subject, teacher, is_break) "
+                 "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    
+    QSqlQuery versionQuery(db);
+    versionQuery.prepare("INSERT INTO period_timetable_versions (grade, section, version, day_of_week, "
+                        "period_number, subject, teacher, is_break) VALUES (?, ?, ?, ?, ?, ?, ?, ?)");
+    
+    // Only what is stored is cached, so the cache matches a reload
+    QList<PeriodSlot> stored;
+    for (const PeriodSlot &slot : timetable) {
+        if (slot.periodNumber < 1 || slot.periodNumber > MaxPeriods) {
+            qDebug() << "Skipping period outside 1 -" << MaxPeriods << ":" << slot.periodNumber;
+            continue;
+        }
+        
+        query.addBindValue(grade);
+        query.addBindValue(section);
+        query.addBindValue(slot.dayOfWeek);
+        query.addBindValue(slot.periodNumber);
+        query.addBindValue(slot.startTime);
+        query.addBindValue(slot.durationMinutes);
+        query.addBindValue(slot.subject);
+        query.addBindValue(slot.teacher);
+        query.addBindValue(slot.isBreak);
+        
+        versionQuery.addBindValue(grade);
+        versionQuery.addBindValue(section);
+        versionQuery.addBindValue(version);
+        versionQuery.addBindValue(slot.dayOfWeek);
+        versionQuery.addBindValue(slot.periodNumber);
+        versionQuery.addBindValue(slot.subject);
+        versionQuery.addBindValue(slot.teacher);
+        versionQuery.addBindValue(slot.isBreak);
+        
+        if (!query.exec() || !versionQuery.exec()) {
+            qDebug() << "Failed to save period timetable:" << query.lastError().text() << versionQuery.lastError().text();
+            db.rollback();
+            return false;
+        }
+        stored.append(slot);
+    }
+    
+    db.commit();
+    
+    // Same order as the ORDER BY of getClassTimetable
+    std::sort(stored.begin(), stored.end(), [](const PeriodSlot &a, const PeriodSlot &b) {
+        return a.dayOfWeek != b.dayOfWeek ? a.dayOfWeek < b.dayOfWeek : a.periodNumber < b.periodNumber;
+    });
+    m_timetables.insert(classKey(grade, section), stored);
+    m_timetableVersions.insert(classKey(grade, section), version);
+    emit timetableChanged(grade, section);
+    return true;
+}
+
+QList<PeriodSlot> PeriodAttendance::getClassTimetable(const QString &grade, const QString &section)
+{
+    QString key = classKey(grade, section);
+    auto cached = m_timetables.constFind(key);
+    if (cached != m_timetables.constEnd()) {
+        return cached.value();
+    }
+    
+    QList<PeriodSlot> timetable;
+    QSqlQuery query(Database::instance().database());
+    
+    query.prepare("SELECT * FROM period_timetable WHERE grade = ? AND section = ? "
+                 "ORDER BY day_of_week, period_number");
+    query.addBindValue(grade);
+    query.addBindValue(section);
+    
+    if (!query.exec()) {
+        qDebug() << "Failed to load period timetable:" << query.lastError().text();
+        return timetable;
+    }
+    
+    while (query.next()) {
+        PeriodSlot slot;
+        slot.dayOfWeek = query.value("day_of_week").toInt();
+        slot.periodNumber = query.value("period_number").toInt();
+        slot.startTime = query.value("start_time").toTime();
+        slot.durationMinutes = query.value("duration_minutes").toInt();
+        slot.subject = query.value("subject").toString();
+        slot.teacher = query.value("teacher").toString();
+        slot.isBreak = query.value("is_break").toBool();
+        timetable.append(slot);
+    }
+    
+    m_timetables.insert(key, timetable);
+    return timetable;
+}
+
+int PeriodAttendance::periodAt(const QString &grade, const QString &section, const QDate &date, const QTime &time)
+{
+    for (const PeriodSlot &slot : getClassTimetable(grade, section)) {
+        if (slot.isBreak || slot.dayOfWeek != date.dayOfWeek() || !slot.startTime.isValid()) {
+            continue;
+        }
+        
+        if (time >= slot.startTime && time < slot.startTime.addSecs(slot.durationMinutes * 60)) {
+            return slot.periodNumber;
+        }
+    }
+    
+    return 0;
+}
+
+bool PeriodAttendance::lookupClass(const QString &studentRoll, QString *grade, QString *section)
+{
+    QSqlQuery query(Database::instance().database());
+    
+    query.prepare("SELECT grade, section FROM enhanced_students WHERE roll_number = ?");
+    query.addBindValue(studentRoll);
+    
+    if (!query.exec() || !query.next()) {
+        qDebug() << "Unknown student for period attendance:" << studentRoll;
+        return false;
+    }
+    
+    *grade = query.value("grade").toString();
+    *section = query.value("section").toString();
+    return true;
+}
+
+int PeriodAttendance::timetableVersion(const QString &grade, const QString &section)
+{
+    QString key = classKey(grade, section);
+    auto cached = m_timetableVersions.constFind(key);
+    if (cached != m_timetableVersions.constEnd()) {
+        return cached.value();
+    }
+    
+    QSqlQuery query(Database::instance().database());
+    query.prepare("SELECT COALESCE(MAX(version), 0) FROM period_timetable_versions WHERE grade = ? AND section = ?");
+    query.addBindValue(grade);
+    query.addBindValue(section);
+    
+    if (!query.exec() || !query.next()) {
+        qDebug() << "Failed to load period timetable version:" << query.lastError().text();
+        return 0;
+    }
+    
+    int version = query.value(0).toInt();
+    m_timetableVersions.insert(key, version);
+    return version;
+}
+
+bool PeriodAttendance::markPeriod(const QString &studentRoll, const QDate &date, int period, const QString &status,
+                                  const QString &grade, const QString &section)
+{
+    QHash<QString, QString> statusByRoll;
+    statusByRoll.insert(studentRoll, status);
+    
+    QString studentGrade = grade;
+    QString studentSection = section;
+    if ((studentGrade.isEmpty() || studentSection.isEmpty())
+        && !lookupClass(studentRoll, &studentGrade, &studentSection)) {
+        return false;
+    }
+    
+    return markClassPeriod(studentGrade, studentSection, date, period, statusByRoll);
+}
+
+bool PeriodAttendance::markClassPeriod(const QString &grade, const QString &section, const QDate &date, int period,
+                                       const QHash<QString, QString> &statusByRoll)
+{
+    if (period < 1 || period > MaxPeriods || !date.isValid()) {
+        qDebug() << "Invalid period attendance slot:" << date << period;
+        return false;
+    }
+    
+    const int shift = bitShift(period);
+    const qint64 keepMask = ~(Q_INT64_C(7) << shift);
+    
+    const int version = timetableVersion(grade, section);
+    
+    QSqlDatabase db = Database::instance().database();
+    QSqlQuery query(db);
+    
+    // Rewrites only this period's 3 bits, creating the student-day row if needed;
+    // the row keeps the timetable version it was created under
+    query.prepare("INSERT INTO period_attendance (student_roll, date, day_of_week, grade, section, "
+                 "timetable_version, period_bits) "
+                 "VALUES (?, ?, ?, ?, ?, ?, ?) "
+                 "ON CONFLICT(student_roll, date) DO UPDATE SET "
+                 "period_bits = (period_bits & ?) | ?, updated_at = CURRENT_TIMESTAMP");
+    
+    db.transaction();
+    
+    for (auto it = statusByRoll.constBegin(); it != statusByRoll.constEnd(); ++it) {
+        int code = statusCode(it.value());
+        if (code == Unmarked) {
+            qDebug() << "Invalid period attendance status:" << it.value();
+            db.rollback();
+            return false;
+        }
+        
+        const qint64 bits = static_cast<qint64>(code) << shift;
+        
+        query.addBindValue(it.key());
+        query.addBindValue(date);
+        query.addBindValue(date.dayOfWeek());
+        query.addBindValue(grade);
+        query.addBindValue(section);
+        query.addBindValue(version);
+        query.addBindValue(bits);
+        query.addBindValue(keepMask);
+        query.addBindValue(bits);
+        
+        if (!query.exec()) {
+            qDebug() << "Failed to mark period attendance:" << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+    }
+    
+    db.commit();
+    
+    for (auto it = statusByRoll.constBegin(); it != statusByRoll.constEnd(); ++it) {
+        emit periodMarked(it.key(), date, period, it.value());
+    }
+    
+    return true;
+}
+
+QString PeriodAttendance::getPeriodStatus(const QString &studentRoll, const QDate &date, int period)
+{
+    QSqlQuery query(Database::instance().database());
+    
+    query.prepare("SELECT period_bits FROM period_attendance WHERE student_roll = ? AND date = ?");
+    query.addBindValue(studentRoll);
+    query.addBindValue(date);
+    
+    if (query.exec() && query.next()) {
+        return statusName(periodCode(query.value(0).toLongLong(), period));
+    }
+    
+    return QString();
+}
+
+PeriodAttendanceDay PeriodAttendance::getPeriodAttendance(const QString &studentRoll, const QDate &date)
+{
+    PeriodAttendanceDay day;
+    day.studentRoll = studentRoll;
+    day.date = date;
+    
+    QSqlQuery query(Database::instance().database());
+    
+    query.prepare("SELECT period_bits FROM period_attendance WHERE student_roll = ? AND date = ?");
+    query.addBindValue(studentRoll);
+    query.addBindValue(date);
+    
+    if (query.exec() && query.next()) {
+        qint64 bits = query.value(0).toLongLong();
+        int periodCount = 0;
+        for (int period = MaxPeriods; period > 0 && periodCount == 0; --period) {
+            if (periodCode(bits, period) != Unmarked) {
+                periodCount = period;
+            }
+        }
+        day.statuses = unpackStatuses(bits, periodCount);
+    }
+    
+    return day;
+}
+
+QList<PeriodAttendanceDay> PeriodAttendance::getClassPeriodAttendance(const QString &grade, const QString &section,
+                                                                      const QDate &date)
+{
+    QList<PeriodAttendanceDay> days;
+    
+    // Width of the day comes from the timetable, not from whatever was marked
+    int periodCount = 0;
+    for (const PeriodSlot &slot : getClassTimetable(grade, section)) {
+        if (slot.dayOfWeek == date.dayOfWeek()) {
+            periodCount = qMax(periodCount, slot.periodNumber);
+        }
+    }
+    if (periodCount == 0) {
+        periodCount = MaxPeriods;
+    }
+    
+    QSqlQuery query(Database::instance().database());
+    query.setForwardOnly(true);
+    
+    query.prepare("SELECT student_roll, period_bits FROM period_attendance "
+                 "WHERE grade = ? AND section = ? AND date = ? ORDER BY student_roll");
+    query.addBindValue(grade);
+    query.addBindValue(section);
+    query.addBindValue(date);
+    
+    if (!query.exec()) {
+        qDebug() << "Failed to load class period attendance:" << query.lastError().text();
+        return days;
+    }
+    
+    while (query.next()) {
+        PeriodAttendanceDay day;
+        day.studentRoll = query.value("student_roll").toString();
+        day.date = date;
+        day.statuses = unpackStatuses(query.value("period_bits").toLongLong(), periodCount);
+        days.append(day);
+    }
+    
+    return days;
+}
+
+QList<PeriodAttendanceSummary> PeriodAttendance::getSubjectSummary(const QDate &fromDate, const QDate &toDate,
+                                                                   const QString &grade, const QString &section)
+{
+    return summarize("subject", fromDate, toDate, grade, section);
+}
+
+QList<PeriodAttendanceSummary> PeriodAttendance::getTeacherSummary(const QDate &fromDate, const QDate &toDate,
+                                                                   const QString &grade, const QString &section)
+{
+    return summarize("teacher", fromDate, toDate, grade, section);
+}
+
+QList<PeriodAttendanceSummary> PeriodAttendance::summarize(const QString &groupBy, const QDate &fromDate,
+                                                           const QDate &toDate, const QString &grade,
+                                                           const QString &section)
+{
+    // One grouped query: each student-day row joins the timetable version it
+    // was marked under and SQLite extracts the period's 3-bit code in place
+    QString queryStr = QString(
+        "SELECT pt.%1 AS group_key, "
+        "(pa.period_bits >> ((pt.period_number - 1) * 3)) & 7 AS code, "
+        "COUNT(*) AS count "
+        "FROM period_attendance pa "
+        "JOIN period_timetable_versions pt ON pt.grade = pa.grade AND pt.section = pa.section "
+        "AND pt.version = pa.timetable_version AND pt.day_of_week = pa.day_of_week AND pt.is_break = 0 "
+        "WHERE pa.date BETWEEN ? AND ?").arg(groupBy == "teacher" ? "teacher" : "subject");
+    
+    if (!grade.isEmpty()) {
+        queryStr += " AND pa.grade = ?";
+    }
+    
+    if (!section.isEmpty()) {
+        queryStr += " AND pa.section = ?";
+    }
+    
+    queryStr += " GROUP BY group_key, code";
+    
+    QSqlQuery query(Database::instance().database());
+    query.setForwardOnly(true);
+    query.prepare(queryStr);
+    query.addBindValue(fromDate);
+    query.addBindValue(toDate);
+    if (!grade.isEmpty()) query.addBindValue(grade);
+    if (!section.isEmpty()) query.addBindValue(section);
+    
+    QMap<QString, PeriodAttendanceSummary> summaries;
+    
+    if (!query.exec()) {
+        qDebug() << "Failed to summarize period attendance:" << query.lastError().text();
+        return summaries.values();
+    }
+    
+    while (query.next()) {
+        QString key = query.value("group_key").toString();
+        int count = query.value("count").toInt();
+        
+        PeriodAttendanceSummary &summary = summaries[key];
+        if (groupBy == "teacher") {
+            summary.teacher = key;
+        } else {
+            summary.subject = key;
+        }
+        
+        switch (query.value("code").toInt()) {
+        case PresentCode: summary.presentPeriods += count; break;
+        case AbsentCode: summary.absentPeriods += count; break;
+        case LateCode: summary.latePeriods += count; break;
+        case ExcusedCode: summary.excusedPeriods += count; break;
+        default: break; // Period not marked
+        }
+    }
+    
+    for (PeriodAttendanceSummary &summary : summaries) {
+        summary.totalPeriods = summary.presentPeriods + summary.absentPeriods
+                             + summary.latePeriods + summary.excusedPeriods;
+        summary.attendancePercentage = summary.totalPeriods > 0 ?
+            (double)(summary.presentPeriods + summary.latePeriods + summary.excusedPeriods) / summary.totalPeriods * 100 : 0.0;
+    }
+    
+    return summaries.values();
+}
+
+bool PeriodAttendance::createDatabaseTables()
+{
+    QSqlQuery query(Database::instance().database());
+    
+    // Class timetable mirrored from the scheduler's time slots
+    QString createTimetableTable = R"(
+        CREATE TABLE IF NOT EXISTS period_timetable (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            grade TEXT NOT NULL,
+            section TEXT NOT NULL,
+            day_of_week INTEGER NOT NULL,
+            period_number INTEGER NOT NULL,
+            start_time TIME,
+            duration_minutes INTEGER DEFAULT 45,
+            subject TEXT,
+            teacher TEXT,
+            is_break BOOLEAN DEFAULT 0,
+            UNIQUE(grade, section, day_of_week, period_number)
+        )
+    )";
+    
+    if (!query.exec(createTimetableTable)) {
+        qDebug() << "Failed to create period_timetable table:" << query.lastError().text();
+        return false;
+    }
+    
+    // One row per student-day; 3 bits per period in period_bits
+    QString createPeriodAttendanceTable = R"(
+        CREATE TABLE IF NOT EXISTS period_attendance (
+            id INTEGER PRIMARY KEY AUTOINCREMENT,
+            student_roll TEXT NOT NULL,
+            date DATE NOT NULL,
+            day_of_week INTEGER NOT NULL,
+            grade TEXT NOT NULL,
+            section TEXT NOT NULL,
+            timetable_version INTEGER NOT NULL DEFAULT 0,
+            period_bits INTEGER NOT NULL DEFAULT 0,
+            updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+            UNIQUE(student_roll, date),
+            FOREIGN KEY (student_roll) REFERENCES enhanced_students(roll_number)
+        )
+    )";
+    
+    if (!query.exec(createPeriodAttendanceTable)) {
+        qDebug() << "Failed to create period_attendance table:" << query.lastError().text();
+        return false;
+    }
+    
+    // Tables created before versions existed; fails harmlessly once the column does
+    query.exec("ALTER TABLE period_attendance ADD COLUMN timetable_version INTEGER NOT NULL DEFAULT 0");
+    
+    // Every timetable ever saved, per class; period_timetable holds only the current one
+    QString createVersionsTable = R"(
+        CREATE TABLE IF NOT EXISTS period_timetable_versions (
+            grade TEXT NOT NULL,
+            section TEXT NOT NULL,
+            version INTEGER NOT NULL,
+            day_of_week INTEGER NOT NULL,
+            period_number INTEGER NOT NULL,
+            subject TEXT,
+            teacher TEXT,
+            is_break BOOLEAN DEFAULT 0,
+            PRIMARY KEY (grade, section, version, day_of_week, period_number)
+        )
+    )";
+    
+    if (!query.exec(createVersionsTable)) {
+        qDebug() << "Failed to create period_timetable_versions table:" << query.lastError().text();
+        return false;
+    }
+    
+    // A timetable saved before versions existed becomes version 0, the one older rows carry
+    if (!query.exec(R"(
+        INSERT INTO period_timetable_versions
+            (grade, section, version, day_of_week, period_number, subject, teacher, is_break)
+        SELECT grade, section, 0, day_of_week, period_number, subject, teacher, is_break
+        FROM period_timetable pt
+        WHERE NOT EXISTS (SELECT 1 FROM period_timetable_versions v
+                          WHERE v.grade = pt.grade AND v.section = pt.section)
+    )")) {
+        qDebug() << "Failed to version existing period timetables:" << query.lastError().text();
+        return false;
+    }
+    
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_period_attendance_class_date "
+                    "ON period_attendance (grade, section, date)")) {
+        qDebug() << "Failed to create period_attendance index:" << query.lastError().text();
+        return false;
+    }
+    
+    return true;
+}
@@ -1,4 +1,5 @@
 #include "database/database.h"
+#include "database/dataversions.h"
 #include "models/teacher.h"
 #include "models/student.h"
 #include "models/class.h"
@@ -41,6 +42,14 @@ bool Database::initialize()
         return false;
     }
     
+    // Kept in the file once set: report, journal and template connections
+    // then read a snapshot while this one writes, instead of waiting on it
+    QSqlQuery walQuery(m_database);
+    if (!walQuery.exec("PRAGMA journal_mode=WAL") || !walQuery.next()
+        || walQuery.value(0).toString().compare("wal", Qt::CaseInsensitive) != 0) {
+        qDebug() << "Failed to enable WAL journal mode:" << walQuery.lastError().text();
+    }
+    
     if (!createTables()) {
         qDebug() << "Failed to create tables";
         return false;
@@ -197,7 +206,11 @@ bool Database::addTeacher(const Teacher &teacher)
     query.addBindValue(teacher.getJoinDate());
     query.addBindValue(teacher.isActive());
     
-    return query.exec();
+    if (!query.exec()) {
+        return false;
+    }
+    DataVersions::instance().bump("teachers");
+    return true;
 }
 
 bool Database::updateTeacher(const Teacher &teacher)
@@ -217,7 +230,11 @@ bool Database::updateTeacher(const Teacher &teacher)
     query.addBindValue(teacher.isActive());
     query.addBindValue(teacher.getId());
     
-    return query.exec();
+    if (!query.exec()) {
+        return false;
+    }
+    DataVersions::instance().bump("teachers");
+    return true;
 }
 
 bool Database::deleteTeacher(int teacherId)
@@ -225,7 +242,11 @@ bool Database::deleteTeacher(int teacherId)
     QSqlQuery query;
     query.prepare("DELETE FROM teachers WHERE id = ?");
     query.addBindValue(teacherId);
-    return query.exec();
+    if (!query.exec()) {
+        return false;
+    }
+    DataVersions::instance().bump("teachers");
+    return true;
 }
 
 QList<Teacher> Database::getAllTeachers()
@@ -470,7 +491,11 @@ bool Database::addClass(const Class &classObj)
     query.addBindValue(classObj.getDescription());
     query.addBindValue(classObj.isActive());
     
-    return query.exec();
+    if (!query.exec()) {
+        return false;
+    }
+    DataVersions::instance().bump("classes");
+    return true;
 }
 
 bool Database::updateClass(const Class &classObj)
@@ -488,7 +513,11 @@ bool Database::updateClass(const Class &classObj)
     query.addBindValue(classObj.isActive());
     query.addBindValue(classObj.getId());
     
-    return query.exec();
+    if (!query.exec()) {
+        return false;
+    }
+    DataVersions::instance().bump("classes");
+    return true;
 }
 
 bool Database::deleteClass(int classId)
@@ -496,7 +525,11 @@ bool Database::deleteClass(int classId)
     QSqlQuery query;
     query.prepare("DELETE FROM classes WHERE id = ?");
     query.addBindValue(classId);
-    return query.exec();
+    if (!query.exec()) {
+        return false;
+    }
+    DataVersions::instance().bump("classes");
+    return true;
 }
 
 QList<Class> Database::getAllClasses()
@@ -704,7 +737,11 @@ bool Database::addHoliday(const QDate &date, const QString &description)
     query.prepare("INSERT OR REPLACE INTO holidays (date, description) VALUES (?, ?)");
     query.addBindValue(date);
     query.addBindValue(description);
-    return query.exec();
+    if (!query.exec()) {
+        return false;
+    }
+    DataVersions::instance().bump("holidays");
+    return true;
 }
 
 bool Database::deleteHoliday(const QDate &date)
@@ -712,7 +749,11 @@ bool Database::deleteHoliday(const QDate &date)
     QSqlQuery query;
     query.prepare("DELETE FROM holidays WHERE date = ?");
     query.addBindValue(date);
-    return query.exec();
+    if (!query.exec()) {
+        return false;
+    }
+    DataVersions::instance().bump("holidays");
+    return true;
 }
 
 bool Database::isHoliday(const QDate &date)
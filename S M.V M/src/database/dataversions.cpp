@@ -0,0 +1,28 @@
+#include "database/dataversions.h"
+
+DataVersions &DataVersions::instance()
+{
+    static DataVersions versions;
+    return versions;
+}
+
+DataVersions::DataVersions(QObject *parent)
+    : QObject(parent)
+{
+}
+
+QHash<QString, quint64> DataVersions::versions(const QStringList &tables) const
+{
+    QHash<QString, quint64> result;
+    for (const QString &table : tables) {
+        result.insert(table, version(table));
+    }
+    return result;
+}
+
+void DataVersions::bump(const QString &table)
+{
+    quint64 &version = m_versions[table];
+    ++version;
+    emit tableChanged(table, version);
+}
@@ -0,0 +1,61 @@
+#include "database/readconnectionpool.h"
+#include <QSqlError>
+#include <QAtomicInt>
+#include <QThread>
+#include <QDebug>
+
+namespace {
+
+QAtomicInt nextConnectionId(0);
+
+} // namespace
+
+ReadConnectionPool::ReadConnectionPool(const QString &databasePath, int maxThreads)
+    : m_databasePath(databasePath)
+{
+    m_threads.setMaxThreadCount(maxThreads > 0 ? maxThreads : QThread::idealThreadCount());
+    // Threads never expire, so their connections are reused until the pool goes away
+    m_threads.setExpiryTimeout(-1);
+}
+
+ReadConnectionPool::~ReadConnectionPool()
+{
+    // Joins the threads, which close their connections on their own thread
+    m_threads.waitForDone();
+}
+
+ReadConnectionPool::Connection::~Connection()
+{
+    {
+        QSqlDatabase db = QSqlDatabase::database(name, false);
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(name);
+}
+
+QSqlDatabase ReadConnectionPool::connection()
+{
+    if (m_connections.hasLocalData()) {
+        return QSqlDatabase::database(m_connections.localData()->name, false);
+    }
+
+    QString name = QString("report_read_%1").arg(nextConnectionId.fetchAndAddRelaxed(1));
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+        db.setDatabaseName(m_databasePath);
+        db.setConnectOptions("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=1000");
+
+        if (!db.open()) {
+            qDebug() << "Failed to open read connection:" << db.lastError().text();
+            db = QSqlDatabase();
+            QSqlDatabase::removeDatabase(name);
+            return QSqlDatabase();
+        }
+    }
+
+    Connection *connection = new Connection;
+    connection->name = name;
+    m_connections.setLocalData(connection);
+
+    return QSqlDatabase::database(name, false);
+}
@@ -9,6 +9,7 @@
 #include "dialogs/studentdialog.h"
 #include "dialogs/classdialog.h"
 #include "dialogs/attendancedialog.h"
+#include "attendance/attendanceheatmap.h"
 #include <QApplication>
 #include <QStyle>
 #include <QSettings>
@@ -22,6 +23,7 @@ MainWindow::MainWindow(QWidget *parent)
     , m_adminPanel(new AdminPanel(m_database, this))
     , m_reports(nullptr)
     , m_nepaliCalendar(new NepaliCalendar(this))
+    , m_heatmapMonthIndex(-1)
     , m_isAdmin(false)
     , m_darkMode(false)
     , m_useNepaliCalendar(true)
@@ -406,11 +408,24 @@ void MainWindow::setupCalendarTab()
     m_eventsTable->setHorizontalHeaderLabels({"Date", "Title", "Description"});
     eventsLayout->addWidget(m_eventsTable);
     
+    // Attendance heatmap: one row per class, one column per day of the BS month
+    eventsLayout->addWidget(new QLabel("Attendance Heatmap:"));
+    m_attendanceHeatmapTable = new QTableWidget();
+    m_attendanceHeatmapTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_attendanceHeatmapTable->setSelectionMode(QAbstractItemView::NoSelection);
+    eventsLayout->addWidget(m_attendanceHeatmapTable);
+    
     layout->addLayout(calendarLayout);
     layout->addLayout(eventsLayout);
     
     // Connect signals
     connect(m_calendar, &QCalendarWidget::clicked, this, &MainWindow::onDateSelected);
+    connect(m_calendar, &QCalendarWidget::currentPageChanged, this, &MainWindow::updateAttendanceHeatmap);
+    connect(&AttendanceHeatmap::instance(), &AttendanceHeatmap::tilesChanged, this, [this](int monthIndex) {
+        if (monthIndex == m_heatmapMonthIndex) {
+            updateAttendanceHeatmap();
+        }
+    });
     connect(m_addHolidayBtn, &QPushButton::clicked, this, &MainWindow::addHoliday);
     connect(m_addEventBtn, &QPushButton::clicked, this, &MainWindow::addEvent);
     
@@ -498,6 +513,7 @@ void MainWindow::loadData()
     refreshTeacherTable();
     refreshStudentTable();
     refreshClassTable();
+    updateAttendanceHeatmap();
 }
 
 void MainWindow::saveSettings()
@@ -734,6 +750,61 @@ void MainWindow::onDateSelected(const QDate &date) {
     showNotification("Date selected: " + date.toString("dddd, MMMM dd, yyyy"), "info");
 }
 
+void MainWindow::updateAttendanceHeatmap()
+{
+    // The BS month covering the middle of the AD page being shown
+    QDate anchor(m_calendar->yearShown(), m_calendar->monthShown(), 15);
+    m_heatmapMonthIndex = NepaliCalendar::getNepaliMonthIndex(anchor);
+    
+    m_attendanceHeatmapTable->clear();
+    m_attendanceHeatmapTable->setRowCount(0);
+    m_attendanceHeatmapTable->setColumnCount(0);
+    
+    if (m_heatmapMonthIndex < 0) {
+        return;
+    }
+    
+    // Whole month for every class from one in-memory lookup
+    AttendanceHeatmapMonth month = AttendanceHeatmap::instance().month(m_heatmapMonthIndex);
+    
+    QStringList dayLabels;
+    for (int day = 1; day <= month.dayCount; ++day) {
+        dayLabels.append(QString::number(day));
+    }
+    QStringList classLabels;
+    for (const QString &key : month.classes) {
+        classLabels.append(AttendanceHeatmap::className(key));
+    }
+    
+    m_attendanceHeatmapTable->setRowCount(month.classes.size());
+    m_attendanceHeatmapTable->setColumnCount(month.dayCount);
+    m_attendanceHeatmapTable->setHorizontalHeaderLabels(dayLabels);
+    m_attendanceHeatmapTable->setVerticalHeaderLabels(classLabels);
+    
+    for (int row = 0; row < month.classes.size(); ++row) {
+        const QVector<AttendanceHeatmapTile> tiles = month.tiles.value(month.classes.at(row));
+        for (int day = 0; day < tiles.size(); ++day) {
+            const AttendanceHeatmapTile &tile = tiles.at(day);
+            double rate = tile.rate();
+            if (rate < 0) {
+                continue;
+            }
+            
+            QTableWidgetItem *item = new QTableWidgetItem(QString::number(qRound(rate * 100)));
+            item->setTextAlignment(Qt::AlignCenter);
+            // Red (0%) through yellow to green (100%)
+            item->setBackground(QColor::fromHsv(qRound(rate * 120), 170, 235));
+            item->setToolTip(QString("%1, %2\nPresent: %3  Late: %4  Absent: %5  Excused: %6")
+                            .arg(classLabels.at(row))
+                            .arg(month.startDate.addDays(day).toString("yyyy-MM-dd"))
+                            .arg(tile.present).arg(tile.late).arg(tile.absent).arg(tile.excused));
+            m_attendanceHeatmapTable->setItem(row, day, item);
+        }
+    }
+    
+    m_attendanceHeatmapTable->resizeColumnsToContents();
+}
+
 void MainWindow::addHoliday() {
     showNotification("Add holiday functionality", "info");
 }
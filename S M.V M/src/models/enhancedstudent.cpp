@@ -1,5 +1,6 @@
 #include "models/enhancedstudent.h"
 #include "database/database.h"
+#include "database/dataversions.h"
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QDebug>
@@ -47,6 +48,7 @@ bool EnhancedStudent::addStudent(const StudentData &student)
         return false;
     }
     
+    DataVersions::instance().bump("enhanced_students");
     return true;
 }
 
@@ -83,6 +85,7 @@ bool EnhancedStudent::updateStudent(const StudentData &student)
         return false;
     }
     
+    DataVersions::instance().bump("enhanced_students");
     return true;
 }
 
@@ -98,6 +101,7 @@ bool EnhancedStudent::deleteStudent(const QString &rollNumber)
         return false;
     }
     
+    DataVersions::instance().bump("enhanced_students");
     return true;
 }
 
@@ -328,6 +332,7 @@ bool EnhancedStudent::addFeeTransaction(const FeeTransaction &transaction)
         return false;
     }
     
+    DataVersions::instance().bump("fee_transactions");
     return true;
 }
 
@@ -380,6 +385,7 @@ bool EnhancedStudent::addExamResult(const ExamResult &result)
         return false;
     }
     
+    DataVersions::instance().bump("exam_results");
     return true;
 }
 
@@ -358,6 +358,52 @@ QDate NepaliCalendar::getNepaliNewYearDate(int bsYear)
     return bsToAd(bsYear, 1, 1);
 }
 
+int NepaliCalendar::getNepaliMonthIndex(const QDate &adDate)
+{
+    if (!adDate.isValid()) {
+        return -1;
+    }
+    
+    // Walk the table directly; adToBs() cannot return day 32 as a QDate
+    QDate baseDate(1943, 4, 13);
+    int totalDays = baseDate.daysTo(adDate);
+    if (totalDays < 0) {
+        return -1;
+    }
+    
+    int bsYear = 2000;
+    while (isValidNepaliYear(bsYear) && totalDays >= getTotalDaysInNepaliYear(bsYear)) {
+        totalDays -= getTotalDaysInNepaliYear(bsYear);
+        bsYear++;
+    }
+    
+    if (!isValidNepaliYear(bsYear)) {
+        return -1;
+    }
+    
+    int bsMonth = 1;
+    while (bsMonth < 12 && totalDays >= getDaysInNepaliMonth(bsYear, bsMonth)) {
+        totalDays -= getDaysInNepaliMonth(bsYear, bsMonth);
+        bsMonth++;
+    }
+    
+    return bsYear * 12 + (bsMonth - 1);
+}
+
+QDate NepaliCalendar::getNepaliMonthStart(int monthIndex)
+{
+    if (monthIndex < 0) return QDate();
+    return bsToAd(monthIndex / 12, monthIndex % 12 + 1, 1);
+}
+
+QDate NepaliCalendar::getNepaliMonthEnd(int monthIndex)
+{
+    if (monthIndex < 0) return QDate();
+    int bsYear = monthIndex / 12;
+    int bsMonth = monthIndex % 12 + 1;
+    return bsToAd(bsYear, bsMonth, getDaysInNepaliMonth(bsYear, bsMonth));
+}
+
 bool NepaliCalendar::isValidNepaliDate(int year, int month, int day)
 {
     if (!isValidNepaliYear(year) || !isValidNepaliMonth(month) || !isValidNepaliDay(day)) {
@@ -1,5 +1,17 @@
 #include "reports/advancedreports.h"
+#include "reports/reportcache.h"
+#include "reports/reportexecutor.h"
+#include "reports/pdfreportrenderer.h"
+#include "reports/reporttemplateengine.h"
+#include "reports/reportcardgenerator.h"
+#include "reports/reportcodec.h"
+#include "reports/rankingengine.h"
+#include "reports/analyticscube.h"
+#include "reports/markstatistics.h"
 #include "database/database.h"
+#include "attendance/attendancerollups.h"
+#include "models/nepalicalendar.h"
+#include "utils/xlsxwriter.h"
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QDebug>
@@ -8,26 +20,30 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QVector>
+#include <QMap>
+#include <QHash>
+#include <cmath>
+#include <algorithm>
 
-AdvancedReports::AdvancedReports(QObject *parent)
-    : QObject(parent)
-{
-}
+namespace {
 
-AdvancedReports::~AdvancedReports()
+// SQLITE_BUSY and SQLITE_LOCKED get a message of their own: the report is
+// missing because another connection held a lock, not because it is empty
+QString queryError(const QSqlError &error)
 {
+    if (error.nativeErrorCode() == "5" || error.nativeErrorCode() == "6") {
+        return "The database is busy; try again in a moment";
+    }
+    return error.text();
 }
 
-ReportData AdvancedReports::generateAttendanceReport(const QDate &fromDate, const QDate &toDate,
-                                                    const QString &grade, const QString &section)
+// One row per student of the attendance report, in ORDER BY grade, section, name
+bool queryAttendanceRows(QSqlDatabase db, const QDate &fromDate, const QDate &toDate,
+                         const QString &grade, const QString &section, QJsonArray *rows, QString *error)
 {
-    ReportData report;
-    report.reportType = "Attendance Report";
-    report.generatedDate = QDateTime::currentDateTime();
-    report.dateRange = QString("%1 to %2").arg(fromDate.toString("dd/MM/yyyy"))
-                                         .arg(toDate.toString("dd/MM/yyyy"));
-    
-    QSqlQuery query(Database::instance().database());
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
     
     QString queryStr = R"(
         SELECT es.roll_number, es.name, es.grade, es.section,
@@ -57,62 +73,52 @@ ReportData AdvancedReports::generateAttendanceReport(const QDate &fromDate, cons
     if (!grade.isEmpty()) query.addBindValue(grade);
     if (!section.isEmpty()) query.addBindValue(section);
     
-    QJsonArray studentsArray;
-    int totalStudents = 0;
-    double totalAttendancePercentage = 0.0;
-    
-    if (query.exec()) {
-        while (query.next()) {
-            QJsonObject studentObj;
-            studentObj["roll_number"] = query.value("roll_number").toString();
-            studentObj["name"] = query.value("name").toString();
-            studentObj["grade"] = query.value("grade").toString();
-            studentObj["section"] = query.value("section").toString();
-            
-            int presentDays = query.value("present_days").toInt();
-            int absentDays = query.value("absent_days").toInt();
-            int lateDays = query.value("late_days").toInt();
-            int excusedDays = query.value("excused_days").toInt();
-            int totalDays = query.value("total_days").toInt();
-            
-            studentObj["present_days"] = presentDays;
-            studentObj["absent_days"] = absentDays;
-            studentObj["late_days"] = lateDays;
-            studentObj["excused_days"] = excusedDays;
-            studentObj["total_days"] = totalDays;
-            
-            double percentage = totalDays > 0 ? 
-                (double)(presentDays + lateDays + excusedDays) / totalDays * 100 : 0.0;
-            studentObj["attendance_percentage"] = percentage;
-            
-            studentsArray.append(studentObj);
-            totalStudents++;
-            totalAttendancePercentage += percentage;
-        }
+    if (!query.exec()) {
+        qDebug() << "Failed to generate attendance report:" << query.lastError().text();
+        *error = queryError(query.lastError());
+        return false;
     }
     
-    QJsonObject summaryObj;
-    summaryObj["total_students"] = totalStudents;
-    summaryObj["average_attendance"] = totalStudents > 0 ? totalAttendancePercentage / totalStudents : 0.0;
-    
-    QJsonObject reportObj;
-    reportObj["summary"] = summaryObj;
-    reportObj["students"] = studentsArray;
-    
-    report.jsonData = QJsonDocument(reportObj);
+    while (query.next()) {
+        QJsonObject studentObj;
+        studentObj["roll_number"] = query.value("roll_number").toString();
+        studentObj["name"] = query.value("name").toString();
+        studentObj["grade"] = query.value("grade").toString();
+        studentObj["section"] = query.value("section").toString();
+        
+        int presentDays = query.value("present_days").toInt();
+        int absentDays = query.value("absent_days").toInt();
+        int lateDays = query.value("late_days").toInt();
+        int excusedDays = query.value("excused_days").toInt();
+        int totalDays = query.value("total_days").toInt();
+        
+        studentObj["present_days"] = presentDays;
+        studentObj["absent_days"] = absentDays;
+        studentObj["late_days"] = lateDays;
+        studentObj["excused_days"] = excusedDays;
+        studentObj["total_days"] = totalDays;
+        
+        double percentage = totalDays > 0 ? 
+            (double)(presentDays + lateDays + excusedDays) / totalDays * 100 : 0.0;
+        studentObj["attendance_percentage"] = percentage;
+        
+        rows->append(studentObj);
+    }
     
-    return report;
+    // A lock can also fail a later step
+    if (query.lastError().isValid()) {
+        *error = queryError(query.lastError());
+        return false;
+    }
+    return true;
 }
 
-ReportData AdvancedReports::generateAcademicReport(const QString &examName, const QString &grade,
-                                                  const QString &section)
+// One object per student with their subject results for the exam, by roll number
+bool queryAcademicStudents(QSqlDatabase db, const QString &examName, const QString &grade,
+                           const QString &section, QJsonArray *students, QString *error)
 {
-    ReportData report;
-    report.reportType = "Academic Performance Report";
-    report.generatedDate = QDateTime::currentDateTime();
-    report.parameters = QString("Exam: %1, Grade: %2, Section: %3").arg(examName).arg(grade).arg(section);
-    
-    QSqlQuery query(Database::instance().database());
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
     
     QString queryStr = R"(
         SELECT es.roll_number, es.name, es.grade, es.section,
@@ -137,40 +143,84 @@ ReportData AdvancedReports::generateAcademicReport(const QString &examName, cons
     if (!grade.isEmpty()) query.addBindValue(grade);
     if (!section.isEmpty()) query.addBindValue(section);
     
-    QJsonArray studentsArray;
+    if (!query.exec()) {
+        qDebug() << "Failed to generate academic report:" << query.lastError().text();
+        *error = queryError(query.lastError());
+        return false;
+    }
+    
     QMap<QString, QJsonObject> studentMap;
     
-    if (query.exec()) {
-        while (query.next()) {
-            QString rollNumber = query.value("roll_number").toString();
-            
-            if (!studentMap.contains(rollNumber)) {
-                QJsonObject studentObj;
-                studentObj["roll_number"] = rollNumber;
-                studentObj["name"] = query.value("name").toString();
-                studentObj["grade"] = query.value("grade").toString();
-                studentObj["section"] = query.value("section").toString();
-                studentObj["subjects"] = QJsonArray();
-                studentMap[rollNumber] = studentObj;
-            }
-            
-            QJsonObject &studentObj = studentMap[rollNumber];
-            QJsonArray subjectsArray = studentObj["subjects"].toArray();
-            
-            QJsonObject subjectObj;
-            subjectObj["subject"] = query.value("subject").toString();
-            subjectObj["marks_obtained"] = query.value("marks_obtained").toDouble();
-            subjectObj["total_marks"] = query.value("total_marks").toDouble();
-            subjectObj["percentage"] = query.value("percentage").toDouble();
-            subjectObj["grade"] = query.value("exam_grade").toString();
-            
-            subjectsArray.append(subjectObj);
-            studentObj["subjects"] = subjectsArray;
+    while (query.next()) {
+        QString rollNumber = query.value("roll_number").toString();
+        
+        if (!studentMap.contains(rollNumber)) {
+            QJsonObject studentObj;
+            studentObj["roll_number"] = rollNumber;
+            studentObj["name"] = query.value("name").toString();
+            studentObj["grade"] = query.value("grade").toString();
+            studentObj["section"] = query.value("section").toString();
+            studentObj["subjects"] = QJsonArray();
             studentMap[rollNumber] = studentObj;
         }
+        
+        QJsonObject &studentObj = studentMap[rollNumber];
+        QJsonArray subjectsArray = studentObj["subjects"].toArray();
+        
+        QJsonObject subjectObj;
+        subjectObj["subject"] = query.value("subject").toString();
+        subjectObj["marks_obtained"] = query.value("marks_obtained").toDouble();
+        subjectObj["total_marks"] = query.value("total_marks").toDouble();
+        subjectObj["percentage"] = query.value("percentage").toDouble();
+        subjectObj["grade"] = query.value("exam_grade").toString();
+        
+        subjectsArray.append(subjectObj);
+        studentObj["subjects"] = subjectsArray;
+    }
+    
+    if (query.lastError().isValid()) {
+        *error = queryError(query.lastError());
+        return false;
+    }
+    
+    for (auto it = studentMap.begin(); it != studentMap.end(); ++it) {
+        students->append(it.value());
+    }
+    
+    return true;
+}
+
+// Summary plus the student rows, as stored in an attendance report's JSON
+QJsonObject attendanceReportData(const QJsonArray &students)
+{
+    int totalStudents = students.size();
+    double totalAttendancePercentage = 0.0;
+    for (const QJsonValue &student : students) {
+        totalAttendancePercentage += student.toObject()["attendance_percentage"].toDouble();
+    }
+    
+    QJsonObject summaryObj;
+    summaryObj["total_students"] = totalStudents;
+    summaryObj["average_attendance"] = totalStudents > 0 ? totalAttendancePercentage / totalStudents : 0.0;
+    
+    QJsonObject reportObj;
+    reportObj["summary"] = summaryObj;
+    reportObj["students"] = students;
+    return reportObj;
+}
+
+QJsonObject academicReportData(const QString &examName, const QVector<QJsonArray> &results)
+{
+    // Students are listed by roll number across all partitions
+    QMap<QString, QJsonObject> studentMap;
+    for (const QJsonArray &students : results) {
+        for (const QJsonValue &student : students) {
+            QJsonObject studentObj = student.toObject();
+            studentMap[studentObj["roll_number"].toString()] = studentObj;
+        }
     }
     
-    // Convert map to array
+    QJsonArray studentsArray;
     for (auto it = studentMap.begin(); it != studentMap.end(); ++it) {
         studentsArray.append(it.value());
     }
@@ -178,21 +228,13 @@ ReportData AdvancedReports::generateAcademicReport(const QString &examName, cons
     QJsonObject reportObj;
     reportObj["exam_name"] = examName;
     reportObj["students"] = studentsArray;
-    
-    report.jsonData = QJsonDocument(reportObj);
-    
-    return report;
+    return reportObj;
 }
 
-ReportData AdvancedReports::generateFinancialReport(const QDate &fromDate, const QDate &toDate)
+bool queryFinancialData(QSqlDatabase db, const QDate &fromDate, const QDate &toDate,
+                        QJsonObject *reportObj, QString *error)
 {
-    ReportData report;
-    report.reportType = "Financial Report";
-    report.generatedDate = QDateTime::currentDateTime();
-    report.dateRange = QString("%1 to %2").arg(fromDate.toString("dd/MM/yyyy"))
-                                         .arg(toDate.toString("dd/MM/yyyy"));
-    
-    QSqlQuery query(Database::instance().database());
+    QSqlQuery query(db);
     
     // Get fee collection summary
     query.prepare(R"(
@@ -211,19 +253,26 @@ ReportData AdvancedReports::generateFinancialReport(const QDate &fromDate, const
     QJsonArray collectionsArray;
     double totalRevenue = 0.0;
     
-    if (query.exec()) {
-        while (query.next()) {
-            QJsonObject collectionObj;
-            collectionObj["fee_type"] = query.value("fee_type").toString();
-            collectionObj["payment_method"] = query.value("payment_method").toString();
-            collectionObj["transaction_count"] = query.value("transaction_count").toInt();
-            
-            double amount = query.value("total_amount").toDouble();
-            collectionObj["total_amount"] = amount;
-            totalRevenue += amount;
-            
-            collectionsArray.append(collectionObj);
-        }
+    if (!query.exec()) {
+        qDebug() << "Failed to load fee collections:" << query.lastError().text();
+        *error = queryError(query.lastError());
+        return false;
+    }
+    while (query.next()) {
+        QJsonObject collectionObj;
+        collectionObj["fee_type"] = query.value("fee_type").toString();
+        collectionObj["payment_method"] = query.value("payment_method").toString();
+        collectionObj["transaction_count"] = query.value("transaction_count").toInt();
+        
+        double amount = query.value("total_amount").toDouble();
+        collectionObj["total_amount"] = amount;
+        totalRevenue += amount;
+        
+        collectionsArray.append(collectionObj);
+    }
+    if (query.lastError().isValid()) {
+        *error = queryError(query.lastError());
+        return false;
     }
     
     // Get outstanding fees
@@ -240,19 +289,26 @@ ReportData AdvancedReports::generateFinancialReport(const QDate &fromDate, const
     QJsonArray outstandingArray;
     double totalOutstanding = 0.0;
     
-    if (query.exec()) {
-        while (query.next()) {
-            QJsonObject outstandingObj;
-            outstandingObj["grade"] = query.value("grade").toString();
-            outstandingObj["section"] = query.value("section").toString();
-            outstandingObj["student_count"] = query.value("student_count").toInt();
-            
-            double amount = query.value("outstanding_amount").toDouble();
-            outstandingObj["outstanding_amount"] = amount;
-            totalOutstanding += amount;
-            
-            outstandingArray.append(outstandingObj);
-        }
+    if (!query.exec()) {
+        qDebug() << "Failed to load outstanding fees:" << query.lastError().text();
+        *error = queryError(query.lastError());
+        return false;
+    }
+    while (query.next()) {
+        QJsonObject outstandingObj;
+        outstandingObj["grade"] = query.value("grade").toString();
+        outstandingObj["section"] = query.value("section").toString();
+        outstandingObj["student_count"] = query.value("student_count").toInt();
+        
+        double amount = query.value("outstanding_amount").toDouble();
+        outstandingObj["outstanding_amount"] = amount;
+        totalOutstanding += amount;
+        
+        outstandingArray.append(outstandingObj);
+    }
+    if (query.lastError().isValid()) {
+        *error = queryError(query.lastError());
+        return false;
     }
     
     QJsonObject summaryObj;
@@ -260,12 +316,605 @@ ReportData AdvancedReports::generateFinancialReport(const QDate &fromDate, const
     summaryObj["total_outstanding"] = totalOutstanding;
     summaryObj["net_revenue"] = totalRevenue - totalOutstanding;
     
+    (*reportObj)["summary"] = summaryObj;
+    (*reportObj)["collections"] = collectionsArray;
+    (*reportObj)["outstanding"] = outstandingArray;
+    return true;
+}
+
+QString jsonText(const QJsonValue &value)
+{
+    if (value.isDouble()) {
+        double number = value.toDouble();
+        return number == std::floor(number) ? QString::number(static_cast<qint64>(number)) : QString::number(number, 'f', 2);
+    }
+    if (value.isBool()) {
+        return value.toBool() ? "Yes" : "No";
+    }
+    return value.toString();
+}
+
+// "average_attendance" -> "Average Attendance"
+QString displayName(const QString &key)
+{
+    QStringList words = key.split('_', Qt::SkipEmptyParts);
+    for (QString &word : words) {
+        word[0] = word.at(0).toUpper();
+    }
+    return words.join(' ');
+}
+
+// Scalars become fields, objects a heading with fields, and arrays of
+// objects a table of their scalar members
+void addJsonSection(PdfReportRenderer &pdf, const QString &key, const QJsonValue &value)
+{
+    if (value.isObject()) {
+        pdf.addHeading(displayName(key));
+        QJsonObject object = value.toObject();
+        for (auto it = object.begin(); it != object.end(); ++it) {
+            if (!it.value().isArray() && !it.value().isObject()) {
+                pdf.addField(displayName(it.key()), jsonText(it.value()));
+            }
+        }
+    } else if (value.isArray()) {
+        QJsonArray array = value.toArray();
+        pdf.addHeading(displayName(key));
+        if (array.isEmpty() || !array.first().isObject()) {
+            pdf.addParagraph(array.isEmpty() ? "No records." : QString::fromUtf8(QJsonDocument(array).toJson(QJsonDocument::Compact)));
+            return;
+        }
+
+        QStringList keys;
+        QJsonObject first = array.first().toObject();
+        for (auto it = first.begin(); it != first.end(); ++it) {
+            if (!it.value().isArray() && !it.value().isObject()) {
+                keys.append(it.key());
+            }
+        }
+
+        QStringList columns;
+        for (const QString &column : keys) {
+            columns.append(displayName(column));
+        }
+        QList<QStringList> rows;
+        rows.reserve(array.size());
+        for (const QJsonValue &item : array) {
+            QJsonObject object = item.toObject();
+            QStringList row;
+            for (const QString &column : keys) {
+                row.append(jsonText(object.value(column)));
+            }
+            rows.append(row);
+        }
+        pdf.addTable(columns, rows);
+    } else {
+        pdf.addField(displayName(key), jsonText(value));
+    }
+}
+
+ReportTemplate readTemplate(const QSqlQuery &query)
+{
+    ReportTemplate temp;
+    temp.id = query.value("id").toInt();
+    temp.name = query.value("name").toString();
+    temp.description = query.value("description").toString();
+    temp.category = query.value("category").toString();
+    for (const QString &parameter : query.value("parameters").toString().split(",")) {
+        if (!parameter.trimmed().isEmpty()) {
+            temp.parameters.append(parameter.trimmed());
+        }
+    }
+    temp.sqlQuery = query.value("sql_query").toString();
+    temp.outputFormat = query.value("output_format").toString();
+    temp.createdBy = query.value("created_by").toString();
+    temp.createdAt = query.value("created_at").toDateTime();
+    return temp;
+}
+
+// Flat fields, so exports show them as table columns
+void addMarkSummary(QJsonObject *object, const MarkSummary &summary)
+{
+    (*object)["result_count"] = summary.count;
+    (*object)["mean"] = summary.mean;
+    (*object)["std_dev"] = summary.standardDeviation;
+    (*object)["skewness"] = summary.skewness;
+    (*object)["min"] = summary.minimum;
+    (*object)["q1"] = summary.q1;
+    (*object)["median"] = summary.median;
+    (*object)["q3"] = summary.q3;
+    (*object)["max"] = summary.maximum;
+}
+
+enum ComparedPeriod { PreviousPeriod = 0, CurrentPeriod = 1 };
+
+// Attendance and exam moments of one student, class or subject in one period
+struct PeriodStats {
+    qint64 attended = 0;                 // Present, late or excused
+    qint64 marked = 0;
+    qint64 results = 0;
+    double percentageSum = 0.0;          // Over exam results, each as a percentage
+    double percentageSquares = 0.0;
+
+    void add(const PeriodStats &other)
+    {
+        attended += other.attended;
+        marked += other.marked;
+        results += other.results;
+        percentageSum += other.percentageSum;
+        percentageSquares += other.percentageSquares;
+    }
+    double attendanceRate() const { return marked > 0 ? 100.0 * attended / marked : -1.0; }
+    double averagePercentage() const { return results > 0 ? percentageSum / results : -1.0; }
+    double variance() const
+    {
+        if (results < 2) {
+            return 0.0;
+        }
+        double mean = percentageSum / results;
+        return qMax(0.0, (percentageSquares - results * mean * mean) / (results - 1));
+    }
+};
+
+struct PeriodPair {
+    PeriodStats periods[2];              // Indexed by ComparedPeriod
+
+    void add(const PeriodPair &other)
+    {
+        periods[PreviousPeriod].add(other.periods[PreviousPeriod]);
+        periods[CurrentPeriod].add(other.periods[CurrentPeriod]);
+    }
+};
+
+struct ComparedStudent {
+    QString name;
+    QString grade;
+    QString section;
+};
+
+// Two-proportion z statistic of attended over marked days, current minus previous
+double attendanceScore(const PeriodPair &pair)
+{
+    const PeriodStats &before = pair.periods[PreviousPeriod];
+    const PeriodStats &after = pair.periods[CurrentPeriod];
+    if (before.marked == 0 || after.marked == 0) {
+        return 0.0;
+    }
+    double pooled = double(before.attended + after.attended) / (before.marked + after.marked);
+    double error = std::sqrt(pooled * (1.0 - pooled) * (1.0 / before.marked + 1.0 / after.marked));
+    double difference = double(after.attended) / after.marked - double(before.attended) / before.marked;
+    return error > 0 ? difference / error : 0.0;
+}
+
+// Welch's t of the per-result percentages, read against a normal cut-off
+double marksScore(const PeriodPair &pair)
+{
+    const PeriodStats &before = pair.periods[PreviousPeriod];
+    const PeriodStats &after = pair.periods[CurrentPeriod];
+    if (before.results < 2 || after.results < 2) {
+        return 0.0;
+    }
+    double error = std::sqrt(before.variance() / before.results + after.variance() / after.results);
+    double difference = after.averagePercentage() - before.averagePercentage();
+    // Identical results in both periods give no spread to judge a change against
+    return error > 0 ? difference / error : 0.0;
+}
+
+// <measure>_previous, _current, _change (null where a period has no data) and _flag
+void addComparison(QJsonObject *object, const QString &measure, double previous, double current,
+                   double score, double critical)
+{
+    (*object)[measure + "_previous"] = previous >= 0 ? QJsonValue(previous) : QJsonValue();
+    (*object)[measure + "_current"] = current >= 0 ? QJsonValue(current) : QJsonValue();
+    (*object)[measure + "_change"] = previous >= 0 && current >= 0 ? QJsonValue(current - previous) : QJsonValue();
+    (*object)[measure + "_flag"] = score >= critical ? "improved" : score <= -critical ? "declined" : "";
+}
+
+void addAttendanceComparison(QJsonObject *object, const PeriodPair &pair, double critical)
+{
+    addComparison(object, "attendance", pair.periods[PreviousPeriod].attendanceRate(),
+                  pair.periods[CurrentPeriod].attendanceRate(), attendanceScore(pair), critical);
+}
+
+void addMarksComparison(QJsonObject *object, const PeriodPair &pair, double critical)
+{
+    addComparison(object, "marks", pair.periods[PreviousPeriod].averagePercentage(),
+                  pair.periods[CurrentPeriod].averagePercentage(), marksScore(pair), critical);
+}
+
+bool gradeLessThan(const QString &a, const QString &b)
+{
+    return a.toInt() != b.toInt() ? a.toInt() < b.toInt() : a < b;
+}
+
+// Tables of a Period Comparison report, with their columns in display order
+struct ComparisonTable {
+    QString key;
+    QString title;
+    QStringList columns;
+};
+
+QList<ComparisonTable> comparisonTables()
+{
+    const QStringList attendance = {"attendance_previous", "attendance_current", "attendance_change", "attendance_flag"};
+    const QStringList marks = {"marks_previous", "marks_current", "marks_change", "marks_flag"};
+    return {
+        {"students", "Students", QStringList{"roll_number", "name", "grade", "section"} + attendance + marks},
+        {"classes", "Classes", QStringList{"grade", "section", "students"} + attendance + marks},
+        {"subjects", "Subjects", QStringList{"subject", "results_previous", "results_current"} + marks}
+    };
+}
+
+QString csvField(const QString &field)
+{
+    if (field.contains(',') || field.contains('"') || field.contains('\n')) {
+        return '"' + QString(field).replace("\"", "\"\"") + '"';
+    }
+    return field;
+}
+
+bool addComparisonSheets(XlsxWriter &xlsx, const QJsonObject &rootObj)
+{
+    for (const ComparisonTable &table : comparisonTables()) {
+        QVariantList header;
+        for (const QString &column : table.columns) {
+            header.append(displayName(column));
+        }
+        if (!xlsx.beginSheet(table.title) || !xlsx.addRow(header, XlsxWriter::Header)) {
+            return false;
+        }
+        
+        for (const QJsonValue &item : rootObj[table.key].toArray()) {
+            QJsonObject object = item.toObject();
+            QList<XlsxCell> cells;
+            for (const QString &column : table.columns) {
+                QJsonValue value = object.value(column);
+                if (value.isDouble()) {
+                    bool count = column == "students" || column.startsWith("results_");
+                    cells.append(XlsxCell(value.toDouble(), count ? XlsxWriter::Integer : XlsxWriter::Decimal));
+                } else if (value.isNull() || value.isUndefined()) {
+                    cells.append(XlsxCell());
+                } else {
+                    cells.append(XlsxCell(value.toString()));
+                }
+            }
+            if (!xlsx.addRow(cells)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Numbers keep a numeric cell, whole ones as integers
+XlsxCell jsonCell(const QJsonValue &value)
+{
+    if (value.isDouble()) {
+        double number = value.toDouble();
+        return XlsxCell(number, number == std::floor(number) ? XlsxWriter::Integer : XlsxWriter::Decimal);
+    }
+    if (value.isNull() || value.isUndefined()) {
+        return XlsxCell();
+    }
+    return XlsxCell(jsonText(value));
+}
+
+bool addFinancialSheets(XlsxWriter &xlsx, const QJsonObject &rootObj)
+{
+    QJsonObject summary = rootObj["summary"].toObject();
+    bool ok = xlsx.beginSheet("Summary", 1, {22, 16})
+        && xlsx.addRow({"Measure", "Amount"}, XlsxWriter::Header)
+        && xlsx.addRow({XlsxCell("Total Revenue"), XlsxCell(summary["total_revenue"].toDouble(), XlsxWriter::Decimal)})
+        && xlsx.addRow({XlsxCell("Total Outstanding"), XlsxCell(summary["total_outstanding"].toDouble(), XlsxWriter::Decimal)})
+        && xlsx.addRow({XlsxCell("Net Revenue"), XlsxCell(summary["net_revenue"].toDouble(), XlsxWriter::Decimal)});
+    
+    QJsonArray collections = rootObj["collections"].toArray();
+    ok = ok && xlsx.beginSheet("Collections", 1, {20, 18, 14, 16})
+        && xlsx.addRow({"Fee Type", "Payment Method", "Transactions", "Total Amount"}, XlsxWriter::Header);
+    for (int i = 0; ok && i < collections.size(); ++i) {
+        QJsonObject collection = collections.at(i).toObject();
+        ok = xlsx.addRow({XlsxCell(collection["fee_type"].toString()),
+                          XlsxCell(collection["payment_method"].toString()),
+                          XlsxCell(collection["transaction_count"].toInt(), XlsxWriter::Integer),
+                          XlsxCell(collection["total_amount"].toDouble(), XlsxWriter::Decimal)});
+    }
+    if (ok && !collections.isEmpty()) {
+        int lastRow = xlsx.rowCount();
+        ok = xlsx.addRow({XlsxCell("Total", XlsxWriter::Header), XlsxCell(),
+                          XlsxCell::fromFormula(QString("SUM(C2:C%1)").arg(lastRow), XlsxWriter::Integer),
+                          XlsxCell::fromFormula(QString("SUM(D2:D%1)").arg(lastRow), XlsxWriter::Decimal)});
+    }
+    
+    QJsonArray outstanding = rootObj["outstanding"].toArray();
+    ok = ok && xlsx.beginSheet("Outstanding", 1, {8, 8, 10, 20})
+        && xlsx.addRow({"Grade", "Section", "Students", "Outstanding Amount"}, XlsxWriter::Header);
+    for (int i = 0; ok && i < outstanding.size(); ++i) {
+        QJsonObject row = outstanding.at(i).toObject();
+        ok = xlsx.addRow({XlsxCell(row["grade"].toString()),
+                          XlsxCell(row["section"].toString()),
+                          XlsxCell(row["student_count"].toInt(), XlsxWriter::Integer),
+                          XlsxCell(row["outstanding_amount"].toDouble(), XlsxWriter::Decimal)});
+    }
+    if (ok && !outstanding.isEmpty()) {
+        int lastRow = xlsx.rowCount();
+        ok = xlsx.addRow({XlsxCell("Total", XlsxWriter::Header), XlsxCell(),
+                          XlsxCell::fromFormula(QString("SUM(C2:C%1)").arg(lastRow), XlsxWriter::Integer),
+                          XlsxCell::fromFormula(QString("SUM(D2:D%1)").arg(lastRow), XlsxWriter::Decimal)});
+    }
+    return ok;
+}
+
+// Any other report, laid out as addJsonSection does for PDF: scalars and
+// the scalars of nested objects on a summary sheet, and each array of
+// objects on a sheet of its own with a column per scalar member
+bool addJsonSheets(XlsxWriter &xlsx, const ReportData &report)
+{
+    QJsonObject rootObj = report.jsonData.object();
+    bool ok = xlsx.beginSheet("Summary", 1, {24, 40})
+        && xlsx.addRow({"Field", "Value"}, XlsxWriter::Header)
+        && xlsx.addRow({XlsxCell("Report Type"), XlsxCell(report.reportType)})
+        && xlsx.addRow({XlsxCell("Generated"), XlsxCell(report.generatedDate.toString("yyyy-MM-dd hh:mm"))});
+    if (ok && !report.dateRange.isEmpty()) {
+        ok = xlsx.addRow({XlsxCell("Date Range"), XlsxCell(report.dateRange)});
+    }
+    if (ok && !report.parameters.isEmpty()) {
+        ok = xlsx.addRow({XlsxCell("Parameters"), XlsxCell(report.parameters)});
+    }
+    
+    QStringList tables;
+    for (auto it = rootObj.begin(); ok && it != rootObj.end(); ++it) {
+        if (it.value().isArray()) {
+            tables.append(it.key());
+        } else if (it.value().isObject()) {
+            QJsonObject object = it.value().toObject();
+            for (auto field = object.begin(); ok && field != object.end(); ++field) {
+                if (!field.value().isArray() && !field.value().isObject()) {
+                    ok = xlsx.addRow({XlsxCell(displayName(it.key()) + ": " + displayName(field.key())),
+                                      jsonCell(field.value())});
+                }
+            }
+        } else {
+            ok = xlsx.addRow({XlsxCell(displayName(it.key())), jsonCell(it.value())});
+        }
+    }
+    
+    for (const QString &key : tables) {
+        QJsonArray array = rootObj[key].toArray();
+        
+        // Columns in first-seen order over every row, not just the first
+        QStringList columns;
+        for (const QJsonValue &item : array) {
+            QJsonObject object = item.toObject();
+            for (auto it = object.begin(); it != object.end(); ++it) {
+                if (!it.value().isArray() && !it.value().isObject() && !columns.contains(it.key())) {
+                    columns.append(it.key());
+                }
+            }
+        }
+        
+        QVariantList header;
+        for (const QString &column : columns) {
+            header.append(displayName(column));
+        }
+        if (columns.isEmpty()) {
+            header.append(displayName(key));
+        }
+        ok = ok && xlsx.beginSheet(displayName(key)) && xlsx.addRow(header, XlsxWriter::Header);
+        
+        for (int i = 0; ok && i < array.size(); ++i) {
+            QList<XlsxCell> cells;
+            if (columns.isEmpty()) {
+                cells.append(jsonCell(array.at(i)));
+            } else {
+                QJsonObject object = array.at(i).toObject();
+                for (const QString &column : columns) {
+                    cells.append(jsonCell(object.value(column)));
+                }
+            }
+            ok = xlsx.addRow(cells);
+        }
+    }
+    return ok;
+}
+
+} // namespace
+
+AdvancedReports::AdvancedReports(QObject *parent)
+    : QObject(parent)
+    , m_reportCache(new ReportCache(this))
+    , m_executor(new ReportExecutor(this))
+    , m_templateEngine(new ReportTemplateEngine(Database::instance().database().databaseName()))
+{
+    connect(m_executor, &ReportExecutor::progress, this, &AdvancedReports::reportProgress);
+}
+
+AdvancedReports::~AdvancedReports()
+{
+    delete m_templateEngine;
+}
+
+void AdvancedReports::cancelReportGeneration()
+{
+    m_executor->cancel();
+}
+
+ReportData AdvancedReports::generateAttendanceReport(const QDate &fromDate, const QDate &toDate,
+                                                    const QString &grade, const QString &section)
+{
+    // One trimmed copy for the cache key and both builders, so equal keys mean equal reports
+    QString gradeFilter = grade.trimmed();
+    QString sectionFilter = section.trimmed();
+    
+    QMap<QString, QVariant> parameters;
+    parameters["from_date"] = fromDate;
+    parameters["to_date"] = toDate;
+    parameters["grade"] = gradeFilter;
+    parameters["section"] = sectionFilter;
+    
+    return m_reportCache->fetch("Attendance Report", parameters,
+                                {"advanced_attendance", "enhanced_students"},
+                                [=]() { return buildAttendanceReport(fromDate, toDate, gradeFilter, sectionFilter); },
+                                [=](QSqlDatabase db) { return buildReport(db, "Attendance Report", parameters); });
+}
+
+ReportData AdvancedReports::generateAcademicReport(const QString &examName, const QString &grade,
+                                                  const QString &section)
+{
+    QString exam = examName.trimmed();
+    QString gradeFilter = grade.trimmed();
+    QString sectionFilter = section.trimmed();
+    
+    QMap<QString, QVariant> parameters;
+    parameters["exam_name"] = exam;
+    parameters["grade"] = gradeFilter;
+    parameters["section"] = sectionFilter;
+    
+    return m_reportCache->fetch("Academic Performance Report", parameters,
+                                {"exam_results", "enhanced_students"},
+                                [=]() { return buildAcademicReport(exam, gradeFilter, sectionFilter); },
+                                [=](QSqlDatabase db) { return buildReport(db, "Academic Performance Report", parameters); });
+}
+
+ReportData AdvancedReports::generateFinancialReport(const QDate &fromDate, const QDate &toDate)
+{
+    QMap<QString, QVariant> parameters;
+    parameters["from_date"] = fromDate;
+    parameters["to_date"] = toDate;
+    
+    return m_reportCache->fetch("Financial Report", parameters,
+                                {"fee_transactions", "enhanced_students"},
+                                [=]() { return buildFinancialReport(fromDate, toDate); },
+                                [=](QSqlDatabase db) { return buildReport(db, "Financial Report", parameters); });
+}
+
+ReportData AdvancedReports::buildAttendanceReport(const QDate &fromDate, const QDate &toDate,
+                                                 const QString &grade, const QString &section)
+{
+    ReportData report;
+    report.reportType = "Attendance Report";
+    report.generatedDate = QDateTime::currentDateTime();
+    report.dateRange = QString("%1 to %2").arg(fromDate.toString("dd/MM/yyyy"))
+                                         .arg(toDate.toString("dd/MM/yyyy"));
+    
+    QJsonArray studentsArray;
+    bool ok = false;
+    
+    // Whole-school and whole-grade reports run one section per worker
+    QList<ReportPartition> partitions = ReportExecutor::partitions(grade, section);
+    if (partitions.size() > 1) {
+        QVector<QJsonArray> results;
+        ok = m_executor->run(partitions, [=](QSqlDatabase db, const ReportPartition &partition, QJsonArray *rows,
+                                             QString *error) {
+            return queryAttendanceRows(db, fromDate, toDate, partition.grade, partition.section, rows, error);
+        }, &results);
+        report.error = m_executor->lastError();
+        
+        for (const QJsonArray &rows : results) {
+            for (const QJsonValue &row : rows) {
+                studentsArray.append(row);
+            }
+        }
+    } else {
+        ok = queryAttendanceRows(Database::instance().database(), fromDate, toDate, grade, section,
+                                 &studentsArray, &report.error);
+    }
+    
+    // No data rather than a partial report, so it is never cached
+    if (ok) {
+        report.jsonData = QJsonDocument(attendanceReportData(studentsArray));
+    }
+    
+    return report;
+}
+
+ReportData AdvancedReports::buildAcademicReport(const QString &examName, const QString &grade,
+                                               const QString &section)
+{
+    ReportData report;
+    report.reportType = "Academic Performance Report";
+    report.generatedDate = QDateTime::currentDateTime();
+    report.parameters = QString("Exam: %1, Grade: %2, Section: %3").arg(examName).arg(grade).arg(section);
+    
+    QVector<QJsonArray> results(1);
+    bool ok = false;
+    
+    QList<ReportPartition> partitions = ReportExecutor::partitions(grade, section);
+    if (partitions.size() > 1) {
+        ok = m_executor->run(partitions, [=](QSqlDatabase db, const ReportPartition &partition, QJsonArray *rows,
+                                             QString *error) {
+            return queryAcademicStudents(db, examName, partition.grade, partition.section, rows, error);
+        }, &results);
+        report.error = m_executor->lastError();
+    } else {
+        ok = queryAcademicStudents(Database::instance().database(), examName, grade, section, &results[0],
+                                   &report.error);
+    }
+    
+    if (ok) {
+        report.jsonData = QJsonDocument(academicReportData(examName, results));
+    }
+    
+    return report;
+}
+
+ReportData AdvancedReports::buildFinancialReport(const QDate &fromDate, const QDate &toDate)
+{
+    ReportData report;
+    report.reportType = "Financial Report";
+    report.generatedDate = QDateTime::currentDateTime();
+    report.dateRange = QString("%1 to %2").arg(fromDate.toString("dd/MM/yyyy"))
+                                         .arg(toDate.toString("dd/MM/yyyy"));
+    
     QJsonObject reportObj;
-    reportObj["summary"] = summaryObj;
-    reportObj["collections"] = collectionsArray;
-    reportObj["outstanding"] = outstandingArray;
+    if (queryFinancialData(Database::instance().database(), fromDate, toDate, &reportObj, &report.error)) {
+        report.jsonData = QJsonDocument(reportObj);
+    }
     
-    report.jsonData = QJsonDocument(reportObj);
+    return report;
+}
+
+bool AdvancedReports::canBuildReport(const QString &reportType)
+{
+    return reportType == "Attendance Report" || reportType == "Academic Performance Report"
+        || reportType == "Financial Report";
+}
+
+ReportData AdvancedReports::buildReport(QSqlDatabase db, const QString &reportType,
+                                        const QMap<QString, QVariant> &parameters)
+{
+    QDate fromDate = parameters.value("from_date").toDate();
+    QDate toDate = parameters.value("to_date").toDate();
+    QString grade = parameters.value("grade").toString();
+    QString section = parameters.value("section").toString();
+    
+    ReportData report;
+    report.reportType = reportType;
+    report.generatedDate = QDateTime::currentDateTime();
+    
+    if (reportType == "Attendance Report") {
+        report.dateRange = QString("%1 to %2").arg(fromDate.toString("dd/MM/yyyy"))
+                                             .arg(toDate.toString("dd/MM/yyyy"));
+        QJsonArray studentsArray;
+        if (queryAttendanceRows(db, fromDate, toDate, grade, section, &studentsArray, &report.error)) {
+            report.jsonData = QJsonDocument(attendanceReportData(studentsArray));
+        }
+    } else if (reportType == "Academic Performance Report") {
+        QString examName = parameters.value("exam_name").toString();
+        report.parameters = QString("Exam: %1, Grade: %2, Section: %3").arg(examName).arg(grade).arg(section);
+        QVector<QJsonArray> results(1);
+        if (queryAcademicStudents(db, examName, grade, section, &results[0], &report.error)) {
+            report.jsonData = QJsonDocument(academicReportData(examName, results));
+        }
+    } else if (reportType == "Financial Report") {
+        report.dateRange = QString("%1 to %2").arg(fromDate.toString("dd/MM/yyyy"))
+                                             .arg(toDate.toString("dd/MM/yyyy"));
+        QJsonObject reportObj;
+        if (queryFinancialData(db, fromDate, toDate, &reportObj, &report.error)) {
+            report.jsonData = QJsonDocument(reportObj);
+        }
+    } else {
+        qDebug() << "Report type cannot be built in the background:" << reportType;
+        report.error = "Report type cannot be built in the background";
+    }
     
     return report;
 }
@@ -285,6 +934,44 @@ ReportData AdvancedReports::generateCustomReport(const QString &reportName, cons
         return generateClassComparisonReport(parameters);
     } else if (reportName == "Trend Analysis") {
         return generateTrendAnalysisReport(parameters);
+    } else if (reportName == "Merit List") {
+        return generateMeritList(parameters);
+    } else if (reportName == "Period Comparison") {
+        return generatePeriodComparison(parameters);
+    }
+    
+    // Otherwise a saved template of that name
+    QSqlQuery query(Database::instance().database());
+    query.prepare("SELECT * FROM report_templates WHERE name = ?");
+    query.addBindValue(reportName);
+    if (query.exec() && query.next()) {
+        ReportTemplate temp = readTemplate(query);
+        TemplateResult result;
+        QString error;
+        if (!m_templateEngine->execute(temp, parameters, &result, &error)) {
+            qDebug() << "Failed to run report template" << reportName << ":" << error;
+            report.jsonData = QJsonDocument(QJsonObject());
+            report.error = error;
+            return report;
+        }
+        
+        QJsonArray rows;
+        for (const QVariantList &values : result.rows) {
+            QJsonObject row;
+            for (int i = 0; i < result.columns.size(); ++i) {
+                row[result.columns.at(i)] = QJsonValue::fromVariant(values.at(i));
+            }
+            rows.append(row);
+        }
+        
+        QJsonObject rootObj;
+        rootObj["columns"] = QJsonArray::fromStringList(result.columns);
+        rootObj["rows"] = rows;
+        rootObj["row_count"] = result.rows.size();
+        rootObj["truncated"] = result.truncated;
+        rootObj["elapsed_ms"] = result.elapsedMs;
+        report.jsonData = QJsonDocument(rootObj);
+        return report;
     }
     
     // Default empty report
@@ -294,36 +981,252 @@ ReportData AdvancedReports::generateCustomReport(const QString &reportName, cons
 
 bool AdvancedReports::exportReportToPDF(const ReportData &report, const QString &filePath)
 {
-    // This would require QPrinter and more complex implementation
-    // For now, we'll create a simplified text export
-    QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        return false;
+    QString subtitle = "Generated: " + report.generatedDate.toString("dd/MM/yyyy hh:mm:ss");
+    if (!report.dateRange.isEmpty()) {
+        subtitle += "\nDate Range: " + report.dateRange;
+    }
+    if (!report.parameters.isEmpty()) {
+        subtitle += "\nParameters: " + report.parameters;
     }
     
-    QTextStream out(&file);
-    out << "=== " << report.reportType << " ===\\n\\n";
-    out << "Generated: " << report.generatedDate.toString("dd/MM/yyyy hh:mm:ss") << "\\n";
+    PdfReportRenderer pdf(report.reportType, subtitle);
+    QJsonObject rootObj = report.jsonData.object();
     
-    if (!report.dateRange.isEmpty()) {
-        out << "Date Range: " << report.dateRange << "\\n";
+    if (report.reportType == "Attendance Report") {
+        QJsonObject summary = rootObj["summary"].toObject();
+        QJsonArray students = rootObj["students"].toArray();
+        
+        pdf.addHeading("Summary");
+        pdf.addField("Total Students", QString::number(summary["total_students"].toInt()));
+        pdf.addField("Average Attendance", QString::number(summary["average_attendance"].toDouble(), 'f', 2) + "%");
+        
+        QList<QPair<QString, double>> bands = {{"Below 50%", 0}, {"50-75%", 0}, {"75-90%", 0}, {"90% and above", 0}};
+        QList<QStringList> rows;
+        rows.reserve(students.size());
+        for (const QJsonValue &studentVal : students) {
+            QJsonObject student = studentVal.toObject();
+            double percentage = student["attendance_percentage"].toDouble();
+            bands[percentage < 50 ? 0 : percentage < 75 ? 1 : percentage < 90 ? 2 : 3].second += 1;
+            
+            rows.append({student["roll_number"].toString(), student["name"].toString(),
+                         student["grade"].toString(), student["section"].toString(),
+                         QString::number(student["present_days"].toInt()), QString::number(student["absent_days"].toInt()),
+                         QString::number(student["late_days"].toInt()), QString::number(student["excused_days"].toInt()),
+                         QString::number(student["total_days"].toInt()), QString::number(percentage, 'f', 2) + "%"});
+        }
+        
+        pdf.addBarChart("Students by Attendance", bands);
+        pdf.addHeading("Students");
+        pdf.addTable({"Roll", "Name", "Grade", "Sec", "Present", "Absent", "Late", "Excused", "Total", "Attendance"},
+                     rows, {1.2, 3, 0.8, 0.7, 1, 1, 0.8, 1, 0.8, 1.3});
+    } else if (report.reportType == "Academic Performance Report") {
+        QJsonArray students = rootObj["students"].toArray();
+        pdf.addField("Exam", rootObj["exam_name"].toString());
+        pdf.addField("Students", QString::number(students.size()));
+        
+        QMap<QString, QPair<double, int>> subjectTotals;
+        QList<QStringList> rows;
+        for (const QJsonValue &studentVal : students) {
+            QJsonObject student = studentVal.toObject();
+            QJsonArray subjects = student["subjects"].toArray();
+            for (const QJsonValue &subjectVal : subjects) {
+                QJsonObject subject = subjectVal.toObject();
+                QPair<double, int> &total = subjectTotals[subject["subject"].toString()];
+                total.first += subject["percentage"].toDouble();
+                total.second += 1;
+                
+                rows.append({student["roll_number"].toString(), student["name"].toString(),
+                             student["grade"].toString(), student["section"].toString(),
+                             subject["subject"].toString(),
+                             QString::number(subject["marks_obtained"].toDouble(), 'f', 1),
+                             QString::number(subject["total_marks"].toDouble(), 'f', 1),
+                             QString::number(subject["percentage"].toDouble(), 'f', 2) + "%",
+                             subject["grade"].toString()});
+            }
+        }
+        
+        QList<QPair<QString, double>> averages;
+        for (auto it = subjectTotals.begin(); it != subjectTotals.end(); ++it) {
+            averages.append({it.key(), it.value().first / it.value().second});
+        }
+        
+        pdf.addBarChart("Average Percentage by Subject", averages, 100.0);
+        pdf.addHeading("Results");
+        pdf.addTable({"Roll", "Name", "Grade", "Sec", "Subject", "Marks", "Out of", "Percent", "Grade"},
+                     rows, {1.2, 3, 0.8, 0.7, 2, 1, 1, 1.1, 0.8});
+    } else if (report.reportType == "Financial Report") {
+        addJsonSection(pdf, "summary", rootObj["summary"]);
+        
+        QMap<QString, double> byFeeType;
+        for (const QJsonValue &collection : rootObj["collections"].toArray()) {
+            QJsonObject collectionObj = collection.toObject();
+            byFeeType[collectionObj["fee_type"].toString()] += collectionObj["total_amount"].toDouble();
+        }
+        QList<QPair<QString, double>> bars;
+        for (auto it = byFeeType.begin(); it != byFeeType.end(); ++it) {
+            bars.append({it.key(), it.value()});
+        }
+        
+        pdf.addBarChart("Collections by Fee Type", bars);
+        addJsonSection(pdf, "collections", rootObj["collections"]);
+        addJsonSection(pdf, "outstanding", rootObj["outstanding"]);
+    } else if (report.reportType == "Period Comparison") {
+        addJsonSection(pdf, "summary", rootObj["summary"]);
+        
+        for (const ComparisonTable &table : comparisonTables()) {
+            QStringList columns;
+            for (const QString &column : table.columns) {
+                columns.append(displayName(column));
+            }
+            QList<QStringList> rows;
+            for (const QJsonValue &item : rootObj[table.key].toArray()) {
+                QStringList row;
+                for (const QString &column : table.columns) {
+                    row.append(jsonText(item.toObject().value(column)));
+                }
+                rows.append(row);
+            }
+            
+            pdf.addHeading(table.title);
+            if (rows.isEmpty()) {
+                pdf.addParagraph("No records.");
+            } else {
+                pdf.addTable(columns, rows);
+            }
+        }
+    } else {
+        for (auto it = rootObj.begin(); it != rootObj.end(); ++it) {
+            addJsonSection(pdf, it.key(), it.value());
+        }
     }
     
-    if (!report.parameters.isEmpty()) {
-        out << "Parameters: " << report.parameters << "\\n";
+    return pdf.write(filePath);
+}
+
+bool AdvancedReports::exportReportToExcel(const ReportData &report, const QString &filePath)
+{
+    bool attendance = report.reportType == "Attendance Report";
+    bool academic = report.reportType == "Academic Performance Report";
+    bool comparison = report.reportType == "Period Comparison";
+    bool financial = report.reportType == "Financial Report";
+    
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
     }
     
-    out << "\\n" << report.jsonData.toJson() << "\\n";
+    QJsonArray students = report.jsonData.object()["students"].toArray();
+    bool ok = true;
+    {
+        XlsxWriter xlsx(&file);
+        
+        if (comparison) {
+            ok = addComparisonSheets(xlsx, report.jsonData.object());
+        } else if (financial) {
+            ok = addFinancialSheets(xlsx, report.jsonData.object());
+        } else if (attendance) {
+            ok = xlsx.beginSheet("Attendance", 1, {12, 28, 8, 8, 10, 10, 10, 10, 10, 14})
+                && xlsx.addRow({"Roll Number", "Name", "Grade", "Section", "Present Days", "Absent Days",
+                                "Late Days", "Excused Days", "Total Days", "Attendance %"}, XlsxWriter::Header);
+            
+            for (int i = 0; ok && i < students.size(); ++i) {
+                QJsonObject student = students.at(i).toObject();
+                ok = xlsx.addRow({XlsxCell(student["roll_number"].toString()),
+                                  XlsxCell(student["name"].toString()),
+                                  XlsxCell(student["grade"].toString()),
+                                  XlsxCell(student["section"].toString()),
+                                  XlsxCell(student["present_days"].toInt(), XlsxWriter::Integer),
+                                  XlsxCell(student["absent_days"].toInt(), XlsxWriter::Integer),
+                                  XlsxCell(student["late_days"].toInt(), XlsxWriter::Integer),
+                                  XlsxCell(student["excused_days"].toInt(), XlsxWriter::Integer),
+                                  XlsxCell(student["total_days"].toInt(), XlsxWriter::Integer),
+                                  XlsxCell(student["attendance_percentage"].toDouble() / 100.0, XlsxWriter::Percent)});
+            }
+            
+            // Totals stay live formulas so edits in Excel recalculate
+            if (ok && !students.isEmpty()) {
+                int lastRow = xlsx.rowCount();
+                QList<XlsxCell> totals = {XlsxCell("Total", XlsxWriter::Header), XlsxCell(), XlsxCell(), XlsxCell()};
+                for (int column = 4; column <= 8; ++column) {
+                    QString range = XlsxWriter::cellReference(column, 2) + ":" + XlsxWriter::cellReference(column, lastRow);
+                    totals.append(XlsxCell::fromFormula("SUM(" + range + ")", XlsxWriter::Integer));
+                }
+                totals.append(XlsxCell::fromFormula(QString("AVERAGE(J2:J%1)").arg(lastRow), XlsxWriter::Percent));
+                ok = xlsx.addRow(totals);
+            }
+        } else if (academic) {
+            ok = xlsx.beginSheet("Academic", 1, {12, 28, 8, 8, 18, 14, 12, 12, 8})
+                && xlsx.addRow({"Roll Number", "Name", "Grade", "Section", "Subject", "Marks Obtained",
+                                "Total Marks", "Percentage", "Grade"}, XlsxWriter::Header);
+            
+            for (int i = 0; ok && i < students.size(); ++i) {
+                QJsonObject student = students.at(i).toObject();
+                QJsonArray subjects = student["subjects"].toArray();
+                for (int j = 0; ok && j < subjects.size(); ++j) {
+                    QJsonObject subject = subjects.at(j).toObject();
+                    ok = xlsx.addRow({XlsxCell(student["roll_number"].toString()),
+                                      XlsxCell(student["name"].toString()),
+                                      XlsxCell(student["grade"].toString()),
+                                      XlsxCell(student["section"].toString()),
+                                      XlsxCell(subject["subject"].toString()),
+                                      XlsxCell(subject["marks_obtained"].toDouble(), XlsxWriter::Decimal),
+                                      XlsxCell(subject["total_marks"].toDouble(), XlsxWriter::Decimal),
+                                      XlsxCell(subject["percentage"].toDouble() / 100.0, XlsxWriter::Percent),
+                                      XlsxCell(subject["grade"].toString())});
+                }
+            }
+            
+            if (ok && xlsx.rowCount() > 1) {
+                int lastRow = xlsx.rowCount();
+                ok = xlsx.addRow({XlsxCell("Average", XlsxWriter::Header), XlsxCell(), XlsxCell(), XlsxCell(), XlsxCell(),
+                                  XlsxCell::fromFormula(QString("AVERAGE(F2:F%1)").arg(lastRow), XlsxWriter::Decimal),
+                                  XlsxCell::fromFormula(QString("AVERAGE(G2:G%1)").arg(lastRow), XlsxWriter::Decimal),
+                                  XlsxCell::fromFormula(QString("AVERAGE(H2:H%1)").arg(lastRow), XlsxWriter::Percent)});
+            }
+        } else {
+            ok = addJsonSheets(xlsx, report);
+        }
+        
+        ok = xlsx.close() && ok;
+    }
     
     file.close();
-    return true;
+    if (!ok) {
+        file.remove();
+    }
+    return ok;
 }
 
-bool AdvancedReports::exportReportToExcel(const ReportData &report, const QString &filePath)
+bool AdvancedReports::exportReportCards(const QMap<QString, QVariant> &parameters, const QString &outputPath)
 {
-    // This would require a library like QXlsx for proper Excel export
-    // For now, we'll create a CSV export
-    return exportReportToCSV(report, filePath);
+    QString examName = parameters.value("exam_name").toString();
+    QString grade = parameters.value("grade").toString();
+    if (examName.isEmpty() || grade.isEmpty()) {
+        qDebug() << "Report cards need an exam name and a grade";
+        return false;
+    }
+    
+    QDate toDate = parameters.value("to_date", QDate::currentDate()).toDate();
+    QDate fromDate = parameters.value("from_date", toDate.addMonths(-6)).toDate();
+    ReportCardGenerator::Format format = parameters.value("format").toString().toUpper() == "HTML" ?
+        ReportCardGenerator::Html : ReportCardGenerator::Pdf;
+    
+    ReportCardGenerator generator(examName, fromDate, toDate);
+    if (!generator.load(Database::instance().database(), grade, parameters.value("section").toString())) {
+        return false;
+    }
+    
+    bool ok;
+    if (parameters.value("merged", true).toBool()) {
+        ok = generator.writeMerged(outputPath, format);
+    } else {
+        ok = generator.writeEach(outputPath, format).size() == generator.cards().size();
+    }
+    
+    if (ok) {
+        emit reportExported(outputPath);
+    }
+    return ok;
 }
 
 bool AdvancedReports::exportReportToCSV(const ReportData &report, const QString &filePath)
@@ -376,12 +1279,66 @@ bool AdvancedReports::exportReportToCSV(const ReportData &report, const QString
                     << subject["grade"].toString() << "\\n";
             }
         }
+    } else if (report.reportType == "Period Comparison") {
+        // One block per table, separated by a blank line
+        for (const ComparisonTable &table : comparisonTables()) {
+            out << table.title << "\n" << table.columns.join(',') << "\n";
+            for (const QJsonValue &item : rootObj[table.key].toArray()) {
+                QStringList fields;
+                for (const QString &column : table.columns) {
+                    QJsonValue value = item.toObject().value(column);
+                    fields.append(value.isDouble() ? QString::number(value.toDouble()) : csvField(value.toString()));
+                }
+                out << fields.join(',') << "\n";
+            }
+            out << "\n";
+        }
     }
     
     file.close();
     return true;
 }
 
+qint64 AdvancedReports::archiveReport(const ReportData &report, const QString &reportName, const QString &filePath)
+{
+    QByteArray payload = ReportCodec::encode(report);
+    
+    QSqlQuery query(Database::instance().database());
+    query.prepare("INSERT INTO report_history (report_name, report_type, parameters, generated_date, "
+                 "file_path, file_size, generated_by, status, report_data) "
+                 "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    query.addBindValue(reportName);
+    query.addBindValue(report.reportType);
+    query.addBindValue(report.parameters);
+    query.addBindValue(report.generatedDate);
+    query.addBindValue(filePath);
+    query.addBindValue(payload.size());
+    query.addBindValue("User");
+    query.addBindValue("Archived");
+    query.addBindValue(payload);
+    
+    if (!query.exec()) {
+        qDebug() << "Failed to archive report:" << query.lastError().text();
+        return -1;
+    }
+    
+    return query.lastInsertId().toLongLong();
+}
+
+bool AdvancedReports::loadArchivedReport(qint64 historyId, ReportData *report)
+{
+    QSqlQuery query(Database::instance().database());
+    query.prepare("SELECT report_data FROM report_history WHERE id = ?");
+    query.addBindValue(historyId);
+    
+    if (!query.exec() || !query.next()) {
+        qDebug() << "Archived report not found:" << historyId;
+        return false;
+    }
+    
+    return ReportCodec::decode(query.value(0).toByteArray(), report);
+}
+
 QList<ReportTemplate> AdvancedReports::getReportTemplates()
 {
     QList<ReportTemplate> templates;
@@ -389,17 +1346,7 @@ QList<ReportTemplate> AdvancedReports::getReportTemplates()
     
     if (query.exec("SELECT * FROM report_templates ORDER BY category, name")) {
         while (query.next()) {
-            ReportTemplate temp;
-            temp.id = query.value("id").toInt();
-            temp.name = query.value("name").toString();
-            temp.description = query.value("description").toString();
-            temp.category = query.value("category").toString();
-            temp.parameters = query.value("parameters").toString().split(",");
-            temp.sqlQuery = query.value("sql_query").toString();
-            temp.outputFormat = query.value("output_format").toString();
-            temp.createdBy = query.value("created_by").toString();
-            temp.createdAt = query.value("created_at").toDateTime();
-            templates.append(temp);
+            templates.append(readTemplate(query));
         }
     }
     
@@ -408,6 +1355,13 @@ QList<ReportTemplate> AdvancedReports::getReportTemplates()
 
 bool AdvancedReports::addReportTemplate(const ReportTemplate &temp)
 {
+    // Rejected here rather than on every run
+    QString error;
+    if (!m_templateEngine->check(temp, &error)) {
+        qDebug() << "Invalid report template" << temp.name << ":" << error;
+        return false;
+    }
+    
     QSqlQuery query(Database::instance().database());
     
     query.prepare("INSERT INTO report_templates (name, description, category, "
@@ -469,42 +1423,107 @@ QList<ReportAnalytics> AdvancedReports::getReportAnalytics()
         analytics.append(attendanceAnalytics);
     }
     
-    // Grade-wise performance analysis
-    if (query.exec(R"(
-        SELECT es.grade, 
-               AVG(er.marks_obtained / er.total_marks * 100) as avg_percentage,
-               COUNT(DISTINCT es.roll_number) as student_count,
-               COUNT(er.id) as exam_count
-        FROM enhanced_students es
-        LEFT JOIN exam_results er ON es.roll_number = er.student_roll
-        WHERE er.exam_date >= date('now', '-90 days')
-        GROUP BY es.grade
-        ORDER BY es.grade
-    )")) {
-        ReportAnalytics performanceAnalytics;
-        performanceAnalytics.analyticsType = "Grade Performance";
-        performanceAnalytics.period = "Last 90 Days";
-        
-        QJsonArray dataArray;
+    // The rest reads the analytics cube, which keeps itself current from data versions
+    AnalyticsCube &cube = AnalyticsCube::instance();
+    int currentMonth = NepaliCalendar::getNepaliMonthIndex(QDate::currentDate());
+    
+    AnalyticsCube::Query monthlyQuery;
+    monthlyQuery.groupBy = { AnalyticsCube::BsMonth };
+    monthlyQuery.fromMonth = currentMonth - 11;
+    
+    ReportAnalytics monthlyAnalytics;
+    monthlyAnalytics.analyticsType = "Monthly Attendance";
+    monthlyAnalytics.period = "Last 12 Months";
+    
+    QJsonArray monthArray;
+    const QList<AnalyticsCube::Row> monthRows = cube.query(monthlyQuery);
+    for (const AnalyticsCube::Row &row : monthRows) {
+        if (row.measures.attendanceTotal() == 0) {
+            continue;
+        }
+        QJsonObject monthObj;
+        monthObj["month_index"] = row.keys.at(0).toInt();
+        monthObj["month"] = AnalyticsCube::monthLabel(row.keys.at(0).toInt());
+        monthObj["present"] = row.measures.present;
+        monthObj["late"] = row.measures.late;
+        monthObj["absent"] = row.measures.absent;
+        monthObj["excused"] = row.measures.excused;
+        monthObj["total"] = row.measures.attendanceTotal();
+        monthObj["attendance_rate"] = row.measures.attendanceRate();
+        monthArray.append(monthObj);
+    }
+    monthlyAnalytics.data = QJsonDocument(monthArray);
+    analytics.append(monthlyAnalytics);
+    
+    // Grade-wise performance over the current and two previous BS months
+    QHash<QString, int> enrolled;
+    if (query.exec("SELECT grade, COUNT(*) FROM enhanced_students GROUP BY grade")) {
         while (query.next()) {
-            QJsonObject gradeObj;
-            gradeObj["grade"] = query.value("grade").toString();
-            gradeObj["average_percentage"] = query.value("avg_percentage").toDouble();
-            gradeObj["student_count"] = query.value("student_count").toInt();
-            gradeObj["exam_count"] = query.value("exam_count").toInt();
-            
-            dataArray.append(gradeObj);
+            enrolled.insert(query.value(0).toString(), query.value(1).toInt());
         }
-        
-        performanceAnalytics.data = QJsonDocument(dataArray);
-        analytics.append(performanceAnalytics);
     }
     
+    AnalyticsCube::Query gradeQuery;
+    gradeQuery.groupBy = { AnalyticsCube::Grade };
+    gradeQuery.fromMonth = currentMonth - 2;
+    
+    ReportAnalytics performanceAnalytics;
+    performanceAnalytics.analyticsType = "Grade Performance";
+    performanceAnalytics.period = "Last 3 Months";
+    
+    QJsonArray gradeArray;
+    const QList<AnalyticsCube::Row> gradeRows = cube.query(gradeQuery);
+    for (const AnalyticsCube::Row &row : gradeRows) {
+        if (row.measures.resultCount == 0) {
+            continue;
+        }
+        QJsonObject gradeObj;
+        gradeObj["grade"] = row.keys.at(0);
+        gradeObj["average_percentage"] = row.measures.averagePercentage();
+        gradeObj["student_count"] = enrolled.value(row.keys.at(0));
+        gradeObj["exam_count"] = row.measures.resultCount;
+        gradeObj["attendance_rate"] = row.measures.attendanceRate();
+        gradeArray.append(gradeObj);
+    }
+    performanceAnalytics.data = QJsonDocument(gradeArray);
+    analytics.append(performanceAnalytics);
+    
+    // Subject performance by teacher over the same months
+    AnalyticsCube::Query subjectQuery;
+    subjectQuery.groupBy = { AnalyticsCube::Subject, AnalyticsCube::Teacher };
+    subjectQuery.fromMonth = currentMonth - 2;
+    
+    ReportAnalytics subjectAnalytics;
+    subjectAnalytics.analyticsType = "Subject Performance";
+    subjectAnalytics.period = "Last 3 Months";
+    
+    QJsonArray subjectArray;
+    const QList<AnalyticsCube::Row> subjectRows = cube.query(subjectQuery);
+    for (const AnalyticsCube::Row &row : subjectRows) {
+        if (row.measures.resultCount == 0) {
+            continue;
+        }
+        QJsonObject subjectObj;
+        subjectObj["subject"] = row.keys.at(0);
+        subjectObj["teacher"] = row.keys.at(1);
+        subjectObj["average_percentage"] = row.measures.averagePercentage();
+        subjectObj["exam_count"] = row.measures.resultCount;
+        subjectArray.append(subjectObj);
+    }
+    subjectAnalytics.data = QJsonDocument(subjectArray);
+    analytics.append(subjectAnalytics);
+    
     return analytics;
 }
 
 bool AdvancedReports::scheduleReport(const ScheduledReport &scheduledReport)
 {
+    // Scheduled runs happen on a worker connection, which only buildReport supports
+    if (!canBuildReport(scheduledReport.reportType)) {
+        qDebug() << "Report type cannot be scheduled:" << scheduledReport.reportType;
+        return false;
+    }
+    
     QSqlQuery query(Database::instance().database());
     
     query.prepare("INSERT INTO scheduled_reports (report_name, report_type, "
@@ -528,6 +1547,7 @@ bool AdvancedReports::scheduleReport(const ScheduledReport &scheduledReport)
         return false;
     }
     
+    emit scheduleChanged();
     return true;
 }
 
@@ -658,90 +1678,466 @@ ReportData AdvancedReports::generateClassComparisonReport(const QMap<QString, QV
 {
     ReportData report;
     report.reportType = "Class Comparison Report";
+    report.generatedDate = QDateTime::currentDateTime();
     
     QString grade = parameters.value("grade").toString();
     QDate fromDate = parameters.value("from_date").toDate();
     QDate toDate = parameters.value("to_date").toDate();
+    int bins = parameters.value("histogram_bins", 10).toInt();
     
-    QSqlQuery query(Database::instance().database());
+    QSqlDatabase db = Database::instance().database();
+    QSqlQuery query(db);
     
-    // Compare sections within a grade
+    // Enrolment and attendance per section; marks are summarized from arrays below
     query.prepare(R"(
         SELECT es.section,
                COUNT(DISTINCT es.roll_number) as student_count,
-               AVG(CASE WHEN aa.status = 'Present' OR aa.status = 'Late' THEN 1.0 ELSE 0.0 END) * 100 as avg_attendance,
-               AVG(er.marks_obtained / er.total_marks * 100) as avg_academic_performance
+               AVG(CASE WHEN aa.status = 'Present' OR aa.status = 'Late' THEN 1.0 ELSE 0.0 END) * 100 as avg_attendance
         FROM enhanced_students es
         LEFT JOIN advanced_attendance aa ON es.roll_number = aa.student_roll
         AND aa.date BETWEEN ? AND ?
-        LEFT JOIN exam_results er ON es.roll_number = er.student_roll
-        AND er.exam_date BETWEEN ? AND ?
         WHERE es.grade = ?
         GROUP BY es.section
         ORDER BY es.section
     )");
     
-    query.addBindValue(fromDate);
-    query.addBindValue(toDate);
     query.addBindValue(fromDate);
     query.addBindValue(toDate);
     query.addBindValue(grade);
     
+    const QList<MarkSample> samples = MarkStatistics::load(db, grade, fromDate, toDate);
+    QHash<QString, int> sectionSamples;
+    for (int i = 0; i < samples.size(); ++i) {
+        if (samples.at(i).subject.isEmpty()) {
+            sectionSamples.insert(samples.at(i).section, i);
+        }
+    }
+    
+    // School-wide distribution, to place each section's median
+    TDigest schoolDigest;
+    MarkStatistics::loadDigest(db, fromDate, toDate, &schoolDigest);
+    
     QJsonArray sectionsArray;
     if (query.exec()) {
         while (query.next()) {
+            QString section = query.value("section").toString();
             QJsonObject sectionObj;
-            sectionObj["section"] = query.value("section").toString();
+            sectionObj["section"] = section;
             sectionObj["student_count"] = query.value("student_count").toInt();
             sectionObj["average_attendance"] = query.value("avg_attendance").toDouble();
-            sectionObj["average_academic_performance"] = query.value("avg_academic_performance").toDouble();
+            
+            int sampleIndex = sectionSamples.value(section, -1);
+            if (sampleIndex >= 0) {
+                const QVector<float> &marks = samples.at(sampleIndex).percentages;
+                MarkSummary summary = MarkStatistics::summarize(marks);
+                sectionObj["average_academic_performance"] = summary.mean;
+                addMarkSummary(&sectionObj, summary);
+                if (!schoolDigest.isEmpty()) {
+                    sectionObj["median_school_percentile"] = schoolDigest.cdf(summary.median) * 100.0;
+                }
+                
+                QJsonArray histogramArray;
+                for (int count : MarkStatistics::histogram(marks.constData(), marks.size(), bins)) {
+                    histogramArray.append(count);
+                }
+                sectionObj["histogram"] = histogramArray;
+            } else {
+                sectionObj["average_academic_performance"] = QJsonValue();
+            }
             sectionsArray.append(sectionObj);
         }
     }
     
+    QJsonArray subjectsArray;
+    for (const MarkSample &sample : samples) {
+        if (sample.subject.isEmpty()) {
+            continue;
+        }
+        QJsonObject subjectObj;
+        subjectObj["section"] = sample.section;
+        subjectObj["subject"] = sample.subject;
+        addMarkSummary(&subjectObj, MarkStatistics::summarize(sample.percentages));
+        subjectsArray.append(subjectObj);
+    }
+    
+    QJsonObject schoolObj;
+    schoolObj["result_count"] = schoolDigest.totalWeight();
+    if (!schoolDigest.isEmpty()) {
+        schoolObj["p10"] = schoolDigest.quantile(0.10);
+        schoolObj["p25"] = schoolDigest.quantile(0.25);
+        schoolObj["median"] = schoolDigest.quantile(0.50);
+        schoolObj["p75"] = schoolDigest.quantile(0.75);
+        schoolObj["p90"] = schoolDigest.quantile(0.90);
+    }
+    
     QJsonObject reportObj;
     reportObj["grade"] = grade;
     reportObj["sections"] = sectionsArray;
+    reportObj["subjects"] = subjectsArray;
+    reportObj["school_distribution"] = schoolObj;
     
     report.jsonData = QJsonDocument(reportObj);
     return report;
 }
 
-ReportData AdvancedReports::generateTrendAnalysisReport(const QMap<QString, QVariant> &parameters)
+ReportData AdvancedReports::generateMeritList(const QMap<QString, QVariant> &parameters)
 {
     ReportData report;
-    report.reportType = "Trend Analysis Report";
+    report.reportType = "Merit List";
+    report.generatedDate = QDateTime::currentDateTime();
+    
+    // k students per grade (or school-wide), top or bottom, by exam percentage
+    QString examName = parameters.value("exam_name").toString();
+    int k = parameters.value("k", 10).toInt();
+    bool bottom = parameters.value("order").toString().compare("bottom", Qt::CaseInsensitive) == 0;
+    bool perGrade = parameters.value("per_grade", true).toBool();
+    QString methodName = parameters.value("method", "competition").toString().toLower();
+    
+    RankingEngine::Method method = RankingEngine::Competition;
+    if (methodName == "dense") {
+        method = RankingEngine::Dense;
+    } else if (methodName == "ordinal") {
+        method = RankingEngine::Ordinal;
+    }
     
     QSqlQuery query(Database::instance().database());
+    query.setForwardOnly(true);
     
-    // Analyze trends over the last 6 months
-    if (query.exec(R"(
-        SELECT DATE(aa.date, 'start of month') as month,
-               COUNT(CASE WHEN aa.status = 'Present' OR aa.status = 'Late' THEN 1 END) as present_count,
-               COUNT(*) as total_count,
-               (COUNT(CASE WHEN aa.status = 'Present' OR aa.status = 'Late' THEN 1 END) * 100.0 / COUNT(*)) as attendance_rate
-        FROM advanced_attendance aa
-        WHERE aa.date >= date('now', '-6 months')
-        GROUP BY DATE(aa.date, 'start of month')
-        ORDER BY month
-    )")) {
-        QJsonArray trendsArray;
+    // One row per student; total marks obtained breaks equal percentages
+    query.prepare(R"(
+        SELECT es.roll_number, es.name, es.grade,
+               SUM(er.marks_obtained) * 100.0 / SUM(er.total_marks) as percentage,
+               SUM(er.marks_obtained) as marks_obtained
+        FROM exam_results er
+        JOIN enhanced_students es ON es.roll_number = er.student_roll
+        WHERE er.exam_name = ?
+        GROUP BY es.roll_number
+        HAVING SUM(er.total_marks) > 0
+    )");
+    query.addBindValue(examName);
+    
+    if (!query.exec()) {
+        qDebug() << "Failed to generate merit list:" << query.lastError().text();
+        report.jsonData = QJsonDocument(QJsonObject());
+        return report;
+    }
+    
+    RankingEngine ranking(k, bottom ? RankingEngine::Lowest : RankingEngine::Highest, method,
+                          RankingEngine::BySecondary);
+    while (query.next()) {
+        RankedEntry entry;
+        entry.id = query.value("roll_number").toString();
+        entry.name = query.value("name").toString();
+        entry.group = perGrade ? query.value("grade").toString() : QString();
+        entry.score = query.value("percentage").toDouble();
+        entry.secondary = query.value("marks_obtained").toDouble();
+        ranking.add(entry);
+    }
+    
+    QStringList groups = ranking.groups();
+    std::sort(groups.begin(), groups.end(), [](const QString &a, const QString &b) {
+        return a.toInt() != b.toInt() ? a.toInt() < b.toInt() : a < b;
+    });
+    
+    QJsonArray groupsArray;
+    for (const QString &group : groups) {
+        QJsonArray studentsArray;
+        const QList<RankedEntry> ranked = ranking.results(group);
+        for (const RankedEntry &entry : ranked) {
+            QJsonObject studentObj;
+            studentObj["rank"] = entry.rank;
+            studentObj["roll_number"] = entry.id;
+            studentObj["name"] = entry.name;
+            studentObj["percentage"] = entry.score;
+            studentObj["marks_obtained"] = entry.secondary;
+            studentObj["percentile"] = entry.percentile;
+            studentsArray.append(studentObj);
+        }
         
-        while (query.next()) {
-            QJsonObject monthObj;
-            monthObj["month"] = query.value("month").toString();
-            monthObj["present_count"] = query.value("present_count").toInt();
-            monthObj["total_count"] = query.value("total_count").toInt();
-            monthObj["attendance_rate"] = query.value("attendance_rate").toDouble();
-            trendsArray.append(monthObj);
+        QJsonObject groupObj;
+        groupObj["grade"] = perGrade ? group : QString("All");
+        groupObj["students_ranked"] = ranking.count(group);
+        groupObj["students"] = studentsArray;
+        groupsArray.append(groupObj);
+    }
+    
+    QJsonObject reportObj;
+    reportObj["exam_name"] = examName;
+    reportObj["order"] = bottom ? "bottom" : "top";
+    reportObj["method"] = methodName;
+    reportObj["grades"] = groupsArray;
+    
+    report.jsonData = QJsonDocument(reportObj);
+    return report;
+}
+
+ReportData AdvancedReports::generatePeriodComparison(const QMap<QString, QVariant> &parameters)
+{
+    ReportData report;
+    report.reportType = "Period Comparison";
+    report.generatedDate = QDateTime::currentDateTime();
+    
+    // Current period defaults to the last 90 days, the previous one to as many days just before it
+    QDate currentTo = parameters.value("current_to", QDate::currentDate()).toDate();
+    QDate currentFrom = parameters.value("current_from", currentTo.addDays(-89)).toDate();
+    QDate previousTo = parameters.value("previous_to", currentFrom.addDays(-1)).toDate();
+    QDate previousFrom = parameters.value("previous_from", previousTo.addDays(-currentFrom.daysTo(currentTo))).toDate();
+    QString grade = parameters.value("grade").toString();
+    QString section = parameters.value("section").toString();
+    // |score| at or above this flags a change as significant; 1.96 is the two-sided 5% level
+    double critical = parameters.value("z", 1.96).toDouble();
+    
+    report.dateRange = QString("%1 to %2 against %3 to %4").arg(currentFrom.toString("dd/MM/yyyy"))
+                                                          .arg(currentTo.toString("dd/MM/yyyy"))
+                                                          .arg(previousFrom.toString("dd/MM/yyyy"))
+                                                          .arg(previousTo.toString("dd/MM/yyyy"));
+    report.parameters = QString("Grade: %1, Section: %2").arg(grade).arg(section);
+    
+    QSqlQuery query(Database::instance().database());
+    query.setForwardOnly(true);
+    
+    // Build side of the hash joins: the students in scope
+    QString studentSql = "SELECT roll_number, name, grade, section FROM enhanced_students WHERE 1 = 1";
+    if (!grade.isEmpty()) {
+        studentSql += " AND grade = ?";
+    }
+    if (!section.isEmpty()) {
+        studentSql += " AND section = ?";
+    }
+    query.prepare(studentSql);
+    if (!grade.isEmpty()) {
+        query.addBindValue(grade);
+    }
+    if (!section.isEmpty()) {
+        query.addBindValue(section);
+    }
+    if (!query.exec()) {
+        qDebug() << "Failed to load students for period comparison:" << query.lastError().text();
+        report.jsonData = QJsonDocument(QJsonObject());
+        return report;
+    }
+    
+    QHash<QString, ComparedStudent> students;
+    while (query.next()) {
+        ComparedStudent student;
+        student.name = query.value("name").toString();
+        student.grade = query.value("grade").toString();
+        student.section = query.value("section").toString();
+        students.insert(query.value("roll_number").toString(), student);
+    }
+    
+    // Both periods come back from one grouped scan each, tagged 1 for current and 0 for previous
+    QHash<QString, PeriodPair> studentStats;
+    QHash<QString, PeriodPair> subjectStats;
+    
+    query.prepare(R"(
+        SELECT student_roll,
+               CASE WHEN date BETWEEN ? AND ? THEN 1 ELSE 0 END as period,
+               SUM(CASE WHEN status IN ('Present', 'Late', 'Excused') THEN 1 ELSE 0 END) as attended,
+               COUNT(*) as marked
+        FROM advanced_attendance
+        WHERE date BETWEEN ? AND ? OR date BETWEEN ? AND ?
+        GROUP BY student_roll, period
+    )");
+    query.addBindValue(currentFrom);
+    query.addBindValue(currentTo);
+    query.addBindValue(currentFrom);
+    query.addBindValue(currentTo);
+    query.addBindValue(previousFrom);
+    query.addBindValue(previousTo);
+    
+    if (!query.exec()) {
+        qDebug() << "Failed to compare attendance:" << query.lastError().text();
+    }
+    while (query.next()) {
+        QString roll = query.value("student_roll").toString();
+        if (!students.contains(roll)) {
+            continue;
+        }
+        PeriodStats &stats = studentStats[roll].periods[query.value("period").toInt()];
+        stats.attended += query.value("attended").toLongLong();
+        stats.marked += query.value("marked").toLongLong();
+    }
+    
+    query.prepare(R"(
+        SELECT student_roll, subject,
+               CASE WHEN exam_date BETWEEN ? AND ? THEN 1 ELSE 0 END as period,
+               COUNT(*) as results,
+               SUM(marks_obtained * 100.0 / total_marks) as percentage_sum,
+               SUM((marks_obtained * 100.0 / total_marks) * (marks_obtained * 100.0 / total_marks)) as percentage_squares
+        FROM exam_results
+        WHERE total_marks > 0 AND (exam_date BETWEEN ? AND ? OR exam_date BETWEEN ? AND ?)
+        GROUP BY student_roll, subject, period
+    )");
+    query.addBindValue(currentFrom);
+    query.addBindValue(currentTo);
+    query.addBindValue(currentFrom);
+    query.addBindValue(currentTo);
+    query.addBindValue(previousFrom);
+    query.addBindValue(previousTo);
+    
+    if (!query.exec()) {
+        qDebug() << "Failed to compare exam results:" << query.lastError().text();
+    }
+    while (query.next()) {
+        QString roll = query.value("student_roll").toString();
+        if (!students.contains(roll)) {
+            continue;
         }
+        PeriodStats stats;
+        stats.results = query.value("results").toLongLong();
+        stats.percentageSum = query.value("percentage_sum").toDouble();
+        stats.percentageSquares = query.value("percentage_squares").toDouble();
         
-        QJsonObject reportObj;
-        reportObj["attendance_trends"] = trendsArray;
+        int period = query.value("period").toInt();
+        studentStats[roll].periods[period].add(stats);
+        subjectStats[query.value("subject").toString()].periods[period].add(stats);
+    }
+    
+    // Classes and the school roll up from the students in one more pass
+    QHash<QPair<QString, QString>, PeriodPair> classStats;
+    QHash<QPair<QString, QString>, int> classSizes;
+    PeriodPair schoolStats;
+    QJsonArray studentsArray;
+    int attendanceImproved = 0;
+    int attendanceDeclined = 0;
+    int marksImproved = 0;
+    int marksDeclined = 0;
+    
+    QStringList rolls = studentStats.keys();
+    std::sort(rolls.begin(), rolls.end(), [&students](const QString &a, const QString &b) {
+        const ComparedStudent &left = students[a];
+        const ComparedStudent &right = students[b];
+        if (left.grade != right.grade) {
+            return gradeLessThan(left.grade, right.grade);
+        }
+        if (left.section != right.section) {
+            return left.section < right.section;
+        }
+        return QString::localeAwareCompare(left.name, right.name) < 0;
+    });
+    
+    for (const QString &roll : rolls) {
+        const ComparedStudent &student = students[roll];
+        const PeriodPair &pair = studentStats[roll];
+        QPair<QString, QString> classKey(student.grade, student.section);
+        classStats[classKey].add(pair);
+        ++classSizes[classKey];
+        schoolStats.add(pair);
         
-        report.jsonData = QJsonDocument(reportObj);
+        QJsonObject studentObj;
+        studentObj["roll_number"] = roll;
+        studentObj["name"] = student.name;
+        studentObj["grade"] = student.grade;
+        studentObj["section"] = student.section;
+        addAttendanceComparison(&studentObj, pair, critical);
+        addMarksComparison(&studentObj, pair, critical);
+        studentsArray.append(studentObj);
+        
+        attendanceImproved += studentObj["attendance_flag"].toString() == "improved";
+        attendanceDeclined += studentObj["attendance_flag"].toString() == "declined";
+        marksImproved += studentObj["marks_flag"].toString() == "improved";
+        marksDeclined += studentObj["marks_flag"].toString() == "declined";
+    }
+    
+    QList<QPair<QString, QString>> classKeys = classStats.keys();
+    std::sort(classKeys.begin(), classKeys.end(), [](const QPair<QString, QString> &a, const QPair<QString, QString> &b) {
+        return a.first != b.first ? gradeLessThan(a.first, b.first) : a.second < b.second;
+    });
+    
+    QJsonArray classesArray;
+    for (const QPair<QString, QString> &classKey : classKeys) {
+        QJsonObject classObj;
+        classObj["grade"] = classKey.first;
+        classObj["section"] = classKey.second;
+        classObj["students"] = classSizes.value(classKey);
+        addAttendanceComparison(&classObj, classStats[classKey], critical);
+        addMarksComparison(&classObj, classStats[classKey], critical);
+        classesArray.append(classObj);
+    }
+    
+    QStringList subjects = subjectStats.keys();
+    std::sort(subjects.begin(), subjects.end());
+    
+    QJsonArray subjectsArray;
+    for (const QString &subject : subjects) {
+        const PeriodPair &pair = subjectStats[subject];
+        QJsonObject subjectObj;
+        subjectObj["subject"] = subject;
+        subjectObj["results_previous"] = pair.periods[PreviousPeriod].results;
+        subjectObj["results_current"] = pair.periods[CurrentPeriod].results;
+        addMarksComparison(&subjectObj, pair, critical);
+        subjectsArray.append(subjectObj);
+    }
+    
+    QJsonObject summaryObj;
+    summaryObj["students_compared"] = rolls.size();
+    summaryObj["attendance_improved"] = attendanceImproved;
+    summaryObj["attendance_declined"] = attendanceDeclined;
+    summaryObj["marks_improved"] = marksImproved;
+    summaryObj["marks_declined"] = marksDeclined;
+    summaryObj["significance_z"] = critical;
+    addAttendanceComparison(&summaryObj, schoolStats, critical);
+    addMarksComparison(&summaryObj, schoolStats, critical);
+    
+    QJsonObject reportObj;
+    reportObj["current_period"] = QString("%1 to %2").arg(currentFrom.toString(Qt::ISODate)).arg(currentTo.toString(Qt::ISODate));
+    reportObj["previous_period"] = QString("%1 to %2").arg(previousFrom.toString(Qt::ISODate)).arg(previousTo.toString(Qt::ISODate));
+    reportObj["summary"] = summaryObj;
+    reportObj["students"] = studentsArray;
+    reportObj["classes"] = classesArray;
+    reportObj["subjects"] = subjectsArray;
+    
+    report.jsonData = QJsonDocument(reportObj);
+    return report;
+}
+
+ReportData AdvancedReports::generateTrendAnalysisReport(const QMap<QString, QVariant> &parameters)
+{
+    ReportData report;
+    report.reportType = "Trend Analysis Report";
+    
+    // Analyze trends over the last 6 months by default, from the monthly rollups
+    int months = parameters.value("months", 6).toInt();
+    bool bsMonths = parameters.value("calendar").toString().compare("BS", Qt::CaseInsensitive) == 0;
+    QString grade = parameters.value("grade").toString();
+    QString section = parameters.value("section").toString();
+    QDate toDate = QDate::currentDate();
+    QDate fromDate = toDate.addMonths(-qMax(0, months));
+    
+    QSqlDatabase db = Database::instance().database();
+    QList<AttendanceRollupRow> rows = bsMonths ? AttendanceRollups::bsMonthly(db, fromDate, toDate, grade, section)
+                                               : AttendanceRollups::monthly(db, fromDate, toDate, grade, section);
+    
+    // Rows come per class; the trend is per month
+    QJsonArray trendsArray;
+    for (int i = 0; i < rows.size();) {
+        const AttendanceRollupRow &first = rows.at(i);
+        int presentCount = 0;
+        int totalCount = 0;
+        for (; i < rows.size() && rows.at(i).periodStart == first.periodStart; ++i) {
+            presentCount += rows.at(i).present + rows.at(i).late;
+            totalCount += rows.at(i).total;
+        }
+        
+        QJsonObject monthObj;
+        if (bsMonths) {
+            monthObj["month"] = NepaliCalendar::getNepaliMonthName(first.bsMonthIndex % 12 + 1) + " "
+                                + QString::number(first.bsMonthIndex / 12);
+        } else {
+            monthObj["month"] = first.periodStart.toString("yyyy-MM-dd");
+        }
+        monthObj["present_count"] = presentCount;
+        monthObj["total_count"] = totalCount;
+        monthObj["attendance_rate"] = totalCount > 0 ? presentCount * 100.0 / totalCount : 0.0;
+        trendsArray.append(monthObj);
     }
     
+    QJsonObject reportObj;
+    reportObj["attendance_trends"] = trendsArray;
+    
+    report.jsonData = QJsonDocument(reportObj);
+    
     return report;
 }
 
@@ -803,8 +2199,10 @@ bool AdvancedReports::createDatabaseTables()
             generated_date TIMESTAMP NOT NULL,
             file_path TEXT,
             file_size INTEGER,
+            duration_ms INTEGER,
             generated_by TEXT,
-            status TEXT DEFAULT 'Generated'
+            status TEXT DEFAULT 'Generated',
+            report_data BLOB
         )
     )";
     
@@ -813,5 +2211,9 @@ bool AdvancedReports::createDatabaseTables()
         return false;
     }
     
+    // Tables created before these columns existed; fails harmlessly once they do
+    query.exec("ALTER TABLE report_history ADD COLUMN duration_ms INTEGER");
+    query.exec("ALTER TABLE report_history ADD COLUMN report_data BLOB");
+    
     return true;
 }
@@ -0,0 +1,438 @@
+#include "reports/analyticscube.h"
+#include "database/database.h"
+#include "database/dataversions.h"
+#include "attendance/attendancerollups.h"
+#include "models/nepalicalendar.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QSet>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+// Cell key: grade, section, subject and teacher ids in 12 bits each, BS month index in the top 16
+const int kMemberBits = 12;
+const int kMaxMembers = (1 << kMemberBits) - 1;
+const int kShifts[] = { 0, 12, 48, 24, 36 };        // Indexed by AnalyticsCube::Dimension
+const quint64 kMasks[] = { 0xFFF, 0xFFF, 0xFFFF, 0xFFF, 0xFFF };
+const int kDimensionCount = 5;
+
+const QStringList kAttendanceTables = { "advanced_attendance", "enhanced_students" };
+const QStringList kExamTables = { "exam_results", "enhanced_students", "teachers", "classes" };
+
+// classes.grade is a number, enhanced_students.grade free text such as "10" or "Grade 10"
+QString teacherKey(const QString &grade, const QString &subject)
+{
+    QString digits;
+    for (const QChar &c : grade) {
+        if (c.isDigit()) {
+            digits += c;
+        }
+    }
+    QString gradeKey = digits.isEmpty() ? grade.trimmed() : QString::number(digits.toInt());
+    return gradeKey + QLatin1Char('|') + subject.trimmed().toLower();
+}
+
+bool keysLessThan(const QStringList &a, const QStringList &b)
+{
+    for (int i = 0; i < a.size() && i < b.size(); ++i) {
+        if (a.at(i) == b.at(i)) {
+            continue;
+        }
+        bool aNumber = false;
+        bool bNumber = false;
+        int aValue = a.at(i).toInt(&aNumber);
+        int bValue = b.at(i).toInt(&bNumber);
+        if (aNumber && bNumber) {
+            return aValue < bValue;
+        }
+        return QString::localeAwareCompare(a.at(i), b.at(i)) < 0;
+    }
+    return a.size() < b.size();
+}
+
+} // namespace
+
+void CubeMeasures::add(const CubeMeasures &other)
+{
+    present += other.present;
+    late += other.late;
+    absent += other.absent;
+    excused += other.excused;
+    marksObtained += other.marksObtained;
+    totalMarks += other.totalMarks;
+    resultCount += other.resultCount;
+}
+
+AnalyticsCube &AnalyticsCube::instance()
+{
+    static AnalyticsCube cube;
+    return cube;
+}
+
+AnalyticsCube::AnalyticsCube()
+    : m_examWatermark(0)
+    , m_members(kDimensionCount, QStringList{ QString() })
+    , m_memberIds(kDimensionCount, QHash<QString, int>{ { QString(), 0 } })
+{
+}
+
+quint64 AnalyticsCube::cellKey(int grade, int section, int month, int subject, int teacher)
+{
+    return (quint64(grade) << kShifts[Grade])
+         | (quint64(section) << kShifts[Section])
+         | (quint64(month) << kShifts[BsMonth])
+         | (quint64(subject) << kShifts[Subject])
+         | (quint64(teacher) << kShifts[Teacher]);
+}
+
+int AnalyticsCube::field(quint64 key, Dimension dimension)
+{
+    return static_cast<int>((key >> kShifts[dimension]) & kMasks[dimension]);
+}
+
+int AnalyticsCube::memberId(Dimension dimension, const QString &member)
+{
+    auto it = m_memberIds[dimension].constFind(member);
+    if (it != m_memberIds[dimension].constEnd()) {
+        return it.value();
+    }
+
+    int id = m_members[dimension].size();
+    if (id > kMaxMembers) {
+        qDebug() << "Analytics cube dimension" << dimension << "is full; counting" << member << "as blank";
+        return 0;
+    }
+    m_members[dimension].append(member);
+    m_memberIds[dimension].insert(member, id);
+    return id;
+}
+
+QString AnalyticsCube::memberName(Dimension dimension, int id) const
+{
+    if (dimension == BsMonth) {
+        return QString::number(id);
+    }
+    return m_members.at(dimension).value(id);
+}
+
+QString AnalyticsCube::monthLabel(int monthIndex)
+{
+    return QString("%1 %2").arg(NepaliCalendar::getNepaliMonthName(monthIndex % 12 + 1)).arg(monthIndex / 12);
+}
+
+void AnalyticsCube::invalidate()
+{
+    m_attendance.loaded = false;
+    m_exams.loaded = false;
+}
+
+void AnalyticsCube::ensureCurrent()
+{
+    // Versions are taken before loading, so a write during the load is picked up next time
+    QHash<QString, quint64> attendanceVersions = DataVersions::instance().versions(kAttendanceTables);
+    if (!m_attendance.loaded || m_attendance.versions != attendanceVersions) {
+        // A roster edit can move a student to another class in every month
+        bool monthsOnly = m_attendance.loaded && m_attendance.versions.value("enhanced_students")
+                                                 == attendanceVersions.value("enhanced_students");
+        m_attendance.loaded = monthsOnly ? reloadAttendanceMonths() : loadAttendance();
+        m_attendance.versions = attendanceVersions;
+    }
+
+    QHash<QString, quint64> examVersions = DataVersions::instance().versions(kExamTables);
+    if (m_exams.loaded && m_exams.versions == examVersions) {
+        return;
+    }
+
+    // exam_results is insert-only, so on its own a change only adds rows past the watermark
+    bool appendOnly = m_exams.loaded;
+    for (const QString &table : kExamTables) {
+        if (table != "exam_results" && m_exams.versions.value(table) != examVersions.value(table)) {
+            appendOnly = false;
+        }
+    }
+    m_exams.loaded = loadExamResults(appendOnly);
+    m_exams.versions = examVersions;
+}
+
+bool AnalyticsCube::ensureChangeLog(QSqlDatabase db)
+{
+    static const QStringList statements = {
+        "CREATE TABLE IF NOT EXISTS analytics_cube_attendance_dirty (date DATE PRIMARY KEY) WITHOUT ROWID",
+        R"(
+        CREATE TRIGGER IF NOT EXISTS trg_analytics_cube_attendance_insert
+        AFTER INSERT ON advanced_attendance
+        BEGIN
+            INSERT OR IGNORE INTO analytics_cube_attendance_dirty (date) VALUES (NEW.date);
+        END
+        )",
+        R"(
+        CREATE TRIGGER IF NOT EXISTS trg_analytics_cube_attendance_update
+        AFTER UPDATE OF student_roll, date, status ON advanced_attendance
+        BEGIN
+            INSERT OR IGNORE INTO analytics_cube_attendance_dirty (date) VALUES (OLD.date);
+            INSERT OR IGNORE INTO analytics_cube_attendance_dirty (date) VALUES (NEW.date);
+        END
+        )",
+        R"(
+        CREATE TRIGGER IF NOT EXISTS trg_analytics_cube_attendance_delete
+        AFTER DELETE ON advanced_attendance
+        BEGIN
+            INSERT OR IGNORE INTO analytics_cube_attendance_dirty (date) VALUES (OLD.date);
+        END
+        )"
+    };
+
+    QSqlQuery query(db);
+    for (const QString &statement : statements) {
+        if (!query.exec(statement)) {
+            qDebug() << "Failed to create analytics cube change log:" << query.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
+void AnalyticsCube::addAttendanceRows(const QList<AttendanceRollupRow> &rows)
+{
+    for (const AttendanceRollupRow &row : rows) {
+        if (row.bsMonthIndex < 0) {
+            continue;
+        }
+        quint64 key = cellKey(memberId(Grade, row.grade), memberId(Section, row.section), row.bsMonthIndex, 0, 0);
+        CubeMeasures &cell = m_attendance.cells[key];
+        cell.present += row.present;
+        cell.late += row.late;
+        cell.absent += row.absent;
+        cell.excused += row.excused;
+    }
+}
+
+bool AnalyticsCube::loadAttendance()
+{
+    QSqlDatabase db = Database::instance().database();
+    m_attendance.cells.clear();
+
+    // Cleared before reading, so a write during the load is noted again for the next refresh
+    QSqlQuery range(db);
+    if (!ensureChangeLog(db) || !range.exec("DELETE FROM analytics_cube_attendance_dirty")) {
+        qDebug() << "Failed to reset analytics cube change log:" << range.lastError().text();
+        return false;
+    }
+    if (!range.exec("SELECT MIN(date), MAX(date) FROM advanced_attendance")) {
+        qDebug() << "Failed to read attendance range:" << range.lastError().text();
+        return false;
+    }
+    if (!range.next() || range.value(0).isNull()) {
+        return true;
+    }
+
+    QDate fromDate = range.value(0).toDate();
+    QDate toDate = qMax(range.value(1).toDate(), QDate::currentDate());
+
+    // One row per class per BS month; closed months come straight from the rollup table
+    addAttendanceRows(AttendanceRollups::bsMonthly(db, fromDate, toDate));
+    return true;
+}
+
+bool AnalyticsCube::reloadAttendanceMonths()
+{
+    QSqlDatabase db = Database::instance().database();
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    if (!query.exec("SELECT date FROM analytics_cube_attendance_dirty")) {
+        qDebug() << "Failed to read analytics cube change log:" << query.lastError().text();
+        return false;
+    }
+
+    QVariantList dates;
+    QSet<int> months;
+    while (query.next()) {
+        dates.append(query.value(0));
+        int month = NepaliCalendar::getNepaliMonthIndex(query.value(0).toDate());
+        if (month >= 0) {
+            months.insert(month);
+        }
+    }
+    if (dates.isEmpty()) {
+        return true;
+    }
+
+    // Only the dates read, and before the months are re-read, so a write meanwhile is seen or noted again
+    query.prepare("DELETE FROM analytics_cube_attendance_dirty WHERE date = ?");
+    query.addBindValue(dates);
+    if (!query.execBatch()) {
+        qDebug() << "Failed to clear analytics cube change log:" << query.lastError().text();
+        return false;
+    }
+
+    for (auto it = m_attendance.cells.begin(); it != m_attendance.cells.end();) {
+        if (months.contains(field(it.key(), BsMonth))) {
+            it = m_attendance.cells.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (int month : months) {
+        addAttendanceRows(AttendanceRollups::bsMonthly(db, NepaliCalendar::getNepaliMonthStart(month),
+                                                       NepaliCalendar::getNepaliMonthEnd(month)));
+    }
+    return true;
+}
+
+QHash<QString, QString> AnalyticsCube::subjectTeachers() const
+{
+    QHash<QString, QString> teachers;
+    QSqlQuery query(Database::instance().database());
+    query.setForwardOnly(true);
+
+    if (!query.exec(R"(
+        SELECT c.grade, t.subject, MIN(t.name) as teacher_name
+        FROM teachers t
+        JOIN classes c ON c.id = t.assigned_class
+        WHERE t.is_active = 1
+        GROUP BY c.grade, t.subject
+    )")) {
+        qDebug() << "Failed to load subject teachers:" << query.lastError().text();
+        return teachers;
+    }
+
+    while (query.next()) {
+        teachers.insert(teacherKey(query.value(0).toString(), query.value(1).toString()), query.value(2).toString());
+    }
+    return teachers;
+}
+
+bool AnalyticsCube::loadExamResults(bool append)
+{
+    if (!append) {
+        m_exams.cells.clear();
+        m_examWatermark = 0;
+    }
+
+    QSqlQuery query(Database::instance().database());
+    query.setForwardOnly(true);
+
+    if (!query.exec("SELECT MAX(id) FROM exam_results")) {
+        qDebug() << "Failed to read exam results watermark:" << query.lastError().text();
+        return false;
+    }
+    qint64 through = query.next() ? query.value(0).toLongLong() : 0;
+    if (through <= m_examWatermark) {
+        return true;
+    }
+
+    const QHash<QString, QString> teachers = subjectTeachers();
+
+    query.prepare(R"(
+        SELECT es.grade, es.section, er.exam_date, er.subject,
+               SUM(er.marks_obtained) as marks_obtained,
+               SUM(er.total_marks) as total_marks,
+               COUNT(*) as result_count
+        FROM exam_results er
+        JOIN enhanced_students es ON es.roll_number = er.student_roll
+        WHERE er.id > ? AND er.id <= ?
+        GROUP BY es.grade, es.section, er.exam_date, er.subject
+    )");
+    query.addBindValue(m_examWatermark);
+    query.addBindValue(through);
+
+    if (!query.exec()) {
+        qDebug() << "Failed to load exam results into the cube:" << query.lastError().text();
+        return false;
+    }
+
+    while (query.next()) {
+        int month = NepaliCalendar::getNepaliMonthIndex(query.value(2).toDate());
+        if (month < 0) {
+            continue;
+        }
+
+        QString grade = query.value(0).toString();
+        QString subject = query.value(3).toString();
+        quint64 key = cellKey(memberId(Grade, grade), memberId(Section, query.value(1).toString()), month,
+                              memberId(Subject, subject), memberId(Teacher, teachers.value(teacherKey(grade, subject))));
+
+        CubeMeasures &cell = m_exams.cells[key];
+        cell.marksObtained += query.value(4).toDouble();
+        cell.totalMarks += query.value(5).toDouble();
+        cell.resultCount += query.value(6).toLongLong();
+    }
+
+    m_examWatermark = through;
+    return true;
+}
+
+QList<AnalyticsCube::Row> AnalyticsCube::query(const Query &query)
+{
+    ensureCurrent();
+
+    quint64 groupMask = 0;
+    for (Dimension dimension : query.groupBy) {
+        groupMask |= kMasks[dimension] << kShifts[dimension];
+    }
+
+    // Members are resolved to ids once; an unknown member matches nothing
+    QList<QPair<Dimension, QSet<int>>> filters;
+    for (auto it = query.members.constBegin(); it != query.members.constEnd(); ++it) {
+        if (it.value().isEmpty()) {
+            continue;
+        }
+        QSet<int> ids;
+        for (const QString &member : it.value()) {
+            if (it.key() == BsMonth) {
+                ids.insert(member.toInt());
+            } else if (m_memberIds.at(it.key()).contains(member)) {
+                ids.insert(m_memberIds.at(it.key()).value(member));
+            }
+        }
+        filters.append(qMakePair(it.key(), ids));
+    }
+
+    QHash<quint64, CubeMeasures> groups;
+    for (const Slab *slab : { &m_attendance, &m_exams }) {
+        for (auto it = slab->cells.constBegin(); it != slab->cells.constEnd(); ++it) {
+            quint64 key = it.key();
+            int month = field(key, BsMonth);
+            if ((query.fromMonth >= 0 && month < query.fromMonth) || (query.toMonth >= 0 && month > query.toMonth)) {
+                continue;
+            }
+
+            bool keep = true;
+            for (const auto &filter : filters) {
+                if (!filter.second.contains(field(key, filter.first))) {
+                    keep = false;
+                    break;
+                }
+            }
+            if (keep) {
+                groups[key & groupMask].add(it.value());
+            }
+        }
+    }
+
+    QList<Row> rows;
+    rows.reserve(groups.size());
+    for (auto it = groups.constBegin(); it != groups.constEnd(); ++it) {
+        Row row;
+        for (Dimension dimension : query.groupBy) {
+            row.keys.append(memberName(dimension, field(it.key(), dimension)));
+        }
+        row.measures = it.value();
+        rows.append(row);
+    }
+
+    std::sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) { return keysLessThan(a.keys, b.keys); });
+    return rows;
+}
+
+CubeMeasures AnalyticsCube::total(const Query &query)
+{
+    Query rollup = query;
+    rollup.groupBy.clear();
+    QList<Row> rows = this->query(rollup);
+    return rows.isEmpty() ? CubeMeasures() : rows.first().measures;
+}
@@ -0,0 +1,281 @@
+#include "reports/chartseriesbuilder.h"
+#include "attendance/attendanceheatmap.h"
+#include "models/attendance.h"
+#include <QChart>
+#include <QLineSeries>
+#include <QDateTimeAxis>
+#include <QValueAxis>
+#include <QDateTime>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+#include <cmath>
+
+namespace {
+
+// Below this a plot is too narrow to be worth decimating for
+const int kMinimumWidth = 16;
+const int kDateTicks = 7;
+
+void appendDay(ChartSeriesBuilder::DailyAttendance *daily, const QDate &day, const AttendanceHeatmapTile &counts)
+{
+    double x = QDateTime(day, QTime(0, 0)).toMSecsSinceEpoch();
+    daily->present.append(QPointF(x, counts.present));
+    daily->absent.append(QPointF(x, counts.absent));
+    daily->late.append(QPointF(x, counts.late));
+    daily->excused.append(QPointF(x, counts.excused));
+    daily->rate.append(QPointF(x, qMax(0.0, counts.rate()) * 100));
+}
+
+} // namespace
+
+ChartSeriesBuilder::DailyAttendance ChartSeriesBuilder::dailyAttendance(QSqlDatabase db, const QDate &startDate,
+                                                                        const QDate &endDate, const QString &grade)
+{
+    DailyAttendance daily;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    // Walks idx_advanced_attendance_date; a five-year range comes back as
+    // a few thousand grouped rows rather than every mark
+    QString queryStr = "SELECT aa.date, aa.status, COUNT(*) AS count FROM advanced_attendance aa";
+    if (!grade.isEmpty()) {
+        queryStr += " JOIN enhanced_students es ON es.roll_number = aa.student_roll AND es.grade = ?";
+    }
+    queryStr += " WHERE aa.date BETWEEN ? AND ? GROUP BY aa.date, aa.status ORDER BY aa.date";
+
+    query.prepare(queryStr);
+    if (!grade.isEmpty()) {
+        query.addBindValue(grade);
+    }
+    query.addBindValue(startDate);
+    query.addBindValue(endDate);
+
+    if (!query.exec()) {
+        qDebug() << "Failed to load daily attendance:" << query.lastError().text();
+        return daily;
+    }
+
+    QDate day;
+    AttendanceHeatmapTile counts;
+
+    auto flush = [&]() {
+        if (day.isValid()) {
+            appendDay(&daily, day, counts);
+        }
+    };
+
+    while (query.next()) {
+        QDate date = query.value(0).toDate();
+        if (date != day) {
+            flush();
+            day = date;
+            counts = AttendanceHeatmapTile();
+        }
+
+        QString status = query.value(1).toString();
+        int count = query.value(2).toInt();
+        if (status == "Present") {
+            counts.present += count;
+        } else if (status == "Late") {
+            counts.late += count;
+        } else if (status == "Absent") {
+            counts.absent += count;
+        } else if (status == "Excused") {
+            counts.excused += count;
+        }
+    }
+    flush();
+
+    return daily;
+}
+
+ChartSeriesBuilder::DailyAttendance ChartSeriesBuilder::dailyAttendance(QSqlDatabase db, const QDate &startDate,
+                                                                        const QDate &endDate, int classId)
+{
+    DailyAttendance daily;
+    const QMap<QDate, AttendanceHeatmapTile> days = classDailyCounts(db, classId, startDate, endDate);
+    for (auto it = days.constBegin(); it != days.constEnd(); ++it) {
+        appendDay(&daily, it.key(), it.value());
+    }
+    return daily;
+}
+
+QMap<QDate, AttendanceHeatmapTile> ChartSeriesBuilder::classDailyCounts(QSqlDatabase db, int classId,
+                                                                        const QDate &startDate, const QDate &endDate)
+{
+    QMap<QDate, AttendanceHeatmapTile> days;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    query.prepare("SELECT date, status, COUNT(*) AS count FROM attendance "
+                  "WHERE class_id = ? AND date BETWEEN ? AND ? GROUP BY date, status");
+    query.addBindValue(classId);
+    query.addBindValue(startDate);
+    query.addBindValue(endDate);
+
+    if (!query.exec()) {
+        qDebug() << "Failed to load class attendance:" << query.lastError().text();
+        return days;
+    }
+
+    while (query.next()) {
+        AttendanceHeatmapTile &counts = days[query.value(0).toDate()];
+        int count = query.value(2).toInt();
+        switch (query.value(1).toInt()) {
+        case Attendance::Present: counts.present += count; break;
+        case Attendance::Late: counts.late += count; break;
+        case Attendance::Absent: counts.absent += count; break;
+        case Attendance::Leave: counts.excused += count; break;
+        default: break;
+        }
+    }
+
+    return days;
+}
+
+QList<QPointF> ChartSeriesBuilder::lttb(const QList<QPointF> &points, int threshold)
+{
+    int count = points.size();
+    if (threshold < 3 || count <= threshold) {
+        return points;
+    }
+
+    QList<QPointF> sampled;
+    sampled.reserve(threshold);
+    sampled.append(points.first());
+
+    // First and last points are kept; the rest is split into threshold - 2
+    // buckets and each contributes the point forming the largest triangle
+    // with the previous pick and the average of the next bucket
+    double bucketSize = double(count - 2) / (threshold - 2);
+    int previous = 0;
+
+    for (int bucket = 0; bucket < threshold - 2; ++bucket) {
+        int nextStart = static_cast<int>(std::floor((bucket + 1) * bucketSize)) + 1;
+        int nextEnd = qMin(static_cast<int>(std::floor((bucket + 2) * bucketSize)) + 1, count);
+        double averageX = 0.0;
+        double averageY = 0.0;
+        for (int i = nextStart; i < nextEnd; ++i) {
+            averageX += points.at(i).x();
+            averageY += points.at(i).y();
+        }
+        int nextCount = qMax(1, nextEnd - nextStart);
+        averageX /= nextCount;
+        averageY /= nextCount;
+
+        int start = static_cast<int>(std::floor(bucket * bucketSize)) + 1;
+        int end = static_cast<int>(std::floor((bucket + 1) * bucketSize)) + 1;
+        const QPointF &anchor = points.at(previous);
+
+        double largestArea = -1.0;
+        int chosen = start;
+        for (int i = start; i < end; ++i) {
+            double area = std::fabs((anchor.x() - averageX) * (points.at(i).y() - anchor.y())
+                                    - (anchor.x() - points.at(i).x()) * (averageY - anchor.y()));
+            if (area > largestArea) {
+                largestArea = area;
+                chosen = i;
+            }
+        }
+
+        sampled.append(points.at(chosen));
+        previous = chosen;
+    }
+
+    sampled.append(points.last());
+    return sampled;
+}
+
+QList<QPointF> ChartSeriesBuilder::minMax(const QList<QPointF> &points, int buckets)
+{
+    int count = points.size();
+    if (buckets < 1 || count <= 2 * buckets) {
+        return points;
+    }
+
+    QList<QPointF> sampled;
+    sampled.reserve(2 * buckets);
+
+    // Each bucket keeps its lowest and highest point, in x order
+    for (int bucket = 0; bucket < buckets; ++bucket) {
+        int start = static_cast<int>(qint64(bucket) * count / buckets);
+        int end = static_cast<int>(qint64(bucket + 1) * count / buckets);
+        int low = start;
+        int high = start;
+        for (int i = start + 1; i < end; ++i) {
+            if (points.at(i).y() < points.at(low).y()) low = i;
+            if (points.at(i).y() > points.at(high).y()) high = i;
+        }
+
+        sampled.append(points.at(qMin(low, high)));
+        if (low != high) {
+            sampled.append(points.at(qMax(low, high)));
+        }
+    }
+
+    return sampled;
+}
+
+QList<QPointF> ChartSeriesBuilder::decimate(const QList<QPointF> &points, int pixelWidth, Decimation method)
+{
+    int width = qMax(kMinimumWidth, pixelWidth);
+    // Min-max emits two points per bucket, so it gets half as many buckets
+    return method == MinMax ? minMax(points, width / 2) : lttb(points, width);
+}
+
+QLineSeries *ChartSeriesBuilder::lineSeries(const QString &name, const QList<QPointF> &points, int pixelWidth,
+                                            Decimation method)
+{
+    QLineSeries *series = new QLineSeries();
+    series->setName(name);
+    series->replace(decimate(points, pixelWidth, method));
+    return series;
+}
+
+void ChartSeriesBuilder::replacePoints(QLineSeries *series, const QList<QPointF> &points, int pixelWidth,
+                                       Decimation method)
+{
+    series->replace(decimate(points, pixelWidth, method));
+}
+
+void ChartSeriesBuilder::attachTimeAxes(QChart *chart, const QString &yTitle, double yMin, double yMax)
+{
+    double first = 0.0;
+    double last = 0.0;
+    bool any = false;
+    const QList<QAbstractSeries *> seriesList = chart->series();
+    for (QAbstractSeries *abstract : seriesList) {
+        QXYSeries *series = qobject_cast<QXYSeries *>(abstract);
+        if (!series || series->count() == 0) {
+            continue;
+        }
+        first = any ? qMin(first, series->at(0).x()) : series->at(0).x();
+        last = any ? qMax(last, series->at(series->count() - 1).x()) : series->at(series->count() - 1).x();
+        any = true;
+    }
+
+    QDateTimeAxis *axisX = new QDateTimeAxis();
+    axisX->setTickCount(kDateTicks);
+    if (any) {
+        QDateTime from = QDateTime::fromMSecsSinceEpoch(static_cast<qint64>(first));
+        QDateTime to = QDateTime::fromMSecsSinceEpoch(static_cast<qint64>(last));
+        qint64 days = from.daysTo(to);
+        axisX->setFormat(days > 2 * 365 ? "yyyy" : days > 60 ? "MMM yyyy" : "dd MMM");
+        axisX->setRange(from, to);
+    } else {
+        axisX->setFormat("dd MMM");
+    }
+    axisX->setTitleText("Date");
+    chart->addAxis(axisX, Qt::AlignBottom);
+
+    QValueAxis *axisY = new QValueAxis();
+    axisY->setTitleText(yTitle);
+    axisY->setRange(yMin, yMax);
+    chart->addAxis(axisY, Qt::AlignLeft);
+
+    for (QAbstractSeries *series : seriesList) {
+        series->attachAxis(axisX);
+        series->attachAxis(axisY);
+    }
+}
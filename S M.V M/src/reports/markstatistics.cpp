@@ -0,0 +1,457 @@
+#include "reports/markstatistics.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SMARTMAVI_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+// Values buffered per unit of compression before a merge
+const int kBufferFactor = 5;
+
+// First pass: total, lowest and highest of count > 0 values
+void sumMinMax(const float *values, int count, double *total, float *lowest, float *highest)
+{
+    int i = 0;
+    double sum = 0.0;
+    float minimum = values[0];
+    float maximum = values[0];
+
+#ifdef SMARTMAVI_HAVE_SSE2
+    if (count >= 4) {
+        __m128d sumLow = _mm_setzero_pd();
+        __m128d sumHigh = _mm_setzero_pd();
+        __m128 minimums = _mm_loadu_ps(values);
+        __m128 maximums = minimums;
+        for (; i + 4 <= count; i += 4) {
+            __m128 x = _mm_loadu_ps(values + i);
+            sumLow = _mm_add_pd(sumLow, _mm_cvtps_pd(x));
+            sumHigh = _mm_add_pd(sumHigh, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+            minimums = _mm_min_ps(minimums, x);
+            maximums = _mm_max_ps(maximums, x);
+        }
+
+        double sums[2];
+        float lows[4];
+        float highs[4];
+        _mm_storeu_pd(sums, _mm_add_pd(sumLow, sumHigh));
+        _mm_storeu_ps(lows, minimums);
+        _mm_storeu_ps(highs, maximums);
+        sum = sums[0] + sums[1];
+        for (int lane = 0; lane < 4; ++lane) {
+            minimum = std::min(minimum, lows[lane]);
+            maximum = std::max(maximum, highs[lane]);
+        }
+    }
+#endif
+
+    for (; i < count; ++i) {
+        sum += values[i];
+        minimum = std::min(minimum, values[i]);
+        maximum = std::max(maximum, values[i]);
+    }
+
+    *total = sum;
+    *lowest = minimum;
+    *highest = maximum;
+}
+
+// Second pass: sums of squared and cubed deviations from mean
+void centralMoments(const float *values, int count, double mean, double *squares, double *cubes)
+{
+    int i = 0;
+    double m2 = 0.0;
+    double m3 = 0.0;
+
+#ifdef SMARTMAVI_HAVE_SSE2
+    __m128d centre = _mm_set1_pd(mean);
+    __m128d squareSums = _mm_setzero_pd();
+    __m128d cubeSums = _mm_setzero_pd();
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(values + i);
+        __m128d low = _mm_sub_pd(_mm_cvtps_pd(x), centre);
+        __m128d high = _mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(x, x)), centre);
+        __m128d lowSquared = _mm_mul_pd(low, low);
+        __m128d highSquared = _mm_mul_pd(high, high);
+        squareSums = _mm_add_pd(squareSums, _mm_add_pd(lowSquared, highSquared));
+        cubeSums = _mm_add_pd(cubeSums, _mm_add_pd(_mm_mul_pd(lowSquared, low), _mm_mul_pd(highSquared, high)));
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, squareSums);
+    m2 = lanes[0] + lanes[1];
+    _mm_storeu_pd(lanes, cubeSums);
+    m3 = lanes[0] + lanes[1];
+#endif
+
+    for (; i < count; ++i) {
+        double deviation = values[i] - mean;
+        m2 += deviation * deviation;
+        m3 += deviation * deviation * deviation;
+    }
+
+    *squares = m2;
+    *cubes = m3;
+}
+
+} // namespace
+
+TDigest::TDigest(double compression)
+    : m_compression(std::max(20.0, compression))
+    , m_mergedWeight(0.0)
+    , m_bufferedWeight(0.0)
+    , m_minimum(0.0)
+    , m_maximum(0.0)
+{
+}
+
+void TDigest::add(double value, double weight)
+{
+    if (weight <= 0.0 || std::isnan(value)) {
+        return;
+    }
+
+    m_minimum = isEmpty() ? value : std::min(m_minimum, value);
+    m_maximum = isEmpty() ? value : std::max(m_maximum, value);
+    m_buffer.push_back({value, weight});
+    m_bufferedWeight += weight;
+
+    if (m_buffer.size() >= static_cast<size_t>(kBufferFactor * m_compression)) {
+        flush();
+    }
+}
+
+void TDigest::add(const float *values, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        add(values[i]);
+    }
+}
+
+void TDigest::merge(const TDigest &other)
+{
+    if (other.isEmpty()) {
+        return;
+    }
+    other.flush();
+
+    double minimum = isEmpty() ? other.m_minimum : std::min(m_minimum, other.m_minimum);
+    double maximum = isEmpty() ? other.m_maximum : std::max(m_maximum, other.m_maximum);
+    // Centroids go back through the buffer and are re-clustered with ours
+    for (const Centroid &centroid : other.m_centroids) {
+        m_buffer.push_back(centroid);
+        m_bufferedWeight += centroid.weight;
+    }
+    m_minimum = minimum;
+    m_maximum = maximum;
+    flush();
+}
+
+int TDigest::centroidCount() const
+{
+    flush();
+    return static_cast<int>(m_centroids.size());
+}
+
+void TDigest::flush() const
+{
+    if (m_buffer.empty()) {
+        return;
+    }
+
+    m_buffer.insert(m_buffer.end(), m_centroids.begin(), m_centroids.end());
+    std::sort(m_buffer.begin(), m_buffer.end(), [](const Centroid &a, const Centroid &b) {
+        return a.mean < b.mean;
+    });
+
+    double total = m_mergedWeight + m_bufferedWeight;
+    // k1 scale: k(q) = compression / 2pi * asin(2q - 1). A centroid may span
+    // one unit of k, which is narrow near q = 0 and q = 1.
+    double normalizer = m_compression / (2.0 * kPi);
+    auto scale = [normalizer](double q) { return normalizer * std::asin(2.0 * q - 1.0); };
+    auto inverse = [normalizer](double k) { return (std::sin(k / normalizer) + 1.0) / 2.0; };
+
+    std::vector<Centroid> merged;
+    merged.reserve(static_cast<size_t>(m_compression));
+    Centroid current = m_buffer.front();
+    double weightBefore = 0.0;
+    double limit = total * inverse(scale(0.0) + 1.0);
+
+    for (size_t i = 1; i < m_buffer.size(); ++i) {
+        const Centroid &next = m_buffer[i];
+        if (weightBefore + current.weight + next.weight <= limit) {
+            current.weight += next.weight;
+            current.mean += (next.mean - current.mean) * next.weight / current.weight;
+        } else {
+            weightBefore += current.weight;
+            merged.push_back(current);
+            limit = total * inverse(scale(std::min(1.0, weightBefore / total)) + 1.0);
+            current = next;
+        }
+    }
+    merged.push_back(current);
+
+    m_centroids.swap(merged);
+    m_buffer.clear();
+    m_mergedWeight = total;
+    m_bufferedWeight = 0.0;
+}
+
+double TDigest::quantile(double q) const
+{
+    if (isEmpty()) {
+        return 0.0;
+    }
+    flush();
+
+    if (q <= 0.0) {
+        return m_minimum;
+    }
+    if (q >= 1.0) {
+        return m_maximum;
+    }
+
+    int count = static_cast<int>(m_centroids.size());
+    if (count == 1) {
+        return m_minimum + q * (m_maximum - m_minimum);
+    }
+
+    // Each centroid's mean sits at the middle of its weight; interpolate
+    // between neighbouring middles, and towards min and max at the ends
+    double index = q * m_mergedWeight;
+    const Centroid &first = m_centroids.front();
+    if (index < first.weight / 2.0) {
+        return m_minimum + (first.mean - m_minimum) * index / (first.weight / 2.0);
+    }
+
+    double weightSoFar = first.weight / 2.0;
+    for (int i = 0; i + 1 < count; ++i) {
+        const Centroid &left = m_centroids[i];
+        const Centroid &right = m_centroids[i + 1];
+        double gap = (left.weight + right.weight) / 2.0;
+        if (weightSoFar + gap > index) {
+            double fraction = (index - weightSoFar) / gap;
+            return left.mean + fraction * (right.mean - left.mean);
+        }
+        weightSoFar += gap;
+    }
+
+    const Centroid &last = m_centroids.back();
+    double fraction = std::min(1.0, (index - weightSoFar) / (last.weight / 2.0));
+    return last.mean + fraction * (m_maximum - last.mean);
+}
+
+double TDigest::cdf(double value) const
+{
+    if (isEmpty() || value < m_minimum) {
+        return 0.0;
+    }
+    if (value >= m_maximum) {
+        return 1.0;
+    }
+    flush();
+
+    int count = static_cast<int>(m_centroids.size());
+    if (count == 1 || m_maximum == m_minimum) {
+        return (value - m_minimum) / (m_maximum - m_minimum);
+    }
+
+    const Centroid &first = m_centroids.front();
+    if (value < first.mean) {
+        return (first.weight / 2.0) * (value - m_minimum) / (first.mean - m_minimum) / m_mergedWeight;
+    }
+
+    double weightSoFar = first.weight / 2.0;
+    for (int i = 0; i + 1 < count; ++i) {
+        const Centroid &left = m_centroids[i];
+        const Centroid &right = m_centroids[i + 1];
+        double gap = (left.weight + right.weight) / 2.0;
+        if (value < right.mean) {
+            double fraction = right.mean > left.mean ? (value - left.mean) / (right.mean - left.mean) : 0.5;
+            return (weightSoFar + fraction * gap) / m_mergedWeight;
+        }
+        weightSoFar += gap;
+    }
+
+    const Centroid &last = m_centroids.back();
+    double fraction = (value - last.mean) / (m_maximum - last.mean);
+    return std::min(1.0, (weightSoFar + fraction * last.weight / 2.0) / m_mergedWeight);
+}
+
+double MarkStatistics::sum(const float *values, int count)
+{
+    if (count <= 0) {
+        return 0.0;
+    }
+    double total;
+    float lowest;
+    float highest;
+    sumMinMax(values, count, &total, &lowest, &highest);
+    return total;
+}
+
+double MarkStatistics::quantile(float *values, int count, double q)
+{
+    if (count <= 0) {
+        return 0.0;
+    }
+
+    double rank = std::clamp(q, 0.0, 1.0) * (count - 1);
+    int below = static_cast<int>(std::floor(rank));
+    std::nth_element(values, values + below, values + count);
+    double value = values[below];
+    if (below + 1 < count && rank > below) {
+        // After nth_element everything past below is at least as large; the next rank is their minimum
+        float next = *std::min_element(values + below + 1, values + count);
+        value += (rank - below) * (next - value);
+    }
+    return value;
+}
+
+MarkSummary MarkStatistics::summarize(const float *values, int count)
+{
+    MarkSummary summary;
+    if (count <= 0) {
+        return summary;
+    }
+
+    double total;
+    float lowest;
+    float highest;
+    sumMinMax(values, count, &total, &lowest, &highest);
+
+    summary.count = count;
+    summary.mean = total / count;
+    summary.minimum = lowest;
+    summary.maximum = highest;
+
+    double squares;
+    double cubes;
+    centralMoments(values, count, summary.mean, &squares, &cubes);
+    if (count > 1) {
+        summary.variance = squares / (count - 1);
+        summary.standardDeviation = std::sqrt(summary.variance);
+    }
+    if (count > 2 && squares > 0.0) {
+        double populationSkew = (cubes / count) / std::pow(squares / count, 1.5);
+        summary.skewness = populationSkew * std::sqrt(double(count) * (count - 1)) / (count - 2);
+    }
+
+    // Selection on a scratch copy, linear per quartile
+    std::vector<float> scratch(values, values + count);
+    summary.q1 = quantile(scratch.data(), count, 0.25);
+    summary.median = quantile(scratch.data(), count, 0.5);
+    summary.q3 = quantile(scratch.data(), count, 0.75);
+    return summary;
+}
+
+QVector<int> MarkStatistics::histogram(const float *values, int count, int bins, float low, float high)
+{
+    QVector<int> counts(qMax(1, bins), 0);
+    int last = counts.size() - 1;
+    float scale = high > low ? counts.size() / (high - low) : 0.0f;
+    int i = 0;
+
+#ifdef SMARTMAVI_HAVE_SSE2
+    // Bin indexes four at a time, clamped in float before truncation
+    __m128 origin = _mm_set1_ps(low);
+    __m128 factor = _mm_set1_ps(scale);
+    __m128 zero = _mm_setzero_ps();
+    __m128 lastBin = _mm_set1_ps(static_cast<float>(last));
+    int indexes[4];
+    for (; i + 4 <= count; i += 4) {
+        __m128 position = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(values + i), origin), factor);
+        position = _mm_min_ps(_mm_max_ps(position, zero), lastBin);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(indexes), _mm_cvttps_epi32(position));
+        ++counts[indexes[0]];
+        ++counts[indexes[1]];
+        ++counts[indexes[2]];
+        ++counts[indexes[3]];
+    }
+#endif
+
+    for (; i < count; ++i) {
+        float position = std::clamp((values[i] - low) * scale, 0.0f, static_cast<float>(last));
+        ++counts[static_cast<int>(position)];
+    }
+    return counts;
+}
+
+QList<MarkSample> MarkStatistics::load(QSqlDatabase db, const QString &grade, const QDate &fromDate,
+                                       const QDate &toDate)
+{
+    QList<MarkSample> samples;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    query.prepare(R"(
+        SELECT es.section, er.subject, er.marks_obtained * 100.0 / er.total_marks as percentage
+        FROM exam_results er
+        JOIN enhanced_students es ON es.roll_number = er.student_roll
+        WHERE es.grade = ? AND er.exam_date BETWEEN ? AND ? AND er.total_marks > 0
+        ORDER BY es.section, er.subject
+    )");
+    query.addBindValue(grade);
+    query.addBindValue(fromDate);
+    query.addBindValue(toDate);
+
+    if (!query.exec()) {
+        qDebug() << "Failed to load marks:" << query.lastError().text();
+        return samples;
+    }
+
+    // Rows arrive grouped, so each value is appended to its section's sample and its subject's
+    int sectionIndex = -1;
+    int subjectIndex = -1;
+    while (query.next()) {
+        QString section = query.value(0).toString();
+        QString subject = query.value(1).toString();
+
+        if (sectionIndex < 0 || samples.at(sectionIndex).section != section) {
+            samples.append({section, QString(), QVector<float>()});
+            sectionIndex = samples.size() - 1;
+            subjectIndex = -1;
+        }
+        if (subjectIndex < 0 || samples.at(subjectIndex).subject != subject) {
+            samples.append({section, subject, QVector<float>()});
+            subjectIndex = samples.size() - 1;
+        }
+
+        float percentage = query.value(2).toFloat();
+        samples[sectionIndex].percentages.append(percentage);
+        samples[subjectIndex].percentages.append(percentage);
+    }
+
+    return samples;
+}
+
+bool MarkStatistics::loadDigest(QSqlDatabase db, const QDate &fromDate, const QDate &toDate, TDigest *digest)
+{
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    query.prepare(R"(
+        SELECT marks_obtained * 100.0 / total_marks
+        FROM exam_results
+        WHERE exam_date BETWEEN ? AND ? AND total_marks > 0
+    )");
+    query.addBindValue(fromDate);
+    query.addBindValue(toDate);
+
+    if (!query.exec()) {
+        qDebug() << "Failed to load school marks:" << query.lastError().text();
+        return false;
+    }
+
+    while (query.next()) {
+        digest->add(query.value(0).toDouble());
+    }
+    return true;
+}
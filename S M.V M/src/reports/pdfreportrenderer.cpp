@@ -0,0 +1,471 @@
+#include "reports/pdfreportrenderer.h"
+#include <QPdfWriter>
+#include <QPainter>
+#include <QPicture>
+#include <QPen>
+#include <QPageSize>
+#include <QFont>
+#include <QFontMetricsF>
+#include <QDateTime>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QDebug>
+#include <cmath>
+
+namespace {
+
+// A4 at 72 dpi, so one device unit is one point
+const double kPageWidth = 595.0;
+const double kPageHeight = 842.0;
+const double kMargin = 40.0;
+const double kHeaderBand = 24.0;
+const double kFooterBand = 20.0;
+const double kContentTop = kMargin + kHeaderBand;
+const double kContentBottom = kPageHeight - kMargin - kFooterBand;
+const double kContentWidth = kPageWidth - 2 * kMargin;
+const double kBlockSpacing = 8.0;
+const double kCellPadding = 3.0;
+const double kChartHeight = 200.0;
+const int kKeepWithHeadingRows = 3;
+
+// Pixel sizes: QPicture replays point-sized fonts scaled by the recording
+// device's dpi, pixel sizes come back unchanged
+QFont pixelFont(int pixels, bool bold = false)
+{
+    QFont font("Helvetica");
+    font.setPixelSize(pixels);
+    font.setBold(bold);
+    return font;
+}
+
+QFont titleFont() { return pixelFont(18, true); }
+QFont headingFont() { return pixelFont(12, true); }
+QFont bodyFont() { return pixelFont(9); }
+QFont tableFont() { return pixelFont(8); }
+QFont tableHeaderFont() { return pixelFont(8, true); }
+QFont smallFont() { return pixelFont(7); }
+
+double wrappedHeight(const QFont &font, const QString &text)
+{
+    QFontMetricsF metrics(font);
+    return metrics.boundingRect(QRectF(0, 0, kContentWidth, 1e6), Qt::TextWordWrap, text).height();
+}
+
+double tableRowHeight()
+{
+    return QFontMetricsF(tableFont()).height() + 2 * kCellPadding;
+}
+
+bool isNumeric(const QString &text)
+{
+    bool ok = false;
+    QString trimmed = text.trimmed();
+    if (trimmed.endsWith(QLatin1Char('%'))) {
+        trimmed.chop(1);
+    }
+    trimmed.toDouble(&ok);
+    return ok;
+}
+
+} // namespace
+
+PdfReportRenderer::PdfReportRenderer(const QString &title, const QString &subtitle)
+    : m_title(title)
+    , m_subtitle(subtitle)
+    , m_generatedOn(QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm"))
+{
+}
+
+PdfReportRenderer::~PdfReportRenderer()
+{
+}
+
+void PdfReportRenderer::addHeading(const QString &text)
+{
+    Block block;
+    block.kind = Block::Heading;
+    block.text = text;
+    m_blocks.append(block);
+}
+
+void PdfReportRenderer::addField(const QString &label, const QString &value)
+{
+    Block block;
+    block.kind = Block::Field;
+    block.text = label;
+    block.value = value;
+    m_blocks.append(block);
+}
+
+void PdfReportRenderer::addParagraph(const QString &text)
+{
+    Block block;
+    block.kind = Block::Paragraph;
+    block.text = text;
+    m_blocks.append(block);
+}
+
+void PdfReportRenderer::addTable(const QStringList &columns, const QList<QStringList> &rows,
+                                 const QList<double> &weights)
+{
+    Block block;
+    block.kind = Block::Table;
+    block.columns = columns;
+    block.rows = rows;
+
+    double total = 0.0;
+    for (int i = 0; i < columns.size(); ++i) {
+        double weight = i < weights.size() && weights.at(i) > 0 ? weights.at(i) : 1.0;
+        block.weights.append(weight);
+        total += weight;
+    }
+    // Stored as fractions of the content width
+    for (double &weight : block.weights) {
+        weight /= total;
+    }
+
+    m_blocks.append(block);
+}
+
+void PdfReportRenderer::addBarChart(const QString &title, const QList<QPair<QString, double>> &bars, double maximum)
+{
+    Block block;
+    block.kind = Block::BarChart;
+    block.text = title;
+    block.bars = bars;
+    block.maximum = maximum;
+    m_blocks.append(block);
+}
+
+void PdfReportRenderer::addPageBreak()
+{
+    Block block;
+    block.kind = Block::PageBreak;
+    m_blocks.append(block);
+}
+
+double PdfReportRenderer::titleHeight() const
+{
+    double height = QFontMetricsF(titleFont()).height() + 4;
+    if (!m_subtitle.isEmpty()) {
+        height += wrappedHeight(bodyFont(), m_subtitle) + 2;
+    }
+    return height + 2 * kBlockSpacing;
+}
+
+double PdfReportRenderer::blockHeight(const Block &block) const
+{
+    switch (block.kind) {
+    case Block::Heading:
+        return QFontMetricsF(headingFont()).height() + 6;
+    case Block::Field:
+        return wrappedHeight(bodyFont(), block.text + ": " + block.value);
+    case Block::Paragraph:
+        return wrappedHeight(bodyFont(), block.text);
+    case Block::BarChart:
+        return kChartHeight;
+    case Block::PageBreak:
+        return 0.0;
+    case Block::Table:
+        break;
+    }
+    return tableRowHeight() * (block.rows.size() + 1);
+}
+
+QVector<PdfReportRenderer::PageLayout> PdfReportRenderer::layout() const
+{
+    QVector<PageLayout> pages(1);
+    double y = kContentTop + titleHeight();
+    double rowHeight = tableRowHeight();
+
+    auto startPage = [&]() {
+        pages.append(PageLayout());
+        y = kContentTop;
+    };
+
+    for (int i = 0; i < m_blocks.size(); ++i) {
+        const Block &block = m_blocks.at(i);
+
+        if (block.kind == Block::PageBreak) {
+            if (y > kContentTop) {
+                startPage();
+            }
+            continue;
+        }
+
+        if (block.kind != Block::Table) {
+            // Over-long text is clipped to one page rather than split
+            double height = qMin(blockHeight(block), kContentBottom - kContentTop);
+            double needed = height;
+            if (block.kind == Block::Heading) {
+                needed += kKeepWithHeadingRows * rowHeight;
+            }
+            if (y + needed > kContentBottom && y > kContentTop) {
+                startPage();
+            }
+
+            Placement placement;
+            placement.block = i;
+            placement.y = y;
+            placement.height = height;
+            pages.last().append(placement);
+            y += height + (block.kind == Block::Heading ? 2 : kBlockSpacing);
+            continue;
+        }
+
+        // Tables split at row boundaries; every part repeats the header row
+        int row = 0;
+        do {
+            if (y + 2 * rowHeight > kContentBottom && y > kContentTop) {
+                startPage();
+            }
+            int fits = qMax(1, static_cast<int>((kContentBottom - y) / rowHeight) - 1);
+
+            Placement placement;
+            placement.block = i;
+            placement.firstRow = row;
+            placement.rowCount = qMin(fits, block.rows.size() - row);
+            placement.y = y;
+            placement.height = rowHeight * (placement.rowCount + 1);
+            pages.last().append(placement);
+
+            y += placement.height + kBlockSpacing;
+            row += placement.rowCount;
+        } while (row < block.rows.size());
+    }
+
+    return pages;
+}
+
+int PdfReportRenderer::pageCount() const
+{
+    return layout().size();
+}
+
+void PdfReportRenderer::drawFrame(QPainter &painter, int index, int pageCount) const
+{
+    painter.setPen(QColor(90, 90, 90));
+    painter.setFont(smallFont());
+
+    QRectF header(kMargin, kMargin, kContentWidth, kHeaderBand - 6);
+    painter.drawText(header, Qt::AlignLeft | Qt::AlignVCenter, "Smart MA.VI Manager - " + m_title);
+    painter.drawText(header, Qt::AlignRight | Qt::AlignVCenter, m_generatedOn);
+    painter.drawLine(QPointF(kMargin, kMargin + kHeaderBand - 4), QPointF(kPageWidth - kMargin, kMargin + kHeaderBand - 4));
+
+    double footerTop = kPageHeight - kMargin - kFooterBand + 6;
+    painter.drawLine(QPointF(kMargin, footerTop), QPointF(kPageWidth - kMargin, footerTop));
+    QRectF footer(kMargin, footerTop + 2, kContentWidth, kFooterBand - 8);
+    painter.drawText(footer, Qt::AlignLeft | Qt::AlignVCenter, "Shree MA.VI Imilya");
+    painter.drawText(footer, Qt::AlignRight | Qt::AlignVCenter, QString("Page %1 of %2").arg(index + 1).arg(pageCount));
+}
+
+void PdfReportRenderer::drawTitle(QPainter &painter) const
+{
+    double y = kContentTop;
+    double titleLine = QFontMetricsF(titleFont()).height() + 4;
+
+    painter.setPen(QColor(44, 62, 80));
+    painter.setFont(titleFont());
+    painter.drawText(QRectF(kMargin, y, kContentWidth, titleLine), Qt::AlignLeft | Qt::AlignVCenter, m_title);
+    y += titleLine;
+
+    if (!m_subtitle.isEmpty()) {
+        painter.setPen(Qt::black);
+        painter.setFont(bodyFont());
+        painter.drawText(QRectF(kMargin, y, kContentWidth, wrappedHeight(bodyFont(), m_subtitle) + 2),
+                         Qt::TextWordWrap, m_subtitle);
+    }
+}
+
+void PdfReportRenderer::drawTable(QPainter &painter, const Block &block, const Placement &placement) const
+{
+    double rowHeight = tableRowHeight();
+    QFontMetricsF metrics(tableFont());
+    QFontMetricsF headerMetrics(tableHeaderFont());
+
+    auto drawRow = [&](const QStringList &cells, double top, const QFontMetricsF &rowMetrics) {
+        double x = kMargin;
+        for (int column = 0; column < block.columns.size(); ++column) {
+            double width = block.weights.at(column) * kContentWidth;
+            QString text = column < cells.size() ? cells.at(column) : QString();
+            QRectF cell(x + kCellPadding, top, width - 2 * kCellPadding, rowHeight);
+            Qt::Alignment align = isNumeric(text) ? Qt::AlignRight : Qt::AlignLeft;
+            painter.drawText(cell, align | Qt::AlignVCenter,
+                             rowMetrics.elidedText(text, Qt::ElideRight, cell.width()));
+            x += width;
+        }
+    };
+
+    double y = placement.y;
+    painter.fillRect(QRectF(kMargin, y, kContentWidth, rowHeight), QColor(224, 224, 224));
+    painter.setPen(Qt::black);
+    painter.setFont(tableHeaderFont());
+    drawRow(block.columns, y, headerMetrics);
+    y += rowHeight;
+
+    painter.setFont(tableFont());
+    for (int i = 0; i < placement.rowCount; ++i) {
+        int row = placement.firstRow + i;
+        if (row % 2 == 1) {
+            painter.fillRect(QRectF(kMargin, y, kContentWidth, rowHeight), QColor(246, 246, 246));
+        }
+        drawRow(block.rows.at(row), y, metrics);
+        y += rowHeight;
+    }
+
+    painter.setPen(QPen(QColor(180, 180, 180), 0.5));
+    painter.drawRect(QRectF(kMargin, placement.y, kContentWidth, placement.height));
+    painter.drawLine(QPointF(kMargin, placement.y + rowHeight), QPointF(kPageWidth - kMargin, placement.y + rowHeight));
+}
+
+void PdfReportRenderer::drawBarChart(QPainter &painter, const Block &block, const Placement &placement) const
+{
+    QFontMetricsF labelMetrics(smallFont());
+    double titleLine = QFontMetricsF(bodyFont()).height() + 4;
+    double labelLine = labelMetrics.height() + 2;
+
+    painter.setPen(Qt::black);
+    painter.setFont(pixelFont(9, true));
+    painter.drawText(QRectF(kMargin, placement.y, kContentWidth, titleLine), Qt::AlignLeft | Qt::AlignVCenter, block.text);
+
+    QRectF plot(kMargin + 30, placement.y + titleLine + labelLine,
+                kContentWidth - 30, placement.height - titleLine - 2 * labelLine - 4);
+
+    double maximum = block.maximum;
+    for (const auto &bar : block.bars) {
+        maximum = qMax(maximum, bar.second);
+    }
+    if (maximum <= 0) {
+        maximum = 1.0;
+    }
+
+    // Axis with quarter gridlines
+    painter.setFont(smallFont());
+    for (int step = 0; step <= 4; ++step) {
+        double y = plot.bottom() - plot.height() * step / 4;
+        painter.setPen(QPen(QColor(220, 220, 220), 0.5));
+        painter.drawLine(QPointF(plot.left(), y), QPointF(plot.right(), y));
+        painter.setPen(QColor(90, 90, 90));
+        painter.drawText(QRectF(kMargin, y - labelLine / 2, 26, labelLine), Qt::AlignRight | Qt::AlignVCenter,
+                         QString::number(maximum * step / 4, 'g', 4));
+    }
+
+    if (block.bars.isEmpty()) {
+        painter.drawText(plot, Qt::AlignCenter, "No data");
+        return;
+    }
+
+    double slot = plot.width() / block.bars.size();
+    double barWidth = qMin(slot * 0.7, 48.0);
+    // Thin out labels when they would overlap
+    int labelEvery = qMax(1, static_cast<int>(std::ceil(40.0 / slot)));
+
+    for (int i = 0; i < block.bars.size(); ++i) {
+        const auto &bar = block.bars.at(i);
+        double height = plot.height() * qBound(0.0, bar.second / maximum, 1.0);
+        double x = plot.left() + slot * i + (slot - barWidth) / 2;
+
+        painter.fillRect(QRectF(x, plot.bottom() - height, barWidth, height), QColor(52, 152, 219));
+
+        painter.setPen(QColor(60, 60, 60));
+        if (slot >= 24) {
+            painter.drawText(QRectF(x - 8, plot.bottom() - height - labelLine, barWidth + 16, labelLine),
+                             Qt::AlignCenter, QString::number(bar.second, 'f', bar.second == std::floor(bar.second) ? 0 : 1));
+        }
+        if (i % labelEvery == 0) {
+            QRectF label(plot.left() + slot * i, plot.bottom() + 2, slot * labelEvery, labelLine);
+            painter.drawText(label, Qt::AlignHCenter | Qt::AlignTop,
+                             labelMetrics.elidedText(bar.first, Qt::ElideRight, label.width()));
+        }
+    }
+
+    painter.setPen(QPen(QColor(90, 90, 90), 0.75));
+    painter.drawLine(plot.bottomLeft(), plot.bottomRight());
+}
+
+QPicture PdfReportRenderer::renderPage(int index, const PageLayout &page, int pageCount) const
+{
+    QPicture picture;
+    QPainter painter(&picture);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setRenderHint(QPainter::TextAntialiasing);
+
+    drawFrame(painter, index, pageCount);
+    if (index == 0) {
+        drawTitle(painter);
+    }
+
+    for (const Placement &placement : page) {
+        const Block &block = m_blocks.at(placement.block);
+        QRectF area(kMargin, placement.y, kContentWidth, placement.height);
+
+        switch (block.kind) {
+        case Block::Heading:
+            painter.setPen(QColor(44, 62, 80));
+            painter.setFont(headingFont());
+            painter.drawText(area, Qt::AlignLeft | Qt::AlignBottom, block.text);
+            break;
+        case Block::Field: {
+            painter.setPen(Qt::black);
+            painter.setFont(bodyFont());
+            painter.drawText(area, Qt::TextWordWrap, block.text + ": " + block.value);
+            break;
+        }
+        case Block::Paragraph:
+            painter.setPen(Qt::black);
+            painter.setFont(bodyFont());
+            painter.drawText(area, Qt::TextWordWrap, block.text);
+            break;
+        case Block::Table:
+            drawTable(painter, block, placement);
+            break;
+        case Block::BarChart:
+            drawBarChart(painter, block, placement);
+            break;
+        case Block::PageBreak:
+            break;
+        }
+    }
+
+    painter.end();
+    return picture;
+}
+
+bool PdfReportRenderer::write(const QString &filePath) const
+{
+    QVector<PageLayout> pages = layout();
+    int total = pages.size();
+
+    // Each page is recorded into its own display list in parallel; QPainter
+    // on a QPicture is safe off the GUI thread, the PDF itself is not
+    QVector<int> indices(total);
+    for (int i = 0; i < total; ++i) {
+        indices[i] = i;
+    }
+    QList<QPicture> pictures = QtConcurrent::blockingMapped<QList<QPicture>>(indices, [this, &pages, total](int index) {
+        return renderPage(index, pages.at(index), total);
+    });
+
+    QPdfWriter writer(filePath);
+    writer.setPageSize(QPageSize(QPageSize::A4));
+    writer.setPageMargins(QMarginsF(0, 0, 0, 0));
+    writer.setResolution(72);
+    writer.setTitle(m_title);
+    writer.setCreator("Smart MA.VI Manager");
+
+    QPainter painter;
+    if (!painter.begin(&writer)) {
+        qDebug() << "Cannot open PDF for writing:" << filePath;
+        return false;
+    }
+
+    for (int i = 0; i < pictures.size(); ++i) {
+        if (i > 0 && !writer.newPage()) {
+            qDebug() << "Failed to start PDF page" << i + 1;
+            painter.end();
+            return false;
+        }
+        painter.drawPicture(0, 0, pictures.at(i));
+    }
+
+    return painter.end();
+}
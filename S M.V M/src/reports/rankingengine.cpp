@@ -0,0 +1,127 @@
+#include "reports/rankingengine.h"
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <algorithm>
+
+RankingEngine::RankingEngine(int k, Order order, Method method, TieBreak tieBreak)
+    : m_k(k)
+    , m_order(order)
+    , m_method(method)
+    , m_tieBreak(tieBreak)
+{
+}
+
+bool RankingEngine::better(const RankedEntry &a, const RankedEntry &b) const
+{
+    if (a.score != b.score) {
+        return m_order == Highest ? a.score > b.score : a.score < b.score;
+    }
+    if (m_tieBreak == BySecondary && a.secondary != b.secondary) {
+        return m_order == Highest ? a.secondary > b.secondary : a.secondary < b.secondary;
+    }
+    // Name then id, so the order is total and the cut at k is deterministic
+    int byName = QString::localeAwareCompare(a.name, b.name);
+    if (byName != 0) {
+        return byName < 0;
+    }
+    return a.id < b.id;
+}
+
+bool RankingEngine::tied(const RankedEntry &a, const RankedEntry &b) const
+{
+    return a.score == b.score && (m_tieBreak != BySecondary || a.secondary == b.secondary);
+}
+
+void RankingEngine::add(const RankedEntry &entry)
+{
+    auto it = m_groups.find(entry.group);
+    if (it == m_groups.end()) {
+        it = m_groups.insert(entry.group, Group());
+        m_groupOrder.append(entry.group);
+    }
+
+    Group &group = it.value();
+    ++group.seen;
+
+    // Max-heap under "better", so the front is the worst entry kept
+    auto comparator = [this](const RankedEntry &a, const RankedEntry &b) { return better(a, b); };
+
+    if (m_k <= 0 || static_cast<int>(group.heap.size()) < m_k) {
+        group.heap.push_back(entry);
+        std::push_heap(group.heap.begin(), group.heap.end(), comparator);
+    } else if (better(entry, group.heap.front())) {
+        std::pop_heap(group.heap.begin(), group.heap.end(), comparator);
+        group.heap.back() = entry;
+        std::push_heap(group.heap.begin(), group.heap.end(), comparator);
+    }
+}
+
+bool RankingEngine::addRows(QSqlQuery &query)
+{
+    if (!query.isActive()) {
+        return false;
+    }
+
+    bool hasSecondary = query.record().count() > 4;
+    while (query.next()) {
+        RankedEntry entry;
+        entry.id = query.value(0).toString();
+        entry.name = query.value(1).toString();
+        entry.group = query.value(2).toString();
+        entry.score = query.value(3).toDouble();
+        if (hasSecondary) {
+            entry.secondary = query.value(4).toDouble();
+        }
+        add(entry);
+    }
+    return true;
+}
+
+QStringList RankingEngine::groups() const
+{
+    return m_groupOrder;
+}
+
+int RankingEngine::count(const QString &group) const
+{
+    return m_groups.value(group).seen;
+}
+
+QList<RankedEntry> RankingEngine::results(const QString &group) const
+{
+    auto it = m_groups.constFind(group);
+    if (it == m_groups.constEnd()) {
+        return QList<RankedEntry>();
+    }
+
+    std::vector<RankedEntry> sorted = it.value().heap;
+    std::sort(sorted.begin(), sorted.end(), [this](const RankedEntry &a, const RankedEntry &b) {
+        return better(a, b);
+    });
+
+    int seen = it.value().seen;
+    QList<RankedEntry> ranked;
+    ranked.reserve(static_cast<int>(sorted.size()));
+    int competition = 0;
+    int dense = 0;
+
+    for (int i = 0; i < static_cast<int>(sorted.size()); ++i) {
+        RankedEntry entry = sorted[i];
+        if (i == 0 || !tied(sorted[i - 1], entry)) {
+            competition = i + 1;
+            ++dense;
+        }
+
+        switch (m_method) {
+        case Competition: entry.rank = competition; break;
+        case Dense: entry.rank = dense; break;
+        case Ordinal: entry.rank = i + 1; break;
+        }
+
+        // From the competition rank, so tied entries share a percentile
+        entry.percentile = seen > 1 ? 100.0 * (seen - competition) / (seen - 1) : 100.0;
+        ranked.append(entry);
+    }
+
+    return ranked;
+}
@@ -0,0 +1,257 @@
+#include "reports/reportcache.h"
+#include "database/database.h"
+#include "database/dataversions.h"
+#include "database/readconnectionpool.h"
+#include <QtConcurrent/QtConcurrentRun>
+#include <QFutureWatcher>
+#include <QThread>
+#include <QTimer>
+#include <QDate>
+#include <QDateTime>
+#include <QDebug>
+
+namespace {
+
+// Lets a burst of writes (a whole class being marked) settle before rebuilding
+const int kRefreshDelayMs = 500;
+
+} // namespace
+
+ReportCache::ReportCache(QObject *parent)
+    : QObject(parent)
+    , m_refreshTimer(new QTimer(this))
+    , m_pool(nullptr)
+    , m_refreshing(false)
+    , m_maxEntries(32)
+    , m_maxBytes(16 * 1024 * 1024)
+    , m_bytesUsed(0)
+    , m_hits(0)
+    , m_misses(0)
+{
+    m_refreshTimer->setSingleShot(true);
+    connect(m_refreshTimer, &QTimer::timeout, this, &ReportCache::refreshNext);
+    connect(&DataVersions::instance(), &DataVersions::tableChanged, this, &ReportCache::onTableChanged);
+}
+
+ReportCache::~ReportCache()
+{
+    // Waits for a rebuild still running; its result is dropped
+    delete m_pool;
+}
+
+QString ReportCache::cacheKey(const QString &reportType, const QMap<QString, QVariant> &parameters)
+{
+    // Same report whatever the key case, whitespace or date type the caller used;
+    // empty values mean "no filter" to every generator, so they are dropped
+    QMap<QString, QString> normalized;
+    for (auto it = parameters.constBegin(); it != parameters.constEnd(); ++it) {
+        const QVariant &value = it.value();
+        QString text;
+
+        if (value.typeId() == QMetaType::QDate) {
+            text = value.toDate().toString(Qt::ISODate);
+        } else if (value.typeId() == QMetaType::QDateTime) {
+            text = value.toDateTime().toString(Qt::ISODate);
+        } else if (value.typeId() == QMetaType::QStringList) {
+            text = value.toStringList().join(QLatin1Char(','));
+        } else {
+            text = value.toString().trimmed();
+        }
+
+        if (!text.isEmpty()) {
+            normalized.insert(it.key().trimmed().toLower(), text);
+        }
+    }
+
+    QString key = reportType;
+    for (auto it = normalized.constBegin(); it != normalized.constEnd(); ++it) {
+        key += QLatin1Char('\x1f') + it.key() + QLatin1Char('=') + it.value();
+    }
+    return key;
+}
+
+ReportData ReportCache::fetch(const QString &reportType, const QMap<QString, QVariant> &parameters,
+                              const QStringList &tables, const Producer &producer, const Refresher &refresher)
+{
+    QString key = cacheKey(reportType, parameters);
+
+    auto it = m_entries.constFind(key);
+    if (it != m_entries.constEnd() && isCurrent(it.value())) {
+        m_hits++;
+        ReportData report = it.value().report;
+        touch(key);
+        return report;
+    }
+
+    m_misses++;
+    QHash<QString, quint64> versions = DataVersions::instance().versions(tables);
+    ReportData report = producer();
+    store(key, tables, versions, refresher, report);
+    return report;
+}
+
+void ReportCache::setMaxEntries(int entries)
+{
+    m_maxEntries = qMax(1, entries);
+    evict();
+}
+
+void ReportCache::setMaxBytes(qint64 bytes)
+{
+    m_maxBytes = qMax<qint64>(0, bytes);
+    evict();
+}
+
+void ReportCache::clear()
+{
+    m_entries.clear();
+    m_recentKeys.clear();
+    m_staleKeys.clear();
+    m_refreshTimer->stop();
+    m_bytesUsed = 0;
+}
+
+bool ReportCache::isCurrent(const Entry &entry) const
+{
+    for (auto it = entry.versions.constBegin(); it != entry.versions.constEnd(); ++it) {
+        if (DataVersions::instance().version(it.key()) != it.value()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ReportCache::store(const QString &key, const QStringList &tables, const QHash<QString, quint64> &versions,
+                        const Refresher &refresher, const ReportData &report)
+{
+    remove(key);
+
+    Entry entry;
+    entry.report = report;
+    entry.tables = tables;
+    entry.versions = versions;
+    entry.refresher = refresher;
+    entry.bytes = estimateBytes(report);
+
+    // Cancelled or failed reports carry no data and are not kept
+    if (report.jsonData.isNull() || entry.bytes > m_maxBytes) {
+        return;
+    }
+
+    m_bytesUsed += entry.bytes;
+    m_entries.insert(key, entry);
+    touch(key);
+    evict();
+}
+
+void ReportCache::touch(const QString &key)
+{
+    m_recentKeys.removeOne(key);
+    m_recentKeys.prepend(key);
+}
+
+void ReportCache::remove(const QString &key)
+{
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        return;
+    }
+
+    m_bytesUsed -= it.value().bytes;
+    m_entries.erase(it);
+    m_recentKeys.removeOne(key);
+    m_staleKeys.removeOne(key);
+}
+
+void ReportCache::evict()
+{
+    while (!m_recentKeys.isEmpty() && (m_entries.size() > m_maxEntries || m_bytesUsed > m_maxBytes)) {
+        remove(m_recentKeys.last());
+    }
+}
+
+qint64 ReportCache::estimateBytes(const ReportData &report)
+{
+    // Serialized size is a stable stand-in for the in-memory document
+    return report.jsonData.toJson(QJsonDocument::Compact).size()
+        + (report.reportType.size() + report.dateRange.size() + report.parameters.size()) * 2;
+}
+
+void ReportCache::onTableChanged(const QString &table)
+{
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        if (it.value().tables.contains(table) && !m_staleKeys.contains(it.key())) {
+            m_staleKeys.append(it.key());
+        }
+    }
+
+    if (!m_staleKeys.isEmpty() && !m_refreshTimer->isActive()) {
+        m_refreshTimer->start(kRefreshDelayMs);
+    }
+}
+
+void ReportCache::refreshNext()
+{
+    // One rebuild at a time, off the GUI thread
+    if (m_refreshing) {
+        return;
+    }
+
+    while (!m_staleKeys.isEmpty()) {
+        QString key = m_staleKeys.takeFirst();
+        auto it = m_entries.constFind(key);
+        if (it == m_entries.constEnd() || isCurrent(it.value())) {
+            continue;
+        }
+
+        if (!m_pool) {
+            m_pool = new ReadConnectionPool(Database::instance().database().databaseName(), 1);
+            m_pool->threadPool()->setThreadPriority(QThread::LowestPriority);
+        }
+
+        // Versions are taken before the read, so a write during it marks the entry stale again
+        QHash<QString, quint64> versions = DataVersions::instance().versions(it.value().tables);
+        Refresher refresher = it.value().refresher;
+        ReadConnectionPool *pool = m_pool;
+        m_refreshing = true;
+
+        QFutureWatcher<ReportData> *watcher = new QFutureWatcher<ReportData>(this);
+        connect(watcher, &QFutureWatcher<ReportData>::finished, this, [this, watcher, key, versions]() {
+            finishRefresh(key, versions, watcher->result());
+            watcher->deleteLater();
+        });
+        watcher->setFuture(QtConcurrent::run(pool->threadPool(), [pool, refresher]() {
+            QSqlDatabase db = pool->connection();
+            return db.isValid() ? refresher(db) : ReportData();
+        }));
+        return;
+    }
+}
+
+void ReportCache::finishRefresh(const QString &key, const QHash<QString, quint64> &versions, const ReportData &report)
+{
+    m_refreshing = false;
+
+    // Updated in place so a refresh does not count as a use; gone if cleared or evicted meanwhile
+    auto entry = m_entries.find(key);
+    if (entry != m_entries.end()) {
+        qint64 bytes = estimateBytes(report);
+        if (report.jsonData.isNull() || bytes > m_maxBytes) {
+            remove(key);
+        } else {
+            m_bytesUsed += bytes - entry->bytes;
+            entry->report = report;
+            entry->versions = versions;
+            entry->bytes = bytes;
+            evict();
+
+            if (m_entries.contains(key)) {
+                emit reportRefreshed(key);
+            }
+        }
+    }
+
+    if (!m_staleKeys.isEmpty()) {
+        m_refreshTimer->start(0);
+    }
+}
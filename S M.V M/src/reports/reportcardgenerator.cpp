@@ -0,0 +1,419 @@
+#include "reports/reportcardgenerator.h"
+#include "reports/pdfreportrenderer.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QHash>
+#include <QMap>
+#include <QDir>
+#include <QFile>
+#include <QtConcurrent/QtConcurrentMap>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+// Lower percentage bound, letter and grade point, highest first
+struct GradeBand {
+    double minimum;
+    const char *letter;
+    double point;
+};
+
+const GradeBand kGradeBands[] = {
+    {90.0, "A+", 4.0},
+    {80.0, "A", 3.6},
+    {70.0, "B+", 3.2},
+    {60.0, "B", 2.8},
+    {50.0, "C+", 2.4},
+    {40.0, "C", 2.0},
+    {35.0, "D", 1.6},
+};
+
+const GradeBand *bandFor(double percentage)
+{
+    for (const GradeBand &band : kGradeBands) {
+        if (percentage >= band.minimum) {
+            return &band;
+        }
+    }
+    return nullptr;
+}
+
+QString number(double value)
+{
+    return QString::number(value, 'f', value == static_cast<qint64>(value) ? 0 : 2);
+}
+
+QString rankText(int rank, int size)
+{
+    return rank > 0 ? QString("%1 of %2").arg(rank).arg(size) : QString("-");
+}
+
+QString classText(const ReportCard &card)
+{
+    return card.section.isEmpty() ? card.grade : card.grade + " - " + card.section;
+}
+
+QString periodText(const QDate &fromDate, const QDate &toDate)
+{
+    return fromDate.toString("dd/MM/yyyy") + " to " + toDate.toString("dd/MM/yyyy");
+}
+
+void addCard(PdfReportRenderer &pdf, const ReportCard &card)
+{
+    pdf.addHeading(card.name);
+    pdf.addField("Roll Number", card.rollNumber);
+    pdf.addField("Class", classText(card));
+    if (!card.parentName.isEmpty()) {
+        pdf.addField("Parent", card.parentName);
+    }
+
+    QList<QStringList> rows;
+    for (const ReportCardSubject &subject : card.subjects) {
+        rows.append({subject.subject, number(subject.marksObtained), number(subject.totalMarks),
+                     QString::number(subject.percentage, 'f', 1) + "%", subject.letterGrade,
+                     QString::number(subject.gradePoint, 'f', 1), subject.remarks});
+    }
+    if (!rows.isEmpty()) {
+        pdf.addTable({"Subject", "Marks", "Full Marks", "Percentage", "Grade", "Grade Point", "Remarks"},
+                     rows, {3, 1.2, 1.2, 1.4, 1, 1.2, 3});
+    } else {
+        pdf.addParagraph("No exam results recorded.");
+    }
+
+    pdf.addField("Total", number(card.marksObtained) + " / " + number(card.totalMarks));
+    pdf.addField("Percentage", QString::number(card.percentage, 'f', 2) + "%");
+    pdf.addField("GPA", QString::number(card.gpa, 'f', 2) + " (" + card.letterGrade + ")");
+    pdf.addField("Rank in Grade", rankText(card.gradeRank, card.gradeSize));
+    pdf.addField("Rank in Section", rankText(card.sectionRank, card.sectionSize));
+    pdf.addField("Attendance", QString("%1 of %2 days (%3%), %4 late, %5 excused")
+                                   .arg(card.presentDays + card.lateDays + card.excusedDays)
+                                   .arg(card.totalDays)
+                                   .arg(card.attendancePercentage, 0, 'f', 1)
+                                   .arg(card.lateDays)
+                                   .arg(card.excusedDays));
+}
+
+QString cardHtml(const ReportCard &card, const QString &examName, const QString &period)
+{
+    QString html = "<div class='card'>\n";
+    html += "<h1>Report Card</h1>\n";
+    html += "<p>" + examName.toHtmlEscaped() + "<br>Attendance period: " + period + "</p>\n";
+    html += "<h2>" + card.name.toHtmlEscaped() + "</h2>\n";
+    html += "<p>Roll Number: " + card.rollNumber.toHtmlEscaped() + "<br>";
+    html += "Class: " + classText(card).toHtmlEscaped();
+    if (!card.parentName.isEmpty()) {
+        html += "<br>Parent: " + card.parentName.toHtmlEscaped();
+    }
+    html += "</p>\n";
+
+    if (!card.subjects.isEmpty()) {
+        html += "<table>\n<tr><th>Subject</th><th>Marks</th><th>Full Marks</th><th>Percentage</th>"
+                "<th>Grade</th><th>Grade Point</th><th>Remarks</th></tr>\n";
+        for (const ReportCardSubject &subject : card.subjects) {
+            html += "<tr><td>" + subject.subject.toHtmlEscaped() + "</td>";
+            html += "<td>" + number(subject.marksObtained) + "</td>";
+            html += "<td>" + number(subject.totalMarks) + "</td>";
+            html += "<td>" + QString::number(subject.percentage, 'f', 1) + "%</td>";
+            html += "<td>" + subject.letterGrade + "</td>";
+            html += "<td>" + QString::number(subject.gradePoint, 'f', 1) + "</td>";
+            html += "<td>" + subject.remarks.toHtmlEscaped() + "</td></tr>\n";
+        }
+        html += "</table>\n";
+    } else {
+        html += "<p>No exam results recorded.</p>\n";
+    }
+
+    html += "<p>Total: " + number(card.marksObtained) + " / " + number(card.totalMarks) + "<br>";
+    html += "Percentage: " + QString::number(card.percentage, 'f', 2) + "%<br>";
+    html += "GPA: " + QString::number(card.gpa, 'f', 2) + " (" + card.letterGrade + ")<br>";
+    html += "Rank in Grade: " + rankText(card.gradeRank, card.gradeSize) + "<br>";
+    html += "Rank in Section: " + rankText(card.sectionRank, card.sectionSize) + "<br>";
+    html += QString("Attendance: %1 of %2 days (%3%), %4 late, %5 excused</p>\n")
+                .arg(card.presentDays + card.lateDays + card.excusedDays)
+                .arg(card.totalDays)
+                .arg(card.attendancePercentage, 0, 'f', 1)
+                .arg(card.lateDays)
+                .arg(card.excusedDays);
+    html += "</div>\n";
+    return html;
+}
+
+QString htmlDocument(const QString &title, const QString &body)
+{
+    QString html = "<!DOCTYPE html>\n<html>\n<head>\n";
+    html += "<meta charset='UTF-8'>\n";
+    html += "<title>" + title.toHtmlEscaped() + "</title>\n";
+    html += "<style>\n";
+    html += "body { font-family: Arial, sans-serif; margin: 20px; }\n";
+    html += "h1 { color: #2c3e50; }\n";
+    html += "table { border-collapse: collapse; margin-bottom: 15px; }\n";
+    html += "th, td { border: 1px solid #ccc; padding: 4px 8px; text-align: left; }\n";
+    html += "th { background-color: #f5f5f5; }\n";
+    html += ".card { page-break-after: always; }\n";
+    html += "</style>\n";
+    html += "</head>\n<body>\n";
+    html += body;
+    html += "</body>\n</html>\n";
+    return html;
+}
+
+bool writeText(const QString &filePath, const QString &text)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "Cannot open report card file for writing:" << filePath;
+        return false;
+    }
+    return file.write(text.toUtf8()) >= 0;
+}
+
+} // namespace
+
+ReportCardGenerator::ReportCardGenerator(const QString &examName, const QDate &fromDate, const QDate &toDate)
+    : m_examName(examName)
+    , m_fromDate(fromDate)
+    , m_toDate(toDate)
+{
+}
+
+QString ReportCardGenerator::letterGrade(double percentage)
+{
+    const GradeBand *band = bandFor(percentage);
+    return band ? QString(band->letter) : QString("NG");
+}
+
+double ReportCardGenerator::gradePoint(double percentage)
+{
+    const GradeBand *band = bandFor(percentage);
+    return band ? band->point : 0.0;
+}
+
+bool ReportCardGenerator::load(QSqlDatabase db, const QString &grade, const QString &section)
+{
+    m_cards.clear();
+    QHash<QString, int> byRoll;
+
+    QString sectionFilter = section.isEmpty() ? QString() : QString(" AND es.section = ?");
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT es.roll_number, es.name, es.grade, es.section, es.parent_name "
+                  "FROM enhanced_students es WHERE es.grade = ?" + sectionFilter +
+                  " ORDER BY es.section, es.name");
+    query.addBindValue(grade);
+    if (!section.isEmpty()) query.addBindValue(section);
+
+    if (!query.exec()) {
+        qDebug() << "Failed to load report card students:" << query.lastError().text();
+        return false;
+    }
+
+    while (query.next()) {
+        ReportCard card;
+        card.rollNumber = query.value(0).toString();
+        card.name = query.value(1).toString();
+        card.grade = query.value(2).toString();
+        card.section = query.value(3).toString();
+        card.parentName = query.value(4).toString();
+        byRoll.insert(card.rollNumber, m_cards.size());
+        m_cards.append(card);
+    }
+
+    // Every result of the exam for the grade in one pass
+    query.prepare("SELECT er.student_roll, er.subject, er.marks_obtained, er.total_marks, er.remarks "
+                  "FROM exam_results er JOIN enhanced_students es ON es.roll_number = er.student_roll "
+                  "WHERE er.exam_name = ? AND es.grade = ?" + sectionFilter +
+                  " ORDER BY er.student_roll, er.subject");
+    query.addBindValue(m_examName);
+    query.addBindValue(grade);
+    if (!section.isEmpty()) query.addBindValue(section);
+
+    if (!query.exec()) {
+        qDebug() << "Failed to load report card results:" << query.lastError().text();
+        return false;
+    }
+
+    while (query.next()) {
+        auto it = byRoll.constFind(query.value(0).toString());
+        if (it == byRoll.constEnd()) {
+            continue;
+        }
+
+        ReportCardSubject subject;
+        subject.subject = query.value(1).toString();
+        subject.marksObtained = query.value(2).toDouble();
+        subject.totalMarks = query.value(3).toDouble();
+        subject.remarks = query.value(4).toString();
+        subject.percentage = subject.totalMarks > 0 ? subject.marksObtained / subject.totalMarks * 100 : 0.0;
+        subject.letterGrade = letterGrade(subject.percentage);
+        subject.gradePoint = gradePoint(subject.percentage);
+        m_cards[it.value()].subjects.append(subject);
+    }
+
+    // Attendance per student over the period, also one pass
+    query.prepare(R"(
+        SELECT aa.student_roll,
+               COUNT(CASE WHEN aa.status = 'Present' THEN 1 END) as present_days,
+               COUNT(CASE WHEN aa.status = 'Absent' THEN 1 END) as absent_days,
+               COUNT(CASE WHEN aa.status = 'Late' THEN 1 END) as late_days,
+               COUNT(CASE WHEN aa.status = 'Excused' THEN 1 END) as excused_days,
+               COUNT(*) as total_days
+        FROM advanced_attendance aa
+        JOIN enhanced_students es ON es.roll_number = aa.student_roll
+        WHERE aa.date BETWEEN ? AND ? AND es.grade = ?)" + sectionFilter + R"(
+        GROUP BY aa.student_roll
+    )");
+    query.addBindValue(m_fromDate);
+    query.addBindValue(m_toDate);
+    query.addBindValue(grade);
+    if (!section.isEmpty()) query.addBindValue(section);
+
+    if (!query.exec()) {
+        qDebug() << "Failed to load report card attendance:" << query.lastError().text();
+        return false;
+    }
+
+    while (query.next()) {
+        auto it = byRoll.constFind(query.value(0).toString());
+        if (it == byRoll.constEnd()) {
+            continue;
+        }
+
+        ReportCard &card = m_cards[it.value()];
+        card.presentDays = query.value(1).toInt();
+        card.absentDays = query.value(2).toInt();
+        card.lateDays = query.value(3).toInt();
+        card.excusedDays = query.value(4).toInt();
+        card.totalDays = query.value(5).toInt();
+        // Same rule as the attendance report: late and excused count as attended
+        card.attendancePercentage = card.totalDays > 0 ?
+            (double)(card.presentDays + card.lateDays + card.excusedDays) / card.totalDays * 100 : 0.0;
+    }
+
+    for (ReportCard &card : m_cards) {
+        double points = 0.0;
+        for (const ReportCardSubject &subject : card.subjects) {
+            card.marksObtained += subject.marksObtained;
+            card.totalMarks += subject.totalMarks;
+            points += subject.gradePoint;
+        }
+        card.percentage = card.totalMarks > 0 ? card.marksObtained / card.totalMarks * 100 : 0.0;
+        card.gpa = card.subjects.isEmpty() ? 0.0 : points / card.subjects.size();
+        card.letterGrade = card.subjects.isEmpty() ? QString("-") : letterGrade(card.percentage);
+    }
+
+    rank();
+    return true;
+}
+
+void ReportCardGenerator::rank()
+{
+    // GPA first, percentage breaks ties; equal students share a rank (1, 2, 2, 4)
+    auto before = [this](int a, int b) {
+        const ReportCard &left = m_cards.at(a);
+        const ReportCard &right = m_cards.at(b);
+        if (left.gpa != right.gpa) {
+            return left.gpa > right.gpa;
+        }
+        return left.percentage > right.percentage;
+    };
+
+    auto assign = [&](QList<int> &indices, bool bySection) {
+        std::stable_sort(indices.begin(), indices.end(), before);
+        for (int i = 0; i < indices.size(); ++i) {
+            ReportCard &card = m_cards[indices.at(i)];
+            int rank = i + 1;
+            if (i > 0 && !before(indices.at(i - 1), indices.at(i))) {
+                const ReportCard &previous = m_cards.at(indices.at(i - 1));
+                rank = bySection ? previous.sectionRank : previous.gradeRank;
+            }
+            if (bySection) {
+                card.sectionRank = rank;
+                card.sectionSize = indices.size();
+            } else {
+                card.gradeRank = rank;
+                card.gradeSize = indices.size();
+            }
+        }
+    };
+
+    QList<int> ranked;
+    QMap<QString, QList<int>> sections;
+    for (int i = 0; i < m_cards.size(); ++i) {
+        if (!m_cards.at(i).subjects.isEmpty()) {
+            ranked.append(i);
+            sections[m_cards.at(i).section].append(i);
+        }
+    }
+
+    assign(ranked, false);
+    for (auto it = sections.begin(); it != sections.end(); ++it) {
+        assign(it.value(), true);
+    }
+}
+
+QString ReportCardGenerator::fileNameFor(const ReportCard &card, Format format) const
+{
+    QString name = card.rollNumber + "_" + card.name;
+    for (QChar &c : name) {
+        if (!c.isLetterOrNumber() && c != '-' && c != '_') {
+            c = '_';
+        }
+    }
+    return name + (format == Pdf ? ".pdf" : ".html");
+}
+
+QStringList ReportCardGenerator::writeEach(const QString &directory, Format format) const
+{
+    if (!QDir().mkpath(directory)) {
+        qDebug() << "Cannot create report card directory:" << directory;
+        return QStringList();
+    }
+
+    QString period = periodText(m_fromDate, m_toDate);
+    QDir dir(directory);
+
+    // Cards share nothing, so each is rendered and written on its own pool thread
+    QStringList written = QtConcurrent::blockingMapped<QStringList>(m_cards, [&](const ReportCard &card) {
+        QString filePath = dir.filePath(fileNameFor(card, format));
+        bool ok = false;
+        if (format == Pdf) {
+            PdfReportRenderer pdf("Report Card", m_examName + "\nAttendance period: " + period);
+            addCard(pdf, card);
+            ok = pdf.write(filePath);
+        } else {
+            ok = writeText(filePath, htmlDocument("Report Card - " + card.name, cardHtml(card, m_examName, period)));
+        }
+        return ok ? filePath : QString();
+    });
+
+    written.removeAll(QString());
+    if (written.size() < m_cards.size()) {
+        qDebug() << "Failed to write" << m_cards.size() - written.size() << "report cards";
+    }
+    return written;
+}
+
+bool ReportCardGenerator::writeMerged(const QString &filePath, Format format) const
+{
+    QString period = periodText(m_fromDate, m_toDate);
+    QString title = m_cards.isEmpty() ? QString("Report Cards") : "Report Cards - Grade " + m_cards.first().grade;
+
+    if (format == Pdf) {
+        // The renderer records pages in parallel itself
+        PdfReportRenderer pdf(title, m_examName + "\nAttendance period: " + period);
+        for (int i = 0; i < m_cards.size(); ++i) {
+            if (i > 0) {
+                pdf.addPageBreak();
+            }
+            addCard(pdf, m_cards.at(i));
+        }
+        return pdf.write(filePath);
+    }
+
+    QStringList cards = QtConcurrent::blockingMapped<QStringList>(m_cards, [&](const ReportCard &card) {
+        return cardHtml(card, m_examName, period);
+    });
+    return writeText(filePath, htmlDocument(title, cards.join(QString())));
+}
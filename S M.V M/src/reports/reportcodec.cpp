@@ -0,0 +1,213 @@
+#include "reports/reportcodec.h"
+#include <QCborValue>
+#include <QCborMap>
+#include <QCborStreamReader>
+#include <QJsonValue>
+#include <QDebug>
+
+namespace {
+
+const char kMagic[] = "SMRD";
+const int kMagicSize = 4;
+const int kHeaderSize = kMagicSize + 2;
+const quint8 kFormatVersion = 1;
+const quint8 kFlagCompressed = 0x01;
+// Smaller bodies are not worth the qCompress framing and time
+const int kCompressThreshold = 512;
+
+// Map keys; metadata first so decodeHeader can stop before the data
+enum ReportKey { ReportType = 0, GeneratedDate = 1, DateRange = 2, Parameters = 3, Data = 4 };
+enum AnalyticsKey { AnalyticsType = 0, Period = 1, AnalyticsData = 2 };
+
+QCborValue fromDocument(const QJsonDocument &document)
+{
+    if (document.isObject()) {
+        return QCborValue::fromJsonValue(document.object());
+    }
+    if (document.isArray()) {
+        return QCborValue::fromJsonValue(document.array());
+    }
+    return QCborValue();
+}
+
+QJsonDocument toDocument(const QCborValue &value)
+{
+    QJsonValue json = value.toJsonValue();
+    if (json.isObject()) {
+        return QJsonDocument(json.toObject());
+    }
+    if (json.isArray()) {
+        return QJsonDocument(json.toArray());
+    }
+    return QJsonDocument();
+}
+
+void setReportField(ReportData *report, qint64 key, const QCborValue &value)
+{
+    switch (key) {
+    case ReportType:
+        report->reportType = value.toString();
+        break;
+    case GeneratedDate:
+        report->generatedDate = value.toDateTime();
+        break;
+    case DateRange:
+        report->dateRange = value.toString();
+        break;
+    case Parameters:
+        report->parameters = value.toString();
+        break;
+    case Data:
+        report->jsonData = toDocument(value);
+        break;
+    default:
+        // Keys from a newer writer are ignored
+        break;
+    }
+}
+
+} // namespace
+
+QByteArray ReportCodec::wrap(const QByteArray &cbor, Compression compression)
+{
+    quint8 flags = 0;
+    QByteArray body = cbor;
+    if (compression == Compress && cbor.size() > kCompressThreshold) {
+        body = qCompress(cbor);
+        flags |= kFlagCompressed;
+    }
+
+    QByteArray payload;
+    payload.reserve(kHeaderSize + body.size());
+    payload.append(kMagic, kMagicSize);
+    payload.append(static_cast<char>(kFormatVersion));
+    payload.append(static_cast<char>(flags));
+    payload.append(body);
+    return payload;
+}
+
+bool ReportCodec::isPayload(const QByteArray &bytes)
+{
+    return bytes.size() >= kHeaderSize && bytes.startsWith(QByteArray::fromRawData(kMagic, kMagicSize));
+}
+
+bool ReportCodec::unwrap(const QByteArray &payload, QByteArray *cbor)
+{
+    if (!isPayload(payload)) {
+        qDebug() << "Not a report payload";
+        return false;
+    }
+
+    quint8 version = static_cast<quint8>(payload.at(kMagicSize));
+    quint8 flags = static_cast<quint8>(payload.at(kMagicSize + 1));
+    if (version > kFormatVersion) {
+        qDebug() << "Report payload version" << version << "is newer than supported" << kFormatVersion;
+        return false;
+    }
+
+    QByteArray body = payload.mid(kHeaderSize);
+    if (flags & kFlagCompressed) {
+        body = qUncompress(body);
+        if (body.isEmpty()) {
+            qDebug() << "Corrupt compressed report payload";
+            return false;
+        }
+    }
+
+    *cbor = body;
+    return true;
+}
+
+QByteArray ReportCodec::encode(const ReportData &report, Compression compression)
+{
+    QCborMap map;
+    map.insert(ReportType, report.reportType);
+    map.insert(GeneratedDate, QCborValue(report.generatedDate));
+    map.insert(DateRange, report.dateRange);
+    map.insert(Parameters, report.parameters);
+    map.insert(Data, fromDocument(report.jsonData));
+    return wrap(map.toCborValue().toCbor(), compression);
+}
+
+bool ReportCodec::decode(const QByteArray &payload, ReportData *report)
+{
+    QByteArray cbor;
+    if (!unwrap(payload, &cbor)) {
+        return false;
+    }
+
+    QCborParserError error;
+    QCborValue value = QCborValue::fromCbor(cbor, &error);
+    if (error.error != QCborError::NoError || !value.isMap()) {
+        qDebug() << "Failed to decode report payload:" << error.errorString();
+        return false;
+    }
+
+    *report = ReportData();
+    QCborMap map = value.toMap();
+    for (auto it = map.constBegin(); it != map.constEnd(); ++it) {
+        setReportField(report, it.key().toInteger(-1), it.value());
+    }
+    return true;
+}
+
+bool ReportCodec::decodeHeader(const QByteArray &payload, ReportData *report)
+{
+    QByteArray cbor;
+    if (!unwrap(payload, &cbor)) {
+        return false;
+    }
+
+    *report = ReportData();
+    QCborStreamReader reader(cbor);
+    if (!reader.isMap() || !reader.enterContainer()) {
+        qDebug() << "Failed to decode report payload header";
+        return false;
+    }
+
+    // Reads values one at a time and stops at the data key, leaving the body untouched
+    while (reader.hasNext() && reader.lastError() == QCborError::NoError) {
+        if (!reader.isInteger()) {
+            return false;
+        }
+        qint64 key = reader.toInteger();
+        reader.next();
+        if (key == Data) {
+            break;
+        }
+        setReportField(report, key, QCborValue::fromCbor(reader));
+    }
+
+    return reader.lastError() == QCborError::NoError;
+}
+
+QByteArray ReportCodec::encode(const ReportAnalytics &analytics, Compression compression)
+{
+    QCborMap map;
+    map.insert(AnalyticsType, analytics.analyticsType);
+    map.insert(Period, analytics.period);
+    map.insert(AnalyticsData, fromDocument(analytics.data));
+    return wrap(map.toCborValue().toCbor(), compression);
+}
+
+bool ReportCodec::decode(const QByteArray &payload, ReportAnalytics *analytics)
+{
+    QByteArray cbor;
+    if (!unwrap(payload, &cbor)) {
+        return false;
+    }
+
+    QCborParserError error;
+    QCborValue value = QCborValue::fromCbor(cbor, &error);
+    if (error.error != QCborError::NoError || !value.isMap()) {
+        qDebug() << "Failed to decode analytics payload:" << error.errorString();
+        return false;
+    }
+
+    QCborMap map = value.toMap();
+    *analytics = ReportAnalytics();
+    analytics->analyticsType = map.value(AnalyticsType).toString();
+    analytics->period = map.value(Period).toString();
+    analytics->data = toDocument(map.value(AnalyticsData));
+    return true;
+}
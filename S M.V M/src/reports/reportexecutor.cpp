@@ -0,0 +1,183 @@
+#include "reports/reportexecutor.h"
+#include "database/database.h"
+#include "database/readconnectionpool.h"
+#include <QtConcurrent/QtConcurrentMap>
+#include <QFutureWatcher>
+#include <QEventLoop>
+#include <QThread>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+
+namespace {
+
+struct PartitionResult {
+    QJsonArray rows;
+    QString error;
+    bool ok = false;
+};
+
+} // namespace
+
+ReportExecutor::ReportExecutor(QObject *parent)
+    : QObject(parent)
+    , m_pool(nullptr)
+    , m_cancelled(0)
+    , m_running(false)
+{
+}
+
+ReportExecutor::~ReportExecutor()
+{
+    delete m_pool;
+}
+
+int ReportExecutor::maxThreads() const
+{
+    return m_pool ? m_pool->maxThreads() : QThread::idealThreadCount();
+}
+
+void ReportExecutor::cancel()
+{
+    m_cancelled.storeRelaxed(1);
+}
+
+QList<ReportPartition> ReportExecutor::partitions(const QString &grade, const QString &section)
+{
+    QList<ReportPartition> result;
+    QSqlQuery query(Database::instance().database());
+    query.setForwardOnly(true);
+
+    // Ordered by SQLite itself so the merge matches the single-query ORDER BY
+    QString queryStr = "SELECT DISTINCT grade, section FROM enhanced_students WHERE 1=1";
+    if (!grade.isEmpty()) {
+        queryStr += " AND grade = ?";
+    }
+    if (!section.isEmpty()) {
+        queryStr += " AND section = ?";
+    }
+    queryStr += " ORDER BY grade, section";
+
+    query.prepare(queryStr);
+    if (!grade.isEmpty()) query.addBindValue(grade);
+    if (!section.isEmpty()) query.addBindValue(section);
+
+    if (!query.exec()) {
+        qDebug() << "Failed to load report partitions:" << query.lastError().text();
+        return result;
+    }
+
+    while (query.next()) {
+        ReportPartition partition;
+        partition.grade = query.value("grade").toString();
+        partition.section = query.value("section").toString();
+
+        // A per-partition filter could not select these students
+        if (partition.grade.isEmpty() || partition.section.isEmpty()) {
+            return QList<ReportPartition>();
+        }
+
+        result.append(partition);
+    }
+
+    return result;
+}
+
+bool ReportExecutor::run(const QList<ReportPartition> &partitions, const PartitionTask &task,
+                         QVector<QJsonArray> *results)
+{
+    results->clear();
+    m_lastError.clear();
+    if (partitions.isEmpty()) {
+        return true;
+    }
+
+    // Asked again from the event loop of a running report
+    if (m_running) {
+        return runSequentially(partitions, task, results);
+    }
+
+    m_running = true;
+    m_cancelled.storeRelaxed(0);
+
+    if (!m_pool) {
+        m_pool = new ReadConnectionPool(Database::instance().database().databaseName());
+    }
+
+    QVector<int> indices(partitions.size());
+    for (int i = 0; i < indices.size(); ++i) {
+        indices[i] = i;
+    }
+
+    ReadConnectionPool *pool = m_pool;
+    QAtomicInt *cancelled = &m_cancelled;
+    QFuture<PartitionResult> future = QtConcurrent::mapped(pool->threadPool(), indices,
+        [pool, cancelled, partitions, task](int index) {
+            PartitionResult result;
+            if (cancelled->loadRelaxed()) {
+                return result;
+            }
+
+            QSqlDatabase db = pool->connection();
+            if (!db.isValid() || !db.isOpen()) {
+                result.error = "Database unavailable";
+                return result;
+            }
+            result.ok = task(db, partitions.at(index), &result.rows, &result.error);
+            return result;
+        });
+
+    QFutureWatcher<PartitionResult> watcher;
+    QEventLoop loop;
+    connect(&watcher, &QFutureWatcherBase::progressValueChanged, this, [this, &partitions](int completed) {
+        emit progress(completed, partitions.size());
+    });
+    connect(&watcher, &QFutureWatcherBase::finished, &loop, &QEventLoop::quit);
+    watcher.setFuture(future);
+
+    if (!future.isFinished()) {
+        loop.exec();
+    }
+    future.waitForFinished();
+
+    // Results are indexed by partition, whatever order the workers finished in
+    bool ok = !m_cancelled.loadRelaxed();
+    if (!ok) {
+        m_lastError = "Cancelled";
+    }
+    results->resize(partitions.size());
+    for (int i = 0; i < partitions.size(); ++i) {
+        PartitionResult result = future.resultAt(i);
+        if (!result.ok) {
+            // The first failing partition explains the report
+            if (ok && !result.error.isEmpty()) {
+                m_lastError = result.error;
+            }
+            ok = false;
+        }
+        (*results)[i] = result.rows;
+    }
+
+    m_running = false;
+    emit progress(partitions.size(), partitions.size());
+
+    if (!ok) {
+        results->clear();
+    }
+    return ok;
+}
+
+bool ReportExecutor::runSequentially(const QList<ReportPartition> &partitions, const PartitionTask &task,
+                                     QVector<QJsonArray> *results)
+{
+    results->resize(partitions.size());
+
+    for (int i = 0; i < partitions.size(); ++i) {
+        if (!task(Database::instance().database(), partitions.at(i), &(*results)[i], &m_lastError)) {
+            results->clear();
+            return false;
+        }
+    }
+
+    return true;
+}
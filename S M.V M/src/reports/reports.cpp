@@ -1,18 +1,37 @@
 #include "reports/reports.h"
+#include "reports/reportwriter.h"
+#include "utils/xlsxwriter.h"
 #include "database/database.h"
 #include "models/teacher.h"
 #include "models/student.h"
 #include "models/class.h"
 #include "models/attendance.h"
+#include "reports/chartseriesbuilder.h"
+#include "reports/rankingengine.h"
 #include <QTextStream>
 #include <QFile>
+#include <QBuffer>
 #include <QDir>
 #include <QDate>
 #include <QDateTime>
 #include <QDebug>
 #include <QStandardPaths>
 #include <QApplication>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QLineSeries>
 #include <cstdlib>
+#include <algorithm>
+#include <memory>
+
+namespace {
+
+// A bar per day stays readable for about a month; longer ranges are drawn as lines
+const int kMaxDailyBars = 31;
+// Point budget for charts built before they have a view to measure
+const int kDefaultChartWidth = 800;
+
+} // namespace
 
 Reports::Reports(Database *database, QObject *parent)
     : QObject(parent)
@@ -22,192 +41,305 @@ Reports::Reports(Database *database, QObject *parent)
 
 QString Reports::generateTeacherReport(const QDate &startDate, const QDate &endDate)
 {
-    QString report;
-    QTextStream stream(&report);
+    return renderReport(TeacherReport, -1, startDate, endDate);
+}
+
+QString Reports::generateStudentReport(int classId, const QDate &startDate, const QDate &endDate)
+{
+    return renderReport(StudentReport, classId, startDate, endDate);
+}
+
+QString Reports::generateAttendanceReport(int classId, const QDate &date)
+{
+    return renderReport(AttendanceReport, classId, date, date);
+}
+
+QString Reports::generateClassReport(int classId, const QDate &startDate, const QDate &endDate)
+{
+    return renderReport(ClassReport, classId, startDate, endDate);
+}
+
+QString Reports::generateSummaryReport(const QDate &startDate, const QDate &endDate)
+{
+    return renderReport(SummaryReport, -1, startDate, endDate);
+}
+
+QString Reports::renderReport(ReportType type, int classId, const QDate &startDate, const QDate &endDate)
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
     
-    stream << formatReportHeader("Teacher Report", startDate, endDate);
-    stream << "\n";
+    TextReportWriter writer(&buffer);
+    writeReport(type, writer, classId, startDate, endDate);
     
-    // Get teacher data from database
-    QList<Teacher> teachers = m_database->getAllTeachers();
+    return QString::fromUtf8(buffer.data());
+}
+
+bool Reports::writeReport(ReportType type, ReportWriter &writer, int classId,
+                          const QDate &startDate, const QDate &endDate)
+{
+    switch (type) {
+        case TeacherReport: return writeTeacherReport(writer, startDate, endDate);
+        case StudentReport: return writeStudentReport(writer, classId, startDate, endDate);
+        case AttendanceReport: return writeAttendanceReport(writer, classId, startDate);
+        case ClassReport: return writeClassReport(writer, classId, startDate, endDate);
+        case SummaryReport: return writeSummaryReport(writer, startDate, endDate);
+    }
+    return false;
+}
+
+bool Reports::exportReport(ReportType type, ExportFormat format, const QString &filename, int classId,
+                           const QDate &startDate, const QDate &endDate)
+{
+    QString documentsPath = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
+    QString filePath = documentsPath + "/" + filename;
     
-    if (teachers.isEmpty()) {
-        stream << "No teachers found in the system.\n";
-    } else {
-        stream << formatTeacherData(teachers);
-        
-        // Add statistics
-        stream << "\n=== STATISTICS ===\n";
-        stream << "Total Teachers: " << teachers.size() << "\n";
-        stream << "Report Period: " << formatDate(startDate) << " to " << formatDate(endDate) << "\n";
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Failed to open file for writing:" << filePath;
+        return false;
     }
     
-    stream << formatReportFooter();
+    ReportWriter::Format writerFormat = ReportWriter::Text;
+    switch (format) {
+        case CSV: writerFormat = ReportWriter::Csv; break;
+        case Excel: writerFormat = ReportWriter::Xlsx; break;
+        case HTML: writerFormat = ReportWriter::Html; break;
+        case PlainText: writerFormat = ReportWriter::Text; break;
+    }
+    
+    bool ok = false;
+    {
+        std::unique_ptr<ReportWriter> writer(ReportWriter::create(writerFormat, &file));
+        ok = writeReport(type, *writer, classId, startDate, endDate);
+    }
     
-    return report;
+    file.close();
+    if (!ok) {
+        file.remove();
+    }
+    
+    return ok;
 }
 
-QString Reports::generateStudentReport(int classId, const QDate &startDate, const QDate &endDate)
+bool Reports::writeTeacherReport(ReportWriter &writer, const QDate &startDate, const QDate &endDate)
 {
-    QString report;
-    QTextStream stream(&report);
-    
-    stream << formatReportHeader("Student Report", startDate, endDate);
-    stream << "\n";
+    writer.beginReport("Teacher Report", startDate, endDate);
     
-    // Get student data from database
-    QList<Student> students = m_database->getStudentsByClass(classId);
+    QSqlQuery query(m_database->database());
+    query.setForwardOnly(true);
     
-    if (students.isEmpty()) {
-        stream << "No students found for the specified class.\n";
+    int teacherCount = 0;
+    if (query.exec("SELECT id, name, subject, contact, assigned_class FROM teachers "
+                   "WHERE is_active = 1 ORDER BY name")) {
+        while (query.next() && !writer.hasError()) {
+            if (teacherCount == 0) {
+                writer.beginSection("Teacher Information");
+                writer.beginTable({"ID", "Name", "Subject", "Contact", "Class"}, {5, 20, 15, 15, 10});
+            }
+            
+            writer.addRow({query.value("id").toString(),
+                           query.value("name").toString(),
+                           query.value("subject").toString(),
+                           query.value("contact").toString(),
+                           query.value("assigned_class").toString()});
+            teacherCount++;
+        }
     } else {
-        stream << formatStudentData(students);
-        
-        // Add attendance statistics
-        double attendancePercentage = calculateAttendancePercentage(classId, startDate, endDate);
-        
-        stream << "\n=== STATISTICS ===\n";
-        stream << "Total Students: " << students.size() << "\n";
-        stream << "Average Attendance: " << QString::number(attendancePercentage, 'f', 2) << "%\n";
-        stream << "Report Period: " << formatDate(startDate) << " to " << formatDate(endDate) << "\n";
+        qDebug() << "Failed to load teachers for report:" << query.lastError().text();
     }
     
-    stream << formatReportFooter();
+    if (teacherCount == 0) {
+        writer.addText("No teachers found in the system.");
+    } else {
+        writer.endTable();
+        writer.beginSection("Statistics");
+        writer.addField("Total Teachers", QString::number(teacherCount));
+        writer.addField("Report Period", formatDate(startDate) + " to " + formatDate(endDate));
+    }
     
-    return report;
+    return writer.endReport();
 }
 
-QString Reports::generateAttendanceReport(int classId, const QDate &date)
+int Reports::writeStudentTable(ReportWriter &writer, int classId)
 {
-    QString report;
-    QTextStream stream(&report);
+    QSqlQuery query(m_database->database());
+    query.setForwardOnly(true);
+    query.prepare("SELECT roll_no, name, guardian_name, guardian_contact, date_of_birth FROM students "
+                 "WHERE class_id = ? AND is_active = 1 ORDER BY name");
+    query.addBindValue(classId);
     
-    stream << formatReportHeader("Attendance Report", date, date);
-    stream << "\n";
+    if (!query.exec()) {
+        qDebug() << "Failed to load students for report:" << query.lastError().text();
+        return 0;
+    }
     
-    // Get attendance data from database
-    QList<Attendance> attendance = m_database->getAttendanceByClass(classId, date);
+    int studentCount = 0;
+    Student student;
     
-    if (attendance.isEmpty()) {
-        stream << "No attendance records found for the specified class and date.\n";
-    } else {
-        stream << formatAttendanceData(attendance);
-        
-        // Calculate statistics
-        int totalStudents = calculateTotalStudents(classId);
-        int present = 0, absent = 0, leave = 0, late = 0;
-        
-        for (const Attendance &att : attendance) {
-            switch (att.getStatus()) {
-                case Attendance::Present: present++; break;
-                case Attendance::Absent: absent++; break;
-                case Attendance::Leave: leave++; break;
-                case Attendance::Late: late++; break;
-            }
+    while (query.next() && !writer.hasError()) {
+        if (studentCount == 0) {
+            writer.beginSection("Student Information");
+            writer.beginTable({"Roll", "Name", "Age", "Guardian", "Contact"}, {5, 20, 10, 20, 15});
         }
         
-        stream << "\n=== STATISTICS ===\n";
-        stream << "Date: " << formatDate(date) << "\n";
-        stream << "Total Students: " << totalStudents << "\n";
-        stream << "Present: " << present << "\n";
-        stream << "Absent: " << absent << "\n";
-        stream << "Leave: " << leave << "\n";
-        stream << "Late: " << late << "\n";
-        stream << "Attendance Rate: " << QString::number((double)present / totalStudents * 100, 'f', 2) << "%\n";
+        student.setDateOfBirth(query.value("date_of_birth").toDate());
+        writer.addRow({query.value("roll_no").toString(),
+                       query.value("name").toString(),
+                       QString::number(student.getAge()),
+                       query.value("guardian_name").toString(),
+                       query.value("guardian_contact").toString()});
+        studentCount++;
     }
     
-    stream << formatReportFooter();
+    if (studentCount > 0) {
+        writer.endTable();
+    }
     
-    return report;
+    return studentCount;
 }
 
-QString Reports::generateClassReport(int classId, const QDate &startDate, const QDate &endDate)
+bool Reports::writeStudentReport(ReportWriter &writer, int classId, const QDate &startDate, const QDate &endDate)
 {
-    QString report;
-    QTextStream stream(&report);
+    writer.beginReport("Student Report", startDate, endDate);
     
-    stream << formatReportHeader("Class Report", startDate, endDate);
-    stream << "\n";
+    int studentCount = writeStudentTable(writer, classId);
     
-    // Get class information
-    QList<Class> classes = m_database->getAllClasses();
-    Class targetClass;
-    bool found = false;
+    if (studentCount == 0) {
+        writer.addText("No students found for the specified class.");
+    } else {
+        double attendancePercentage = calculateAttendancePercentage(classId, startDate, endDate);
+        
+        writer.beginSection("Statistics");
+        writer.addField("Total Students", QString::number(studentCount));
+        writer.addField("Average Attendance", QString::number(attendancePercentage, 'f', 2) + "%");
+        writer.addField("Report Period", formatDate(startDate) + " to " + formatDate(endDate));
+    }
     
-    for (const Class &cls : classes) {
-        if (cls.getId() == classId) {
-            targetClass = cls;
-            found = true;
-            break;
+    return writer.endReport();
+}
+
+bool Reports::writeAttendanceReport(ReportWriter &writer, int classId, const QDate &date)
+{
+    writer.beginReport("Attendance Report", date, date);
+    
+    QSqlQuery query(m_database->database());
+    query.setForwardOnly(true);
+    query.prepare("SELECT a.student_id, s.name, a.status, a.marked_at FROM attendance a "
+                 "LEFT JOIN students s ON s.id = a.student_id "
+                 "WHERE a.class_id = ? AND a.date = ? ORDER BY a.student_id");
+    query.addBindValue(classId);
+    query.addBindValue(date);
+    
+    int present = 0, absent = 0, leave = 0, late = 0;
+    int recordCount = 0;
+    
+    if (query.exec()) {
+        while (query.next() && !writer.hasError()) {
+            if (recordCount == 0) {
+                writer.beginSection("Attendance Records");
+                writer.beginTable({"Student ID", "Name", "Status", "Time"}, {10, 20, 10, 10});
+            }
+            
+            QString statusStr;
+            switch (static_cast<Attendance::Status>(query.value("status").toInt())) {
+                case Attendance::Present: statusStr = "Present"; present++; break;
+                case Attendance::Absent: statusStr = "Absent"; absent++; break;
+                case Attendance::Leave: statusStr = "Leave"; leave++; break;
+                case Attendance::Late: statusStr = "Late"; late++; break;
+            }
+            
+            writer.addRow({query.value("student_id").toString(),
+                           query.value("name").toString(),
+                           statusStr,
+                           query.value("marked_at").toDateTime().toString("hh:mm")});
+            recordCount++;
         }
+    } else {
+        qDebug() << "Failed to load attendance for report:" << query.lastError().text();
     }
     
-    if (!found) {
-        stream << "Class not found.\n";
+    if (recordCount == 0) {
+        writer.addText("No attendance records found for the specified class and date.");
     } else {
-        stream << "=== CLASS INFORMATION ===\n";
-        stream << "Grade: " << targetClass.getGrade() << "\n";
-        stream << "Section: " << targetClass.getDescription() << "\n";
-        stream << "Teacher: " << targetClass.getTeacherId() << "\n";
-        stream << "Capacity: " << targetClass.getCapacity() << "\n";
-        stream << "Room Number: " << targetClass.getRoomNumber() << "\n";
-        stream << "\n";
+        writer.endTable();
+        
+        int totalStudents = calculateTotalStudents(classId);
+        double rate = totalStudents > 0 ? (double)present / totalStudents * 100 : 0.0;
         
-        // Get students in this class
-        QList<Student> students = m_database->getStudentsByClass(classId);
-        stream << formatStudentData(students);
+        writer.beginSection("Statistics");
+        writer.addField("Date", formatDate(date));
+        writer.addField("Total Students", QString::number(totalStudents));
+        writer.addField("Present", QString::number(present));
+        writer.addField("Absent", QString::number(absent));
+        writer.addField("Leave", QString::number(leave));
+        writer.addField("Late", QString::number(late));
+        writer.addField("Attendance Rate", QString::number(rate, 'f', 2) + "%");
+    }
+    
+    return writer.endReport();
+}
+
+bool Reports::writeClassReport(ReportWriter &writer, int classId, const QDate &startDate, const QDate &endDate)
+{
+    writer.beginReport("Class Report", startDate, endDate);
+    
+    // Get class information
+    Class targetClass = m_database->getClassById(classId);
+    
+    if (targetClass.getId() != classId) {
+        writer.addText("Class not found.");
+    } else {
+        writer.beginSection("Class Information");
+        writer.addField("Grade", QString::number(targetClass.getGrade()));
+        writer.addField("Section", targetClass.getDescription());
+        writer.addField("Teacher", QString::number(targetClass.getTeacherId()));
+        writer.addField("Capacity", QString::number(targetClass.getCapacity()));
+        writer.addField("Room Number", targetClass.getRoomNumber());
         
-        // Add statistics
+        int studentCount = writeStudentTable(writer, classId);
         double attendancePercentage = calculateAttendancePercentage(classId, startDate, endDate);
         
-        stream << "\n=== STATISTICS ===\n";
-        stream << "Total Students: " << students.size() << "\n";
-        stream << "Average Attendance: " << QString::number(attendancePercentage, 'f', 2) << "%\n";
-        stream << "Report Period: " << formatDate(startDate) << " to " << formatDate(endDate) << "\n";
+        writer.beginSection("Statistics");
+        writer.addField("Total Students", QString::number(studentCount));
+        writer.addField("Average Attendance", QString::number(attendancePercentage, 'f', 2) + "%");
+        writer.addField("Report Period", formatDate(startDate) + " to " + formatDate(endDate));
     }
     
-    stream << formatReportFooter();
-    
-    return report;
+    return writer.endReport();
 }
 
-QString Reports::generateSummaryReport(const QDate &startDate, const QDate &endDate)
+bool Reports::writeSummaryReport(ReportWriter &writer, const QDate &startDate, const QDate &endDate)
 {
-    QString report;
-    QTextStream stream(&report);
+    writer.beginReport("Summary Report", startDate, endDate);
     
-    stream << formatReportHeader("Summary Report", startDate, endDate);
-    stream << "\n";
-    
-    // Get overall statistics
+    // Get overall statistics; per-class figures come from grouped queries,
+    // so the number of queries does not grow with the number of classes
     int totalTeachers = calculateTotalTeachers();
-    int totalClasses = calculateTotalClasses();
+    QList<Class> classes = m_database->getAllClasses();
+    QHash<int, ClassSummary> summaries = loadClassSummaries(startDate, endDate);
+    int totalClasses = classes.size();
     
-    // Calculate total students across all classes
     int totalStudents = 0;
-    QList<Class> classes = m_database->getAllClasses();
     for (const Class &cls : classes) {
-        totalStudents += calculateTotalStudents(cls.getId());
+        totalStudents += summaries.value(cls.getId()).studentCount;
     }
     
-    stream << "=== SYSTEM OVERVIEW ===\n";
-    stream << "Total Teachers: " << totalTeachers << "\n";
-    stream << "Total Classes: " << totalClasses << "\n";
-    stream << "Total Students: " << totalStudents << "\n";
-    stream << "Report Period: " << formatDate(startDate) << " to " << formatDate(endDate) << "\n";
-    stream << "\n";
+    writer.beginSection("System Overview");
+    writer.addField("Total Teachers", QString::number(totalTeachers));
+    writer.addField("Total Classes", QString::number(totalClasses));
+    writer.addField("Total Students", QString::number(totalStudents));
+    writer.addField("Report Period", formatDate(startDate) + " to " + formatDate(endDate));
     
     // Top performing classes
-    QList<QPair<QString, double>> topClasses = getTopPerformingClasses(startDate, endDate);
+    QList<QPair<QString, double>> topClasses = rankClasses(classes, summaries);
     
-    stream << "=== TOP PERFORMING CLASSES ===\n";
+    writer.beginSection("Top Performing Classes");
     for (const auto &pair : topClasses) {
-        stream << pair.first << ": " << QString::number(pair.second, 'f', 2) << "%\n";
+        writer.addField(pair.first, QString::number(pair.second, 'f', 2) + "%");
     }
     
-    stream << formatReportFooter();
-    
-    return report;
+    return writer.endReport();
 }
 
 bool Reports::exportToCSV(const QString &content, const QString &filename)
@@ -230,11 +362,36 @@ bool Reports::exportToCSV(const QString &content, const QString &filename)
 
 bool Reports::exportToExcel(const QString &content, const QString &filename)
 {
-    // For now, export as CSV with .xlsx extension
-    // Full Excel support would require additional libraries
-    QString csvFilename = filename;
-    csvFilename.replace(".xlsx", ".csv");
-    return exportToCSV(content, csvFilename);
+    QString documentsPath = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
+    QString filePath = documentsPath + "/" + filename;
+    
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Failed to open file for writing:" << filePath;
+        return false;
+    }
+    
+    // Pre-rendered text: one line per row in a single wide column
+    bool ok = true;
+    {
+        XlsxWriter xlsx(&file);
+        ok = xlsx.beginSheet("Report", 0, {100});
+        const QStringList lines = content.split('\n');
+        for (const QString &line : lines) {
+            if (!ok) {
+                break;
+            }
+            ok = xlsx.addRow({XlsxCell(line)});
+        }
+        ok = xlsx.close() && ok;
+    }
+    
+    file.close();
+    if (!ok) {
+        file.remove();
+    }
+    
+    return ok;
 }
 
 bool Reports::exportToHTML(const QString &content, const QString &filename)
@@ -258,32 +415,61 @@ bool Reports::exportToHTML(const QString &content, const QString &filename)
 QChart* Reports::generateAttendanceChart(int classId, const QDate &startDate, const QDate &endDate)
 {
     QChart *chart = new QChart();
-    QBarSeries *series = createAttendanceBarSeries(classId, startDate, endDate);
-    setupBarChart(chart, series, "Attendance Chart");
+    
+    if (startDate.daysTo(endDate) < kMaxDailyBars) {
+        QBarSeries *series = createAttendanceBarSeries(classId, startDate, endDate);
+        setupBarChart(chart, series, "Attendance Chart");
+        return chart;
+    }
+    
+    // Long ranges: one grouped query, then min-max decimation so every spike
+    // in a count survives at roughly one point per pixel
+    setupChart(chart, "Attendance Chart");
+    chart->setAnimationOptions(QChart::NoAnimation);
+    
+    ChartSeriesBuilder::DailyAttendance daily =
+        ChartSeriesBuilder::dailyAttendance(m_database->database(), startDate, endDate, classId);
+    
+    const QList<QPair<QString, QList<QPointF>>> counts = {
+        {"Present", daily.present}, {"Absent", daily.absent}, {"Leave", daily.excused}, {"Late", daily.late}
+    };
+    double maximum = 1.0;
+    for (const auto &count : counts) {
+        for (const QPointF &point : count.second) {
+            maximum = qMax(maximum, point.y());
+        }
+        chart->addSeries(ChartSeriesBuilder::lineSeries(count.first, count.second, kDefaultChartWidth,
+                                                        ChartSeriesBuilder::MinMax));
+    }
+    
+    ChartSeriesBuilder::attachTimeAxes(chart, "Students", 0, maximum);
     return chart;
 }
 
 QChart* Reports::generateStudentPerformanceChart(int classId, const QDate &startDate, const QDate &endDate)
 {
     QChart *chart = new QChart();
-    QBarSeries *series = createStudentPerformanceBarSeries(classId, startDate, endDate);
-    setupBarChart(chart, series, "Student Performance Chart");
+    QStringList categories;
+    QBarSeries *series = createStudentPerformanceBarSeries(classId, startDate, endDate, &categories);
+    setupBarChart(chart, series, "Student Performance Chart", categories);
     return chart;
 }
 
 QChart* Reports::generateTeacherWorkloadChart(const QDate &startDate, const QDate &endDate)
 {
     QChart *chart = new QChart();
-    QBarSeries *series = createTeacherWorkloadBarSeries(startDate, endDate);
-    setupBarChart(chart, series, "Teacher Workload Chart");
+    QStringList categories;
+    QBarSeries *series = createTeacherWorkloadBarSeries(startDate, endDate, &categories);
+    setupBarChart(chart, series, "Teacher Workload Chart", categories);
     return chart;
 }
 
 QChart* Reports::generateClassComparisonChart(const QDate &date)
 {
     QChart *chart = new QChart();
-    QBarSeries *series = createClassComparisonBarSeries(date);
-    setupBarChart(chart, series, "Class Comparison Chart");
+    QStringList categories;
+    QBarSeries *series = createClassComparisonBarSeries(date, &categories);
+    setupBarChart(chart, series, "Class Comparison Chart", categories);
     return chart;
 }
 
@@ -333,24 +519,29 @@ QString Reports::formatDateTime(const QDateTime &dateTime)
 
 double Reports::calculateAttendancePercentage(int classId, const QDate &startDate, const QDate &endDate)
 {
-    // Simplified calculation - in real implementation, would iterate through date range
-    int totalStudents = calculateTotalStudents(classId);
-    if (totalStudents == 0) return 0.0;
-    
-    // Mock calculation - would need actual attendance data
-    return 85.5; // Placeholder
+    return loadClassSummaries(startDate, endDate, classId).value(classId).attendancePercentage();
 }
 
 int Reports::calculateTotalStudents(int classId)
 {
-    QList<Student> students = m_database->getStudentsByClass(classId);
-    return students.size();
+    QSqlQuery query(m_database->database());
+    query.prepare("SELECT COUNT(*) FROM students WHERE class_id = ? AND is_active = 1");
+    query.addBindValue(classId);
+    
+    if (query.exec() && query.next()) {
+        return query.value(0).toInt();
+    }
+    return 0;
 }
 
 int Reports::calculateTotalTeachers()
 {
-    QList<Teacher> teachers = m_database->getAllTeachers();
-    return teachers.size();
+    QSqlQuery query(m_database->database());
+    
+    if (query.exec("SELECT COUNT(*) FROM teachers WHERE is_active = 1") && query.next()) {
+        return query.value(0).toInt();
+    }
+    return 0;
 }
 
 int Reports::calculateTotalClasses()
@@ -359,124 +550,144 @@ int Reports::calculateTotalClasses()
     return classes.size();
 }
 
-QList<QPair<QString, double>> Reports::getTopPerformingStudents(int classId, const QDate &startDate, const QDate &endDate)
-{
-    QList<QPair<QString, double>> result;
-    QList<Student> students = m_database->getStudentsByClass(classId);
-    
-    // Mock data - in real implementation, calculate actual performance
-    for (const Student &student : students) {
-        double performance = 80.0 + (rand() % 20); // Mock performance 80-100%
-        result.append(qMakePair(student.getName(), performance));
+QList<QPair<QString, double>> Reports::getTopPerformingStudents(int classId, const QDate &startDate, const QDate &endDate,
+                                                               int limit)
+{
+    // Attendance rate per student, streamed through a bounded heap; days
+    // marked separate equal rates so a longer record ranks first
+    QSqlQuery query(m_database->database());
+    query.setForwardOnly(true);
+    query.prepare("SELECT s.id, s.name, '' AS grp, "
+                  "COALESCE(SUM(CASE WHEN a.status IN (?, ?) THEN 1 ELSE 0 END) * 100.0 / NULLIF(COUNT(a.id), 0), 0) AS rate, "
+                  "COUNT(a.id) AS marked "
+                  "FROM students s LEFT JOIN attendance a ON a.student_id = s.id AND a.date BETWEEN ? AND ? "
+                  "WHERE s.class_id = ? AND s.is_active = 1 GROUP BY s.id");
+    query.addBindValue(static_cast<int>(Attendance::Present));
+    query.addBindValue(static_cast<int>(Attendance::Late));
+    query.addBindValue(startDate);
+    query.addBindValue(endDate);
+    query.addBindValue(classId);
+    
+    if (!query.exec()) {
+        qDebug() << "Failed to rank students:" << query.lastError().text();
+        return QList<QPair<QString, double>>();
     }
     
-    return result;
-}
-
-QList<QPair<QString, double>> Reports::getTopPerformingClasses(const QDate &startDate, const QDate &endDate)
-{
-    QList<QPair<QString, double>> result;
-    QList<Class> classes = m_database->getAllClasses();
+    RankingEngine ranking(limit, RankingEngine::Highest, RankingEngine::Competition, RankingEngine::BySecondary);
+    ranking.addRows(query);
     
-    // Mock data - in real implementation, calculate actual performance
-    for (const Class &cls : classes) {
-        double performance = 75.0 + (rand() % 25); // Mock performance 75-100%
-        QString className = "Grade " + QString::number(cls.getGrade()) + " " + cls.getDescription();
-        result.append(qMakePair(className, performance));
+    QList<QPair<QString, double>> result;
+    const QList<RankedEntry> ranked = ranking.results();
+    for (const RankedEntry &entry : ranked) {
+        result.append(qMakePair(entry.name, entry.score));
     }
-    
     return result;
 }
 
-QString Reports::formatTeacherData(const QList<Teacher> &teachers)
+QList<QPair<QString, double>> Reports::getTopPerformingClasses(const QDate &startDate, const QDate &endDate, int limit)
 {
-    QString result;
-    QTextStream stream(&result);
+    // Same rate as ClassSummary::attendancePercentage, one grouped pass over attendance
+    QSqlQuery query(m_database->database());
+    query.setForwardOnly(true);
+    query.prepare("SELECT c.id, 'Grade ' || COALESCE(c.grade, '') || ' ' || COALESCE(c.description, ''), '' AS grp, "
+                  "COALESCE(SUM(CASE WHEN a.status IN (?, ?) THEN 1 ELSE 0 END) * 100.0 / NULLIF(COUNT(a.id), 0), 0) AS rate "
+                  "FROM classes c LEFT JOIN attendance a ON a.class_id = c.id AND a.date BETWEEN ? AND ? "
+                  "WHERE c.is_active = 1 GROUP BY c.id");
+    query.addBindValue(static_cast<int>(Attendance::Present));
+    query.addBindValue(static_cast<int>(Attendance::Late));
+    query.addBindValue(startDate);
+    query.addBindValue(endDate);
     
-    stream << "=== TEACHER INFORMATION ===\n";
-    stream << QString("%-5s %-20s %-15s %-15s %-10s\n").arg("ID", "Name", "Subject", "Contact", "Class");
-    stream << QString("-").repeated(70) << "\n";
-    
-    for (const Teacher &teacher : teachers) {
-        stream << QString("%-5s %-20s %-15s %-15s %-10s\n")
-                  .arg(QString::number(teacher.getId()))
-                  .arg(teacher.getName().left(19))
-                  .arg(teacher.getSubject().left(14))
-                  .arg(teacher.getContact().left(14))
-                  .arg(QString::number(teacher.getAssignedClass()).left(9));
+    if (!query.exec()) {
+        qDebug() << "Failed to rank classes:" << query.lastError().text();
+        return QList<QPair<QString, double>>();
     }
     
+    RankingEngine ranking(limit);
+    ranking.addRows(query);
+    
+    QList<QPair<QString, double>> result;
+    const QList<RankedEntry> ranked = ranking.results();
+    for (const RankedEntry &entry : ranked) {
+        result.append(qMakePair(entry.name, entry.score));
+    }
     return result;
 }
 
-QString Reports::formatStudentData(const QList<Student> &students)
+QList<QPair<QString, double>> Reports::rankClasses(const QList<Class> &classes, const QHash<int, ClassSummary> &summaries)
 {
-    QString result;
-    QTextStream stream(&result);
-    
-    stream << "=== STUDENT INFORMATION ===\n";
-    stream << QString("%-5s %-20s %-10s %-20s %-15s\n").arg("Roll", "Name", "Age", "Guardian", "Contact");
-    stream << QString("-").repeated(75) << "\n";
+    QList<QPair<QString, double>> result;
     
-    for (const Student &student : students) {
-        stream << QString("%-5s %-20s %-10s %-20s %-15s\n")
-                  .arg(student.getRollNo())
-                  .arg(student.getName().left(19))
-                  .arg(QString::number(student.getAge()))
-                  .arg(student.getGuardianName().left(19))
-                  .arg(student.getGuardianContact().left(14));
+    for (const Class &cls : classes) {
+        QString className = "Grade " + QString::number(cls.getGrade()) + " " + cls.getDescription();
+        result.append(qMakePair(className, summaries.value(cls.getId()).attendancePercentage()));
     }
     
+    std::stable_sort(result.begin(), result.end(), [](const QPair<QString, double> &a, const QPair<QString, double> &b) {
+        return a.second > b.second;
+    });
+    
     return result;
 }
 
-QString Reports::formatAttendanceData(const QList<Attendance> &attendance)
+QHash<int, Reports::ClassSummary> Reports::loadClassSummaries(const QDate &startDate, const QDate &endDate, int classId)
 {
-    QString result;
-    QTextStream stream(&result);
+    QHash<int, ClassSummary> summaries;
+    QSqlQuery query(m_database->database());
+    query.setForwardOnly(true);
     
-    stream << "=== ATTENDANCE RECORDS ===\n";
-    stream << QString("%-10s %-20s %-10s %-10s\n").arg("Student ID", "Name", "Status", "Time");
-    stream << QString("-").repeated(55) << "\n";
+    // Enrolment for every class in one query
+    QString studentsQuery = "SELECT class_id, COUNT(*) AS students FROM students WHERE is_active = 1";
+    if (classId >= 0) {
+        studentsQuery += " AND class_id = ?";
+    }
+    studentsQuery += " GROUP BY class_id";
     
-    for (const Attendance &att : attendance) {
-        QString statusStr;
-        switch (att.getStatus()) {
-            case Attendance::Present: statusStr = "Present"; break;
-            case Attendance::Absent: statusStr = "Absent"; break;
-            case Attendance::Leave: statusStr = "Leave"; break;
-            case Attendance::Late: statusStr = "Late"; break;
+    query.prepare(studentsQuery);
+    if (classId >= 0) {
+        query.addBindValue(classId);
+    }
+    
+    if (query.exec()) {
+        while (query.next()) {
+            summaries[query.value("class_id").toInt()].studentCount = query.value("students").toInt();
         }
-        
-        stream << QString("%-10s %-20s %-10s %-10s\n")
-                  .arg(QString::number(att.getStudentId()))
-                  .arg("Student") // Would need to fetch student name
-                  .arg(statusStr)
-                  .arg(att.getDate().toString("hh:mm"));
+    } else {
+        qDebug() << "Failed to count students per class:" << query.lastError().text();
     }
     
-    return result;
-}
-
-QString Reports::formatClassData(const QList<Class> &classes)
-{
-    QString result;
-    QTextStream stream(&result);
+    // Attendance per class and status in one query
+    QString attendanceQuery = "SELECT class_id, status, COUNT(*) AS count FROM attendance "
+                              "WHERE date BETWEEN ? AND ?";
+    if (classId >= 0) {
+        attendanceQuery += " AND class_id = ?";
+    }
+    attendanceQuery += " GROUP BY class_id, status";
     
-    stream << "=== CLASS INFORMATION ===\n";
-    stream << QString("%-5s %-10s %-10s %-20s %-10s\n").arg("ID", "Grade", "Section", "Teacher", "Room");
-    stream << QString("-").repeated(60) << "\n";
+    query.prepare(attendanceQuery);
+    query.addBindValue(startDate);
+    query.addBindValue(endDate);
+    if (classId >= 0) {
+        query.addBindValue(classId);
+    }
     
-    for (const Class &cls : classes) {
-        stream << QString("%-5s %-10s %-10s %-20s %-10s\n")
-                  .arg(QString::number(cls.getId()))
-                  .arg(QString::number(cls.getGrade()))
-                  .arg(cls.getDescription().left(9))
-                  .arg(QString::number(cls.getTeacherId()).left(19))
-                  .arg(cls.getRoomNumber().left(9));
+    if (query.exec()) {
+        while (query.next()) {
+            ClassSummary &summary = summaries[query.value("class_id").toInt()];
+            int count = query.value("count").toInt();
+            
+            switch (static_cast<Attendance::Status>(query.value("status").toInt())) {
+                case Attendance::Present: summary.present += count; break;
+                case Attendance::Absent: summary.absent += count; break;
+                case Attendance::Leave: summary.leave += count; break;
+                case Attendance::Late: summary.late += count; break;
+            }
+        }
+    } else {
+        qDebug() << "Failed to summarize attendance per class:" << query.lastError().text();
     }
     
-    return result;
+    return summaries;
 }
 
 QString Reports::createHTMLTemplate(const QString &content)
@@ -505,13 +716,6 @@ QString Reports::createCSVContent(const QString &content)
     return csv;
 }
 
-QString Reports::createExcelContent(const QString &content)
-{
-    // For now, return CSV content
-    // Full Excel support would require additional libraries
-    return createCSVContent(content);
-}
-
 // Chart creation methods (simplified implementations)
 QBarSeries* Reports::createAttendanceBarSeries(int classId, const QDate &startDate, const QDate &endDate)
 {
@@ -522,11 +726,17 @@ QBarSeries* Reports::createAttendanceBarSeries(int classId, const QDate &startDa
     QBarSet *leaveSet = new QBarSet("Leave");
     QBarSet *lateSet = new QBarSet("Late");
     
-    // Mock data - in real implementation, query actual data
-    *presentSet << 25 << 22 << 28 << 30 << 27;
-    *absentSet << 3 << 5 << 2 << 1 << 3;
-    *leaveSet << 1 << 2 << 0 << 1 << 2;
-    *lateSet << 1 << 1 << 0 << 0 << 1;
+    // Daily totals of this class in one grouped query; days without marks get empty bars
+    const QMap<QDate, AttendanceHeatmapTile> days =
+        ChartSeriesBuilder::classDailyCounts(m_database->database(), classId, startDate, endDate);
+    
+    for (QDate date = startDate; date.isValid() && date <= endDate; date = date.addDays(1)) {
+        AttendanceHeatmapTile total = days.value(date);
+        *presentSet << total.present;
+        *absentSet << total.absent;
+        *leaveSet << total.excused;
+        *lateSet << total.late;
+    }
     
     series->append(presentSet);
     series->append(absentSet);
@@ -540,51 +750,88 @@ QPieSeries* Reports::createAttendancePieSeries(int classId, const QDate &date)
 {
     QPieSeries *series = new QPieSeries();
     
-    // Mock data
-    series->append("Present", 25);
-    series->append("Absent", 3);
-    series->append("Leave", 1);
-    series->append("Late", 1);
+    AttendanceHeatmapTile day =
+        ChartSeriesBuilder::classDailyCounts(m_database->database(), classId, date, date).value(date);
+    series->append("Present", day.present);
+    series->append("Absent", day.absent);
+    series->append("Leave", day.excused);
+    series->append("Late", day.late);
     
     return series;
 }
 
-QBarSeries* Reports::createStudentPerformanceBarSeries(int classId, const QDate &startDate, const QDate &endDate)
+QBarSeries* Reports::createStudentPerformanceBarSeries(int classId, const QDate &startDate, const QDate &endDate,
+                                                       QStringList *categories)
 {
     QBarSeries *series = new QBarSeries();
-    
-    QBarSet *performanceSet = new QBarSet("Performance");
-    
-    // Mock data - in real implementation, calculate actual performance
-    *performanceSet << 85 << 92 << 78 << 88 << 94;
+    QBarSet *performanceSet = new QBarSet("Attendance %");
+    
+    // Per-student attendance over the range in one grouped query
+    QSqlQuery query(m_database->database());
+    query.setForwardOnly(true);
+    query.prepare("SELECT s.name, "
+                  "SUM(CASE WHEN a.status IN (?, ?) THEN 1 ELSE 0 END) AS attended, COUNT(a.id) AS marked "
+                  "FROM students s LEFT JOIN attendance a ON a.student_id = s.id AND a.date BETWEEN ? AND ? "
+                  "WHERE s.class_id = ? AND s.is_active = 1 GROUP BY s.id ORDER BY s.name");
+    query.addBindValue(static_cast<int>(Attendance::Present));
+    query.addBindValue(static_cast<int>(Attendance::Late));
+    query.addBindValue(startDate);
+    query.addBindValue(endDate);
+    query.addBindValue(classId);
+    
+    if (query.exec()) {
+        while (query.next()) {
+            int marked = query.value("marked").toInt();
+            categories->append(query.value("name").toString());
+            *performanceSet << (marked > 0 ? query.value("attended").toDouble() / marked * 100 : 0.0);
+        }
+    } else {
+        qDebug() << "Failed to load student performance:" << query.lastError().text();
+    }
     
     series->append(performanceSet);
     
     return series;
 }
 
-QBarSeries* Reports::createTeacherWorkloadBarSeries(const QDate &startDate, const QDate &endDate)
+QBarSeries* Reports::createTeacherWorkloadBarSeries(const QDate &startDate, const QDate &endDate,
+                                                    QStringList *categories)
 {
-    QBarSeries *series = new QBarSeries();
+    // Assignments are not dated, so the current load is shown for any range
+    Q_UNUSED(startDate)
+    Q_UNUSED(endDate)
     
+    QBarSeries *series = new QBarSeries();
     QBarSet *workloadSet = new QBarSet("Classes Taught");
     
-    // Mock data
-    *workloadSet << 5 << 4 << 6 << 3 << 5;
+    QSqlQuery query(m_database->database());
+    query.setForwardOnly(true);
+    if (query.exec("SELECT t.name, COUNT(c.id) AS classes FROM teachers t "
+                   "LEFT JOIN classes c ON c.teacher_id = t.id AND c.is_active = 1 "
+                   "WHERE t.is_active = 1 GROUP BY t.id ORDER BY t.name")) {
+        while (query.next()) {
+            categories->append(query.value("name").toString());
+            *workloadSet << query.value("classes").toInt();
+        }
+    } else {
+        qDebug() << "Failed to load teacher workload:" << query.lastError().text();
+    }
     
     series->append(workloadSet);
     
     return series;
 }
 
-QBarSeries* Reports::createClassComparisonBarSeries(const QDate &date)
+QBarSeries* Reports::createClassComparisonBarSeries(const QDate &date, QStringList *categories)
 {
     QBarSeries *series = new QBarSeries();
-    
     QBarSet *attendanceSet = new QBarSet("Attendance Rate");
     
-    // Mock data
-    *attendanceSet << 85 << 90 << 88 << 92 << 87;
+    const QList<QPair<QString, double>> ranked = getTopPerformingClasses(date, date, 0);
+    for (const auto &pair : ranked) {
+        categories->append(pair.first);
+        *attendanceSet << pair.second;
+    }
     
     series->append(attendanceSet);
     
@@ -597,11 +844,20 @@ void Reports::setupChart(QChart *chart, const QString &title)
     chart->setAnimationOptions(QChart::SeriesAnimations);
 }
 
-void Reports::setupBarChart(QChart *chart, QBarSeries *series, const QString &title)
+void Reports::setupBarChart(QChart *chart, QBarSeries *series, const QString &title, const QStringList &categories)
 {
     setupChart(chart, title);
     chart->addSeries(series);
     chart->createDefaultAxes();
+    
+    if (!categories.isEmpty()) {
+        const QList<QAbstractAxis *> axes = chart->axes(Qt::Horizontal);
+        for (QAbstractAxis *axis : axes) {
+            if (QBarCategoryAxis *categoryAxis = qobject_cast<QBarCategoryAxis *>(axis)) {
+                categoryAxis->setCategories(categories);
+            }
+        }
+    }
 }
 
 void Reports::setupPieChart(QChart *chart, QPieSeries *series, const QString &title)
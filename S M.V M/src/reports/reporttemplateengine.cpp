@@ -0,0 +1,402 @@
+#include "reports/reporttemplateengine.h"
+#include "database/readconnectionpool.h"
+#include <QSqlDriver>
+#include <QSqlRecord>
+#include <QSqlResult>
+#include <QSqlError>
+#include <QElapsedTimer>
+#include <QDeadlineTimer>
+#include <QSemaphore>
+#include <QSet>
+#include <QDebug>
+#include <memory>
+
+#ifdef SMARTMAVI_HAVE_SQLITE3
+#include <sqlite3.h>
+#endif
+
+namespace {
+
+const int kDefaultRowLimit = 10000;
+const int kDefaultTimeLimitMs = 5000;
+#ifdef SMARTMAVI_HAVE_SQLITE3
+const int kProgressOpcodes = 1000;
+#endif
+
+// Shared with the worker, which may outlive the caller's wait
+struct TemplateRun {
+    TemplateResult result;
+    QString error;
+    bool ok = false;
+};
+
+// Bare words and placeholders of a statement, with literals, quoted
+// identifiers and comments skipped so their contents never count
+struct SqlScan {
+    QStringList words;                   // Upper-cased
+    QStringList parameters;              // Named, without the ':'
+    bool positional = false;             // '?' or '@' / '$' parameters
+    bool trailingStatement = false;      // Anything after a ';'
+    bool unterminated = false;
+};
+
+SqlScan scanSql(const QString &sql)
+{
+    SqlScan scan;
+    bool afterSemicolon = false;
+    int i = 0;
+    const int n = sql.size();
+
+    while (i < n) {
+        QChar c = sql.at(i);
+
+        if (c.isSpace()) {
+            ++i;
+            continue;
+        }
+        if (c == '-' && i + 1 < n && sql.at(i + 1) == '-') {
+            while (i < n && sql.at(i) != '\n') ++i;
+            continue;
+        }
+        if (c == '/' && i + 1 < n && sql.at(i + 1) == '*') {
+            int end = sql.indexOf("*/", i + 2);
+            if (end < 0) {
+                scan.unterminated = true;
+                break;
+            }
+            i = end + 2;
+            continue;
+        }
+
+        if (afterSemicolon && c != ';') {
+            scan.trailingStatement = true;
+        }
+
+        if (c == '\'' || c == '"' || c == '`' || c == '[') {
+            QChar close = c == '[' ? QChar(']') : c;
+            int j = i + 1;
+            while (true) {
+                if (j >= n) {
+                    scan.unterminated = true;
+                    return scan;
+                }
+                if (sql.at(j) == close) {
+                    // Doubled quotes are escapes
+                    if (close != ']' && j + 1 < n && sql.at(j + 1) == close) {
+                        j += 2;
+                        continue;
+                    }
+                    break;
+                }
+                ++j;
+            }
+            i = j + 1;
+            continue;
+        }
+
+        if (c == ';') {
+            afterSemicolon = true;
+            ++i;
+            continue;
+        }
+
+        if (c == ':' || c == '@' || c == '$' || c == '?') {
+            int j = i + 1;
+            while (j < n && (sql.at(j).isLetterOrNumber() || sql.at(j) == '_')) ++j;
+            if (c == ':' && j > i + 1) {
+                QString name = sql.mid(i + 1, j - i - 1);
+                if (!scan.parameters.contains(name)) {
+                    scan.parameters.append(name);
+                }
+            } else {
+                scan.positional = true;
+            }
+            i = j;
+            continue;
+        }
+
+        if (c.isLetter() || c == '_') {
+            int j = i + 1;
+            while (j < n && (sql.at(j).isLetterOrNumber() || sql.at(j) == '_')) ++j;
+            scan.words.append(sql.mid(i, j - i).toUpper());
+            i = j;
+            continue;
+        }
+
+        ++i;
+    }
+
+    return scan;
+}
+
+#ifdef SMARTMAVI_HAVE_SQLITE3
+int interruptAfterDeadline(void *deadline)
+{
+    return static_cast<const QDeadlineTimer *>(deadline)->hasExpired() ? 1 : 0;
+}
+
+sqlite3 *sqliteHandle(const QSqlDatabase &db)
+{
+    QVariant handle = db.driver()->handle();
+    if (handle.isValid() && qstrcmp(handle.typeName(), "sqlite3*") == 0) {
+        return *static_cast<sqlite3 *const *>(handle.constData());
+    }
+    return nullptr;
+}
+#endif
+
+} // namespace
+
+ReportTemplateEngine::ReportTemplateEngine(const QString &databasePath)
+    : m_worker(new ReadConnectionPool(databasePath, 1))
+    , m_rowLimit(kDefaultRowLimit)
+    , m_timeLimitMs(kDefaultTimeLimitMs)
+{
+}
+
+ReportTemplateEngine::~ReportTemplateEngine()
+{
+    // Statements must go before their connection, on the thread that owns both
+    m_worker->threadPool()->start([this]() { m_statements.clear(); });
+    delete m_worker;
+}
+
+void ReportTemplateEngine::invalidate(const QString &templateName)
+{
+    m_worker->threadPool()->start([this, templateName]() { m_statements.remove(templateName); });
+}
+
+void ReportTemplateEngine::clear()
+{
+    m_worker->threadPool()->start([this]() { m_statements.clear(); });
+}
+
+bool ReportTemplateEngine::runOnWorker(const std::function<void()> &task, const QDeadlineTimer &deadline)
+{
+    std::shared_ptr<QSemaphore> done = std::make_shared<QSemaphore>();
+    m_worker->threadPool()->start([task, done, deadline]() {
+        // Queued behind a run that overran; nobody waits for this one any more
+        if (!deadline.hasExpired()) {
+            task();
+        }
+        done->release();
+    });
+    return done->tryAcquire(1, static_cast<int>(qMax<qint64>(0, deadline.remainingTime())));
+}
+
+QString ReportTemplateEngine::validate(const QString &sql, const QStringList &declaredParameters)
+{
+    static const QSet<QString> forbidden = {
+        "INSERT", "UPDATE", "DELETE", "CREATE", "DROP", "ALTER", "ATTACH", "DETACH",
+        "PRAGMA", "VACUUM", "REINDEX", "ANALYZE", "BEGIN", "COMMIT", "ROLLBACK",
+        "SAVEPOINT", "RELEASE", "LOAD_EXTENSION"
+    };
+
+    SqlScan scan = scanSql(sql);
+    if (scan.unterminated) {
+        return "Unterminated string, identifier or comment";
+    }
+    if (scan.words.isEmpty() || (scan.words.first() != "SELECT" && scan.words.first() != "WITH")) {
+        return "Templates must be a SELECT query";
+    }
+    if (scan.trailingStatement) {
+        return "Templates must be a single statement";
+    }
+    if (scan.positional) {
+        return "Use :name parameters";
+    }
+
+    for (int i = 0; i < scan.words.size(); ++i) {
+        const QString &word = scan.words.at(i);
+        // replace() is also a string function; only REPLACE INTO writes
+        bool replaceInto = word == "REPLACE" && i + 1 < scan.words.size() && scan.words.at(i + 1) == "INTO";
+        if (forbidden.contains(word) || replaceInto) {
+            return QString("%1 is not allowed in a template").arg(word);
+        }
+#ifndef SMARTMAVI_HAVE_SQLITE3
+        // Nothing can interrupt a single step without the progress handler
+        if (word == "RECURSIVE") {
+            return "RECURSIVE needs a build with SMARTMAVI_USE_SYSTEM_SQLITE";
+        }
+#endif
+    }
+
+    QStringList declared;
+    for (const QString &parameter : declaredParameters) {
+        if (!parameter.trimmed().isEmpty()) {
+            declared.append(parameter.trimmed());
+        }
+    }
+    for (const QString &parameter : scan.parameters) {
+        if (!declared.contains(parameter)) {
+            return QString("Parameter :%1 is not declared").arg(parameter);
+        }
+    }
+
+    return QString();
+}
+
+QStringList ReportTemplateEngine::placeholders(const QString &sql)
+{
+    return scanSql(sql).parameters;
+}
+
+ReportTemplateEngine::CachedStatement *ReportTemplateEngine::statement(const ReportTemplate &temp, QString *error)
+{
+    auto it = m_statements.find(temp.name);
+    if (it != m_statements.end() && it->sql == temp.sqlQuery) {
+        return &it.value();
+    }
+
+    // Templates saved before validation existed are checked here once
+    QString reason = validate(temp.sqlQuery, temp.parameters);
+    if (!reason.isEmpty()) {
+        *error = reason;
+        return nullptr;
+    }
+
+    QSqlDatabase db = m_worker->connection();
+    if (!db.isValid() || !db.isOpen()) {
+        *error = "Database unavailable";
+        return nullptr;
+    }
+
+    CachedStatement cached;
+    cached.sql = temp.sqlQuery;
+    cached.parameters = placeholders(temp.sqlQuery);
+    cached.query = QSqlQuery(db);
+    cached.query.setForwardOnly(true);
+    if (!cached.query.prepare(temp.sqlQuery)) {
+        *error = cached.query.lastError().text();
+        return nullptr;
+    }
+
+#ifdef SMARTMAVI_HAVE_SQLITE3
+    // SQLite's own verdict backs up the keyword scan
+    QVariant handle = cached.query.result()->handle();
+    if (handle.isValid() && qstrcmp(handle.typeName(), "sqlite3_stmt*") == 0) {
+        sqlite3_stmt *stmt = *static_cast<sqlite3_stmt *const *>(handle.constData());
+        if (stmt && !sqlite3_stmt_readonly(stmt)) {
+            *error = "Templates must not modify the database";
+            return nullptr;
+        }
+    }
+#endif
+
+    it = m_statements.insert(temp.name, cached);
+    return &it.value();
+}
+
+bool ReportTemplateEngine::check(const ReportTemplate &temp, QString *error)
+{
+    std::shared_ptr<TemplateRun> run = std::make_shared<TemplateRun>();
+    bool finished = runOnWorker([this, run, temp]() {
+        m_statements.remove(temp.name);
+        run->ok = statement(temp, &run->error) != nullptr;
+    }, QDeadlineTimer(m_timeLimitMs));
+
+    if (!finished) {
+        *error = "Template engine is busy";
+        return false;
+    }
+    *error = run->error;
+    return run->ok;
+}
+
+bool ReportTemplateEngine::execute(const ReportTemplate &temp, const QMap<QString, QVariant> &parameters,
+                                   TemplateResult *result, QString *error)
+{
+    QElapsedTimer timer;
+    timer.start();
+    *result = TemplateResult();
+
+    std::shared_ptr<TemplateRun> run = std::make_shared<TemplateRun>();
+    int rowLimit = m_rowLimit;
+    QDeadlineTimer deadline(m_timeLimitMs);
+    bool finished = runOnWorker([this, run, temp, parameters, rowLimit, deadline]() {
+        run->ok = runStatement(temp, parameters, rowLimit, deadline, &run->result, &run->error);
+    }, deadline);
+
+    // The worker keeps its own copy and resets the statement once the step returns
+    if (!finished || (!run->ok && deadline.hasExpired())) {
+        *error = QString("Template exceeded %1 ms").arg(m_timeLimitMs);
+        return false;
+    }
+
+    *result = run->result;
+    *error = run->error;
+    result->elapsedMs = timer.elapsed();
+    return run->ok;
+}
+
+bool ReportTemplateEngine::runStatement(const ReportTemplate &temp, const QMap<QString, QVariant> &parameters,
+                                        int rowLimit, const QDeadlineTimer &deadline, TemplateResult *result,
+                                        QString *error)
+{
+    CachedStatement *cached = statement(temp, error);
+    if (!cached) {
+        return false;
+    }
+
+    QSqlQuery &query = cached->query;
+    for (const QString &name : cached->parameters) {
+        if (!parameters.contains(name)) {
+            *error = QString("Missing parameter :%1").arg(name);
+            return false;
+        }
+        query.bindValue(":" + name, parameters.value(name));
+    }
+
+#ifdef SMARTMAVI_HAVE_SQLITE3
+    // Interrupts a runaway statement even inside a single step
+    sqlite3 *handle = sqliteHandle(m_worker->connection());
+    if (handle) {
+        sqlite3_progress_handler(handle, kProgressOpcodes, interruptAfterDeadline,
+                                 const_cast<QDeadlineTimer *>(&deadline));
+    }
+#endif
+
+    bool ok = query.exec();
+    if (ok) {
+        QSqlRecord record = query.record();
+        for (int i = 0; i < record.count(); ++i) {
+            result->columns.append(record.fieldName(i));
+        }
+
+        while (query.next()) {
+            if (result->rows.size() >= rowLimit) {
+                result->truncated = true;
+                break;
+            }
+            if (deadline.hasExpired()) {
+                ok = false;
+                break;
+            }
+
+            QVariantList row;
+            row.reserve(result->columns.size());
+            for (int i = 0; i < result->columns.size(); ++i) {
+                row.append(query.value(i));
+            }
+            result->rows.append(row);
+        }
+
+        if (query.lastError().isValid()) {
+            ok = false;
+        }
+    }
+
+    if (!ok) {
+        *error = deadline.hasExpired() ? QString("Template exceeded its time limit") : query.lastError().text();
+    }
+
+#ifdef SMARTMAVI_HAVE_SQLITE3
+    if (handle) {
+        sqlite3_progress_handler(handle, 0, nullptr, nullptr);
+    }
+#endif
+
+    // Resets the statement so it keeps no read lock between runs
+    query.finish();
+    return ok;
+}
@@ -0,0 +1,390 @@
+#include "reports/reportwriter.h"
+#include <QIODevice>
+#include <QDateTime>
+
+namespace {
+
+const char *const kRule = "========================================\n";
+
+QString periodLine(const QDate &startDate, const QDate &endDate)
+{
+    if (startDate != endDate) {
+        return "Period: " + startDate.toString("yyyy-MM-dd") + " - " + endDate.toString("yyyy-MM-dd");
+    }
+    return "Date: " + startDate.toString("yyyy-MM-dd");
+}
+
+} // namespace
+
+ReportWriter::ReportWriter(QIODevice *device)
+    : m_out(device)
+{
+}
+
+ReportWriter::~ReportWriter()
+{
+}
+
+ReportWriter *ReportWriter::create(Format format, QIODevice *device)
+{
+    switch (format) {
+    case Csv: return new CsvReportWriter(device);
+    case Html: return new HtmlReportWriter(device);
+    case Xlsx: return new XlsxReportWriter(device);
+    default: return new TextReportWriter(device);
+    }
+}
+
+// Text
+
+bool TextReportWriter::beginReport(const QString &title, const QDate &startDate, const QDate &endDate)
+{
+    QString header;
+    header += kRule;
+    header += "       SMART MA.VI MANAGER\n";
+    header += "        " + title + "\n";
+    header += kRule;
+    header += "Generated on: " + QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss") + "\n";
+    header += periodLine(startDate, endDate) + "\n";
+    header += "School: Shree MA.VI Imilya\n";
+    header += kRule;
+    header += "\n";
+    return m_out.write(header);
+}
+
+bool TextReportWriter::beginSection(const QString &title)
+{
+    return m_out.write("\n=== " + title.toUpper() + " ===\n");
+}
+
+bool TextReportWriter::beginTable(const QStringList &columns, const QList<int> &widths)
+{
+    m_widths = widths;
+    while (m_widths.size() < columns.size()) {
+        m_widths.append(15);
+    }
+
+    int ruleWidth = 0;
+    for (int i = 0; i < columns.size(); ++i) {
+        ruleWidth += m_widths.at(i) + 1;
+    }
+
+    return m_out.write(formatRow(columns)) && m_out.write(QString("-").repeated(ruleWidth) + "\n");
+}
+
+QString TextReportWriter::formatRow(const QStringList &cells) const
+{
+    QString line;
+    for (int i = 0; i < cells.size(); ++i) {
+        int width = i < m_widths.size() ? m_widths.at(i) : 15;
+        if (i > 0) {
+            line += QLatin1Char(' ');
+        }
+        // Truncated to width - 1 so adjacent columns never touch
+        line += cells.at(i).left(width - 1).leftJustified(width);
+    }
+    while (line.endsWith(QLatin1Char(' '))) {
+        line.chop(1);
+    }
+    return line + "\n";
+}
+
+bool TextReportWriter::addRow(const QStringList &cells)
+{
+    return m_out.write(formatRow(cells));
+}
+
+bool TextReportWriter::addField(const QString &label, const QString &value)
+{
+    return m_out.write(label + ": " + value + "\n");
+}
+
+bool TextReportWriter::addText(const QString &text)
+{
+    return m_out.write(text + "\n");
+}
+
+bool TextReportWriter::endReport()
+{
+    QString footer;
+    footer += "\n";
+    footer += kRule;
+    footer += "Report generated by Smart MA.VI Manager\n";
+    footer += "© 2024 Tech07. All rights reserved.\n";
+    footer += kRule;
+    return m_out.write(footer) && m_out.flush();
+}
+
+// CSV
+
+bool CsvReportWriter::writeRecord(const QStringList &cells)
+{
+    QString line;
+    for (int i = 0; i < cells.size(); ++i) {
+        if (i > 0) {
+            line += QLatin1Char(',');
+        }
+
+        const QString &cell = cells.at(i);
+        if (cell.contains(',') || cell.contains('"') || cell.contains('\n') || cell.contains('\r')) {
+            QString escaped = cell;
+            escaped.replace("\"", "\"\"");
+            line += QLatin1Char('"') + escaped + QLatin1Char('"');
+        } else {
+            line += cell;
+        }
+    }
+    return m_out.write(line + "\r\n");
+}
+
+bool CsvReportWriter::beginReport(const QString &title, const QDate &startDate, const QDate &endDate)
+{
+    return writeRecord({title})
+        && writeRecord({periodLine(startDate, endDate)})
+        && writeRecord({"Generated on", QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss")});
+}
+
+bool CsvReportWriter::beginSection(const QString &title)
+{
+    return m_out.write(QByteArray("\r\n")) && writeRecord({title});
+}
+
+bool CsvReportWriter::beginTable(const QStringList &columns, const QList<int> &widths)
+{
+    Q_UNUSED(widths)
+    return writeRecord(columns);
+}
+
+bool CsvReportWriter::addRow(const QStringList &cells)
+{
+    return writeRecord(cells);
+}
+
+bool CsvReportWriter::addField(const QString &label, const QString &value)
+{
+    return writeRecord({label, value});
+}
+
+bool CsvReportWriter::addText(const QString &text)
+{
+    return writeRecord({text});
+}
+
+bool CsvReportWriter::endReport()
+{
+    return m_out.flush();
+}
+
+// HTML
+
+bool HtmlReportWriter::beginReport(const QString &title, const QDate &startDate, const QDate &endDate)
+{
+    QString html = "<!DOCTYPE html>\n<html>\n<head>\n";
+    html += "<meta charset='UTF-8'>\n";
+    html += "<title>" + title.toHtmlEscaped() + "</title>\n";
+    html += "<style>\n";
+    html += "body { font-family: Arial, sans-serif; margin: 20px; }\n";
+    html += "h1 { color: #2c3e50; }\n";
+    html += "table { border-collapse: collapse; margin-bottom: 15px; }\n";
+    html += "th, td { border: 1px solid #ccc; padding: 4px 8px; text-align: left; }\n";
+    html += "th { background-color: #f5f5f5; }\n";
+    html += "</style>\n";
+    html += "</head>\n<body>\n";
+    html += "<h1>" + title.toHtmlEscaped() + "</h1>\n";
+    html += "<p>" + periodLine(startDate, endDate).toHtmlEscaped() + "<br>";
+    html += "Generated on: " + QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss") + "</p>\n";
+    return m_out.write(html);
+}
+
+bool HtmlReportWriter::beginSection(const QString &title)
+{
+    if (m_inTable && !endTable()) {
+        return false;
+    }
+    return m_out.write("<h2>" + title.toHtmlEscaped() + "</h2>\n");
+}
+
+bool HtmlReportWriter::beginTable(const QStringList &columns, const QList<int> &widths)
+{
+    Q_UNUSED(widths)
+    if (m_inTable && !endTable()) {
+        return false;
+    }
+
+    QString html = "<table>\n<tr>";
+    for (const QString &column : columns) {
+        html += "<th>" + column.toHtmlEscaped() + "</th>";
+    }
+    html += "</tr>\n";
+
+    m_inTable = true;
+    return m_out.write(html);
+}
+
+bool HtmlReportWriter::addRow(const QStringList &cells)
+{
+    QString html = "<tr>";
+    for (const QString &cell : cells) {
+        html += "<td>" + cell.toHtmlEscaped() + "</td>";
+    }
+    html += "</tr>\n";
+    return m_out.write(html);
+}
+
+bool HtmlReportWriter::endTable()
+{
+    if (!m_inTable) {
+        return !m_out.hasError();
+    }
+    m_inTable = false;
+    return m_out.write(QByteArray("</table>\n"));
+}
+
+bool HtmlReportWriter::addField(const QString &label, const QString &value)
+{
+    return m_out.write("<p><b>" + label.toHtmlEscaped() + ":</b> " + value.toHtmlEscaped() + "</p>\n");
+}
+
+bool HtmlReportWriter::addText(const QString &text)
+{
+    return m_out.write("<p>" + text.toHtmlEscaped() + "</p>\n");
+}
+
+bool HtmlReportWriter::endReport()
+{
+    if (m_inTable && !endTable()) {
+        return false;
+    }
+    return m_out.write(QByteArray("</body>\n</html>\n")) && m_out.flush();
+}
+
+// XLSX
+
+XlsxReportWriter::XlsxReportWriter(QIODevice *device)
+    : ReportWriter(device)
+    , m_xlsx(device)
+{
+}
+
+XlsxCell XlsxReportWriter::toCell(const QString &text)
+{
+    bool numeric = false;
+    if (text.endsWith(QLatin1Char('%'))) {
+        double percent = text.chopped(1).toDouble(&numeric);
+        if (numeric) {
+            return XlsxCell(percent / 100.0, XlsxWriter::Percent);
+        }
+    }
+
+    // Leading zeros (contacts, IDs like "007") stay text
+    if (!text.isEmpty() && !(text.size() > 1 && text.startsWith(QLatin1Char('0')) && text.at(1) != QLatin1Char('.'))) {
+        qlonglong integer = text.toLongLong(&numeric);
+        if (numeric) {
+            return XlsxCell(integer);
+        }
+        double decimal = text.toDouble(&numeric);
+        if (numeric) {
+            return XlsxCell(decimal, XlsxWriter::Decimal);
+        }
+    }
+    return XlsxCell(text);
+}
+
+bool XlsxReportWriter::ensureSheet()
+{
+    if (m_sheetOpen) {
+        return !hasError();
+    }
+    m_sheetOpen = true;
+    return m_xlsx.beginSheet(m_section.isEmpty() ? m_sheetName : m_section, 0, {28, 40});
+}
+
+bool XlsxReportWriter::beginReport(const QString &title, const QDate &startDate, const QDate &endDate)
+{
+    m_sheetName = title;
+    return ensureSheet()
+        && m_xlsx.addRow({XlsxCell(title, XlsxWriter::Header)})
+        && m_xlsx.addRow({XlsxCell(startDate != endDate ? "Period" : "Date"),
+                          XlsxCell(startDate, XlsxWriter::Date),
+                          XlsxCell(startDate != endDate ? QVariant(endDate) : QVariant(), XlsxWriter::Date)})
+        && m_xlsx.addRow({XlsxCell("Generated on"), XlsxCell(QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss"))});
+}
+
+bool XlsxReportWriter::beginSection(const QString &title)
+{
+    if (m_inTable && !endTable()) {
+        return false;
+    }
+    m_section = title;
+    if (m_sheetOpen && !m_xlsx.addRow(QVariantList())) {
+        return false;
+    }
+    return ensureSheet() && m_xlsx.addRow({XlsxCell(title, XlsxWriter::Header)});
+}
+
+bool XlsxReportWriter::beginTable(const QStringList &columns, const QList<int> &widths)
+{
+    if (m_inTable && !endTable()) {
+        return false;
+    }
+
+    QList<double> columnWidths;
+    for (int i = 0; i < columns.size(); ++i) {
+        columnWidths.append(qMax(i < widths.size() ? widths.at(i) : 15, columns.at(i).size()) + 2);
+    }
+
+    // Whatever follows the table continues on a new sheet
+    m_sheetOpen = false;
+    m_inTable = true;
+
+    QList<XlsxCell> header;
+    for (const QString &column : columns) {
+        header.append(XlsxCell(column, XlsxWriter::Header));
+    }
+    return m_xlsx.beginSheet(m_section.isEmpty() ? m_sheetName : m_section, 1, columnWidths)
+        && m_xlsx.addRow(header);
+}
+
+bool XlsxReportWriter::addRow(const QStringList &cells)
+{
+    if (!m_inTable && !ensureSheet()) {
+        return false;
+    }
+
+    QList<XlsxCell> row;
+    row.reserve(cells.size());
+    for (const QString &cell : cells) {
+        row.append(toCell(cell));
+    }
+    return m_xlsx.addRow(row);
+}
+
+bool XlsxReportWriter::endTable()
+{
+    if (!m_inTable) {
+        return !hasError();
+    }
+    m_inTable = false;
+    return m_xlsx.endSheet();
+}
+
+bool XlsxReportWriter::addField(const QString &label, const QString &value)
+{
+    if (m_inTable && !endTable()) {
+        return false;
+    }
+    return ensureSheet() && m_xlsx.addRow({XlsxCell(label), toCell(value)});
+}
+
+bool XlsxReportWriter::addText(const QString &text)
+{
+    if (m_inTable && !endTable()) {
+        return false;
+    }
+    return ensureSheet() && m_xlsx.addRow({XlsxCell(text)});
+}
+
+bool XlsxReportWriter::endReport()
+{
+    return m_xlsx.close();
+}
@@ -0,0 +1,333 @@
+#include "reports/scheduledreportrunner.h"
+#include "database/database.h"
+#include "database/readconnectionpool.h"
+#include "reports/reportcodec.h"
+#include <QtConcurrent/QtConcurrentRun>
+#include <QFutureWatcher>
+#include <QTimer>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QStandardPaths>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+
+namespace {
+
+const int kWorkerThreads = 2;
+// Wake at least hourly so clock changes and suspend are picked up
+const qint64 kMaxSleepMs = 60 * 60 * 1000;
+
+// Stored JSON parameters, with the reporting window filled in from the
+// schedule when it has no fixed dates: the day, week or month up to the run
+QMap<QString, QVariant> runParameters(const ScheduledReport &report, const QDateTime &runTime)
+{
+    QMap<QString, QVariant> parameters = QJsonDocument::fromJson(report.parameters.toUtf8()).object().toVariantMap();
+
+    if (!parameters.contains("from_date") || !parameters.contains("to_date")) {
+        QDate toDate = runTime.date();
+        QString type = report.scheduleType.toLower();
+        QDate fromDate = toDate;
+        if (type == "weekly") {
+            fromDate = toDate.addDays(-6);
+        } else if (type == "monthly") {
+            fromDate = toDate.addMonths(-1).addDays(1);
+        }
+        parameters["from_date"] = fromDate;
+        parameters["to_date"] = toDate;
+    }
+
+    return parameters;
+}
+
+QString fileNameFor(const ScheduledReport &report, const QDateTime &runTime, const QString &extension)
+{
+    QString name = report.reportName.isEmpty() ? report.reportType : report.reportName;
+    for (QChar &c : name) {
+        if (!c.isLetterOrNumber() && c != '-' && c != '_') {
+            c = '_';
+        }
+    }
+    return QString("%1_%2.%3").arg(name, runTime.toString("yyyyMMdd_HHmm"), extension);
+}
+
+} // namespace
+
+ScheduledReportRunner::ScheduledReportRunner(AdvancedReports *reports, QObject *parent)
+    : QObject(parent)
+    , m_reports(reports)
+    , m_pool(nullptr)
+    , m_timer(new QTimer(this))
+    , m_outputDirectory(QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation) + "/Scheduled Reports")
+    , m_active(false)
+{
+    m_timer->setSingleShot(true);
+    connect(m_timer, &QTimer::timeout, this, &ScheduledReportRunner::runDueReports);
+    connect(m_reports, &AdvancedReports::scheduleChanged, this, &ScheduledReportRunner::reload);
+}
+
+ScheduledReportRunner::~ScheduledReportRunner()
+{
+    // Waits for reports still being generated
+    delete m_pool;
+}
+
+void ScheduledReportRunner::start()
+{
+    if (!m_pool) {
+        m_pool = new ReadConnectionPool(Database::instance().database().databaseName(), kWorkerThreads);
+        m_pool->threadPool()->setThreadPriority(QThread::LowestPriority);
+    }
+
+    m_active = true;
+    reload();
+}
+
+void ScheduledReportRunner::stop()
+{
+    // Reports already running finish and are recorded as usual
+    m_active = false;
+    m_timer->stop();
+}
+
+void ScheduledReportRunner::reload()
+{
+    if (!m_active) {
+        return;
+    }
+
+    m_schedules.clear();
+    m_queue = decltype(m_queue)();
+
+    const QList<ScheduledReport> reports = m_reports->getScheduledReports();
+    for (const ScheduledReport &report : reports) {
+        if (!report.nextRun.isValid()) {
+            qDebug() << "Scheduled report has no next run:" << report.reportName;
+            continue;
+        }
+        // Saved before scheduling checked the type; it would only ever fail
+        if (!AdvancedReports::canBuildReport(report.reportType)) {
+            qDebug() << "Scheduled report type cannot be built in the background:" << report.reportName;
+            continue;
+        }
+
+        m_schedules.insert(report.id, report);
+        // A running report is queued again when it finishes
+        if (!m_running.contains(report.id)) {
+            m_queue.push({report.nextRun, report.id});
+        }
+    }
+
+    arm();
+}
+
+void ScheduledReportRunner::arm()
+{
+    if (!m_active || m_queue.empty()) {
+        m_timer->stop();
+        return;
+    }
+
+    qint64 wait = QDateTime::currentDateTime().msecsTo(m_queue.top().due);
+    m_timer->start(static_cast<int>(qBound<qint64>(0, wait, kMaxSleepMs)));
+}
+
+void ScheduledReportRunner::runDueReports()
+{
+    QDateTime now = QDateTime::currentDateTime();
+
+    while (!m_queue.empty() && m_queue.top().due <= now) {
+        QueuedRun run = m_queue.top();
+        m_queue.pop();
+
+        // Left behind by a reload or an earlier run
+        auto it = m_schedules.constFind(run.scheduleId);
+        if (it == m_schedules.constEnd() || it->nextRun != run.due || m_running.contains(run.scheduleId)) {
+            continue;
+        }
+
+        dispatch(it.value());
+    }
+
+    arm();
+}
+
+void ScheduledReportRunner::dispatch(const ScheduledReport &report)
+{
+    m_running.insert(report.id);
+    emit reportStarted(report.id, report.reportName);
+
+    ReadConnectionPool *pool = m_pool;
+    AdvancedReports *reports = m_reports;
+    QString directory = m_outputDirectory;
+    QDateTime runTime = QDateTime::currentDateTime();
+
+    QFutureWatcher<RunResult> *watcher = new QFutureWatcher<RunResult>(this);
+    connect(watcher, &QFutureWatcher<RunResult>::finished, this, [this, watcher, report]() {
+        finishRun(report, watcher->result());
+        watcher->deleteLater();
+    });
+
+    // The pool queues past its thread limit, so only kWorkerThreads run at once
+    watcher->setFuture(QtConcurrent::run(m_pool->threadPool(), [=]() {
+        return execute(pool, reports, report, runTime, directory);
+    }));
+}
+
+ScheduledReportRunner::RunResult ScheduledReportRunner::execute(ReadConnectionPool *pool, AdvancedReports *reports,
+                                                                const ScheduledReport &report,
+                                                                const QDateTime &runTime, const QString &directory)
+{
+    QElapsedTimer timer;
+    timer.start();
+    RunResult result;
+
+    QSqlDatabase db = pool->connection();
+    ReportData data;
+    if (db.isValid()) {
+        data = AdvancedReports::buildReport(db, report.reportType, runParameters(report, runTime));
+    } else {
+        data.error = "Database unavailable";
+    }
+    result.error = data.error;
+
+    if (!data.jsonData.isNull() && QDir().mkpath(directory)) {
+        QString format = report.outputFormat.toUpper();
+        if (format == "EXCEL" || format == "XLSX") {
+            result.filePath = QDir(directory).filePath(fileNameFor(report, runTime, "xlsx"));
+            result.success = reports->exportReportToExcel(data, result.filePath);
+        } else if (format == "CSV") {
+            result.filePath = QDir(directory).filePath(fileNameFor(report, runTime, "csv"));
+            result.success = reports->exportReportToCSV(data, result.filePath);
+        } else {
+            result.filePath = QDir(directory).filePath(fileNameFor(report, runTime, "pdf"));
+            result.success = reports->exportReportToPDF(data, result.filePath);
+        }
+        result.fileSize = QFileInfo(result.filePath).size();
+    }
+
+    if (result.success) {
+        result.archive = ReportCodec::encode(data);
+    }
+
+    result.durationMs = timer.elapsed();
+    return result;
+}
+
+void ScheduledReportRunner::finishRun(const ScheduledReport &report, const RunResult &result)
+{
+    m_running.remove(report.id);
+    QDateTime now = QDateTime::currentDateTime();
+
+    if (!result.success) {
+        qDebug() << "Scheduled report failed:" << report.reportName << result.error;
+    }
+
+    QSqlQuery query(Database::instance().database());
+    query.prepare("INSERT INTO report_history (report_name, report_type, parameters, generated_date, "
+                  "file_path, file_size, duration_ms, generated_by, status, report_data) "
+                  "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    query.addBindValue(report.reportName);
+    query.addBindValue(report.reportType);
+    query.addBindValue(report.parameters);
+    query.addBindValue(now);
+    query.addBindValue(result.filePath);
+    query.addBindValue(result.fileSize);
+    query.addBindValue(result.durationMs);
+    query.addBindValue("Scheduler");
+    query.addBindValue(result.success ? "Generated" : "Failed");
+    query.addBindValue(result.archive.isEmpty() ? QVariant() : QVariant(result.archive));
+    if (!query.exec()) {
+        qDebug() << "Failed to record report run:" << query.lastError().text();
+    }
+
+    if (result.success) {
+        queueEmails(report, result);
+    }
+
+    // A failed run is not retried; the schedule simply moves on. Missed
+    // periods collapse into the one run that just happened.
+    bool scheduled = m_schedules.contains(report.id);
+    ScheduledReport current = scheduled ? m_schedules.value(report.id) : report;
+    QDateTime nextRun = followingRun(current, now);
+
+    query.prepare("UPDATE scheduled_reports SET last_run = ?, next_run = COALESCE(?, next_run), active = ? WHERE id = ?");
+    query.addBindValue(now);
+    query.addBindValue(nextRun.isValid() ? QVariant(nextRun) : QVariant());
+    query.addBindValue(nextRun.isValid() && current.active);
+    query.addBindValue(report.id);
+    if (!query.exec()) {
+        qDebug() << "Failed to advance scheduled report:" << query.lastError().text();
+    }
+
+    if (scheduled && nextRun.isValid()) {
+        m_schedules[report.id].nextRun = nextRun;
+        m_queue.push({nextRun, report.id});
+    } else {
+        m_schedules.remove(report.id);
+    }
+
+    emit reportFinished(report.id, result.filePath, result.success);
+    arm();
+}
+
+void ScheduledReportRunner::queueEmails(const ScheduledReport &report, const RunResult &result)
+{
+    // scheduled_messages carries no attachments, so the mail names the file
+    QString subject = "Scheduled report: " + report.reportName;
+    QString content = QString("The scheduled report \"%1\" (%2) was generated on %3.\n\n"
+                              "File: %4 (%5 KB)")
+                          .arg(report.reportName, report.reportType,
+                               QDateTime::currentDateTime().toString("dd/MM/yyyy hh:mm"),
+                               result.filePath)
+                          .arg((result.fileSize + 1023) / 1024);
+
+    QSqlQuery query(Database::instance().database());
+    query.prepare("INSERT INTO scheduled_messages (recipient, type, subject, content, "
+                  "scheduled_time, created_by, status) VALUES (?, ?, ?, ?, ?, ?, ?)");
+
+    for (const QString &recipient : report.emailRecipients) {
+        if (recipient.trimmed().isEmpty()) {
+            continue;
+        }
+
+        query.bindValue(0, recipient.trimmed());
+        query.bindValue(1, "Email");
+        query.bindValue(2, subject);
+        query.bindValue(3, content);
+        query.bindValue(4, QDateTime::currentDateTime());
+        query.bindValue(5, "Scheduler");
+        query.bindValue(6, "Scheduled");
+
+        if (!query.exec()) {
+            qDebug() << "Failed to queue report email:" << query.lastError().text();
+        }
+    }
+}
+
+QDateTime ScheduledReportRunner::followingRun(const ScheduledReport &report, const QDateTime &after)
+{
+    QString type = report.scheduleType.toLower();
+    if (!report.nextRun.isValid() || (type != "daily" && type != "weekly" && type != "monthly")) {
+        return QDateTime();
+    }
+
+    // Stepped from the scheduled time so the time of day does not drift
+    QDateTime next = report.nextRun;
+    int steps = 0;
+    while (next <= after) {
+        ++steps;
+        if (type == "daily") {
+            next = report.nextRun.addDays(steps);
+        } else if (type == "weekly") {
+            next = report.nextRun.addDays(7 * steps);
+        } else {
+            next = report.nextRun.addMonths(steps);
+        }
+    }
+    return next;
+}
@@ -0,0 +1,59 @@
+#include "utils/bufferedwriter.h"
+#include <QIODevice>
+#include <QDebug>
+
+BufferedWriter::BufferedWriter(QIODevice *device, int capacity)
+    : m_device(device)
+    , m_capacity(capacity > 0 ? capacity : 64 * 1024)
+    , m_bytesWritten(0)
+    , m_error(false)
+{
+    m_buffer.reserve(m_capacity);
+}
+
+BufferedWriter::~BufferedWriter()
+{
+    flush();
+}
+
+bool BufferedWriter::write(const char *data, qint64 size)
+{
+    if (m_error || size <= 0) {
+        return !m_error;
+    }
+    
+    if (m_buffer.size() + size > m_capacity && !flush()) {
+        return false;
+    }
+    
+    // Payloads larger than the buffer go straight to the device
+    if (size >= m_capacity) {
+        if (m_device->write(data, size) != size) {
+            qDebug() << "Buffered write failed:" << m_device->errorString();
+            m_error = true;
+            return false;
+        }
+        m_bytesWritten += size;
+        return true;
+    }
+    
+    m_buffer.append(data, size);
+    return true;
+}
+
+bool BufferedWriter::flush()
+{
+    if (m_error || m_buffer.isEmpty()) {
+        return !m_error;
+    }
+    
+    if (m_device->write(m_buffer) != m_buffer.size()) {
+        qDebug() << "Buffered write failed:" << m_device->errorString();
+        m_error = true;
+        return false;
+    }
+    
+    m_bytesWritten += m_buffer.size();
+    m_buffer.resize(0); // Keeps the reserved capacity
+    return true;
+}
@@ -0,0 +1,308 @@
+#include "utils/xlsxwriter.h"
+#include <QIODevice>
+#include <QDate>
+#include <QDateTime>
+#include <QDebug>
+
+namespace {
+
+const char *const kXmlHeader = "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n";
+const char *const kMainNamespace = "http://schemas.openxmlformats.org/spreadsheetml/2006/main";
+const char *const kRelNamespace = "http://schemas.openxmlformats.org/officeDocument/2006/relationships";
+
+// cellXfs in the same order as XlsxWriter::Style
+const char *const kStyles =
+    "<styleSheet xmlns=\"http://schemas.openxmlformats.org/spreadsheetml/2006/main\">"
+    "<numFmts count=\"1\"><numFmt numFmtId=\"164\" formatCode=\"yyyy-mm-dd\"/></numFmts>"
+    "<fonts count=\"2\">"
+    "<font><sz val=\"11\"/><name val=\"Calibri\"/></font>"
+    "<font><b/><sz val=\"11\"/><name val=\"Calibri\"/></font>"
+    "</fonts>"
+    "<fills count=\"3\">"
+    "<fill><patternFill patternType=\"none\"/></fill>"
+    "<fill><patternFill patternType=\"gray125\"/></fill>"
+    "<fill><patternFill patternType=\"solid\"><fgColor rgb=\"FFE0E0E0\"/><bgColor indexed=\"64\"/></patternFill></fill>"
+    "</fills>"
+    "<borders count=\"1\"><border><left/><right/><top/><bottom/><diagonal/></border></borders>"
+    "<cellStyleXfs count=\"1\"><xf numFmtId=\"0\" fontId=\"0\" fillId=\"0\" borderId=\"0\"/></cellStyleXfs>"
+    "<cellXfs count=\"6\">"
+    "<xf numFmtId=\"0\" fontId=\"0\" fillId=\"0\" borderId=\"0\" xfId=\"0\"/>"
+    "<xf numFmtId=\"0\" fontId=\"1\" fillId=\"2\" borderId=\"0\" xfId=\"0\" applyFont=\"1\" applyFill=\"1\"/>"
+    "<xf numFmtId=\"1\" fontId=\"0\" fillId=\"0\" borderId=\"0\" xfId=\"0\" applyNumberFormat=\"1\"/>"
+    "<xf numFmtId=\"2\" fontId=\"0\" fillId=\"0\" borderId=\"0\" xfId=\"0\" applyNumberFormat=\"1\"/>"
+    "<xf numFmtId=\"10\" fontId=\"0\" fillId=\"0\" borderId=\"0\" xfId=\"0\" applyNumberFormat=\"1\"/>"
+    "<xf numFmtId=\"164\" fontId=\"0\" fillId=\"0\" borderId=\"0\" xfId=\"0\" applyNumberFormat=\"1\"/>"
+    "</cellXfs>"
+    "<cellStyles count=\"1\"><cellStyle name=\"Normal\" xfId=\"0\" builtinId=\"0\"/></cellStyles>"
+    "</styleSheet>";
+
+// Excel's day 0 (with the 1900 leap-year bug folded in)
+const QDate kExcelEpoch(1899, 12, 30);
+
+QString sheetName(const QString &name, const QStringList &existing)
+{
+    QString clean;
+    for (const QChar &c : name) {
+        clean += QString("[]:*?/\\").contains(c) ? QChar('_') : c;
+    }
+    clean = clean.trimmed().left(31);
+    if (clean.isEmpty()) {
+        clean = "Sheet";
+    }
+
+    QString unique = clean;
+    for (int n = 2; existing.contains(unique, Qt::CaseInsensitive); ++n) {
+        QString suffix = QString(" (%1)").arg(n);
+        unique = clean.left(31 - suffix.size()) + suffix;
+    }
+    return unique;
+}
+
+} // namespace
+
+XlsxWriter::XlsxWriter(QIODevice *device)
+    : m_zip(device)
+    , m_inSheet(false)
+    , m_rowCount(0)
+{
+}
+
+XlsxWriter::~XlsxWriter()
+{
+}
+
+QString XlsxWriter::columnName(int column)
+{
+    QString name;
+    for (int n = column + 1; n > 0; n = (n - 1) / 26) {
+        name.prepend(QChar('A' + (n - 1) % 26));
+    }
+    return name;
+}
+
+QString XlsxWriter::escape(const QString &text)
+{
+    bool plain = true;
+    for (const QChar &c : text) {
+        if (c == '&' || c == '<' || c == '>' || c == '"' || c.unicode() < 0x20) {
+            plain = false;
+            break;
+        }
+    }
+    if (plain) {
+        return text;
+    }
+
+    QString escaped;
+    escaped.reserve(text.size() + 16);
+    for (const QChar &c : text) {
+        switch (c.unicode()) {
+        case '&': escaped += "&amp;"; break;
+        case '<': escaped += "&lt;"; break;
+        case '>': escaped += "&gt;"; break;
+        case '"': escaped += "&quot;"; break;
+        case '\t': case '\n': case '\r': escaped += c; break;
+        default:
+            // Other control characters are not allowed in XML 1.0
+            if (c.unicode() >= 0x20) {
+                escaped += c;
+            }
+            break;
+        }
+    }
+    return escaped;
+}
+
+int XlsxWriter::defaultStyle(const QVariant &value)
+{
+    switch (value.typeId()) {
+    case QMetaType::QDate:
+    case QMetaType::QDateTime:
+        return Date;
+    default:
+        return General;
+    }
+}
+
+bool XlsxWriter::writeSheetData(const QString &xml)
+{
+    return m_zip.write(xml.toUtf8());
+}
+
+bool XlsxWriter::beginSheet(const QString &name, int frozenRows, const QList<double> &columnWidths)
+{
+    if (m_inSheet && !endSheet()) {
+        return false;
+    }
+
+    m_sheetNames.append(sheetName(name, m_sheetNames));
+    m_rowCount = 0;
+
+    if (!m_zip.beginEntry(QString("xl/worksheets/sheet%1.xml").arg(m_sheetNames.size()))) {
+        return false;
+    }
+    m_inSheet = true;
+
+    QString xml = kXmlHeader;
+    xml += QString("<worksheet xmlns=\"%1\" xmlns:r=\"%2\">").arg(kMainNamespace, kRelNamespace);
+
+    xml += QString("<sheetViews><sheetView workbookViewId=\"0\"%1>")
+               .arg(m_sheetNames.size() == 1 ? " tabSelected=\"1\"" : "");
+    if (frozenRows > 0) {
+        xml += QString("<pane ySplit=\"%1\" topLeftCell=\"A%2\" activePane=\"bottomLeft\" state=\"frozen\"/>"
+                       "<selection pane=\"bottomLeft\"/>")
+                   .arg(frozenRows).arg(frozenRows + 1);
+    }
+    xml += "</sheetView></sheetViews>";
+    xml += "<sheetFormatPr defaultRowHeight=\"15\"/>";
+
+    if (!columnWidths.isEmpty()) {
+        xml += "<cols>";
+        for (int i = 0; i < columnWidths.size(); ++i) {
+            xml += QString("<col min=\"%1\" max=\"%1\" width=\"%2\" customWidth=\"1\"/>")
+                       .arg(i + 1).arg(columnWidths.at(i));
+        }
+        xml += "</cols>";
+    }
+
+    xml += "<sheetData>";
+    return writeSheetData(xml);
+}
+
+bool XlsxWriter::addRow(const QVariantList &values, int style)
+{
+    QList<XlsxCell> cells;
+    cells.reserve(values.size());
+    for (const QVariant &value : values) {
+        cells.append(XlsxCell(value, style));
+    }
+    return addRow(cells);
+}
+
+bool XlsxWriter::addRow(const QList<XlsxCell> &cells)
+{
+    if (!m_inSheet) {
+        qDebug() << "XLSX row written outside a sheet";
+        return false;
+    }
+
+    int row = ++m_rowCount;
+    m_rowXml.resize(0);
+    m_rowXml += QString("<row r=\"%1\">").arg(row);
+
+    for (int column = 0; column < cells.size(); ++column) {
+        const XlsxCell &cell = cells.at(column);
+        const QVariant &value = cell.value;
+        int style = cell.style >= 0 ? cell.style : defaultStyle(value);
+
+        if (cell.formula.isEmpty() && (!value.isValid() || value.isNull()) && style == General) {
+            continue;
+        }
+
+        m_rowXml += "<c r=\"" + cellReference(column, row) + "\"";
+        if (style != General) {
+            m_rowXml += QString(" s=\"%1\"").arg(style);
+        }
+
+        if (!cell.formula.isEmpty()) {
+            m_rowXml += "><f>" + escape(cell.formula) + "</f></c>";
+            continue;
+        }
+
+        switch (value.typeId()) {
+        case QMetaType::Int:
+        case QMetaType::UInt:
+        case QMetaType::LongLong:
+        case QMetaType::ULongLong:
+            m_rowXml += "><v>" + QString::number(value.toLongLong()) + "</v></c>";
+            break;
+        case QMetaType::Double:
+        case QMetaType::Float:
+            m_rowXml += "><v>" + QString::number(value.toDouble(), 'g', 15) + "</v></c>";
+            break;
+        case QMetaType::Bool:
+            m_rowXml += QString(" t=\"b\"><v>%1</v></c>").arg(value.toBool() ? 1 : 0);
+            break;
+        case QMetaType::QDate:
+            m_rowXml += "><v>" + QString::number(kExcelEpoch.daysTo(value.toDate())) + "</v></c>";
+            break;
+        case QMetaType::QDateTime: {
+            QDateTime dateTime = value.toDateTime();
+            double serial = kExcelEpoch.daysTo(dateTime.date()) + dateTime.time().msecsSinceStartOfDay() / 86400000.0;
+            m_rowXml += "><v>" + QString::number(serial, 'g', 15) + "</v></c>";
+            break;
+        }
+        default:
+            if (!value.isValid() || value.isNull()) {
+                m_rowXml += "/>";
+            } else {
+                m_rowXml += " t=\"inlineStr\"><is><t xml:space=\"preserve\">" + escape(value.toString()) + "</t></is></c>";
+            }
+            break;
+        }
+    }
+
+    m_rowXml += "</row>";
+    return writeSheetData(m_rowXml);
+}
+
+bool XlsxWriter::endSheet()
+{
+    if (!m_inSheet) {
+        return !hasError();
+    }
+    m_inSheet = false;
+
+    return writeSheetData("</sheetData></worksheet>") && m_zip.endEntry();
+}
+
+bool XlsxWriter::close()
+{
+    if (m_inSheet && !endSheet()) {
+        return false;
+    }
+    if (m_sheetNames.isEmpty() && !(beginSheet("Sheet1", 0) && endSheet())) {
+        return false;
+    }
+
+    QString contentTypes = kXmlHeader;
+    contentTypes += "<Types xmlns=\"http://schemas.openxmlformats.org/package/2006/content-types\">"
+                    "<Default Extension=\"rels\" ContentType=\"application/vnd.openxmlformats-package.relationships+xml\"/>"
+                    "<Default Extension=\"xml\" ContentType=\"application/xml\"/>"
+                    "<Override PartName=\"/xl/workbook.xml\" ContentType=\"application/vnd.openxmlformats-officedocument.spreadsheetml.sheet.main+xml\"/>"
+                    "<Override PartName=\"/xl/styles.xml\" ContentType=\"application/vnd.openxmlformats-officedocument.spreadsheetml.styles+xml\"/>";
+    for (int i = 1; i <= m_sheetNames.size(); ++i) {
+        contentTypes += QString("<Override PartName=\"/xl/worksheets/sheet%1.xml\" "
+                                "ContentType=\"application/vnd.openxmlformats-officedocument.spreadsheetml.worksheet+xml\"/>").arg(i);
+    }
+    contentTypes += "</Types>";
+
+    QString rootRels = kXmlHeader;
+    rootRels += "<Relationships xmlns=\"http://schemas.openxmlformats.org/package/2006/relationships\">"
+                "<Relationship Id=\"rId1\" Type=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships/officeDocument\" "
+                "Target=\"xl/workbook.xml\"/>"
+                "</Relationships>";
+
+    QString workbook = kXmlHeader;
+    workbook += QString("<workbook xmlns=\"%1\" xmlns:r=\"%2\"><sheets>").arg(kMainNamespace, kRelNamespace);
+    QString workbookRels = kXmlHeader;
+    workbookRels += "<Relationships xmlns=\"http://schemas.openxmlformats.org/package/2006/relationships\">";
+    for (int i = 1; i <= m_sheetNames.size(); ++i) {
+        workbook += QString("<sheet name=\"%1\" sheetId=\"%2\" r:id=\"rId%2\"/>").arg(escape(m_sheetNames.at(i - 1))).arg(i);
+        workbookRels += QString("<Relationship Id=\"rId%1\" "
+                                "Type=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships/worksheet\" "
+                                "Target=\"worksheets/sheet%1.xml\"/>").arg(i);
+    }
+    workbook += "</sheets></workbook>";
+    workbookRels += QString("<Relationship Id=\"rId%1\" "
+                            "Type=\"http://schemas.openxmlformats.org/officeDocument/2006/relationships/styles\" "
+                            "Target=\"styles.xml\"/>").arg(m_sheetNames.size() + 1);
+    workbookRels += "</Relationships>";
+
+    return m_zip.addEntry("[Content_Types].xml", contentTypes.toUtf8())
+        && m_zip.addEntry("_rels/.rels", rootRels.toUtf8())
+        && m_zip.addEntry("xl/workbook.xml", workbook.toUtf8())
+        && m_zip.addEntry("xl/_rels/workbook.xml.rels", workbookRels.toUtf8())
+        && m_zip.addEntry("xl/styles.xml", QByteArray(kXmlHeader) + kStyles)
+        && m_zip.finish();
+}
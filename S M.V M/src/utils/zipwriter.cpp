@@ -0,0 +1,301 @@
+#include "utils/zipwriter.h"
+#include <QIODevice>
+#include <QDateTime>
+#include <QDebug>
+#include <QVector>
+
+#ifdef SMARTMAVI_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+const int kChunkSize = 64 * 1024;
+const quint16 kMethodStored = 0;
+const quint16 kMethodDeflated = 8;
+const quint16 kFlagUtf8Names = 0x0800;
+
+QVector<quint32> buildCrcTable()
+{
+    QVector<quint32> table(256);
+    for (quint32 i = 0; i < 256; ++i) {
+        quint32 value = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+        }
+        table[i] = value;
+    }
+    return table;
+}
+
+quint32 updateCrc(quint32 crc, const char *data, qint64 size)
+{
+    static const QVector<quint32> table = buildCrcTable();
+    crc = ~crc;
+    for (qint64 i = 0; i < size; ++i) {
+        crc = table[(crc ^ static_cast<quint8>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void appendLe16(QByteArray &out, quint16 value)
+{
+    out.append(static_cast<char>(value & 0xFF));
+    out.append(static_cast<char>(value >> 8));
+}
+
+void appendLe32(QByteArray &out, quint32 value)
+{
+    appendLe16(out, static_cast<quint16>(value & 0xFFFF));
+    appendLe16(out, static_cast<quint16>(value >> 16));
+}
+
+} // namespace
+
+struct ZipWriter::Deflater {
+#ifdef SMARTMAVI_HAVE_ZLIB
+    z_stream stream;
+    bool active = false;
+#endif
+    int level = 5;
+};
+
+ZipWriter::ZipWriter(QIODevice *device, int compressionLevel)
+    : m_device(device)
+    , m_deflater(new Deflater)
+    , m_inEntry(false)
+    , m_error(false)
+{
+    m_deflater->level = compressionLevel;
+
+    // One timestamp for the whole archive, in MS-DOS format
+    QDateTime now = QDateTime::currentDateTime();
+    m_dosTime = static_cast<quint16>((now.time().hour() << 11) | (now.time().minute() << 5) | (now.time().second() / 2));
+    m_dosDate = static_cast<quint16>(((qMax(1980, now.date().year()) - 1980) << 9) | (now.date().month() << 5) | now.date().day());
+
+    if (m_device->isSequential()) {
+        fail("ZIP output must be seekable");
+    }
+}
+
+ZipWriter::~ZipWriter()
+{
+#ifdef SMARTMAVI_HAVE_ZLIB
+    if (m_deflater->active) {
+        deflateEnd(&m_deflater->stream);
+    }
+#endif
+    delete m_deflater;
+}
+
+bool ZipWriter::fail(const QString &reason)
+{
+    if (!m_error) {
+        qDebug() << "ZIP write failed:" << reason;
+    }
+    m_error = true;
+    return false;
+}
+
+bool ZipWriter::writeDevice(const QByteArray &data)
+{
+    if (m_error) {
+        return false;
+    }
+    if (m_device->write(data) != data.size()) {
+        return fail(m_device->errorString());
+    }
+    return true;
+}
+
+bool ZipWriter::beginEntry(const QString &name)
+{
+    if (m_error || (m_inEntry && !endEntry())) {
+        return false;
+    }
+
+    if (m_device->pos() > 0xFFFFFFFFLL) {
+        return fail("archive exceeds 4 GB");
+    }
+
+    m_current = EntryRecord();
+    m_current.name = name.toUtf8();
+    m_current.offset = static_cast<quint32>(m_device->pos());
+    m_current.method = kMethodStored;
+
+#ifdef SMARTMAVI_HAVE_ZLIB
+    if (m_deflater->active) {
+        deflateReset(&m_deflater->stream);
+    } else {
+        m_deflater->stream = z_stream();
+        // Negative window bits: raw deflate, which is what ZIP stores
+        if (deflateInit2(&m_deflater->stream, m_deflater->level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return fail("cannot initialise deflate");
+        }
+        m_deflater->active = true;
+    }
+    m_current.method = kMethodDeflated;
+#endif
+
+    // CRC and sizes are zero here and patched in endEntry()
+    QByteArray header;
+    appendLe32(header, 0x04034b50);
+    appendLe16(header, 20);
+    appendLe16(header, kFlagUtf8Names);
+    appendLe16(header, m_current.method);
+    appendLe16(header, m_dosTime);
+    appendLe16(header, m_dosDate);
+    appendLe32(header, 0);
+    appendLe32(header, 0);
+    appendLe32(header, 0);
+    appendLe16(header, static_cast<quint16>(m_current.name.size()));
+    appendLe16(header, 0);
+    header.append(m_current.name);
+
+    m_input.clear();
+    m_input.reserve(kChunkSize);
+    m_inEntry = writeDevice(header);
+    return m_inEntry;
+}
+
+bool ZipWriter::write(const char *data, qint64 size)
+{
+    if (m_error || !m_inEntry) {
+        return fail("write outside an entry");
+    }
+
+    m_current.crc = updateCrc(m_current.crc, data, size);
+    if (quint64(m_current.size) + size > 0xFFFFFFFFULL) {
+        return fail("entry exceeds 4 GB");
+    }
+    m_current.size += static_cast<quint32>(size);
+
+    while (size > 0) {
+        qint64 take = qMin<qint64>(size, kChunkSize - m_input.size());
+        m_input.append(data, take);
+        data += take;
+        size -= take;
+
+        if (m_input.size() >= kChunkSize && !compressInput(false)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ZipWriter::compressInput(bool finish)
+{
+#ifdef SMARTMAVI_HAVE_ZLIB
+    z_stream &stream = m_deflater->stream;
+    stream.next_in = reinterpret_cast<Bytef *>(m_input.data());
+    stream.avail_in = static_cast<uInt>(m_input.size());
+
+    QByteArray output(kChunkSize, Qt::Uninitialized);
+    int result = Z_OK;
+    do {
+        stream.next_out = reinterpret_cast<Bytef *>(output.data());
+        stream.avail_out = static_cast<uInt>(output.size());
+        result = deflate(&stream, finish ? Z_FINISH : Z_NO_FLUSH);
+        if (result == Z_STREAM_ERROR) {
+            return fail("deflate failed");
+        }
+
+        int produced = output.size() - static_cast<int>(stream.avail_out);
+        if (produced > 0) {
+            if (!writeDevice(QByteArray::fromRawData(output.constData(), produced))) {
+                return false;
+            }
+            m_current.compressedSize += static_cast<quint32>(produced);
+        }
+    } while (stream.avail_out == 0 || (finish && result != Z_STREAM_END));
+#else
+    Q_UNUSED(finish)
+    if (!writeDevice(m_input)) {
+        return false;
+    }
+    m_current.compressedSize += static_cast<quint32>(m_input.size());
+#endif
+
+    m_input.resize(0);
+    return true;
+}
+
+bool ZipWriter::endEntry()
+{
+    if (m_error || !m_inEntry) {
+        return !m_error;
+    }
+    m_inEntry = false;
+
+    if (!compressInput(true)) {
+        return false;
+    }
+
+    // Patch CRC and sizes into the local header, then return to the end
+    qint64 end = m_device->pos();
+    QByteArray sizes;
+    appendLe32(sizes, m_current.crc);
+    appendLe32(sizes, m_current.compressedSize);
+    appendLe32(sizes, m_current.size);
+
+    if (!m_device->seek(m_current.offset + 14) || !writeDevice(sizes) || !m_device->seek(end)) {
+        return fail("cannot patch local header");
+    }
+
+    m_entries.append(m_current);
+    return true;
+}
+
+bool ZipWriter::addEntry(const QString &name, const QByteArray &data)
+{
+    return beginEntry(name) && write(data) && endEntry();
+}
+
+bool ZipWriter::finish()
+{
+    if (m_inEntry && !endEntry()) {
+        return false;
+    }
+    if (m_error) {
+        return false;
+    }
+
+    qint64 directoryOffset = m_device->pos();
+    QByteArray directory;
+    for (const EntryRecord &entry : m_entries) {
+        appendLe32(directory, 0x02014b50);
+        appendLe16(directory, 20);
+        appendLe16(directory, 20);
+        appendLe16(directory, kFlagUtf8Names);
+        appendLe16(directory, entry.method);
+        appendLe16(directory, m_dosTime);
+        appendLe16(directory, m_dosDate);
+        appendLe32(directory, entry.crc);
+        appendLe32(directory, entry.compressedSize);
+        appendLe32(directory, entry.size);
+        appendLe16(directory, static_cast<quint16>(entry.name.size()));
+        appendLe16(directory, 0);
+        appendLe16(directory, 0);
+        appendLe16(directory, 0);
+        appendLe16(directory, 0);
+        appendLe32(directory, 0);
+        appendLe32(directory, entry.offset);
+        directory.append(entry.name);
+    }
+
+    quint32 directorySize = static_cast<quint32>(directory.size());
+    if (directoryOffset + directorySize > 0xFFFFFFFFLL) {
+        return fail("archive exceeds 4 GB");
+    }
+
+    appendLe32(directory, 0x06054b50);
+    appendLe16(directory, 0);
+    appendLe16(directory, 0);
+    appendLe16(directory, static_cast<quint16>(m_entries.size()));
+    appendLe16(directory, static_cast<quint16>(m_entries.size()));
+    appendLe32(directory, directorySize);
+    appendLe32(directory, static_cast<quint32>(directoryOffset));
+    appendLe16(directory, 0);
+
+    return writeDevice(directory);
+}
@@ -1,6 +1,9 @@
 #include "widgets/dashboard.h"
 #include "database/database.h"
 #include "reports/reports.h"
+#include "reports/chartseriesbuilder.h"
+#include "reports/analyticscube.h"
+#include "models/nepalicalendar.h"
 #include <QApplication>
 #include <QScreen>
 #include <QMouseEvent>
@@ -582,38 +585,30 @@ void Dashboard::createPerformanceChart()
 void Dashboard::createTrendChart()
 {
     m_trendChart = new QChart();
-    m_trendChart->setTitle("Monthly Attendance Trends");
-    m_trendChart->setAnimationOptions(QChart::SeriesAnimations);
+    m_trendChart->setTitle("Daily Attendance Trend");
+    // Animating hundreds of points on every refresh is slower than it is pretty
+    m_trendChart->setAnimationOptions(QChart::NoAnimation);
     
-    // Create line series for trends
-    QSplineSeries *series = new QSplineSeries();
-    series->setName("Attendance Rate %");
-    series->setColor(QColor("#007bff"));
-    
-    // Sample trend data for past 6 months
-    QDateTime currentDate = QDateTime::currentDateTime();
-    for (int i = -6; i <= 0; ++i) {
-        QDateTime date = currentDate.addMonths(i);
-        double attendance = 85 + (QRandomGenerator::global()->bounded(15)); // 85-100%
-        series->append(date.toMSecsSinceEpoch(), attendance);
-    }
-    
-    m_trendChart->addSeries(series);
+    // Filled by updateTrendChart()
+    m_trendSeries = new QLineSeries();
+    m_trendSeries->setName("Attendance Rate %");
+    m_trendSeries->setColor(QColor("#007bff"));
+    m_trendChart->addSeries(m_trendSeries);
     
     // Create axes
     QDateTimeAxis *axisX = new QDateTimeAxis();
     axisX->setTickCount(7);
-    axisX->setFormat("MMM");
-    axisX->setTitleText("Month");
+    axisX->setFormat("MMM yyyy");
+    axisX->setTitleText("Date");
     m_trendChart->addAxis(axisX, Qt::AlignBottom);
-    series->attachAxis(axisX);
+    m_trendSeries->attachAxis(axisX);
     
     QValueAxis *axisY = new QValueAxis();
     axisY->setLabelFormat("%.0f%%");
     axisY->setTitleText("Attendance Rate");
     axisY->setRange(0, 100);
     m_trendChart->addAxis(axisY, Qt::AlignLeft);
-    series->attachAxis(axisY);
+    m_trendSeries->attachAxis(axisY);
     
     m_trendChartView = new QChartView(m_trendChart);
     m_trendChartView->setRenderHint(QPainter::Antialiasing);
@@ -754,12 +749,56 @@ void Dashboard::updateAttendanceChart()
 
 void Dashboard::updatePerformanceChart()
 {
-    // Update performance chart with current data
+    const QList<QAbstractSeries *> seriesList = m_performanceChart->series();
+    QPieSeries *series = seriesList.isEmpty() ? nullptr : qobject_cast<QPieSeries *>(seriesList.first());
+    if (!series || series->count() < 4) {
+        return;
+    }
+
+    // Classes by their average mark over the last three BS months
+    AnalyticsCube::Query query;
+    query.groupBy = { AnalyticsCube::Grade, AnalyticsCube::Section };
+    query.fromMonth = NepaliCalendar::getNepaliMonthIndex(QDate::currentDate()) - 2;
+
+    int bands[4] = { 0, 0, 0, 0 };
+    const QList<AnalyticsCube::Row> rows = AnalyticsCube::instance().query(query);
+    for (const AnalyticsCube::Row &row : rows) {
+        double percentage = row.measures.averagePercentage();
+        if (percentage < 0) {
+            continue;
+        }
+        ++bands[percentage >= 90 ? 0 : percentage >= 80 ? 1 : percentage >= 70 ? 2 : 3];
+    }
+
+    for (int i = 0; i < 4; ++i) {
+        series->slices().at(i)->setValue(bands[i]);
+    }
 }
 
 void Dashboard::updateTrendChart()
 {
-    // Update trend chart with latest trends
+    if (!m_database) return;
+    
+    // Up to five years of daily rates; the series only ever gets a plot's width of them
+    QDate today = QDate::currentDate();
+    m_trendPoints = ChartSeriesBuilder::dailyAttendance(m_database->database(),
+                                                        today.addYears(-5), today).rate;
+    applyTrendPoints();
+}
+
+void Dashboard::applyTrendPoints()
+{
+    int width = static_cast<int>(m_trendChart->plotArea().width());
+    if (width <= 0) {
+        width = m_trendChartView->width();
+    }
+    ChartSeriesBuilder::replacePoints(m_trendSeries, m_trendPoints, width, ChartSeriesBuilder::Lttb);
+    
+    const QList<QAbstractAxis *> axes = m_trendChart->axes(Qt::Horizontal);
+    if (!axes.isEmpty() && !m_trendPoints.isEmpty()) {
+        axes.first()->setRange(QDateTime::fromMSecsSinceEpoch(static_cast<qint64>(m_trendPoints.first().x())),
+                               QDateTime::fromMSecsSinceEpoch(static_cast<qint64>(m_trendPoints.last().x())));
+    }
 }
 
 void Dashboard::showNotification(const QString &message, NotificationWidget::Type type)
@@ -844,6 +883,9 @@ void Dashboard::onWindowResized(const QSize &size)
     m_currentScreenWidth = size.width();
     m_currentScreenHeight = size.height();
     adjustLayoutForScreenSize();
+    
+    // Re-decimate the stored points for the new width; no query needed
+    applyTrendPoints();
 }
 
 // DashboardAnimator Implementation